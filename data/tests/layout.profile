@@ -0,0 +1,10 @@
+# Address and times run, for subleqc --profile.
+0 1
+9 3
+12 3
+15 3
+18 3
+21 3
+24 3
+27 2
+30 1
@@ -13,3 +13,7 @@ if (-not (Test-Path $build_directory -PathType Container))
 
 clang-cl /Zi "./src/subleq.cpp" /o "./build/subleq.exe"
 clang-cl /Zi "./src/subleqc/subleqc.cpp" /o "./build/subleqc.exe"
+clang-cl /Zi "./src/superopt/superopt.cpp" /o "./build/superopt.exe"
+clang-cl /Zi "./src/subleq-ld/subleq-ld.cpp" /o "./build/subleq-ld.exe"
+clang-cl /Zi "./src/sqgen/sqgen.cpp" /o "./build/sqgen.exe"
+clang-cl /Zi "./src/asmbench/asmbench.cpp" /o "./build/asmbench.exe"
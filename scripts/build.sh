@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# @file build.sh
+# @author agent <agent@local>
+# @date 2026-10-18
+#
+# This is the build script for Linux and other POSIX systems. The benchmarks,
+# the test driver, the server's client, subleq-top and the specializer only
+# build here, since they need fork(), Unix domain sockets, shared memory or
+# /dev/null.
+#
+
+CXX=${CXX:-c++}
+
+mkdir -p build
+
+$CXX -g -O2 -pthread src/subleq.cpp -o build/subleq
+$CXX -g -O2 -pthread src/subleqc/subleqc.cpp -o build/subleqc
+$CXX -g -O2 src/superopt/superopt.cpp -o build/superopt
+$CXX -g -O2 src/subleq-ld/subleq-ld.cpp -o build/subleq-ld
+$CXX -g -O2 src/subleq-client/subleq-client.cpp -o build/subleq-client
+$CXX -g -O2 src/subleq-top/subleq-top.cpp -o build/subleq-top
+$CXX -g -O2 src/subleq-spec/subleq-spec.cpp -o build/subleq-spec
+$CXX -g -O2 -pthread src/bench/bench.cpp -o build/bench
+$CXX -g -O2 src/sqgen/sqgen.cpp -o build/sqgen
+$CXX -g -O2 -pthread src/asmbench/asmbench.cpp -o build/asmbench
+$CXX -g -O2 -pthread src/tester/tester.cpp -o build/tester
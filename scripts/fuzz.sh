@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# @file fuzz.sh
+# @author agent <agent@local>
+# @date 2026-10-18
+#
+# This is a script for fuzzing, from the project root. It builds the fuzzer
+# with coverage and the sanitizers, then runs it with the arguments it's
+# given, e.g. scripts/fuzz.sh assembler --seconds 60.
+#
+
+CXX=${CXX:-c++}
+
+mkdir -p build
+
+$CXX -g -O1 -fno-omit-frame-pointer -fsanitize=address,undefined \
+    -fsanitize-coverage=trace-pc src/fuzz/fuzz.cpp -o build/fuzz || exit 1
+
+build/fuzz "$@"
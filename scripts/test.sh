@@ -0,0 +1,11 @@
+#!/bin/sh
+#
+# @file test.sh
+# @author agent <agent@local>
+# @date 2026-10-18
+#
+# This is a script for running the tests, from the project root, after
+# building with build.sh. Any arguments are the names of the tests to run.
+#
+
+build/tester "$@"
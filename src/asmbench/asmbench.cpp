@@ -0,0 +1,414 @@
+/**
+ * @file asmbench.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * These are the assembler benchmarks. They assemble sources, either the files
+ * they're given or one made up by the generator (see generate.cpp), one phase
+ * at a time, and report how fast each phase went through the source and how
+ * many allocations it made, as tab separated values: one line per source and
+ * phase, and a total for each source.
+ *
+ * The phases are the ones Assemble() goes through with a single thread:
+ * splitting the source into lines, lexing, parsing (which declares and looks
+ * up labels in the symbol table's hash map), and linking, which generates the
+ * code. Then come analyzing the program and writing its image, which subleqc
+ * does next. The parser lexes the source again as it goes, so its time
+ * includes lexing; the lexing phase on its own is there to tell them apart.
+ *
+ * Allocations are counted by standing in for malloc() and friends, which only
+ * works with glibc. Everywhere else they're reported as -1.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/arena.cpp"
+#include "../subleqc/assembler.cpp"
+#include "../subleqc/image.cpp"
+#include "../sqgen/generate.cpp"
+
+
+#define UsageString \
+    "Usage: asmbench [--repeat <count>] [-o <output file>] " \
+    ShapeOptionsString " [<source file>...]\n"
+
+// MAGIC Big enough that every phase takes a while, small enough to
+// generate and assemble in a few seconds.
+#define DEFAULT_SOURCE_SIZE (16 * 1024 * 1024)
+
+// MAGIC Enough runs that the fastest isn't an unlucky one.
+#define DEFAULT_REPEAT_COUNT 3
+
+
+/** Counting allocations. */
+
+#if defined(__GLIBC__)
+
+extern "C" void *__libc_malloc(size_t Size);
+extern "C" void *__libc_calloc(size_t Count, size_t Size);
+extern "C" void *__libc_realloc(void *Pointer, size_t Size);
+
+static unsigned long long AllocationCount = 0;
+static unsigned long long AllocatedSize = 0;
+
+extern "C" void *malloc(size_t Size) noexcept
+{
+    AllocationCount++;
+    AllocatedSize += Size;
+
+    return __libc_malloc(Size);
+}
+
+extern "C" void *calloc(size_t Count, size_t Size) noexcept
+{
+    AllocationCount++;
+    AllocatedSize += Count * Size;
+
+    return __libc_calloc(Count, Size);
+}
+
+extern "C" void *realloc(void *Pointer, size_t Size) noexcept
+{
+    AllocationCount++;
+    AllocatedSize += Size;
+
+    return __libc_realloc(Pointer, Size);
+}
+
+#define COUNTS_ALLOCATIONS 1
+
+#else
+
+static unsigned long long AllocationCount = 0;
+static unsigned long long AllocatedSize = 0;
+
+#define COUNTS_ALLOCATIONS 0
+
+#endif
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    SYNTAX_ERROR,
+    UNKNOWN
+};
+
+struct options {
+    buffer<const char *> SourceFiles;
+    // Where to write the images; they're thrown away by default.
+    const char *OutputFile;
+    // How many times to assemble each source. The fastest run of each phase
+    // is the one reported.
+    unsigned int RepeatCount;
+    // The shape of the source to generate, if no files are given.
+    source_shape Shape;
+};
+
+enum phase {
+    PHASE_LINES,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_CODEGEN,
+    PHASE_ANALYZE,
+    PHASE_WRITE,
+    PHASE_COUNT
+};
+
+static const char *PhaseNames[PHASE_COUNT] = {
+    "lines", "lex", "parse", "codegen", "analyze", "write"
+};
+
+// NOTE Where the lexing phase puts how many tokens it found, so that
+// it isn't optimized away.
+static volatile unsigned int TokenSink;
+
+struct phase_measurement {
+    unsigned long long Nanoseconds;
+    unsigned long long Allocations;
+    unsigned long long AllocatedSize;
+};
+
+
+// MeasurePhase() calls [Function], and fills [Measurement] with how long it
+// took and what it allocated.
+template <typename F>
+static
+void MeasurePhase(phase_measurement *Measurement, F Function)
+{
+    unsigned long long Allocations = AllocationCount;
+    unsigned long long Size = AllocatedSize;
+
+    auto Start = std::chrono::steady_clock::now();
+
+    Function();
+
+    auto End = std::chrono::steady_clock::now();
+
+    Measurement->Nanoseconds =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start)
+            .count();
+    Measurement->Allocations = AllocationCount - Allocations;
+    Measurement->AllocatedSize = AllocatedSize - Size;
+}
+
+// PrintPhase() prints one line of results for the [Size] bytes of the source
+// called [Name].
+static
+void PrintPhase(const char *Name, unsigned int Size, const char *Phase,
+                const phase_measurement *Measurement)
+{
+    double Seconds = Measurement->Nanoseconds / 1e9;
+
+    printf("%s\t%u\t%s\t%.6f\t%.2f\t%lld\t%lld\n",
+           Name,
+           Size,
+           Phase,
+           Seconds,
+           Seconds > 0 ? Size / 1e6 / Seconds : 0.0,
+           COUNTS_ALLOCATIONS ? (long long)Measurement->Allocations : -1ll,
+           COUNTS_ALLOCATIONS ? (long long)Measurement->AllocatedSize : -1ll);
+}
+
+// Benchmark() assembles the [Length] characters of [Source], called [Name],
+// a phase at a time, and prints how each phase went. Returns ERROR, after
+// reporting why, if the source doesn't assemble.
+static
+status_code Benchmark(const char *Name,
+                      const char *Source,
+                      unsigned int Length,
+                      const options *Options)
+{
+    phase_measurement Best[PHASE_COUNT] = { };
+
+    for (unsigned int Run = 0; Run < Options->RepeatCount; Run++)
+    {
+        phase_measurement Measurements[PHASE_COUNT] = { };
+
+        assembler Assembler = { };
+        Assembler.Source       = Source;
+        Assembler.SourceLength = Length;
+        Assembler.ThreadCount  = 1;
+
+        image_facts Facts = { };
+
+        // NOTE These are the steps Assemble() takes, with one chunk.
+        MeasurePhase(&Measurements[PHASE_LINES], [&]()
+        {
+            Reserve<unsigned int>(&Assembler.LineStarts, Length / 8 + 1);
+            IndexLines(Source, Length, &Assembler.LineStarts);
+        });
+
+        MeasurePhase(&Measurements[PHASE_LEX], [&]()
+        {
+            lexer Lexer        = { };
+            Lexer.Source       = Source;
+            Lexer.SourceLength = Length;
+            Lexer.LineStarts   = Assembler.LineStarts.Data;
+            Lexer.LineCount    = Assembler.LineStarts.Length;
+
+            unsigned int TokenCount = 0;
+
+            while (NextToken(&Lexer).Type != NONE)
+                TokenCount++;
+
+            TokenSink = TokenCount;
+        });
+
+        MeasurePhase(&Measurements[PHASE_PARSE], [&]()
+        {
+            chunk Chunk = { };
+            Chunk.Begin = 0;
+            Chunk.End   = Length;
+
+            Append<chunk>(&Assembler.Chunks, Chunk);
+
+            Parse(&Assembler, &Assembler.Chunks[0]);
+        });
+
+        MeasurePhase(&Measurements[PHASE_CODEGEN], [&]()
+        {
+            Link(&Assembler);
+        });
+
+        if (ErrorCount(&Assembler))
+        {
+            ReportErrors(&Assembler.Chunks[0].Errors,
+                         Source,
+                         Length,
+                         &Assembler.LineStarts);
+
+            Empty(&Assembler);
+
+            return ERROR;
+        }
+
+        MeasurePhase(&Measurements[PHASE_ANALYZE], [&]()
+        {
+            AnalyzeImage(&Assembler.Program, 0, &Facts);
+        });
+
+        MeasurePhase(&Measurements[PHASE_WRITE], [&]()
+        {
+            std::ofstream BinaryFile (Options->OutputFile,
+                                      std::ofstream::out |
+                                      std::ofstream::binary);
+
+            WriteImage(&BinaryFile,
+                       Assembler.Program.Data,
+                       Assembler.Program.Length,
+                       0,
+                       true,
+                       false,
+                       &Facts,
+                       NULL);
+
+            BinaryFile.close();
+        });
+
+        Empty<unsigned char>(&Facts.Partition);
+        Empty(&Assembler);
+
+        for (unsigned int i = 0; i < PHASE_COUNT; i++)
+        {
+            if (Run == 0 || Measurements[i].Nanoseconds < Best[i].Nanoseconds)
+                Best[i] = Measurements[i];
+        }
+    }
+
+    phase_measurement Total = { };
+
+    for (unsigned int i = 0; i < PHASE_COUNT; i++)
+    {
+        PrintPhase(Name, Length, PhaseNames[i], &Best[i]);
+
+        // The lexing phase is only there for comparison; the parser lexes
+        // as it goes.
+        if (i == PHASE_LEX)
+            continue;
+
+        Total.Nanoseconds   += Best[i].Nanoseconds;
+        Total.Allocations   += Best[i].Allocations;
+        Total.AllocatedSize += Best[i].AllocatedSize;
+    }
+
+    PrintPhase(Name, Length, "total", &Total);
+
+    fflush(stdout);
+
+    return OK;
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.OutputFile  = "/dev/null";
+    Options.RepeatCount = DEFAULT_REPEAT_COUNT;
+    Options.Shape       = DefaultShape();
+    Options.Shape.Size  = DEFAULT_SOURCE_SIZE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        status<bool> Shaped = ParseShapeOption(argc, argv, &i, &Options.Shape);
+
+        if (Shaped.Status != OK)
+        {
+            Severe("Bad value for \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+        else if (Shaped.unpack())
+        {
+            continue;
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            Options.RepeatCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            Options.OutputFile = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            Severe("Unknown option \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+        else
+        {
+            Append<const char *>(&Options.SourceFiles, argv[i]);
+        }
+    }
+
+    printf("source\tbytes\tphase\tseconds\tmb_per_second\tallocations\t"
+           "allocated_bytes\n");
+
+    exit_status ExitStatus = NORMAL;
+
+    if (!Options.SourceFiles.Length)
+    {
+        buffer<char> Source = { };
+        Reserve<char>(&Source, Options.Shape.Size + 1);
+
+        Generate(&Options.Shape, &Source);
+
+        if (Benchmark("generated", Source.Data, Source.Length,
+                      &Options) != OK)
+        {
+            ExitStatus = SYNTAX_ERROR;
+        }
+
+        Empty<char>(&Source);
+    }
+
+    for (unsigned int i = 0; i < Options.SourceFiles.Length; i++)
+    {
+        const char *Path = Options.SourceFiles[i];
+
+        std::ifstream SourceFile (Path, std::ifstream::in |
+                                        std::ifstream::binary);
+
+        if (!SourceFile)
+        {
+            Error("Failed to open input file \"%s\".\n", Path);
+
+            ExitStatus = UNKNOWN;
+            continue;
+        }
+
+        SourceFile.seekg(0, std::ios::end);
+        long SourceSize = SourceFile.tellg();
+        SourceFile.seekg(0, std::ios::beg);
+
+        buffer<char> Source = { };
+        Reserve<char>(&Source, SourceSize + 1);
+        Source.Length = SourceSize;
+
+        SourceFile.read(Source.Data, SourceSize);
+        Source[SourceSize] = '\0';
+
+        if (Benchmark(Path, Source.Data, Source.Length, &Options) != OK)
+            ExitStatus = SYNTAX_ERROR;
+
+        Empty<char>(&Source);
+    }
+
+    Empty<const char *>(&Options.SourceFiles);
+
+    return ExitStatus;
+}
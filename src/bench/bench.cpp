@@ -0,0 +1,580 @@
+/**
+ * @file bench.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * These are the emulator benchmarks. Each workload in data/bench is assembled
+ * once, then run at a few sizes on every engine that can run it (see
+ * engine.cpp), and the results are printed as tab separated values, one line
+ * per workload, size and engine, so they can be kept and compared.
+ *
+ * A workload's source declares the label "N", the cell its size is written
+ * into, and "array", the start of the memory past its code that it works on.
+ * Each run happens in a process of its own, forked from this one, so its peak
+ * resident set is its own. The run's memory is set up before the clock starts
+ * and checked after it stops; only the engine itself is timed.
+ *
+ * This needs fork(), so it only builds on POSIX systems.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+// POSIX
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/arena.cpp"
+#include "../subleqc/assembler.cpp"
+#include "../subleqc/image.cpp"
+#include "../subleqc/engine.cpp"
+
+
+#define UsageString \
+    "Usage: bench [--data <directory>] [--repeat <count>] " \
+    "[--stats [--self-modifying]] [<workload>...]\n"
+
+#define SIZE_COUNT 3
+
+// MAGIC Enough runs that the fastest isn't an unlucky one.
+#define DEFAULT_REPEAT_COUNT 3
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    BENCH_FAILED,
+    UNKNOWN
+};
+
+struct options {
+    // Where the workloads' sources are.
+    const char *DataDirectory;
+    // How many times to run each workload at each size on each engine. The
+    // fastest run is the one reported.
+    unsigned int RepeatCount;
+    // Whether to run every engine publishing its counters as well (see
+    // stats.cpp), to see what that costs.
+    bool Stats;
+    // Whether to count the instructions that write to code too, when
+    // publishing.
+    bool SelfModifying;
+    // The workloads to run; all of them if none are given.
+    buffer<const char *> Workloads;
+};
+
+// What a workload's memory looks like, and what it should look like after.
+struct workload {
+    const char *Name;
+    unsigned int Sizes[SIZE_COUNT];
+    // How many cells, starting at "array", the workload uses at size [N].
+    unsigned int (*ArrayLength)(unsigned int N);
+    // Fills in the [Array] of a workload of size [N], already zeroed, which
+    // starts at address [Base].
+    void (*Fill)(int *Array, unsigned int Base, unsigned int N);
+    // Whether the [Memory] a workload of size [N] left behind is right.
+    bool (*Check)(const int *Memory, symbol_table *Labels, unsigned int N);
+};
+
+// One run of a workload on an engine.
+struct measurement {
+    unsigned long long Steps;
+    unsigned long long Nanoseconds;
+    // In KiB.
+    long PeakResidentSet;
+    bool Passed;
+};
+
+
+// Address() returns the address of the label [Name] in [Labels], or -1 if
+// it isn't declared.
+static
+long Address(symbol_table *Labels, const char *Name)
+{
+    status<unsigned int> Result = Get(&Labels->Names, Name, strlen(Name));
+
+    if (Result.Status != OK || !Labels->Symbols[Result.unpack()].Defined)
+        return -1;
+
+    return Labels->Symbols[Result.unpack()].Address;
+}
+
+
+/** Workloads. */
+
+// NOTE Not every workload uses every parameter.
+#define Unused(X) (void)(X)
+
+// Random() returns the next number of the xorshift generator at [State].
+static inline
+uint32_t Random(uint32_t *State)
+{
+    *State ^= *State << 13;
+    *State ^= *State >> 17;
+    *State ^= *State << 5;
+
+    return *State;
+}
+
+static const workload Workloads[] = {
+    // Multiplies by adding N times, then divides back by subtracting.
+    {
+        "mul", { 1000, 100000, 1000000 },
+        [](unsigned int N) -> unsigned int { Unused(N); return 0; },
+        [](int *Array, unsigned int Base, unsigned int N)
+        {
+            Unused(Array); Unused(Base); Unused(N);
+        },
+        [](const int *Memory, symbol_table *Labels, unsigned int N) -> bool
+        {
+            return Memory[Address(Labels, "q")] == (int)N;
+        }
+    },
+
+    // Sorts N numbers, in reverse order to start with, by swapping
+    // neighbours.
+    {
+        "bubble", { 100, 300, 1000 },
+        [](unsigned int N) -> unsigned int { return N; },
+        [](int *Array, unsigned int Base, unsigned int N)
+        {
+            Unused(Base);
+
+            for (unsigned int i = 0; i < N; i++)
+                Array[i] = (int)(N - i);
+        },
+        [](const int *Memory, symbol_table *Labels, unsigned int N) -> bool
+        {
+            const int *Array = Memory + Address(Labels, "array");
+
+            for (unsigned int i = 0; i < N; i++)
+            {
+                if (Array[i] != (int)(i + 1))
+                    return false;
+            }
+
+            return true;
+        }
+    },
+
+    // Marks the multiples of every number below N, leaving the primes.
+    {
+        "sieve", { 10000, 100000, 1000000 },
+        [](unsigned int N) -> unsigned int { return N; },
+        [](int *Array, unsigned int Base, unsigned int N)
+        {
+            Unused(Array); Unused(Base); Unused(N);
+        },
+        [](const int *Memory, symbol_table *Labels, unsigned int N) -> bool
+        {
+            const int *Array = Memory + Address(Labels, "array");
+
+            buffer<bool> Composite = { };
+            Reserve<bool>(&Composite, N);
+            Composite.Length = N;
+            std::fill(Composite.Data, Composite.Data + N, false);
+
+            bool Passed = true;
+
+            for (unsigned int i = 2; i < N; i++)
+            {
+                for (unsigned int j = 2 * i; j < N && !Composite[i]; j += i)
+                    Composite[j] = true;
+
+                Passed = Passed && Array[i] == (int)Composite[i];
+            }
+
+            Empty<bool>(&Composite);
+
+            return Passed;
+        }
+    },
+
+    // Copies a string N characters long, and its terminating zero, a
+    // character at a time.
+    {
+        "strcpy", { 10000, 100000, 1000000 },
+        [](unsigned int N) -> unsigned int { return 2 * N + 2; },
+        [](int *Array, unsigned int Base, unsigned int N)
+        {
+            Unused(Base);
+
+            for (unsigned int i = 0; i < N; i++)
+                Array[i] = 'a' + i % 26;
+        },
+        [](const int *Memory, symbol_table *Labels, unsigned int N) -> bool
+        {
+            const int *Array = Memory + Address(Labels, "array");
+
+            return std::equal(Array, Array + N + 1, Array + N + 1);
+        }
+    },
+
+    // Follows a list of N cells, each holding the address of the next one,
+    // in a random order, once around. Every step patches the address into
+    // the instruction that loads it.
+    {
+        "chase", { 10000, 100000, 1000000 },
+        [](unsigned int N) -> unsigned int { return N; },
+        [](int *Array, unsigned int Base, unsigned int N)
+        {
+            buffer<unsigned int> Order = { };
+            Reserve<unsigned int>(&Order, N);
+
+            for (unsigned int i = 0; i < N; i++)
+                Append<unsigned int>(&Order, i);
+
+            // NOTE A fixed seed, so every run chases the same list.
+            uint32_t State = 0x9E3779B9;
+
+            for (unsigned int i = N - 1; i > 0; i--)
+                std::swap(Order[i], Order[Random(&State) % (i + 1)]);
+
+            for (unsigned int i = 0; i < N; i++)
+                Array[Order[i]] = (int)(Base + Order[(i + 1) % N]);
+
+            Empty<unsigned int>(&Order);
+        },
+        [](const int *Memory, symbol_table *Labels, unsigned int N) -> bool
+        {
+            Unused(N);
+
+            return Memory[Address(Labels, "p")] == Address(Labels, "array");
+        }
+    }
+};
+
+#undef Unused
+
+
+/** Measuring. */
+
+// Measure() runs [Program] as [Workload] at size [N] once, with the engine
+// [Checked] says, in a process of its own, publishing its counters if
+// [Publish], counting what's in [Flags] (see stats.cpp). Returns ERROR if that
+// process couldn't be started or died.
+static
+status<measurement> Measure(const buffer<int> *Program,
+                            symbol_table *Labels,
+                            const workload *Workload,
+                            unsigned int N,
+                            bool Checked,
+                            bool Publish,
+                            uint32_t Flags)
+{
+    status<measurement> Result = { ERROR, { } };
+
+    int Pipe[2];
+
+    if (pipe(Pipe) != 0)
+        return Result;
+
+    pid_t Child = fork();
+
+    if (Child < 0)
+    {
+        close(Pipe[0]);
+        close(Pipe[1]);
+
+        return Result;
+    }
+
+    if (Child == 0)
+    {
+        close(Pipe[0]);
+
+        unsigned int Base = Address(Labels, "array");
+        unsigned int MemorySize = std::max(Program->Length,
+                                           Base + Workload->ArrayLength(N));
+
+        // NOTE Touching all of memory now keeps page faults out of the
+        // timing.
+        int *Memory = new int[MemorySize]();
+
+        std::copy(Program->Data, Program->Data + Program->Length, Memory);
+        std::fill(Memory + Base, Memory + Program->Length, 0);
+
+        Memory[Address(Labels, "N")] = (int)N;
+        Workload->Fill(Memory + Base, Base, N);
+
+        // The output is still formatted, just not kept.
+        OutputFile = fopen("/dev/null", "w");
+
+        measurement Measurement = { };
+
+        // NOTE Nothing watches it, but the engine can't tell.
+        stats_segment Segment = { };
+        Segment.Flags = Flags;
+        stats_segment *Stats = Publish ? &Segment : NULL;
+
+        auto Start = std::chrono::steady_clock::now();
+
+        engine_status Stopped =
+            Checked ? RunChecked(Memory, MemorySize, 0, NULL,
+                                 &Measurement.Steps, NO_BUDGET, Stats) :
+                      RunUnchecked(Memory, 0, NULL, &Measurement.Steps,
+                                   NO_BUDGET, Stats);
+
+        auto End = std::chrono::steady_clock::now();
+
+        Measurement.Nanoseconds =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start)
+                .count();
+
+        Measurement.Passed = Stopped == HALTED &&
+                             Workload->Check(Memory, Labels, N);
+
+        ssize_t Written = write(Pipe[1], &Measurement, sizeof(Measurement));
+
+        _exit(Written == sizeof(Measurement) ? 0 : 1);
+    }
+
+    close(Pipe[1]);
+
+    ssize_t Read = read(Pipe[0], &Result.Value, sizeof(Result.Value));
+
+    close(Pipe[0]);
+
+    int Status = 0;
+    struct rusage Usage = { };
+
+    wait4(Child, &Status, 0, &Usage);
+
+    if (Read == sizeof(Result.Value) && WIFEXITED(Status) &&
+        WEXITSTATUS(Status) == 0)
+    {
+        Result.Status = OK;
+
+#if defined(__APPLE__)
+        Result.Value.PeakResidentSet = Usage.ru_maxrss / 1024;
+#else
+        Result.Value.PeakResidentSet = Usage.ru_maxrss;
+#endif
+    }
+
+    return Result;
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.DataDirectory = "data/bench";
+    Options.RepeatCount = DEFAULT_REPEAT_COUNT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--data") == 0 && i + 1 < argc)
+        {
+            Options.DataDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            Options.RepeatCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            Options.Stats = true;
+        }
+        else if (std::strcmp(argv[i], "--self-modifying") == 0)
+        {
+            Options.Stats = true;
+            Options.SelfModifying = true;
+        }
+        else if (argv[i][0] == '-')
+        {
+            Severe("Unknown option \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+        else
+        {
+            Append<const char *>(&Options.Workloads, argv[i]);
+        }
+    }
+
+    unsigned int WorkloadCount = sizeof(Workloads) / sizeof(Workloads[0]);
+
+    for (unsigned int i = 0; i < Options.Workloads.Length; i++)
+    {
+        bool Known = false;
+
+        for (unsigned int j = 0; j < WorkloadCount; j++)
+            Known = Known || std::strcmp(Options.Workloads[i],
+                                         Workloads[j].Name) == 0;
+
+        if (!Known)
+        {
+            Severe("No such workload \"%s\", exiting.\n", Options.Workloads[i]);
+            return MISSING_ARGS;
+        }
+    }
+
+    printf("workload\tsize\tengine\tsteps\tseconds\tsteps_per_second\t"
+           "ns_per_step\tpeak_rss_kib\tcheck\n");
+
+    exit_status ExitStatus = NORMAL;
+
+    for (unsigned int i = 0; i < WorkloadCount; i++)
+    {
+        const workload *Workload = &Workloads[i];
+
+        if (Options.Workloads.Length &&
+            std::none_of(Options.Workloads.Data,
+                         Options.Workloads.Data + Options.Workloads.Length,
+                         [&](const char *Name)
+                         {
+                             return std::strcmp(Name, Workload->Name) == 0;
+                         }))
+        {
+            continue;
+        }
+
+
+        /** Assemble the workload. */
+
+        char Path[4096];
+        snprintf(Path, sizeof(Path), "%s/%s.sq",
+                 Options.DataDirectory, Workload->Name);
+
+        std::ifstream SourceFile (Path, std::ifstream::in |
+                                        std::ifstream::binary);
+
+        if (!SourceFile)
+        {
+            Error("Failed to open workload \"%s\".\n", Path);
+
+            ExitStatus = BENCH_FAILED;
+            continue;
+        }
+
+        SourceFile.seekg(0, std::ios::end);
+        long SourceSize = SourceFile.tellg();
+        SourceFile.seekg(0, std::ios::beg);
+
+        buffer<char> Source = { };
+        Reserve<char>(&Source, SourceSize + 1);
+        Source.Length = SourceSize;
+
+        SourceFile.read(Source.Data, SourceSize);
+        Source[SourceSize] = '\0';
+
+        assembler Assembler = { };
+        Assemble(&Assembler, Source.Data, SourceSize, 1);
+
+        if (ErrorCount(&Assembler))
+        {
+            ReportErrors(&Assembler.Chunks[0].Errors,
+                         Source.Data,
+                         SourceSize,
+                         &Assembler.LineStarts);
+
+            ExitStatus = BENCH_FAILED;
+        }
+        else if (Address(Assembler.Labels, "N") < 0 ||
+                 Address(Assembler.Labels, "array") < 0)
+        {
+            Error("Workload \"%s\" doesn't declare both \"N\" and "
+                  "\"array\".\n", Path);
+
+            ExitStatus = BENCH_FAILED;
+        }
+        else
+        {
+            // The unchecked engine only runs programs that get a partition.
+            image_facts Facts = { };
+            AnalyzeImage(&Assembler.Program, 0, &Facts);
+
+            bool Static = Facts.Facts & IMAGE_STATIC;
+
+            Empty<unsigned char>(&Facts.Partition);
+
+
+            /** Run it at every size, on every engine. */
+
+            for (unsigned int j = 0; j < SIZE_COUNT; j++)
+            {
+                for (int Checked = Static ? 0 : 1; Checked <= 1; Checked++)
+                {
+                    unsigned int N = Workload->Sizes[j];
+
+                    // The fastest run, and the most memory any run took.
+                    measurement Best = { };
+                    long PeakResidentSet = 0;
+                    bool Failed = false;
+
+                    for (unsigned int k = 0; k < Options.RepeatCount; k++)
+                    {
+                        status<measurement> Result =
+                            Measure(&Assembler.Program, Assembler.Labels,
+                                    Workload, N, Checked, Options.Stats,
+                                    Options.SelfModifying ?
+                                    STATS_SELF_MODIFYING : 0);
+
+                        if (Result.Status != OK)
+                        {
+                            Failed = true;
+                            break;
+                        }
+
+                        measurement Measurement = Result.unpack();
+
+                        if (k == 0 ||
+                            Measurement.Nanoseconds < Best.Nanoseconds)
+                        {
+                            Best = Measurement;
+                        }
+
+                        PeakResidentSet = std::max(PeakResidentSet,
+                                                   Measurement.PeakResidentSet);
+
+                        Failed = Failed || !Measurement.Passed;
+                    }
+
+                    double Seconds = Best.Nanoseconds / 1e9;
+                    double Steps = (double)Best.Steps;
+
+                    printf("%s\t%u\t%s\t%llu\t%.6f\t%.0f\t%.3f\t%ld\t%s\n",
+                           Workload->Name,
+                           N,
+                           Checked ? (Options.SelfModifying ?
+                                      "checked+stats+self_modifying" :
+                                      Options.Stats ? "checked+stats" :
+                                                      "checked") :
+                                     (Options.Stats ? "unchecked+stats" :
+                                                      "unchecked"),
+                           Best.Steps,
+                           Seconds,
+                           Seconds > 0 ? Steps / Seconds : 0.0,
+                           Steps > 0 ? Best.Nanoseconds / Steps : 0.0,
+                           PeakResidentSet,
+                           Failed ? "fail" : "pass");
+
+                    fflush(stdout);
+
+                    if (Failed)
+                        ExitStatus = BENCH_FAILED;
+                }
+            }
+        }
+
+        Empty(&Assembler);
+        Empty<char>(&Source);
+    }
+
+    Empty<const char *>(&Options.Workloads);
+
+    return ExitStatus;
+}
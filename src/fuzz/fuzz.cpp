@@ -0,0 +1,873 @@
+/**
+ * @file fuzz.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the fuzzer. It runs one of the fuzz targets (see targets.cpp) over
+ * and over in its own process, on inputs it makes by mutating a corpus: the
+ * programs in data/tests and data/bench, a few made up by the generator (see
+ * generate.cpp), and anything in the corpus directory it's given. Given
+ * inputs instead, it runs each of them once, to reproduce a crash.
+ *
+ * Built with -fsanitize-coverage=trace-pc, every branch the target takes is
+ * counted in a coverage map, and any input that takes a branch a new number of
+ * times is kept in the corpus to be mutated further. Built without it, the
+ * mutations are blind. Either way it's best built with the address and
+ * undefined behaviour sanitizers, so that a bad access stops it straight
+ * away (see scripts/fuzz.sh).
+ *
+ * An input that crashes the target, or trips an assertion, is written to
+ * crash-<target> before the fuzzer dies; one that's still running after
+ * HANG_SECONDS is written to hang-<target>.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+
+// POSIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../sqgen/generate.cpp"
+#include "targets.cpp"
+
+
+#define UsageString \
+    "Usage: fuzz <assembler|emulator> [--runs <count>] " \
+    "[--seconds <seconds>] [--budget <steps>] [--max-length <bytes>] " \
+    "[--seed <seed>] [--corpus <directory>] [<input>...]\n"
+
+// MAGIC Far more branches than the assembler and emulator have, so that
+// two rarely share a counter, and small enough to go through after every run.
+#define COVERAGE_BITS 14
+#define COVERAGE_SIZE (1 << COVERAGE_BITS)
+
+// MAGIC Long enough for anything interesting, short enough that every
+// run is quick.
+#define DEFAULT_MAX_LENGTH 256
+
+// MAGIC Every run takes well under a millisecond.
+#define HANG_SECONDS 10
+
+// How many generated sources to seed the corpus with, and how big.
+#define GENERATED_SEEDS 8
+#define GENERATED_SIZE 512
+
+#if defined(__clang__)
+#define NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#else
+#define NO_COVERAGE __attribute__((no_sanitize_coverage))
+#endif
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    HUNG,
+    UNKNOWN
+};
+
+struct options {
+    const char *Target;
+    // Stop after this many runs, or this many seconds; never, if zero.
+    unsigned long long RunCount;
+    unsigned int Seconds;
+    unsigned int MaxLength;
+    uint32_t Seed;
+    // Where to load the corpus from, and save new inputs to.
+    const char *CorpusDirectory;
+    // The inputs to run once each, instead of fuzzing.
+    buffer<const char *> Inputs;
+};
+
+struct fuzz_target {
+    const char *Name;
+    void (*Run)(const unsigned char *Data, size_t Size);
+    // Whether inputs are sources, rather than cells.
+    bool Text;
+};
+
+static const fuzz_target Targets[] = {
+    { "assembler", FuzzAssembler, true },
+    { "emulator",  FuzzEmulator,  false }
+};
+
+// Bits of source the assembler target's inputs get spliced with.
+static const char *Dictionary[] = {
+    ",", ", ", ":", "?", "\n", ";", " ", "\t", "\r", "-", "+", "0", "1", "-1",
+    "3", "2147483647", "-2147483648", "4294967296", "Z", "Z:", "x", "x: "
+};
+
+// Cells the emulator target's inputs get spliced with.
+static const int InterestingCells[] = {
+    -1, 0, 1, 2, 3, 6, 9, 12, -2, -3, 0x7FFFFFFF, (int)0x80000000
+};
+
+
+/** Coverage. */
+
+// How many times each branch was taken in the current run, and every bucket
+// of those counts any run has reached.
+static unsigned char Coverage[COVERAGE_SIZE];
+static unsigned char Seen[COVERAGE_SIZE];
+
+static uint32_t PreviousLocation = 0;
+static volatile bool Tracing = false;
+
+// NOTE The compiler calls this at every branch of everything built with
+// -fsanitize-coverage=trace-pc. A branch is told apart by where it came from
+// as well as where it is, so it's really the edge between them.
+extern "C" NO_COVERAGE
+void __sanitizer_cov_trace_pc()
+{
+    if (!Tracing)
+        return;
+
+    uintptr_t Address = (uintptr_t)__builtin_return_address(0);
+    uint32_t Location = (uint32_t)((Address >> 1) * 2654435761u) >>
+                        (32 - COVERAGE_BITS);
+
+    Coverage[Location ^ PreviousLocation]++;
+    PreviousLocation = Location >> 1;
+}
+
+// NOTE Every sanitizer error should stop us where our handlers can
+// save the input that caused it.
+extern "C" const char *__asan_default_options()
+{
+    return "abort_on_error=1";
+}
+
+extern "C" const char *__ubsan_default_options()
+{
+    return "halt_on_error=1:abort_on_error=1:print_stacktrace=1";
+}
+
+// Bucket() returns which bucket [Count] falls in, as a bit, so that only
+// taking a branch a different order of magnitude of times counts as new.
+static inline NO_COVERAGE
+unsigned char Bucket(unsigned char Count)
+{
+    return Count == 0 ? 0 :
+           Count < 4  ? (unsigned char)(1 << (Count - 1)) :
+           Count < 8  ? 8 :
+           Count < 16 ? 16 :
+           Count < 32 ? 32 :
+           Count < 128 ? 64 : 128;
+}
+
+// TakeCoverage() merges the current run's coverage into everything seen,
+// clearing it for the next run, and returns how many buckets were new.
+static NO_COVERAGE
+unsigned int TakeCoverage()
+{
+    unsigned int NewCount = 0;
+
+    uint64_t *Words = (uint64_t *)Coverage;
+
+    for (unsigned int i = 0; i < COVERAGE_SIZE / 8; i++)
+    {
+        // Most of the map is never touched.
+        if (!Words[i])
+            continue;
+
+        for (unsigned int j = i * 8; j < i * 8 + 8; j++)
+        {
+            unsigned char Bits = Bucket(Coverage[j]);
+
+            if (Bits & ~Seen[j])
+            {
+                Seen[j] |= Bits;
+                NewCount++;
+            }
+        }
+
+        Words[i] = 0;
+    }
+
+    PreviousLocation = 0;
+
+    return NewCount;
+}
+
+// CountCoverage() returns how many branches any run has taken.
+static NO_COVERAGE
+unsigned int CountCoverage()
+{
+    unsigned int Count = 0;
+
+    for (unsigned int i = 0; i < COVERAGE_SIZE; i++)
+        Count += Seen[i] != 0;
+
+    return Count;
+}
+
+
+/** Crashes and hangs. */
+
+// The input being run, so that it can be saved if it never comes back.
+static const unsigned char *volatile CurrentInput = NULL;
+static volatile size_t CurrentSize = 0;
+
+static char CrashPath[256];
+static char HangPath[256];
+
+static volatile unsigned long long Runs = 0;
+static volatile unsigned int Ticks = 0;
+
+// SaveCurrentInput() writes the input being run to [Path], using only what's
+// safe in a signal handler.
+static NO_COVERAGE
+void SaveCurrentInput(const char *Path)
+{
+    int File = open(Path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (File < 0)
+        return;
+
+    const unsigned char *Data = CurrentInput;
+    size_t Size = CurrentSize;
+
+    while (Data && Size)
+    {
+        ssize_t Written = write(File, Data, Size);
+
+        if (Written <= 0)
+            break;
+
+        Data += Written;
+        Size -= Written;
+    }
+
+    close(File);
+}
+
+// HandleCrash() saves the input that crashed the target, then lets the
+// signal kill us the way it would have.
+static NO_COVERAGE
+void HandleCrash(int Signal)
+{
+    static const char Message[] = "The target crashed, the input is in ";
+
+    ssize_t Ignored = write(STDERR_FILENO, Message, sizeof(Message) - 1);
+    Ignored = write(STDERR_FILENO, CrashPath, strlen(CrashPath));
+    Ignored = write(STDERR_FILENO, ".\n", 2);
+    (void)Ignored;
+
+    SaveCurrentInput(CrashPath);
+
+    signal(Signal, SIG_DFL);
+    raise(Signal);
+}
+
+// HandleTick() counts off a second, and saves the input being run if it's
+// been running for too long.
+static NO_COVERAGE
+void HandleTick(int)
+{
+    static unsigned long long LastRuns = 0;
+    static unsigned int StalledTicks = 0;
+
+    Ticks++;
+
+    StalledTicks = Runs == LastRuns && CurrentInput ? StalledTicks + 1 : 0;
+    LastRuns = Runs;
+
+    if (StalledTicks >= HANG_SECONDS)
+    {
+        static const char Message[] = "The target hung, the input is in ";
+
+        ssize_t Ignored = write(STDERR_FILENO, Message, sizeof(Message) - 1);
+        Ignored = write(STDERR_FILENO, HangPath, strlen(HangPath));
+        Ignored = write(STDERR_FILENO, ".\n", 2);
+        (void)Ignored;
+
+        SaveCurrentInput(HangPath);
+
+        _exit(HUNG);
+    }
+}
+
+// RunInput() runs [Target] on the [Size] bytes of [Data], and returns how
+// many new buckets of coverage it reached.
+static NO_COVERAGE
+unsigned int RunInput(const fuzz_target *Target,
+                      const unsigned char *Data,
+                      size_t Size)
+{
+    CurrentInput = Data;
+    CurrentSize = Size;
+
+    Tracing = true;
+    Target->Run(Data, Size);
+    Tracing = false;
+
+    Runs = Runs + 1;
+    CurrentInput = NULL;
+
+    return TakeCoverage();
+}
+
+
+/** The corpus. */
+
+struct input {
+    buffer<unsigned char> Data;
+};
+
+// AddInput() adds a copy of the [Size] bytes of [Data] to [Corpus].
+static NO_COVERAGE
+void AddInput(buffer<input> *Corpus, const unsigned char *Data, size_t Size)
+{
+    input Input = { };
+    Reserve<unsigned char>(&Input.Data, Size ? Size : 1);
+    Append<unsigned char>(&Input.Data, Data, (unsigned int)Size);
+
+    Append<input>(Corpus, Input);
+}
+
+// ReadInput() reads the file at [Path] into [Data]. Returns ERROR if it
+// can't be read.
+static NO_COVERAGE
+status_code ReadInput(const char *Path, buffer<unsigned char> *Data)
+{
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    if (!File)
+        return ERROR;
+
+    File.seekg(0, std::ios::end);
+    long Size = File.tellg();
+    File.seekg(0, std::ios::beg);
+
+    if (Size < 0)
+        return ERROR;
+
+    Reserve<unsigned char>(Data, Size + 1);
+    Data->Length = Size;
+
+    File.read((char *)Data->Data, Size);
+
+    return File ? OK : ERROR;
+}
+
+// AddSeed() adds the source in [Source] to [Corpus] as an input for
+// [Target]: as it is for the assembler, or assembled for the emulator.
+static NO_COVERAGE
+void AddSeed(buffer<input> *Corpus,
+             const fuzz_target *Target,
+             const unsigned char *Source,
+             size_t Size)
+{
+    if (Target->Text)
+    {
+        AddInput(Corpus, Source, Size);
+        return;
+    }
+
+    assembler Assembler = { };
+    Assemble(&Assembler, (const char *)Source, (unsigned int)Size, 1);
+
+    if (!ErrorCount(&Assembler))
+    {
+        AddInput(Corpus,
+                 (const unsigned char *)Assembler.Program.Data,
+                 Assembler.Program.Length * sizeof(int));
+    }
+
+    Empty(&Assembler);
+}
+
+// LoadDirectory() calls [Function] with the path of every file in
+// [Directory] that ends in [Extension], if it's given.
+template <typename F>
+static NO_COVERAGE
+void LoadDirectory(const char *Directory, const char *Extension, F Function)
+{
+    DIR *Listing = opendir(Directory);
+
+    if (!Listing)
+        return;
+
+    while (dirent *Entry = readdir(Listing))
+    {
+        unsigned int Length = strlen(Entry->d_name);
+        unsigned int ExtensionLength = Extension ? strlen(Extension) : 0;
+
+        if (Entry->d_name[0] == '.' || Length < ExtensionLength ||
+            (Extension && std::strcmp(Entry->d_name + Length - ExtensionLength,
+                                      Extension) != 0))
+        {
+            continue;
+        }
+
+        char Path[4096];
+        snprintf(Path, sizeof(Path), "%s/%s", Directory, Entry->d_name);
+
+        Function(Path);
+    }
+
+    closedir(Listing);
+}
+
+// SaveInput() writes the [Size] bytes of [Data] to [Directory], named after
+// their hash.
+static NO_COVERAGE
+void SaveInput(const char *Directory, const unsigned char *Data, size_t Size)
+{
+    uint64_t Hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < Size; i++)
+        Hash = (Hash ^ Data[i]) * 1099511628211ull;
+
+    char Path[4096];
+    snprintf(Path, sizeof(Path), "%s/%016llx", Directory,
+             (unsigned long long)Hash);
+
+    FILE *File = fopen(Path, "wb");
+
+    if (!File)
+        return;
+
+    fwrite(Data, 1, Size, File);
+    fclose(File);
+}
+
+
+/** Mutation. */
+
+// Mutate() changes [Input] in a few random ways, for [Target], splicing in
+// parts of other inputs in [Corpus]. It's never made longer than
+// [MaxLength].
+static NO_COVERAGE
+void Mutate(buffer<unsigned char> *Input,
+            const buffer<input> *Corpus,
+            const fuzz_target *Target,
+            unsigned int MaxLength,
+            uint32_t *State)
+{
+    unsigned int MutationCount = 1 + NextRandom(State) % 8;
+
+    // How big a piece of input to work on: a character of source, or a cell.
+    unsigned int Width = Target->Text ? 1 : sizeof(int);
+
+    for (unsigned int m = 0; m < MutationCount; m++)
+    {
+        unsigned int Length = Input->Length;
+        unsigned int Cells = Length / Width;
+
+        // Where to change, in whole pieces.
+        unsigned int At = Cells ? NextRandom(State) % Cells * Width : 0;
+
+        const input *Other = &Corpus->Data[NextRandom(State) % Corpus->Length];
+        unsigned int OtherLength = Other->Data.Length;
+
+        switch (NextRandom(State) % 7)
+        {
+            // Flip a bit.
+            case 0:
+            {
+                if (Length)
+                {
+                    unsigned int Bit = NextRandom(State) % (Length * 8);
+                    (*Input)[Bit / 8] ^= (unsigned char)(1 << (Bit % 8));
+                }
+            } break;
+
+            // Set a byte to anything.
+            case 1:
+            {
+                if (Length)
+                {
+                    (*Input)[NextRandom(State) % Length] =
+                        (unsigned char)NextRandom(State);
+                }
+            } break;
+
+            // Replace a piece with something interesting, or nudge it.
+            case 2:
+            {
+                if (!Cells)
+                    break;
+
+                if (Target->Text)
+                {
+                    (*Input)[At] = (unsigned char)
+                        Dictionary[NextRandom(State) %
+                                   (sizeof(Dictionary) /
+                                    sizeof(Dictionary[0]))][0];
+                }
+                else
+                {
+                    int Cell;
+                    std::memcpy(&Cell, Input->Data + At, sizeof(int));
+
+                    Cell = NextRandom(State) % 2 ?
+                           InterestingCells[NextRandom(State) %
+                                            (sizeof(InterestingCells) /
+                                             sizeof(int))] :
+                           (int)((unsigned int)Cell +
+                                 NextRandom(State) % 33 - 16);
+
+                    std::memcpy(Input->Data + At, &Cell, sizeof(int));
+                }
+            } break;
+
+            // Cut out a piece.
+            case 3:
+            {
+                if (!Cells)
+                    break;
+
+                unsigned int Count = (1 + NextRandom(State) %
+                                      std::min(Cells - At / Width, 16u)) *
+                                     Width;
+
+                std::memmove(Input->Data + At, Input->Data + At + Count,
+                             Length - At - Count);
+                Input->Length -= Count;
+            } break;
+
+            // Put in something interesting.
+            case 4:
+            {
+                const unsigned char *Piece;
+                unsigned int Count;
+
+                int Cell;
+
+                if (Target->Text)
+                {
+                    const char *Word =
+                        Dictionary[NextRandom(State) %
+                                   (sizeof(Dictionary) /
+                                    sizeof(Dictionary[0]))];
+
+                    Piece = (const unsigned char *)Word;
+                    Count = strlen(Word);
+                }
+                else
+                {
+                    Cell = InterestingCells[NextRandom(State) %
+                                            (sizeof(InterestingCells) /
+                                             sizeof(int))];
+
+                    Piece = (const unsigned char *)&Cell;
+                    Count = sizeof(int);
+                }
+
+                if (Length + Count > MaxLength)
+                    break;
+
+                Reserve<unsigned char>(Input, Length + Count);
+                std::memmove(Input->Data + At + Count, Input->Data + At,
+                             Length - At);
+                std::memcpy(Input->Data + At, Piece, Count);
+                Input->Length += Count;
+            } break;
+
+            // Copy in a piece of another input.
+            case 5:
+            {
+                unsigned int OtherCells = OtherLength / Width;
+
+                if (!OtherCells)
+                    break;
+
+                unsigned int From = NextRandom(State) % OtherCells * Width;
+                unsigned int Count = (1 + NextRandom(State) %
+                                      std::min(OtherCells - From / Width,
+                                               16u)) *
+                                     Width;
+
+                if (Length + Count > MaxLength)
+                    break;
+
+                Reserve<unsigned char>(Input, Length + Count);
+                std::memmove(Input->Data + At + Count, Input->Data + At,
+                             Length - At);
+                std::memcpy(Input->Data + At, Other->Data.Data + From, Count);
+                Input->Length += Count;
+            } break;
+
+            // Splice the rest of another input on.
+            case 6:
+            {
+                unsigned int OtherCells = OtherLength / Width;
+
+                if (!OtherCells)
+                    break;
+
+                unsigned int From = NextRandom(State) % OtherCells * Width;
+                unsigned int Count = std::min(OtherLength - From,
+                                              MaxLength - std::min(At,
+                                                                   MaxLength));
+
+                Input->Length = At;
+                Append<unsigned char>(Input, Other->Data.Data + From, Count);
+            } break;
+        }
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.MaxLength = DEFAULT_MAX_LENGTH;
+    Options.Seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+        {
+            Options.RunCount = strtoull(argv[++i], NULL, 10);
+        }
+        else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            Options.Seconds = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+        {
+            FuzzBudget = strtoull(argv[++i], NULL, 10);
+        }
+        else if (std::strcmp(argv[i], "--max-length") == 0 && i + 1 < argc)
+        {
+            Options.MaxLength = std::max(4ul, strtoul(argv[++i], NULL, 10));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            Options.Seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+            Options.Seed = Options.Seed ? Options.Seed : 1;
+        }
+        else if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+        {
+            Options.CorpusDirectory = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            Severe("Unknown option \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+        else if (!Options.Target)
+        {
+            Options.Target = argv[i];
+        }
+        else
+        {
+            Append<const char *>(&Options.Inputs, argv[i]);
+        }
+    }
+
+    const fuzz_target *Target = NULL;
+
+    for (const fuzz_target &Known : Targets)
+    {
+        if (Options.Target && std::strcmp(Options.Target, Known.Name) == 0)
+            Target = &Known;
+    }
+
+    if (!Target)
+    {
+        Severe("Missing or unknown fuzz target, exiting.\n");
+
+        fprintf(stderr, UsageString);
+
+        return MISSING_ARGS;
+    }
+
+    snprintf(CrashPath, sizeof(CrashPath), "crash-%s", Target->Name);
+    snprintf(HangPath, sizeof(HangPath), "hang-%s", Target->Name);
+
+    int CrashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+    for (int Signal : CrashSignals)
+        signal(Signal, HandleCrash);
+
+    signal(SIGALRM, HandleTick);
+
+    itimerval Tick = { };
+    Tick.it_interval.tv_sec = 1;
+    Tick.it_value.tv_sec = 1;
+    setitimer(ITIMER_REAL, &Tick, NULL);
+
+
+    /** Run the inputs we were given, if any. */
+
+    if (Options.Inputs.Length)
+    {
+        exit_status Status = NORMAL;
+
+        for (unsigned int i = 0; i < Options.Inputs.Length; i++)
+        {
+            buffer<unsigned char> Data = { };
+
+            if (ReadInput(Options.Inputs[i], &Data) != OK)
+            {
+                Error("Failed to read input \"%s\".\n", Options.Inputs[i]);
+                Status = UNKNOWN;
+            }
+            else
+            {
+                RunInput(Target, Data.Data, Data.Length);
+            }
+
+            Empty<unsigned char>(&Data);
+        }
+
+        printf("Ran %u inputs.\n", Options.Inputs.Length);
+
+        Empty<const char *>(&Options.Inputs);
+
+        return Status;
+    }
+
+
+    /** Seed the corpus. */
+
+    buffer<input> Corpus = { };
+
+    auto Seed = [&](const char *Path)
+    {
+        buffer<unsigned char> Data = { };
+
+        if (ReadInput(Path, &Data) == OK)
+            AddSeed(&Corpus, Target, Data.Data, Data.Length);
+
+        Empty<unsigned char>(&Data);
+    };
+
+    LoadDirectory("data/tests", ".sq", Seed);
+    LoadDirectory("data/bench", ".sq", Seed);
+
+    for (unsigned int i = 0; i < GENERATED_SEEDS; i++)
+    {
+        source_shape Shape = DefaultShape();
+        Shape.Size = GENERATED_SIZE;
+        Shape.Seed = i + 1;
+
+        buffer<char> Source = { };
+        Generate(&Shape, &Source);
+
+        AddSeed(&Corpus, Target, (const unsigned char *)Source.Data,
+                Source.Length);
+
+        Empty<char>(&Source);
+    }
+
+    if (Options.CorpusDirectory)
+    {
+        LoadDirectory(Options.CorpusDirectory, NULL, [&](const char *Path)
+        {
+            buffer<unsigned char> Data = { };
+
+            if (ReadInput(Path, &Data) == OK)
+                Append<input>(&Corpus, { Data });
+            else
+                Empty<unsigned char>(&Data);
+        });
+    }
+
+    // Every input has to be shorter than the longest we'll make.
+    for (unsigned int i = 0; i < Corpus.Length; i++)
+    {
+        Corpus[i].Data.Length = std::min(Corpus[i].Data.Length,
+                                         Options.MaxLength);
+    }
+
+    if (!Corpus.Length)
+    {
+        Warning("Found no seeds; run from the project root.\n");
+
+        AddInput(&Corpus, (const unsigned char *)"0\n", 2);
+    }
+
+    for (unsigned int i = 0; i < Corpus.Length; i++)
+        RunInput(Target, Corpus[i].Data.Data, Corpus[i].Data.Length);
+
+    if (!CountCoverage())
+    {
+        Warning("Not built with -fsanitize-coverage=trace-pc, so mutations "
+                "are blind.\n");
+    }
+
+    printf("Seeded the corpus with %u inputs, reaching %u branches.\n",
+           Corpus.Length, CountCoverage());
+
+
+    /** Fuzz. */
+
+    uint32_t State = Options.Seed;
+
+    buffer<unsigned char> Input = { };
+    Reserve<unsigned char>(&Input, Options.MaxLength);
+
+    auto Start = std::chrono::steady_clock::now();
+    unsigned int LastTicks = 0;
+    unsigned long long FirstRun = Runs;
+
+    // NOTE Print how it's going every second.
+    auto Report = [&]()
+    {
+        double Seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - Start).count();
+
+        printf("#%llu\t%.0f runs/s\tcorpus %u\tbranches %u\n",
+               Runs - FirstRun,
+               Seconds > 0 ? (Runs - FirstRun) / Seconds : 0.0,
+               Corpus.Length,
+               CountCoverage());
+
+        fflush(stdout);
+    };
+
+    while ((!Options.RunCount || Runs - FirstRun < Options.RunCount) &&
+           (!Options.Seconds || Ticks < Options.Seconds))
+    {
+        const input *Parent = &Corpus[NextRandom(&State) % Corpus.Length];
+
+        Input.Length = 0;
+        Append<unsigned char>(&Input, Parent->Data.Data, Parent->Data.Length);
+
+        Mutate(&Input, &Corpus, Target, Options.MaxLength, &State);
+
+        if (RunInput(Target, Input.Data, Input.Length))
+        {
+            AddInput(&Corpus, Input.Data, Input.Length);
+
+            if (Options.CorpusDirectory)
+                SaveInput(Options.CorpusDirectory, Input.Data, Input.Length);
+        }
+
+        if (Ticks != LastTicks)
+        {
+            LastTicks = Ticks;
+            Report();
+        }
+    }
+
+    Report();
+
+    for (unsigned int i = 0; i < Corpus.Length; i++)
+        Empty<unsigned char>(&Corpus[i].Data);
+
+    Empty<input>(&Corpus);
+    Empty<unsigned char>(&Input);
+    Empty<const char *>(&Options.Inputs);
+
+    return NORMAL;
+}
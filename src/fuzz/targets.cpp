@@ -0,0 +1,145 @@
+/**
+ * @file targets.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the fuzz targets, run by the fuzzer (see fuzz.cpp) over
+ * and over in the same process. Each takes whatever bytes it's given, never
+ * holds on to anything between runs, and aborts if something that should
+ * always hold doesn't.
+ *
+ * The assembler target assembles its input as a source, both as a program
+ * and as an object, which have to agree. The emulator target takes its input
+ * as the cells of a program and runs it on the checked engine, for at most
+ * [FuzzBudget] instructions. If analysis gives the program a partition, it
+ * runs it again on the unchecked engine, which has to end up exactly where
+ * the checked one did.
+ *
+ * With clang, either target can be built for libFuzzer instead, by defining
+ * FUZZ_LIBFUZZER as the target's function, e.g.
+ * -fsanitize=fuzzer -DFUZZ_LIBFUZZER=FuzzAssembler.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// Own Libraries
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/assembler.cpp"
+#include "../subleqc/image.cpp"
+#include "../subleqc/engine.cpp"
+
+
+// MAGIC Enough instructions to get through any loop a small input
+// makes, few enough that one run never takes long.
+#define DEFAULT_FUZZ_BUDGET 1000
+
+
+// How many instructions the emulator target runs a program for, at most.
+static unsigned long long FuzzBudget = DEFAULT_FUZZ_BUDGET;
+
+
+// FuzzAssembler() assembles the [Size] bytes of [Data] as a source.
+static
+void FuzzAssembler(const unsigned char *Data, size_t Size)
+{
+    const char *Source = (const char *)Data;
+
+    assembler Program = { };
+    Assemble(&Program, Source, (unsigned int)Size, 1);
+
+    assembler Object = { };
+    Object.Relocatable = true;
+    Assemble(&Object, Source, (unsigned int)Size, 1);
+
+    // An object only leaves undeclared labels to the linker, so a source
+    // that assembles as a program assembles to the same code as an object.
+    if (!ErrorCount(&Program))
+    {
+        Assert(!ErrorCount(&Object));
+        Assert(Object.Imports.Length == 0);
+        Assert(Program.Program.Length == Object.Program.Length);
+        Assert(std::equal(Program.Program.Data,
+                          Program.Program.Data + Program.Program.Length,
+                          Object.Program.Data));
+    }
+
+    // NOTE Data can leave the code any length, but never any longer or
+    // shorter than its chunks add up to.
+    unsigned int Length = 0;
+
+    for (unsigned int i = 0; i < Program.Chunks.Length; i++)
+        Length += Program.Chunks[i].Length;
+
+    Assert(ErrorCount(&Program) || Program.Program.Length == Length);
+
+    Empty(&Program);
+    Empty(&Object);
+}
+
+// FuzzEmulator() runs the [Size] bytes of [Data] as the cells of a program,
+// starting at the first one.
+static
+void FuzzEmulator(const unsigned char *Data, size_t Size)
+{
+    // NOTE Whatever the program prints is only in the way.
+    if (OutputFile == stdout)
+        OutputFile = fopen("/dev/null", "wb");
+
+    buffer<int> Program = { };
+    unsigned int Length = (unsigned int)(Size / sizeof(int));
+
+    Reserve<int>(&Program, Length ? Length : 1);
+    Program.Length = Length;
+
+    std::memcpy(Program.Data, Data, Length * sizeof(int));
+
+    image_facts Facts = { };
+    AnalyzeImage(&Program, 0, &Facts);
+
+    buffer<int> Checked = { };
+    Append<int>(&Checked, Program.Data, Program.Length);
+
+    unsigned long long CheckedSteps = 0;
+    engine_status CheckedStatus = RunChecked(Checked.Data, Checked.Length, 0,
+                                             NULL, &CheckedSteps, FuzzBudget);
+
+    if (Facts.Facts & IMAGE_STATIC)
+    {
+        // A program with a partition never goes out of bounds.
+        Assert(CheckedStatus == HALTED || CheckedStatus == OUT_OF_STEPS);
+
+        unsigned long long UncheckedSteps = 0;
+        engine_status UncheckedStatus = RunUnchecked(Program.Data, 0, NULL,
+                                                     &UncheckedSteps,
+                                                     FuzzBudget);
+
+        Assert(UncheckedStatus == CheckedStatus);
+        Assert(UncheckedSteps == CheckedSteps);
+        Assert(std::equal(Program.Data, Program.Data + Program.Length,
+                          Checked.Data));
+    }
+
+    Empty<unsigned char>(&Facts.Partition);
+    Empty<int>(&Checked);
+    Empty<int>(&Program);
+}
+
+
+#if defined(FUZZ_LIBFUZZER)
+
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char *Data, size_t Size)
+{
+    FUZZ_LIBFUZZER(Data, Size);
+    return 0;
+}
+
+#endif
+
+#undef DEFAULT_FUZZ_BUDGET
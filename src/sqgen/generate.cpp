@@ -0,0 +1,276 @@
+/**
+ * @file generate.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the synthetic source generator shared by sqgen and the
+ * assembler benchmarks (see src/asmbench). It writes random SUBLEQ sources
+ * that always assemble, shaped by a handful of knobs: how big, how many
+ * instructions are labelled, how often the jump is `?`, the mix of one, two
+ * and three parameter instructions, and how long the labels are.
+ *
+ * Labels are named after the order they're declared in, padded out to the
+ * length asked for, so references can be made before the label exists. A
+ * reference is to a label already declared or one of the next few, and any of
+ * those still missing when the source is big enough are declared at the end.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+// Own Libraries
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+
+
+#define ShapeOptionsString \
+    "[--size <bytes>] [--labels <percent>] [--next <percent>] " \
+    "[--references <percent>] [--mix <one>:<two>:<three>] " \
+    "[--identifier <length>] [--seed <seed>]"
+
+// MAGIC Longer than anyone names a label.
+#define MAX_IDENTIFIER_LENGTH 255
+
+// MAGIC How far past the last declared label a reference may look, so
+// forward references are common but resolved soon after.
+#define FORWARD_LABELS 64
+
+
+struct source_shape {
+    // Roughly how many bytes of source to write. It's never less.
+    unsigned long long Size;
+    // The percentage of instructions that are labelled.
+    unsigned int LabelPercent;
+    // The percentage of three parameter instructions that jump to `?`.
+    unsigned int NextPercent;
+    // The percentage of other parameters that refer to labels, rather than
+    // being numbers.
+    unsigned int ReferencePercent;
+    // How often each of one, two and three parameter instructions come up,
+    // relative to each other.
+    unsigned int Mix[3];
+    // How long every label's name is, at least.
+    unsigned int IdentifierLength;
+    uint32_t Seed;
+};
+
+
+// DefaultShape() returns the shape of a source like a code generator's.
+static inline
+source_shape DefaultShape()
+{
+    source_shape Shape = { };
+
+    Shape.Size             = 1024 * 1024;
+    Shape.LabelPercent     = 10;
+    Shape.NextPercent      = 50;
+    Shape.ReferencePercent = 50;
+    Shape.Mix[0]           = 1;
+    Shape.Mix[1]           = 2;
+    Shape.Mix[2]           = 4;
+    Shape.IdentifierLength = 8;
+    Shape.Seed             = 1;
+
+    return Shape;
+}
+
+// ParseShapeOption() reads the shape option at argument [*Index] of [argv],
+// if it is one, into [Shape], and moves [*Index] past its value. Returns
+// ERROR if it's a shape option with a bad value, and its Value is whether the
+// argument was a shape option at all.
+static inline
+status<bool> ParseShapeOption(int argc, char **argv, int *Index,
+                              source_shape *Shape)
+{
+    const char *Option = argv[*Index];
+    const char *Value = *Index + 1 < argc ? argv[*Index + 1] : NULL;
+
+    const char *Options[] = {
+        "--size", "--labels", "--next", "--references", "--mix",
+        "--identifier", "--seed"
+    };
+
+    bool Known = false;
+
+    for (const char *Name : Options)
+        Known = Known || std::strcmp(Option, Name) == 0;
+
+    if (!Known)
+        return { OK, false };
+
+    if (!Value)
+        return { ERROR, true };
+
+    (*Index)++;
+
+    if (std::strcmp(Option, "--size") == 0)
+    {
+        Shape->Size = strtoull(Value, NULL, 10);
+    }
+    else if (std::strcmp(Option, "--mix") == 0)
+    {
+        if (sscanf(Value, "%u:%u:%u",
+                   &Shape->Mix[0], &Shape->Mix[1], &Shape->Mix[2]) != 3 ||
+            Shape->Mix[0] + Shape->Mix[1] + Shape->Mix[2] == 0)
+        {
+            return { ERROR, true };
+        }
+    }
+    else
+    {
+        unsigned int Number = (unsigned int)strtoul(Value, NULL, 10);
+
+        if (std::strcmp(Option, "--seed") == 0)
+        {
+            Shape->Seed = Number ? Number : 1;
+        }
+        else if (std::strcmp(Option, "--identifier") == 0)
+        {
+            if (Number > MAX_IDENTIFIER_LENGTH)
+                return { ERROR, true };
+
+            Shape->IdentifierLength = Number;
+        }
+        else
+        {
+            if (Number > 100)
+                return { ERROR, true };
+
+            unsigned int *Percent =
+                std::strcmp(Option, "--labels") == 0 ? &Shape->LabelPercent :
+                std::strcmp(Option, "--next") == 0   ? &Shape->NextPercent :
+                                                       &Shape->ReferencePercent;
+            *Percent = Number;
+        }
+    }
+
+    return { OK, true };
+}
+
+
+// NextRandom() returns the next number of the xorshift generator at [State].
+static inline
+uint32_t NextRandom(uint32_t *State)
+{
+    *State ^= *State << 13;
+    *State ^= *State >> 17;
+    *State ^= *State << 5;
+
+    return *State;
+}
+
+// PutText() appends the [Length] characters of [Text] to [Source].
+static inline
+void PutText(buffer<char> *Source, const char *Text, unsigned int Length)
+{
+    Append<char>(Source, Text, Length);
+}
+
+// PutLabelName() appends the name of the [Index]th label of a source shaped
+// like [Shape] to [Source].
+static
+void PutLabelName(buffer<char> *Source, const source_shape *Shape,
+                  unsigned int Index)
+{
+    char Digits[16];
+    unsigned int DigitCount = snprintf(Digits, sizeof(Digits), "%u", Index);
+
+    // NOTE Names start with a letter, so they're never numbers.
+    static const char Padding[] = "label_abcdefghijklmnopqrstuvwxyz_";
+
+    unsigned int PaddingLength = Shape->IdentifierLength > DigitCount ?
+                                 Shape->IdentifierLength - DigitCount : 1;
+
+    for (unsigned int i = 0; i < PaddingLength; i++)
+        Append<char>(Source, Padding[i % (sizeof(Padding) - 1)]);
+
+    PutText(Source, Digits, DigitCount);
+}
+
+// Generate() appends a random source shaped like [Shape] to [Source].
+static
+void Generate(const source_shape *Shape, buffer<char> *Source)
+{
+    uint32_t State = Shape->Seed ? Shape->Seed : 1;
+
+    unsigned int MixTotal = Shape->Mix[0] + Shape->Mix[1] + Shape->Mix[2];
+
+    // How many labels have been declared, and one more than the highest one
+    // referred to.
+    unsigned int Declared = 0;
+    unsigned int Referenced = 0;
+
+    unsigned long long Start = Source->Length;
+
+    // Percent() returns true [Chance] percent of the time.
+    auto Percent = [&](unsigned int Chance) -> bool
+    {
+        return NextRandom(&State) % 100 < Chance;
+    };
+
+    // PutParameter() appends a reference or a number.
+    auto PutParameter = [&]()
+    {
+        if (Percent(Shape->ReferencePercent) &&
+            (Shape->LabelPercent || Declared))
+        {
+            unsigned int Window = Shape->LabelPercent ? FORWARD_LABELS : 0;
+            unsigned int Index = NextRandom(&State) % (Declared + Window);
+
+            PutLabelName(Source, Shape, Index);
+
+            if (Index >= Referenced)
+                Referenced = Index + 1;
+        }
+        else
+        {
+            char Number[16];
+            unsigned int Length = snprintf(Number, sizeof(Number), "%u",
+                                           NextRandom(&State) % 1000);
+
+            PutText(Source, Number, Length);
+        }
+    };
+
+    while (Source->Length - Start < Shape->Size)
+    {
+        if (Percent(Shape->LabelPercent))
+        {
+            PutLabelName(Source, Shape, Declared++);
+            PutText(Source, ": ", 2);
+        }
+
+        unsigned int Pick = MixTotal ? NextRandom(&State) % MixTotal : 2;
+        unsigned int ParameterCount = Pick < Shape->Mix[0] ? 1 :
+                                      Pick < Shape->Mix[0] + Shape->Mix[1] ?
+                                      2 : 3;
+
+        for (unsigned int i = 0; i < ParameterCount; i++)
+        {
+            if (i)
+                PutText(Source, ", ", 2);
+
+            if (i == 2 && Percent(Shape->NextPercent))
+                Append<char>(Source, '?');
+            else
+                PutParameter();
+        }
+
+        Append<char>(Source, '\n');
+    }
+
+    // Declare every label that was referred to but never reached.
+    while (Declared < Referenced)
+    {
+        PutLabelName(Source, Shape, Declared++);
+        PutText(Source, ": 0\n", 4);
+    }
+}
+
+#undef MAX_IDENTIFIER_LENGTH
+#undef FORWARD_LABELS
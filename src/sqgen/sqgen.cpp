@@ -0,0 +1,103 @@
+/**
+ * @file sqgen.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the synthetic source generator. It writes a random SUBLEQ source of
+ * the size and shape asked for (see generate.cpp), which always assembles, to
+ * test and benchmark the assembler with sources bigger than anyone writes by
+ * hand. The same options and seed always give the same source.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "generate.cpp"
+
+
+#define UsageString "Usage: sqgen " ShapeOptionsString " [-o <output file>]\n"
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    UNKNOWN
+};
+
+struct options {
+    // Where to write the source; stdout if not given.
+    const char *OutputFile;
+    source_shape Shape;
+};
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.Shape = DefaultShape();
+
+    for (int i = 1; i < argc; i++)
+    {
+        status<bool> Shaped = ParseShapeOption(argc, argv, &i, &Options.Shape);
+
+        if (Shaped.Status != OK)
+        {
+            Severe("Bad value for \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+        else if (Shaped.unpack())
+        {
+            continue;
+        }
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            Options.OutputFile = argv[++i];
+        }
+        else
+        {
+            Severe("Unknown argument \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+    }
+
+    buffer<char> Source = { };
+    Reserve<char>(&Source, Options.Shape.Size + 1);
+
+    Generate(&Options.Shape, &Source);
+
+    FILE *File = Options.OutputFile ? fopen(Options.OutputFile, "wb") : stdout;
+
+    if (!File)
+    {
+        Error("Failed to open output file \"%s\", exiting.\n",
+              Options.OutputFile);
+
+        return UNKNOWN;
+    }
+
+    bool Written = fwrite(Source.Data, 1, Source.Length, File) == Source.Length;
+
+    if (File != stdout)
+        fclose(File);
+
+    Empty<char>(&Source);
+
+    if (!Written)
+    {
+        Error("Failed to write the source, exiting.\n");
+        return UNKNOWN;
+    }
+
+    return NORMAL;
+}
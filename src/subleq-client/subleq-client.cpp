@@ -0,0 +1,249 @@
+/**
+ * @file subleq-client.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the client for the emulator's server (see serve.cpp). It sends the
+ * server a job, an image to run with whatever input and limits it's given,
+ * and prints what the program prints as it arrives, the same as running it
+ * with subleq would. How the job went is printed after it, to the standard
+ * error. It can also ask the server for its statistics.
+ *
+ * The protocol is in job.cpp. This only builds on POSIX systems.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <algorithm>
+
+// POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/job.cpp"
+
+
+#define UsageString \
+    "Usage: subleq-client [--socket <path>] [--budget <count>] [--checked] " \
+    "[--input <address>] [--repeat <count>] <binary> [<cell>...]\n" \
+    "       subleq-client [--socket <path>] --stats\n"
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    NO_SERVER,
+    JOB_FAILED,
+    UNKNOWN
+};
+
+struct options {
+    const char *SocketPath;
+    // How many times to send the job.
+    unsigned int RepeatCount;
+    job Job;
+};
+
+
+// Connect() returns a connection to the server listening at [Path], or -1
+// after saying why if there isn't one.
+static
+int Connect(const char *Path)
+{
+    sockaddr_un Address = { };
+    Address.sun_family = AF_UNIX;
+
+    if (std::strlen(Path) >= sizeof(Address.sun_path))
+    {
+        Error("The socket path \"%s\" is too long.\n", Path);
+        return -1;
+    }
+
+    std::strcpy(Address.sun_path, Path);
+
+    int Descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (Descriptor >= 0 &&
+        connect(Descriptor, (sockaddr *)&Address, sizeof(Address)) != 0)
+    {
+        close(Descriptor);
+        Descriptor = -1;
+    }
+
+    if (Descriptor < 0)
+        Error("There's no server listening on \"%s\".\n", Path);
+
+    return Descriptor;
+}
+
+// SendJob() sends [Job] to the server at [Path], and prints what comes back.
+// Returns how the job went.
+static
+exit_status SendJob(const char *Path, const job *Job)
+{
+    int Descriptor = Connect(Path);
+
+    if (Descriptor < 0)
+        return NO_SERVER;
+
+    FILE *Connection = fdopen(Descriptor, "r+");
+
+    if (!Connection)
+    {
+        close(Descriptor);
+        return UNKNOWN;
+    }
+
+    WriteJob(Connection, Job);
+    fflush(Connection);
+
+    // NOTE The server reads until the empty line, but saying we're done
+    // lets it tell a request that never ended from a slow one.
+    shutdown(Descriptor, SHUT_WR);
+
+    exit_status Status = Job->Stats ? NORMAL : UNKNOWN;
+
+    char Line[4096];
+    bool LineStart = true;
+
+    while (fgets(Line, sizeof(Line), Connection))
+    {
+        if (LineStart && !Job->Stats && Line[0] == '=')
+        {
+            fprintf(stderr, "%s", Line + 2);
+            Status = std::strncmp(Line + 2, "halted ", 7) == 0 ? NORMAL :
+                                                               JOB_FAILED;
+        }
+        else if (LineStart && !Job->Stats && Line[0] == '!')
+        {
+            Error("%s", Line + 2);
+            Status = JOB_FAILED;
+        }
+        else
+        {
+            fputs(Line, stdout);
+        }
+
+        LineStart = Line[std::strlen(Line) - 1] == '\n';
+    }
+
+    fflush(stdout);
+    fclose(Connection);
+
+    if (Status == UNKNOWN)
+        Error("The server hung up before the job was done.\n");
+
+    return Status;
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.SocketPath  = DEFAULT_SOCKET_PATH;
+    Options.RepeatCount = 1;
+    Options.Job.Budget  = NO_JOB_BUDGET;
+
+    const char *BinaryFile = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+        {
+            Options.SocketPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+        {
+            Options.Job.Budget = strtoull(argv[++i], NULL, 10);
+        }
+        else if (std::strcmp(argv[i], "--checked") == 0)
+        {
+            Options.Job.Checked = true;
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            Options.Job.InputAddress = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            Options.RepeatCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            Options.Job.Stats = true;
+        }
+        else if (!BinaryFile)
+        {
+            BinaryFile = argv[i];
+        }
+        else
+        {
+            char *End = NULL;
+            long long Cell = strtoll(argv[i], &End, 0);
+
+            if (End == argv[i] || *End != '\0')
+            {
+                Severe("Input cell \"%s\" isn't a number, exiting.\n",
+                       argv[i]);
+
+                Empty(&Options.Job);
+
+                return MISSING_ARGS;
+            }
+
+            Append<int>(&Options.Job.Input, (int)Cell);
+        }
+    }
+
+    if (!Options.Job.Stats && !BinaryFile)
+    {
+        Severe("No input binary given, exiting.\n");
+
+        fprintf(stderr, UsageString);
+
+        return MISSING_ARGS;
+    }
+
+    if (Options.Job.Input.Length && Options.Job.InputAddress.empty())
+        Options.Job.InputAddress = "0";
+
+    // The server runs somewhere else, so it needs the binary's full path.
+    if (BinaryFile)
+    {
+        char Path[PATH_MAX];
+
+        if (!realpath(BinaryFile, Path))
+        {
+            Severe("Failed to find binary \"%s\", exiting.\n", BinaryFile);
+
+            Empty(&Options.Job);
+
+            return MISSING_ARGS;
+        }
+
+        Options.Job.ImagePath = Path;
+    }
+
+    exit_status Status = NORMAL;
+
+    for (unsigned int i = 0; i < Options.RepeatCount && Status != NO_SERVER;
+         i++)
+    {
+        exit_status Sent = SendJob(Options.SocketPath, &Options.Job);
+
+        if (Sent != NORMAL)
+            Status = Sent;
+    }
+
+    Empty(&Options.Job);
+
+    return Status;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file link.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the linker proper, shared by subleq-ld and the test
+ * driver (see src/tester).
+ *
+ * Every object is moved to its place by adding its base address to its
+ * relocations. Then every import is looked up by name among the labels of
+ * all the objects, through one hash table, and the label's address is added
+ * to the word that refers to it. A label declared by more than one object is
+ * only an error if another object imports it, since each object has already
+ * resolved its own references.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <algorithm>
+
+// Own Libraries
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/symbol.cpp"
+#include "../subleqc/object.cpp"
+
+
+#define NO_OBJECT 0xFFFFFFFF
+
+
+// Which objects declare a label: the first one to, and another one if there
+// is one.
+struct declaration {
+    unsigned int Object;
+    unsigned int Other;
+};
+
+
+// LinkObjects() lays [Objects] out one after the other, in order, and fills
+// [Program] with their code, moved into place and with every import
+// resolved, and [Labels] with every label they declare. [Names] are what the
+// objects are called in errors. Returns how many errors there were; if there
+// were any, [Program] isn't finished.
+static
+unsigned int LinkObjects(buffer<object> *Objects,
+                         const char *const *Names,
+                         buffer<int> *Program,
+                         symbol_table *Labels)
+{
+    /** Give each object its place. */
+
+    unsigned int ObjectCount = Objects->Length;
+
+    buffer<unsigned int> Bases = { };
+    Reserve<unsigned int>(&Bases, ObjectCount);
+
+    unsigned long long Length = 0;
+
+    for (unsigned int i = 0; i < ObjectCount; i++)
+    {
+        Append<unsigned int>(&Bases, (unsigned int)Length);
+        Length += (*Objects)[i].Code.Length;
+    }
+
+    if (Length > 0xFFFFFFFFull / sizeof(int))
+    {
+        Error("The objects are too big to link into one image, exiting.\n");
+
+        Empty<unsigned int>(&Bases);
+
+        return 1;
+    }
+
+
+    /** Index every object's labels. */
+
+    buffer<declaration> Declarations = { };
+
+    for (unsigned int i = 0; i < ObjectCount; i++)
+    {
+        symbol_table *Symbols = &(*Objects)[i].Symbols;
+
+        for (unsigned int j = 0; j < Symbols->Symbols.Length; j++)
+        {
+            const symbol *Local = &Symbols->Symbols[j];
+            unsigned int Index = Intern(Labels,
+                                        SymbolName(Symbols, j),
+                                        Local->NameLength);
+            symbol *Global = &Labels->Symbols[Index];
+
+            if (Index == Declarations.Length)
+                Append<declaration>(&Declarations, { NO_OBJECT, NO_OBJECT });
+
+            if (!Global->Defined)
+            {
+                Global->Address = Bases[i] + Local->Address;
+                Global->Defined = true;
+
+                Declarations[Index].Object = i;
+            }
+            else if (Declarations[Index].Other == NO_OBJECT)
+            {
+                Declarations[Index].Other = i;
+            }
+        }
+    }
+
+
+    /** Relocate every object and resolve its imports. */
+
+    Reserve<int>(Program, Length);
+    Program->Length = Length;
+
+    unsigned int ErrorCount = 0;
+
+    for (unsigned int i = 0; i < ObjectCount; i++)
+    {
+        object *Object = &(*Objects)[i];
+        int *Code = Program->Data + Bases[i];
+
+        std::copy(Object->Code.Data, Object->Code.Data + Object->Code.Length,
+                  Code);
+
+        for (unsigned int j = 0; j < Object->Relocations.Length; j++)
+            Code[Object->Relocations[j]] += Bases[i];
+
+        for (unsigned int j = 0; j < Object->Imports.Length; j++)
+        {
+            const reference *Import = &Object->Imports[j];
+
+            status<unsigned int> Result = Get(&Labels->Names,
+                                              Import->Name,
+                                              Import->NameLength);
+
+            if (Result.Status != OK)
+            {
+                Error("%s: Undeclared identifier \"%.*s\".\n",
+                      Names[i],
+                      Import->NameLength,
+                      Import->Name);
+
+                ErrorCount++;
+                continue;
+            }
+
+            const declaration *Declaration = &Declarations[Result.unpack()];
+
+            if (Declaration->Other != NO_OBJECT)
+            {
+                Error("%s: \"%.*s\" is declared by both %s and %s.\n",
+                      Names[i],
+                      Import->NameLength,
+                      Import->Name,
+                      Names[Declaration->Object],
+                      Names[Declaration->Other]);
+
+                ErrorCount++;
+                continue;
+            }
+
+            Code[Import->Offset] += Labels->Symbols[Result.unpack()].Address;
+        }
+    }
+
+    Empty<unsigned int>(&Bases);
+    Empty<declaration>(&Declarations);
+
+    return ErrorCount;
+}
+
+#undef NO_OBJECT
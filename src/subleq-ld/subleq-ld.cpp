@@ -0,0 +1,162 @@
+/**
+ * @file subleq-ld.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the SUBLEQ linker. It takes objects assembled with `subleqc -c`,
+ * lays them out one after the other in the order they're given, and writes
+ * them out as a single image, the same as subleqc would have written for
+ * their sources joined together.
+ *
+ * The linking itself is in link.cpp.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/symbol.cpp"
+#include "../subleqc/image.cpp"
+#include "../subleqc/object.cpp"
+#include "link.cpp"
+
+
+#define UsageString \
+    "Usage: subleq-ld [--memory <cells>] [--symbols] [--compress] " \
+    "-o <output file> <object file>...\n"
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    LINK_ERROR,
+    UNKNOWN
+};
+
+struct options {
+    buffer<const char *> ObjectFiles;
+    const char *OutputFile;
+    // How many cells of memory the program asks for. It always gets at least
+    // as many as it has.
+    unsigned int MemorySize;
+    // Whether to write the address of every label into the image.
+    bool Symbols;
+    // Whether to pack the image's code (see pack.cpp).
+    bool Compress;
+};
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            Options.OutputFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+        {
+            Options.MemorySize = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--symbols") == 0)
+        {
+            Options.Symbols = true;
+        }
+        else if (std::strcmp(argv[i], "--compress") == 0)
+        {
+            Options.Compress = true;
+        }
+        else
+        {
+            Append<const char *>(&Options.ObjectFiles, argv[i]);
+        }
+    }
+
+    if (!Options.ObjectFiles.Length)
+    {
+        Severe("No object files specified, exiting.\n");
+
+        printf(UsageString);
+
+        return MISSING_ARGS;
+    }
+    else if (!Options.OutputFile)
+    {
+        Severe("No output file specified, exiting.\n");
+
+        printf(UsageString);
+
+        return MISSING_ARGS;
+    }
+
+
+    /** Load the objects. */
+
+    unsigned int ObjectCount = Options.ObjectFiles.Length;
+
+    buffer<object> Objects = { };
+    Reserve<object>(&Objects, ObjectCount);
+    Objects.Length = ObjectCount;
+
+    for (unsigned int i = 0; i < ObjectCount; i++)
+    {
+        if (LoadObject(Options.ObjectFiles[i], &Objects[i]) != OK)
+            return UNKNOWN;
+    }
+
+
+    /** Link them. */
+
+    buffer<int> Program = { };
+    symbol_table Labels = { };
+
+    if (LinkObjects(&Objects, Options.ObjectFiles.Data, &Program, &Labels))
+        return LINK_ERROR;
+
+
+    /** Write the image. */
+
+    std::ofstream BinaryFile (Options.OutputFile,
+                              std::ofstream::out | std::ofstream::binary);
+
+    if (!BinaryFile)
+    {
+        Error("Failed to open output file \"%s\", exiting.\n",
+              Options.OutputFile);
+        return UNKNOWN;
+    }
+
+    image_facts Facts = { };
+    AnalyzeImage(&Program, Options.MemorySize, &Facts);
+
+    WriteImage(&BinaryFile,
+               Program.Data,
+               Program.Length,
+               Options.MemorySize,
+               true,
+               Options.Compress,
+               &Facts,
+               Options.Symbols ? &Labels : NULL);
+
+    BinaryFile.close();
+
+    Empty<unsigned char>(&Facts.Partition);
+
+    for (unsigned int i = 0; i < ObjectCount; i++)
+        Empty(&Objects[i]);
+
+    Empty<object>(&Objects);
+    Empty<int>(&Program);
+    Empty(&Labels);
+    Empty<const char *>(&Options.ObjectFiles);
+
+    return NORMAL;
+}
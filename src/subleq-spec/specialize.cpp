@@ -0,0 +1,884 @@
+/**
+ * @file specialize.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the specializer proper (see subleq-spec.cpp).
+ *
+ * The specializer runs the program on what it knows about its memory. Every
+ * cell is either known, with a value, or dynamic: one of the program's inputs,
+ * or worked out from one. An instruction that only reads known cells is run
+ * there and then, and leaves nothing behind. One that reads a dynamic cell is
+ * written out to the residual program, which keeps a cell of its own for each
+ * original cell it needs, and a pool of constants for the known values it
+ * reads. Such an instruction can jump either way, so both ways are
+ * specialized.
+ *
+ * A place the residual program can jump to is a variant: an address in the
+ * original program, and what's known when it gets there. A jump can go to any
+ * variant that agrees with what's known where it jumps from, once the values
+ * the variant expects are written into the residual cells (see Reach()).
+ * Once an address has MAX_VARIANTS, what's known there is generalized
+ * instead: the cells the variants disagree on become dynamic, so that a loop
+ * over dynamic data comes out as a loop rather than unrolled forever.
+ *
+ * The residual program ends with the same values as the original in the
+ * cells it's told to watch, but doesn't print the same thing: it leaves out
+ * what was worked out ahead of time, and prints what it materializes. The
+ * code the program runs has to be known, so a program that works out where to
+ * jump, or what to touch, from its input can't be specialized.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstring>
+#include <algorithm>
+
+// Own Libraries
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/hashmap.cpp"
+#include "../subleqc/engine.cpp"
+
+
+// MAGIC Enough for the first trips around a loop to come out different
+// from the rest, few enough that the residual program stays small.
+#define MAX_VARIANTS 4
+
+#define NO_VARIANT 0xFFFFFFFF
+#define NO_CELL    0xFFFFFFFF
+
+#define CELL_KNOWN 1 // The cell's value is known.
+#define CELL_HELD  2 // What its residual cell holds is known.
+#define CELL_DEAD  4 // It's cleared before it's read, so it doesn't matter.
+#define CELL_SEEN  8 // FindDead() has been by it.
+
+// MAGIC How far ahead to look for cells that are cleared before they're
+// read. Far enough to get past the pointer set up in front of a loop body.
+#define LOOKAHEAD 256
+
+// What a residual instruction's operand refers to, until the residual
+// program is laid out.
+#define OPERAND_CELL     0 // The residual cell of an original cell.
+#define OPERAND_CONSTANT 1 // A cell in the pool holding a constant.
+#define OPERAND_VARIANT  2 // The code of a variant.
+#define OPERAND_NEXT     3 // The instruction after this one.
+#define OPERAND_HALT     4
+#define OPERAND_LAST     5 // The last cell of the residual program.
+#define OPERAND_OUTSIDE  6 // The first address past it.
+
+
+struct cell_state {
+    int Value;
+    // What the cell's residual cell holds, if that's known and it matters.
+    int Held;
+    unsigned char Flags;
+};
+
+struct variant {
+    // Where in the original program it starts, -1 for halting.
+    int Counter;
+    buffer<cell_state> State;
+    // Where its code starts in the residual program, once it's written.
+    unsigned int Address;
+    bool Written;
+    // The next variant at the same address.
+    unsigned int Next;
+};
+
+struct operand {
+    unsigned char Kind;
+    int Value;
+};
+
+struct specializer {
+    const int *Memory;
+    unsigned int MemorySize;
+    // The cells whose final values the residual program has to keep.
+    const unsigned char *Watched;
+
+    buffer<variant> Variants;
+    // The first variant at every address, and at -1 last.
+    buffer<unsigned int> FirstVariant;
+    buffer<unsigned int> Pending;
+
+    // The residual code, three operands an instruction.
+    buffer<operand> Code;
+    // The residual cell of every original cell that has one, and the
+    // original cell of every residual cell.
+    buffer<unsigned int> CellIndex;
+    buffer<unsigned int> Cells;
+    // The cells that have been run as part of an instruction.
+    buffer<unsigned char> Fetched;
+    // The constant pool, and where each constant is in it.
+    buffer<int> Constants;
+    hashmap ConstantIndex;
+
+    // How many instructions have been run while specializing, and how many
+    // may be.
+    unsigned long long Folded;
+    unsigned long long FoldLimit;
+    // How many variants may be made.
+    unsigned int VariantLimit;
+};
+
+// The residual program, laid out.
+struct residual {
+    buffer<int> Program;
+    // Where the residual cells start, and the original cell of each.
+    unsigned int CellBase;
+    buffer<unsigned int> Cells;
+    // Where each variant's code starts, and the address it came from.
+    buffer<unsigned int> CodeAddresses;
+    buffer<int> CodeCounters;
+};
+
+
+// Known() returns whether [Cell]'s value is known.
+static inline
+bool Known(const cell_state *Cell)
+{
+    return Cell->Flags & CELL_KNOWN;
+}
+
+// Synced() returns whether [Cell] is known and its residual cell holds its
+// value.
+static inline
+bool Synced(const cell_state *Cell)
+{
+    return (Cell->Flags & (CELL_KNOWN | CELL_HELD)) ==
+           (CELL_KNOWN | CELL_HELD) && Cell->Held == Cell->Value;
+}
+
+
+/** Writing residual code. */
+
+// CellOf() returns the residual cell of the original cell at [Address],
+// giving it one if it doesn't have one yet. Residual cells start out with
+// what the original cell started out with.
+static
+unsigned int CellOf(specializer *Specializer, unsigned int Address)
+{
+    unsigned int *Index = &Specializer->CellIndex[Address];
+
+    if (*Index == NO_CELL)
+    {
+        *Index = Specializer->Cells.Length;
+        Append<unsigned int>(&Specializer->Cells, Address);
+    }
+
+    return *Index;
+}
+
+// ConstantOf() returns where [Value] is in the constant pool, putting it
+// there if it isn't yet.
+static
+unsigned int ConstantOf(specializer *Specializer, int Value)
+{
+    status<unsigned int> Found = Get(&Specializer->ConstantIndex,
+                                     (const char *)&Value, sizeof(Value));
+
+    if (Found.Status == OK)
+        return Found.unpack();
+
+    unsigned int Index = Specializer->Constants.Length;
+
+    Append<int>(&Specializer->Constants, Value);
+    Put(&Specializer->ConstantIndex, (const char *)&Value, sizeof(Value),
+        Index);
+
+    return Index;
+}
+
+// EmitInstruction() appends an instruction of [A], [B] and [C] to the
+// residual code.
+static inline
+void EmitInstruction(specializer *Specializer,
+                     operand A,
+                     operand B,
+                     operand C)
+{
+    Append<operand>(&Specializer->Code, A);
+    Append<operand>(&Specializer->Code, B);
+    Append<operand>(&Specializer->Code, C);
+}
+
+// Materialize() writes residual code that leaves [Value] in the residual cell
+// of the original cell at [Address], as [Cell] says it should be, and notes
+// that it does.
+static
+void Materialize(specializer *Specializer,
+                 cell_state *Cell,
+                 unsigned int Address,
+                 int Value)
+{
+    operand Target = { OPERAND_CELL, (int)CellOf(Specializer, Address) };
+    operand Next = { OPERAND_NEXT, 0 };
+
+    // NOTE The instruction leaves K - R in R, so if we know what R holds
+    // one instruction does it; otherwise R is cleared first, which is all
+    // there is to do for a 0.
+    int Held = 0;
+
+    if (Cell->Flags & CELL_HELD)
+    {
+        Held = Cell->Held;
+    }
+    else
+    {
+        EmitInstruction(Specializer, Target, Target, Next);
+    }
+
+    if (Value != 0 || (Cell->Flags & CELL_HELD))
+    {
+        int Constant = (int)((unsigned int)Value + (unsigned int)Held);
+        operand Source = { OPERAND_CONSTANT,
+                           (int)ConstantOf(Specializer, Constant) };
+
+        EmitInstruction(Specializer, Source, Target, Next);
+    }
+
+    Cell->Held = Value;
+    Cell->Flags |= CELL_HELD;
+}
+
+
+/** Variants. */
+
+// Compatible() returns whether code specialized for [Target] can run after
+// [State], once the values [Target] expects are materialized. Cells that
+// are dead to [Target] are never known to it.
+static
+bool Compatible(const cell_state *State,
+                const cell_state *Target,
+                unsigned int Length)
+{
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        if (Known(&Target[i]) &&
+            (!Known(&State[i]) || State[i].Value != Target[i].Value))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// SameCode() returns whether [State] and [Other] agree on every cell that's
+// been run as part of an instruction, and is live in both.
+static
+bool SameCode(const specializer *Specializer,
+              const cell_state *State,
+              const cell_state *Other)
+{
+    for (unsigned int i = 0; i < Specializer->MemorySize; i++)
+    {
+        if (Specializer->Fetched.Data[i] &&
+            !((State[i].Flags | Other[i].Flags) & CELL_DEAD) &&
+            (Known(&State[i]) != Known(&Other[i]) ||
+             (Known(&State[i]) && State[i].Value != Other[i].Value)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Normalize() forgets what [State] knows about the residual cells that
+// doesn't matter to a variant: only whether they hold their cell's value.
+static
+void Normalize(cell_state *State, unsigned int Length)
+{
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        if (!Synced(&State[i]))
+            State[i].Flags &= ~CELL_HELD;
+
+        if (!Known(&State[i]))
+            State[i].Value = State[i].Held = 0;
+    }
+}
+
+// AddVariant() makes a variant at [Counter] that expects [State], [Length]
+// cells of it, and returns it. It's written once the pending variants before
+// it are.
+static
+unsigned int AddVariant(specializer *Specializer,
+                        int Counter,
+                        const cell_state *State,
+                        unsigned int Length)
+{
+    unsigned int Slot = IsStdout(Counter) ? Specializer->MemorySize :
+                                            (unsigned int)Counter;
+
+    variant Variant = { };
+    Variant.Counter = Counter;
+    Variant.Next = NO_VARIANT;
+
+    Reserve<cell_state>(&Variant.State, Length);
+    Variant.State.Length = Length;
+    std::copy(State, State + Length, Variant.State.Data);
+    Normalize(Variant.State.Data, Length);
+
+    unsigned int Index = Specializer->Variants.Length;
+
+    // NOTE New variants go last, so the most general is the last one.
+    unsigned int *Link = &Specializer->FirstVariant[Slot];
+
+    while (*Link != NO_VARIANT)
+        Link = &Specializer->Variants[*Link].Next;
+
+    *Link = Index;
+
+    Append<variant>(&Specializer->Variants, Variant);
+    Append<unsigned int>(&Specializer->Pending, Index);
+
+    return Index;
+}
+
+// FindDead() marks the cells of [Key] that the program clears before it
+// reads them, going on from [Counter], as far as it can tell which way it
+// goes. [Key] is what's known there, and is otherwise left as it was.
+static
+void FindDead(const specializer *Specializer, int Counter, cell_state *Key)
+{
+    long Length = Specializer->MemorySize;
+
+    // Every cell touched on the way, and what it was before, to put back.
+    buffer<unsigned int> Touched = { };
+    buffer<cell_state> Saved = { };
+
+    for (unsigned int Step = 0; Step < LOOKAHEAD; Step++)
+    {
+        if (IsStdout(Counter) || !InBounds(Counter, Length - 2) ||
+            !Known(&Key[Counter]) ||
+            !Known(&Key[Counter + 1]) ||
+            !Known(&Key[Counter + 2]))
+        {
+            break;
+        }
+
+        int A = Key[Counter].Value;
+        int B = Key[Counter + 1].Value;
+        int C = Key[Counter + 2].Value;
+
+        if (!InMemory(A, Length) || !InMemory(B, Length) ||
+            !InBounds(C, Length))
+        {
+            break;
+        }
+
+        // NOTE A cell is dead if the first thing done to it is to clear
+        // it; everything else reads it first, the subtraction included.
+        unsigned int Cells[] = { (unsigned int)Counter,
+                                 (unsigned int)Counter + 1,
+                                 (unsigned int)Counter + 2,
+                                 (unsigned int)A,
+                                 (unsigned int)B };
+
+        for (unsigned int i = 0; i < 5; i++)
+        {
+            cell_state *Cell = &Key[Cells[i]];
+
+            if (Cell->Flags & CELL_SEEN)
+                continue;
+
+            Append<unsigned int>(&Touched, Cells[i]);
+            Append<cell_state>(&Saved, *Cell);
+
+            Cell->Flags |= CELL_SEEN;
+
+            if (A == B && i == 4)
+                Cell->Flags |= CELL_DEAD;
+        }
+
+        bool Dynamic = A != B && (!Known(&Key[A]) || !Known(&Key[B]));
+
+        if (Dynamic)
+        {
+            Key[B].Flags &= ~CELL_KNOWN;
+
+            // Which way it goes isn't known, unless it's the same way.
+            if (C != Counter + 3)
+                break;
+
+            Counter = C;
+            continue;
+        }
+
+        int Result = A == B ? 0 : Subtract(Key[A].Value, Key[B].Value);
+
+        Key[B].Value = Result;
+        Key[B].Flags |= CELL_KNOWN;
+
+        Counter = Result <= 0 ? C : Counter + 3;
+    }
+
+    for (unsigned int i = Touched.Length; i > 0; i--)
+    {
+        cell_state *Cell = &Key[Touched[i - 1]];
+        bool Dead = Cell->Flags & CELL_DEAD;
+
+        *Cell = Saved[i - 1];
+
+        if (Dead)
+            *Cell = { 0, 0, CELL_DEAD };
+    }
+
+    Empty<unsigned int>(&Touched);
+    Empty<cell_state>(&Saved);
+}
+
+// Reach() returns a variant at [Counter] that the residual program can jump
+// to from [State], making one if there isn't one, and writes residual code
+// that materializes what it expects. [State] is updated to match.
+static
+unsigned int Reach(specializer *Specializer, int Counter, cell_state *State)
+{
+    unsigned int Length = Specializer->MemorySize;
+    unsigned int Slot = IsStdout(Counter) ? Length : (unsigned int)Counter;
+
+    // What a variant here has to know; nothing about dead cells.
+    buffer<cell_state> Key = { };
+    Reserve<cell_state>(&Key, Length);
+    Key.Length = Length;
+    std::copy(State, State + Length, Key.Data);
+    Normalize(Key.Data, Length);
+    FindDead(Specializer, Counter, Key.Data);
+
+    unsigned int Found = NO_VARIANT;
+    unsigned int Last = NO_VARIANT;
+    unsigned int Count = 0;
+
+    for (unsigned int i = Specializer->FirstVariant[Slot]; i != NO_VARIANT;
+         i = Specializer->Variants[i].Next)
+    {
+        const cell_state *Other = Specializer->Variants[i].State.Data;
+
+        if (Found == NO_VARIANT && Compatible(State, Other, Length))
+            Found = i;
+
+        // NOTE Only variants running the same code are generalized
+        // together, since code that isn't known can't be specialized.
+        if (SameCode(Specializer, Key.Data, Other))
+        {
+            Last = i;
+            Count++;
+        }
+    }
+
+    if (Found == NO_VARIANT && Count >= MAX_VARIANTS)
+    {
+        // Generalize: whatever the last variant and this disagree on is
+        // dynamic from here on.
+        const cell_state *Other = Specializer->Variants[Last].State.Data;
+
+        for (unsigned int i = 0; i < Length; i++)
+        {
+            if ((Key[i].Flags | Other[i].Flags) & CELL_DEAD)
+                Key[i].Flags = CELL_DEAD;
+            else if (!Known(&Other[i]) || Other[i].Value != Key[i].Value)
+                Key[i].Flags = 0;
+            else if (!(Other[i].Flags & CELL_HELD))
+                Key[i].Flags &= ~CELL_HELD;
+        }
+    }
+
+    if (Found == NO_VARIANT)
+        Found = AddVariant(Specializer, Counter, Key.Data, Length);
+
+    Empty<cell_state>(&Key);
+
+    // The variant expects every live cell it doesn't know, and every cell it
+    // knows is held, to be in its residual cell.
+    const cell_state *Target = Specializer->Variants[Found].State.Data;
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        bool Expected = !(Target[i].Flags & CELL_DEAD) &&
+                        (!Known(&Target[i]) || (Target[i].Flags & CELL_HELD));
+
+        if (Expected && Known(&State[i]) && !Synced(&State[i]))
+            Materialize(Specializer, &State[i], i, State[i].Value);
+    }
+
+    return Found;
+}
+
+
+/** Specializing. */
+
+// Stop() writes the residual code for stopping from [State]: every watched
+// cell that's known gets its final value, and then an instruction of [A] and
+// [C] stops the program.
+static
+void Stop(specializer *Specializer,
+          cell_state *State,
+          unsigned char A,
+          unsigned char C)
+{
+    for (unsigned int i = 0; i < Specializer->MemorySize; i++)
+    {
+        if (Specializer->Watched[i] && Known(&State[i]) && !Synced(&State[i]))
+            Materialize(Specializer, &State[i], i, State[i].Value);
+    }
+
+    operand Zero = { OPERAND_CONSTANT, (int)ConstantOf(Specializer, 0) };
+
+    EmitInstruction(Specializer,
+                    A == OPERAND_CONSTANT ? Zero : operand { A, 0 },
+                    Zero,
+                    operand { C, 0 });
+}
+
+// WriteVariant() writes the residual code for the variant [Index], and for
+// the variants after it that can follow on from it without a jump. Returns
+// ERROR, after saying why, if the program can't be specialized.
+static
+status_code WriteVariant(specializer *Specializer, unsigned int Index)
+{
+    unsigned int Length = Specializer->MemorySize;
+
+    buffer<cell_state> State = { };
+    Reserve<cell_state>(&State, Length);
+    State.Length = Length;
+
+    status_code Status = OK;
+
+    while (Index != NO_VARIANT)
+    {
+        variant *Variant = &Specializer->Variants[Index];
+
+        Variant->Address = Specializer->Code.Length;
+        Variant->Written = true;
+
+        std::copy(Variant->State.Data, Variant->State.Data + Length,
+                  State.Data);
+
+        int Counter = Variant->Counter;
+        Index = NO_VARIANT;
+
+        while (true)
+        {
+            if (IsStdout(Counter))
+            {
+                Stop(Specializer, State.Data, OPERAND_CONSTANT, OPERAND_HALT);
+                break;
+            }
+
+            // NOTE A program going out of bounds is stopped the same way
+            // in the residual program. Loops that were generalized can also
+            // get here on paths the program can never take, which costs code
+            // but nothing else.
+            if (!InBounds(Counter, (long)Length - 2))
+            {
+                Stop(Specializer, State.Data, OPERAND_CONSTANT, OPERAND_LAST);
+                break;
+            }
+
+            if (!Known(&State[Counter]) ||
+                !Known(&State[Counter + 1]) ||
+                !Known(&State[Counter + 2]))
+            {
+                Error("The instruction at %d depends on the input.\n",
+                      Counter);
+                Status = ERROR;
+                break;
+            }
+
+            Specializer->Fetched[Counter]     = 1;
+            Specializer->Fetched[Counter + 1] = 1;
+            Specializer->Fetched[Counter + 2] = 1;
+
+            int A = State[Counter].Value;
+            int B = State[Counter + 1].Value;
+            int C = State[Counter + 2].Value;
+
+            if (!InMemory(A, Length) ||
+                !InMemory(B, Length) ||
+                !InBounds(C, Length))
+            {
+                Stop(Specializer, State.Data, OPERAND_OUTSIDE, OPERAND_NEXT);
+                break;
+            }
+
+            if (++Specializer->Folded > Specializer->FoldLimit)
+            {
+                Error("Gave up after running %llu instructions; the program "
+                      "may never halt.\n", Specializer->FoldLimit);
+                Status = ERROR;
+                break;
+            }
+
+            cell_state *Source = &State[A];
+            cell_state *Target = &State[B];
+
+            // NOTE A cell minus itself is 0 whatever it holds.
+            if (A == B || (Known(Source) && Known(Target)))
+            {
+                int Result = A == B ? 0 : Subtract(Source->Value,
+                                                   Target->Value);
+
+                Target->Value = Result;
+                Target->Flags |= CELL_KNOWN;
+
+                Counter = Result <= 0 ? C : Counter + 3;
+                continue;
+            }
+
+            // The instruction has to run in the residual program.
+            operand First = Known(Source) ?
+                operand { OPERAND_CONSTANT,
+                          (int)ConstantOf(Specializer, Source->Value) } :
+                operand { OPERAND_CELL, (int)CellOf(Specializer, A) };
+            operand Second = { OPERAND_CELL, (int)CellOf(Specializer, B) };
+
+            if (Known(Target) && !Synced(Target))
+                Materialize(Specializer, Target, B, Target->Value);
+
+            Target->Flags = 0;
+
+            // NOTE Most instructions go on to the next one either way,
+            // and there's nothing to specialize separately.
+            if (C == Counter + 3)
+            {
+                EmitInstruction(Specializer, First, Second,
+                                operand { OPERAND_NEXT, 0 });
+
+                Counter = C;
+                continue;
+            }
+
+            unsigned int Taken = Reach(Specializer, C, State.Data);
+            unsigned int Next = Reach(Specializer, Counter + 3, State.Data);
+
+            EmitInstruction(Specializer,
+                            First,
+                            Second,
+                            operand { OPERAND_VARIANT, (int)Taken });
+
+            // NOTE Reach() leaves new variants pending, and the one we'd
+            // fall through to is best written right here.
+            if (!Specializer->Variants[Next].Written)
+            {
+                Index = Next;
+            }
+            else
+            {
+                operand Zero = { OPERAND_CONSTANT,
+                                 (int)ConstantOf(Specializer, 0) };
+
+                EmitInstruction(Specializer, Zero, Zero,
+                                operand { OPERAND_VARIANT, (int)Next });
+            }
+
+            break;
+        }
+
+        if (Status != OK)
+            break;
+    }
+
+    Empty<cell_state>(&State);
+
+    return Status;
+}
+
+// Specialize() specializes the program in [Specializer] from [Entry], with
+// the cells marked in [Inputs] dynamic and every other cell known. Returns
+// ERROR, after saying why, if it can't be.
+static
+status_code Specialize(specializer *Specializer,
+                       const unsigned char *Inputs,
+                       unsigned int Entry)
+{
+    unsigned int Length = Specializer->MemorySize;
+
+    Reserve<unsigned int>(&Specializer->FirstVariant, Length + 1);
+    Specializer->FirstVariant.Length = Length + 1;
+    std::fill(Specializer->FirstVariant.Data,
+              Specializer->FirstVariant.Data + Length + 1, NO_VARIANT);
+
+    Reserve<unsigned int>(&Specializer->CellIndex, Length);
+    Specializer->CellIndex.Length = Length;
+    std::fill(Specializer->CellIndex.Data,
+              Specializer->CellIndex.Data + Length, NO_CELL);
+
+    Reserve<unsigned char>(&Specializer->Fetched, Length);
+    Specializer->Fetched.Length = Length;
+    std::fill(Specializer->Fetched.Data, Specializer->Fetched.Data + Length,
+              0);
+
+    buffer<cell_state> State = { };
+    Reserve<cell_state>(&State, Length);
+    State.Length = Length;
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        int Value = Specializer->Memory[i];
+
+        State[i] = { Value, Value, CELL_KNOWN | CELL_HELD };
+
+        // Inputs need somewhere to go.
+        if (Inputs[i])
+        {
+            State[i] = { };
+            CellOf(Specializer, i);
+        }
+    }
+
+    AddVariant(Specializer, (int)Entry, State.Data, Length);
+
+    Empty<cell_state>(&State);
+
+    for (unsigned int i = 0; i < Specializer->Pending.Length; i++)
+    {
+        unsigned int Index = Specializer->Pending[i];
+
+        // NOTE Generalizing only keeps a loop from unrolling when it's
+        // the data that changes from one trip to the next. A loop whose
+        // counter is dynamic but whose pointers are known still unrolls, and
+        // on a path the original never takes, it never stops.
+        if (Specializer->Variants.Length > Specializer->VariantLimit)
+        {
+            Error("Gave up after making %u variants; the residual program "
+                  "would be too big.\n", Specializer->VariantLimit);
+            return ERROR;
+        }
+
+        if (!Specializer->Variants[Index].Written &&
+            WriteVariant(Specializer, Index) != OK)
+        {
+            return ERROR;
+        }
+    }
+
+    return OK;
+}
+
+// LayOut() lays the residual program in [Specializer] out into [Residual]:
+// its code, then its cells, then the constant pool.
+static
+void LayOut(specializer *Specializer, residual *Residual)
+{
+    *Residual = { };
+
+    unsigned int CodeLength = Specializer->Code.Length;
+    unsigned int CellCount = Specializer->Cells.Length;
+    unsigned int ConstantBase = CodeLength + CellCount;
+    unsigned int Length = ConstantBase + Specializer->Constants.Length;
+
+    Reserve<int>(&Residual->Program, Length);
+    Residual->Program.Length = Length;
+
+    for (unsigned int i = 0; i < CodeLength; i++)
+    {
+        operand *Operand = &Specializer->Code[i];
+        int Value = 0;
+
+        switch (Operand->Kind)
+        {
+            case OPERAND_CELL:
+                Value = (int)(CodeLength + Operand->Value);
+                break;
+
+            case OPERAND_CONSTANT:
+                Value = (int)(ConstantBase + Operand->Value);
+                break;
+
+            case OPERAND_VARIANT:
+                Value = (int)Specializer->Variants[Operand->Value].Address;
+                break;
+
+            case OPERAND_NEXT:
+                Value = (int)(i + 1);
+                break;
+
+            case OPERAND_HALT:
+                Value = -1;
+                break;
+
+            case OPERAND_LAST:
+                Value = (int)(Length - 1);
+                break;
+
+            case OPERAND_OUTSIDE:
+                Value = (int)Length;
+                break;
+
+            default:
+                Unreachable();
+        }
+
+        Residual->Program[i] = Value;
+    }
+
+    for (unsigned int i = 0; i < CellCount; i++)
+        Residual->Program[CodeLength + i] =
+            Specializer->Memory[Specializer->Cells[i]];
+
+    std::copy(Specializer->Constants.Data,
+              Specializer->Constants.Data + Specializer->Constants.Length,
+              Residual->Program.Data + ConstantBase);
+
+    Residual->CellBase = CodeLength;
+
+    Reserve<unsigned int>(&Residual->Cells, CellCount);
+
+    for (unsigned int i = 0; i < CellCount; i++)
+        Append<unsigned int>(&Residual->Cells, Specializer->Cells[i]);
+
+    for (unsigned int i = 0; i < Specializer->Variants.Length; i++)
+    {
+        const variant *Variant = &Specializer->Variants[i];
+
+        Append<unsigned int>(&Residual->CodeAddresses, Variant->Address);
+        Append<int>(&Residual->CodeCounters, Variant->Counter);
+    }
+}
+
+// Empty() frees all the memory held by [Specializer].
+static
+void Empty(specializer *Specializer)
+{
+    for (unsigned int i = 0; i < Specializer->Variants.Length; i++)
+        Empty<cell_state>(&Specializer->Variants[i].State);
+
+    Empty<variant>(&Specializer->Variants);
+    Empty<unsigned int>(&Specializer->FirstVariant);
+    Empty<unsigned int>(&Specializer->Pending);
+    Empty<operand>(&Specializer->Code);
+    Empty<unsigned int>(&Specializer->CellIndex);
+    Empty<unsigned int>(&Specializer->Cells);
+    Empty<unsigned char>(&Specializer->Fetched);
+    Empty<int>(&Specializer->Constants);
+    Empty(&Specializer->ConstantIndex);
+}
+
+// Empty() frees all the memory held by [Residual].
+static
+void Empty(residual *Residual)
+{
+    Empty<int>(&Residual->Program);
+    Empty<unsigned int>(&Residual->Cells);
+    Empty<unsigned int>(&Residual->CodeAddresses);
+    Empty<int>(&Residual->CodeCounters);
+}
+
+#undef OPERAND_OUTSIDE
+#undef OPERAND_LAST
+#undef OPERAND_HALT
+#undef OPERAND_NEXT
+#undef OPERAND_VARIANT
+#undef OPERAND_CONSTANT
+#undef OPERAND_CELL
+#undef LOOKAHEAD
+#undef CELL_SEEN
+#undef CELL_DEAD
+#undef CELL_HELD
+#undef CELL_KNOWN
+#undef NO_VARIANT
+#undef MAX_VARIANTS
@@ -0,0 +1,497 @@
+/**
+ * @file subleq-spec.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the SUBLEQ specializer. It takes an image, and which of its cells
+ * are the program's input; every other cell is taken to be constant, as the
+ * image has it. Whatever the program works out from the constants alone is
+ * worked out now, and what's left, the residual program, is written out as a
+ * new image, along with a map from its cells back to the original ones.
+ *
+ * The residual program is then checked against the original on sample
+ * inputs: both are run on the emulator's engine, and have to stop the same
+ * way with the same values in the cells being watched.
+ *
+ * The specializing itself is in specialize.cpp. The check throws away what
+ * the programs print, so this only builds on POSIX systems.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/image.cpp"
+#include "../subleqc/engine.cpp"
+#include "specialize.cpp"
+
+
+#define UsageString \
+    "Usage: subleq-spec [--input <cells>]... [--output <cells>]... " \
+    "[--map <file>] [--check <count>] [--budget <count>] " \
+    "[--fold-limit <count>] [--variant-limit <count>] [--compress] " \
+    "-o <output file> <binary>\n"
+
+// MAGIC Enough samples to catch a wrong branch, few enough that checking
+// takes a moment.
+#define DEFAULT_CHECK_COUNT 100
+#define DEFAULT_CHECK_BUDGET 10000000ull
+#define DEFAULT_FOLD_LIMIT 100000000ull
+
+// MAGIC Every variant keeps what's known about every cell, so this is
+// what bounds how much memory specializing takes.
+#define DEFAULT_VARIANT_LIMIT 4096
+
+// MAGIC Sample inputs are small, so that loops over them finish.
+#define SAMPLE_RANGE 64
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    NOT_SPECIALIZED,
+    CHECK_FAILED,
+    UNKNOWN
+};
+
+struct options {
+    const char *BinaryFile;
+    const char *OutputFile;
+    // Where to write the map; the output file's name with ".map" after it if
+    // this isn't given.
+    const char *MapFile;
+    // The cells given as input, and as output, as they were written.
+    buffer<const char *> Inputs;
+    buffer<const char *> Outputs;
+    // How many sample inputs to check the residual program on, and how many
+    // instructions the original may run on each.
+    unsigned int CheckCount;
+    unsigned long long Budget;
+    unsigned long long FoldLimit;
+    unsigned int VariantLimit;
+    bool Compress;
+};
+
+
+// MarkCells() marks the cells [Text] stands for in [Marks], [Length] cells
+// long: an address or a label in the symbol table of the image at [Path],
+// followed by a comma and how many cells if it's more than one. Returns
+// ERROR, after saying why, if it isn't any cells of the image.
+static
+status_code MarkCells(const char *Path,
+                      const char *Text,
+                      unsigned char *Marks,
+                      unsigned int Length)
+{
+    std::string Name = Text;
+    unsigned long long Count = 1;
+
+    size_t Comma = Name.find(',');
+
+    if (Comma != std::string::npos)
+    {
+        char *End = NULL;
+        Count = strtoull(Name.c_str() + Comma + 1, &End, 0);
+
+        if (*End != '\0' || Count == 0)
+        {
+            Error("\"%s\" isn't a count of cells.\n", Name.c_str() + Comma + 1);
+            return ERROR;
+        }
+
+        Name.resize(Comma);
+    }
+
+    char *End = NULL;
+    long long Address = strtoll(Name.c_str(), &End, 0);
+
+    if (End == Name.c_str() || *End != '\0')
+    {
+        status<unsigned int> Symbol = FindSymbol(Path, Name.c_str());
+
+        if (Symbol.Status != OK)
+        {
+            Error("No address or label \"%s\" in \"%s\".\n", Name.c_str(),
+                  Path);
+            return ERROR;
+        }
+
+        Address = Symbol.unpack();
+    }
+
+    if (Address < 0 || (unsigned long long)Address + Count > Length)
+    {
+        Error("The cells \"%s\" aren't all in memory.\n", Text);
+        return ERROR;
+    }
+
+    std::fill(Marks + Address, Marks + Address + Count, 1);
+
+    return OK;
+}
+
+// WriteMap() writes the map of [Residual] back to the program it came from
+// to [Path]: a line for each of its cells and each place its code starts,
+// with the residual address first.
+static
+status_code WriteMap(const char *Path, const residual *Residual)
+{
+    FILE *File = fopen(Path, "w");
+
+    if (!File)
+    {
+        Error("Failed to open map file \"%s\".\n", Path);
+        return ERROR;
+    }
+
+    fprintf(File, "# residual original\n");
+
+    for (unsigned int i = 0; i < Residual->CodeAddresses.Length; i++)
+        fprintf(File, "code %u %d\n", Residual->CodeAddresses.Data[i],
+                Residual->CodeCounters.Data[i]);
+
+    for (unsigned int i = 0; i < Residual->Cells.Length; i++)
+        fprintf(File, "cell %u %u\n", Residual->CellBase + i,
+                Residual->Cells.Data[i]);
+
+    fclose(File);
+
+    return OK;
+}
+
+// Check() runs the original program, [Image], and [Residual] on [Count]
+// sample inputs, the first being the ones in the image and the rest random,
+// and compares the cells marked [Watched] when they stop. Returns ERROR,
+// after saying how, if they don't agree on any of them.
+static
+status_code Check(const image *Image,
+                  const residual *Residual,
+                  const unsigned int *CellIndex,
+                  const unsigned char *Inputs,
+                  const unsigned char *Watched,
+                  unsigned int Count,
+                  unsigned long long Budget)
+{
+    unsigned int Length = Image->MemorySize;
+    unsigned int ResidualLength = Residual->Program.Length;
+
+    int *Original = new int[Length];
+    int *Specialized = new int[ResidualLength];
+
+    // The output is still formatted, just not kept.
+    OutputFile = fopen("/dev/null", "w");
+
+    unsigned int Seed = 0x2545F491;
+    unsigned int Checked = 0, OutOfSteps = 0;
+    unsigned long long OriginalSteps = 0, ResidualSteps = 0;
+    status_code Status = OK;
+
+    for (unsigned int Sample = 0; Sample < Count && Status == OK; Sample++)
+    {
+        std::copy(Image->Memory, Image->Memory + Length, Original);
+        std::copy(Residual->Program.Data,
+                  Residual->Program.Data + ResidualLength, Specialized);
+
+        for (unsigned int i = 0; Sample && i < Length; i++)
+        {
+            if (!Inputs[i])
+                continue;
+
+            Seed ^= Seed << 13;
+            Seed ^= Seed >> 17;
+            Seed ^= Seed << 5;
+
+            Original[i] = (int)(Seed % (2 * SAMPLE_RANGE + 1)) - SAMPLE_RANGE;
+            Specialized[Residual->CellBase + CellIndex[i]] = Original[i];
+        }
+
+        unsigned long long Steps = 0, Fewer = 0;
+
+        engine_status Expected = RunChecked(Original, Length, Image->Entry,
+                                            NULL, &Steps, Budget);
+
+        // NOTE There's no telling whether a program that ran out of
+        // steps would have halted, so there's nothing to compare.
+        if (Expected == OUT_OF_STEPS)
+        {
+            OutOfSteps++;
+            continue;
+        }
+
+        engine_status Got = RunChecked(Specialized, ResidualLength, 0, NULL,
+                                       &Fewer, Budget);
+
+        // NOTE Which way a program goes out of bounds isn't kept: the
+        // engine says the counter did when an instruction at the very end of
+        // memory reaches outside it, and the residual program's code is
+        // never there.
+        if ((Got == HALTED) != (Expected == HALTED) || Got == OUT_OF_STEPS)
+        {
+            Error("Sample %u: the original program %s but the residual one "
+                  "%s.\n",
+                  Sample,
+                  Expected == HALTED ? "halted" : "went out of bounds",
+                  Got == HALTED       ? "halted" :
+                  Got == OUT_OF_STEPS ? "ran out of steps" :
+                                        "went out of bounds");
+            Status = ERROR;
+            break;
+        }
+
+        for (unsigned int i = 0; i < Length; i++)
+        {
+            if (!Watched[i])
+                continue;
+
+            // NOTE A cell that never got a residual cell was never
+            // changed.
+            int Value = CellIndex[i] == NO_CELL ?
+                        Image->Memory[i] :
+                        Specialized[Residual->CellBase + CellIndex[i]];
+
+            if (Value != Original[i])
+            {
+                Error("Sample %u: cell %u ends up %d, but should be %d.\n",
+                      Sample, i, Value, Original[i]);
+                Status = ERROR;
+                break;
+            }
+        }
+
+        Checked++;
+        OriginalSteps += Steps;
+        ResidualSteps += Fewer;
+    }
+
+    fclose(OutputFile);
+    OutputFile = stdout;
+
+    delete[] Original;
+    delete[] Specialized;
+
+    if (Status == OK)
+    {
+        Info("Checked %u sample inputs (%u ran out of steps); the residual "
+             "program ran %llu instructions to the original's %llu.\n",
+             Checked, OutOfSteps, ResidualSteps, OriginalSteps);
+    }
+
+    return Status;
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.CheckCount   = DEFAULT_CHECK_COUNT;
+    Options.Budget       = DEFAULT_CHECK_BUDGET;
+    Options.FoldLimit    = DEFAULT_FOLD_LIMIT;
+    Options.VariantLimit = DEFAULT_VARIANT_LIMIT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            Options.OutputFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+        {
+            Options.MapFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            Append<const char *>(&Options.Inputs, argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            Append<const char *>(&Options.Outputs, argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+        {
+            Options.CheckCount = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+        {
+            Options.Budget = strtoull(argv[++i], NULL, 10);
+        }
+        else if (std::strcmp(argv[i], "--fold-limit") == 0 && i + 1 < argc)
+        {
+            Options.FoldLimit = strtoull(argv[++i], NULL, 10);
+        }
+        else if (std::strcmp(argv[i], "--variant-limit") == 0 && i + 1 < argc)
+        {
+            Options.VariantLimit = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--compress") == 0)
+        {
+            Options.Compress = true;
+        }
+        else if (argv[i][0] == '-' || Options.BinaryFile)
+        {
+            Severe("Unexpected argument \"%s\", exiting.\n", argv[i]);
+
+            printf(UsageString);
+
+            return MISSING_ARGS;
+        }
+        else
+        {
+            Options.BinaryFile = argv[i];
+        }
+    }
+
+    if (!Options.BinaryFile)
+    {
+        Severe("No input binary given, exiting.\n");
+
+        printf(UsageString);
+
+        return MISSING_ARGS;
+    }
+    else if (!Options.OutputFile)
+    {
+        Severe("No output file specified, exiting.\n");
+
+        printf(UsageString);
+
+        return MISSING_ARGS;
+    }
+
+    std::string MapFile = Options.MapFile ? Options.MapFile :
+                          std::string(Options.OutputFile) + ".map";
+
+
+    /** Load the image, and say what's input and what's watched. */
+
+    image Image = { };
+
+    if (LoadImage(Options.BinaryFile, &Image) != OK)
+        return UNKNOWN;
+
+    unsigned int Length = Image.MemorySize;
+
+    buffer<unsigned char> Inputs = { };
+    Reserve<unsigned char>(&Inputs, Length);
+    Inputs.Length = Length;
+    std::fill(Inputs.Data, Inputs.Data + Length, 0);
+
+    // NOTE Without any outputs, every cell is watched.
+    buffer<unsigned char> Watched = { };
+    Reserve<unsigned char>(&Watched, Length);
+    Watched.Length = Length;
+    std::fill(Watched.Data, Watched.Data + Length, !Options.Outputs.Length);
+
+    exit_status Status = NORMAL;
+
+    for (unsigned int i = 0; i < Options.Inputs.Length && !Status; i++)
+    {
+        if (MarkCells(Options.BinaryFile, Options.Inputs[i], Inputs.Data,
+                      Length) != OK)
+            Status = MISSING_ARGS;
+    }
+
+    for (unsigned int i = 0; i < Options.Outputs.Length && !Status; i++)
+    {
+        if (MarkCells(Options.BinaryFile, Options.Outputs[i], Watched.Data,
+                      Length) != OK)
+            Status = MISSING_ARGS;
+    }
+
+
+    /** Specialize it. */
+
+    specializer Specializer = { };
+    Specializer.Memory       = Image.Memory;
+    Specializer.MemorySize   = Length;
+    Specializer.Watched      = Watched.Data;
+    Specializer.FoldLimit    = Options.FoldLimit;
+    Specializer.VariantLimit = Options.VariantLimit;
+
+    residual Residual = { };
+
+    if (!Status && Specialize(&Specializer, Inputs.Data, Image.Entry) != OK)
+    {
+        Error("Failed to specialize \"%s\".\n", Options.BinaryFile);
+        Status = NOT_SPECIALIZED;
+    }
+
+    if (!Status)
+    {
+        // Watched outputs always have a residual cell, so they're on the map.
+        for (unsigned int i = 0; Options.Outputs.Length && i < Length; i++)
+        {
+            if (Watched[i])
+                CellOf(&Specializer, i);
+        }
+
+        LayOut(&Specializer, &Residual);
+
+        Info("Folded %llu instructions; the residual program is %u cells, "
+             "%u of them code, to the original's %u.\n",
+             Specializer.Folded,
+             Residual.Program.Length,
+             Residual.CellBase,
+             Length);
+    }
+
+
+    /** Check it, and write it out. */
+
+    if (!Status && Options.CheckCount &&
+        Check(&Image, &Residual, Specializer.CellIndex.Data, Inputs.Data,
+              Watched.Data, Options.CheckCount, Options.Budget) != OK)
+    {
+        Status = CHECK_FAILED;
+    }
+
+    if (!Status)
+    {
+        std::ofstream BinaryFile (Options.OutputFile,
+                                  std::ofstream::out | std::ofstream::binary);
+
+        if (!BinaryFile)
+        {
+            Error("Failed to open output file \"%s\", exiting.\n",
+                  Options.OutputFile);
+            Status = UNKNOWN;
+        }
+        else
+        {
+            image_facts Facts = { };
+            AnalyzeImage(&Residual.Program, 0, &Facts);
+
+            WriteImage(&BinaryFile,
+                       Residual.Program.Data,
+                       Residual.Program.Length,
+                       0,
+                       true,
+                       Options.Compress,
+                       &Facts,
+                       NULL);
+
+            BinaryFile.close();
+
+            Empty<unsigned char>(&Facts.Partition);
+
+            if (WriteMap(MapFile.c_str(), &Residual) != OK)
+                Status = UNKNOWN;
+        }
+    }
+
+    Empty(&Residual);
+    Empty(&Specializer);
+    Empty<unsigned char>(&Inputs);
+    Empty<unsigned char>(&Watched);
+    Empty<const char *>(&Options.Inputs);
+    Empty<const char *>(&Options.Outputs);
+    Unload(&Image);
+
+    return Status;
+}
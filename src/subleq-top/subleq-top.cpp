@@ -0,0 +1,164 @@
+/**
+ * @file subleq-top.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This watches a program the emulator is running with "--stats <name>". It
+ * maps the stats segment called that (see stats.cpp) and reads its counters
+ * every so often, printing a line each time with how long it's been watching,
+ * how many instructions have run and how many a second since the last line,
+ * where the program counter is, how many of the instructions jumped, and how
+ * many wrote to the program's own code, if the emulator was asked to count
+ * that. The lines are tab separated values,
+ * so they can be kept and plotted.
+ *
+ * It waits for the segment if the program hasn't started yet, and stops once
+ * the program has, after a last line with the final counters. Reading the
+ * segment never gets in the program's way.
+ *
+ * This only builds on POSIX systems.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/stats.cpp"
+
+
+#define UsageString \
+    "Usage: subleq-top [--interval <milliseconds>] [--count <count>] <name>\n"
+
+// MAGIC A few times a second is plenty to watch by, and reading the
+// segment is cheap enough to do much more often.
+#define DEFAULT_INTERVAL 500
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    UNKNOWN
+};
+
+struct options {
+    // How long to wait between lines.
+    unsigned int Interval;
+    // How many lines to print before giving up; as many as it takes if 0.
+    unsigned int Count;
+    const char *Name;
+};
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.Interval = DEFAULT_INTERVAL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            Options.Interval = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+        {
+            Options.Count = std::max(0, atoi(argv[++i]));
+        }
+        else if (argv[i][0] == '-' || Options.Name)
+        {
+            Severe("Unexpected argument \"%s\", exiting.\n", argv[i]);
+
+            fprintf(stderr, UsageString);
+
+            return MISSING_ARGS;
+        }
+        else
+        {
+            Options.Name = argv[i];
+        }
+    }
+
+    if (!Options.Name)
+    {
+        Severe("No stats segment given, exiting.\n");
+
+        fprintf(stderr, UsageString);
+
+        return MISSING_ARGS;
+    }
+
+    auto Interval = std::chrono::milliseconds(Options.Interval);
+
+    // NOTE The watcher is often started alongside the program, so it
+    // gives the program a moment to make the segment.
+    const stats_segment *Segment = NULL;
+
+    while (!(Segment = OpenStats(Options.Name)))
+        std::this_thread::sleep_for(Interval);
+
+    printf("seconds\tsteps\tsteps_per_second\tcounter\ttaken\t"
+           "self_modifying\n");
+
+    auto Start = std::chrono::steady_clock::now();
+    auto Last = Start;
+    uint64_t LastSteps = 0;
+
+    for (unsigned int Line = 0; Options.Count == 0 || Line < Options.Count;
+         Line++)
+    {
+        // NOTE The counters are read after the state, so that once the
+        // program has stopped they're sure to be the final ones.
+        bool Stopped = Segment->State.load(std::memory_order_acquire) ==
+                       STATS_STOPPED;
+
+        uint64_t Steps = Segment->Steps.load(std::memory_order_relaxed);
+        uint64_t Taken = Segment->Taken.load(std::memory_order_relaxed);
+        uint64_t SelfModifying =
+            Segment->SelfModifying.load(std::memory_order_relaxed);
+        int64_t Counter = Segment->Counter.load(std::memory_order_relaxed);
+
+        auto Now = std::chrono::steady_clock::now();
+
+        double Seconds = std::chrono::duration<double>(Now - Start).count();
+        double Elapsed = std::chrono::duration<double>(Now - Last).count();
+
+        // NOTE The counters are only published every so often, so a
+        // short interval can see them stand still and then jump. There's
+        // nothing to tell how fast they're going by on the first line.
+        printf("%.3f\t%llu\t%.0f\t%lld\t%.3f\t",
+               Seconds,
+               (unsigned long long)Steps,
+               Line && Elapsed > 0 ? (Steps - LastSteps) / Elapsed : 0.0,
+               (long long)Counter,
+               Steps ? (double)Taken / Steps : 0.0);
+
+        // NOTE Writes to code are only counted if the program was run with
+        // "--self-modifying".
+        if (Segment->Flags & STATS_SELF_MODIFYING)
+            printf("%llu\n", (unsigned long long)SelfModifying);
+
+        else
+            printf("-\n");
+
+        fflush(stdout);
+
+        if (Stopped)
+            break;
+
+        Last = Now;
+        LastSteps = Steps;
+
+        std::this_thread::sleep_for(Interval);
+    }
+
+    ReleaseStats(Segment);
+
+    return NORMAL;
+}
@@ -4,118 +4,406 @@
  * @date 2019-06-10
  *
  * This file contains the main entry point for subleq.exe, the SUBLEQ emulator.
+ *
+ * The engines that run the program are in engine.cpp.
+ *
+ * Given a ready point, the emulator runs the program until it gets there,
+ * freezes it into a template (see template.cpp), and then serves requests from
+ * its standard input, one a line: each line is the input, a list of numbers,
+ * for a clone of the template to run with. Whatever each request prints is
+ * followed by an empty line.
+ *
+ * With --serve, the emulator runs jobs sent to it over a socket instead (see
+ * serve.cpp), until it's interrupted.
  */
 
 // C standard libraries.
 #include <cstdio>
 #include <cstdlib>
 #include <cassert>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string>
+
+// Internal libs
+#include "subleqc/image.cpp"
+#include "subleqc/engine.cpp"
+#include "subleqc/template.cpp"
 
+#if !defined(_WIN32)
+#include "subleqc/serve.cpp"
+#endif
 
-#define IsStdout(OFFSET) (OFFSET == -1)
 
+#define UsageString \
+    "Usage: subleq [--profile <profile>] [--checked] " \
+    "[--stats <name> [--self-modifying]] " \
+    "[--ready <address> | --ready-steps <count>] [--input <address>] " \
+    "<binary>\n" \
+    "       subleq --serve [--socket <path>] [--workers <count>] " \
+    "[--cache <images>] [--budget <count>]\n"
 
-enum status {
+
+enum exit_status {
     NORMAL,
     NO_INPUT,
     NO_SUCH_FILE,
     INVALID_BINARY,
     OFFSET_OUT_OF_BOUNDS,
+    NOT_READY,
     UNKNOWN
 };
 
+struct options {
+    const char *BinaryFile;
+    // Where to write how many times each instruction ran, if anywhere.
+    const char *ProfileFile;
+    // Whether to always use the checked engine.
+    bool Checked;
+    // Where the program is ready to serve requests, an address or a label,
+    // and how many instructions it takes to get there. Either will do.
+    const char *ReadyAddress;
+    unsigned long long ReadySteps;
+    // Where each request's input goes, an address or a label.
+    const char *InputAddress;
+#if !defined(_WIN32)
+    // What to call the stats segment to publish the run's counters to, if
+    // there is one.
+    const char *StatsName;
+    // Whether to count the instructions that write to code in it too.
+    bool SelfModifying;
+    // Whether to serve jobs over a socket, and how.
+    bool Serve;
+    serve_options ServeOptions;
+#endif
+};
+
 
+// WriteProfile() writes the [Counts] of every address below [Length] that ran
+// at all to [Path], in the format subleqc's --profile reads.
 static
-bool InBounds(int Offset, long Extent)
+void WriteProfile(const char *Path, const unsigned long long *Counts,
+                  long Length)
 {
-    if (IsStdout(Offset))
-        return true;
+    FILE *File = fopen(Path, "w");
+
+    if (!File)
+    {
+        printf("Failed to open profile \"%s\" for writing.\n", Path);
+        return;
+    }
+
+    fprintf(File, "# Address and times run, for subleqc --profile.\n");
+
+    for (long i = 0; i < Length; i++)
+    {
+        if (Counts[i])
+            fprintf(File, "%ld %llu\n", i, Counts[i]);
+    }
+
+    fclose(File);
+}
+
+
+// ParseAddress() returns the address [Text] stands for, either as a number or
+// as the name of a label in the symbol table of the image at [Path]. Returns
+// ERROR, after saying why, if it's neither.
+static
+status<unsigned int> ParseAddress(const char *Path, const char *Text)
+{
+    char *End = NULL;
+    long long Address = strtoll(Text, &End, 0);
+
+    if (End != Text && *End == '\0')
+    {
+        if (Address < 0 || Address > 0xFFFFFFFFll)
+        {
+            printf("Address \"%s\" is out of range.\n", Text);
+            return { ERROR, 0 };
+        }
+
+        return { OK, (unsigned int)Address };
+    }
+
+    status<unsigned int> Symbol = FindSymbol(Path, Text);
 
-    else if (0 <= Offset && Offset < Extent)
-        return true;
+    if (Symbol.Status != OK)
+        printf("No address or label \"%s\" in \"%s\".\n", Text, Path);
 
-    else
-        return false;
+    return Symbol;
+}
+
+// ServeRequests() runs a clone of [Template] for every line of the standard
+// input, with the numbers on it written from [InputAddress] on, and prints
+// what it printed followed by an empty line. Counts every instruction the
+// clones run in [Counts] if it's given. Returns how many requests went out of
+// bounds; requests that can't run at all are only reported.
+static
+unsigned int ServeRequests(const vm_template *Template,
+                           unsigned int InputAddress,
+                           bool Checked,
+                           unsigned long long *Counts)
+{
+    std::string Line;
+    unsigned int RequestCount = 0;
+    unsigned int FailureCount = 0;
+
+    buffer<int> Input = { };
+
+    while (std::getline(std::cin, Line))
+    {
+        RequestCount++;
+
+        std::istringstream Fields (Line);
+        long long Value;
+
+        Input.Length = 0;
+
+        while (Fields >> Value)
+            Append<int>(&Input, (int)Value);
+
+        image Clone;
+
+        if (!Fields.eof())
+        {
+            Error("Request %u: Input isn't a list of numbers.\n",
+                  RequestCount);
+        }
+        else if (CloneTemplate(Template, &Clone) != OK)
+        {
+            Error("Request %u: Failed to clone the template.\n",
+                  RequestCount);
+        }
+        else
+        {
+            if (WriteInput(&Clone, InputAddress, Input.Data,
+                           Input.Length) != OK)
+            {
+                Error("Request %u: Input doesn't fit in memory.\n",
+                      RequestCount);
+            }
+            else if ((Clone.Static && !Checked ?
+                      RunUnchecked(Clone.Memory, Clone.Entry, Counts) :
+                      RunChecked(Clone.Memory, Clone.MemorySize, Clone.Entry,
+                                 Counts)) != HALTED)
+            {
+                Error("Request %u: The program went out of bounds.\n",
+                      RequestCount);
+
+                FailureCount++;
+            }
+
+            Unload(&Clone);
+        }
+
+        printf("\n");
+        fflush(stdout);
+    }
+
+    Empty<int>(&Input);
+
+    return FailureCount;
 }
 
 
 int main(int argc, char** argv)
 {
-    if (argc == 1)
+    options Options = { };
+    Options.ReadySteps = NO_BUDGET;
+
+#if !defined(_WIN32)
+    Options.ServeOptions.SocketPath  = DEFAULT_SOCKET_PATH;
+    Options.ServeOptions.WorkerCount = HardwareThreadCount();
+    Options.ServeOptions.CacheSize   = DEFAULT_CACHE_SIZE;
+    Options.ServeOptions.Budget      = NO_BUDGET;
+#endif
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            Options.ProfileFile = argv[++i];
+
+        else if (std::strcmp(argv[i], "--checked") == 0)
+            Options.Checked = true;
+
+        else if (std::strcmp(argv[i], "--ready") == 0 && i + 1 < argc)
+            Options.ReadyAddress = argv[++i];
+
+        else if (std::strcmp(argv[i], "--ready-steps") == 0 && i + 1 < argc)
+            Options.ReadySteps = strtoull(argv[++i], NULL, 10);
+
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+            Options.InputAddress = argv[++i];
+
+#if !defined(_WIN32)
+        else if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+            Options.StatsName = argv[++i];
+
+        else if (std::strcmp(argv[i], "--self-modifying") == 0)
+            Options.SelfModifying = true;
+
+        else if (std::strcmp(argv[i], "--serve") == 0)
+            Options.Serve = true;
+
+        else if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            Options.ServeOptions.SocketPath = argv[++i];
+
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            Options.ServeOptions.WorkerCount = atoi(argv[++i]);
+
+        else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            Options.ServeOptions.CacheSize = atoi(argv[++i]);
+
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+            Options.ServeOptions.Budget = strtoull(argv[++i], NULL, 10);
+#endif
+
+        else if (!Options.BinaryFile)
+            Options.BinaryFile = argv[i];
+
+        else
+            printf("Ignoring extra argument \"%s\".\n", argv[i]);
+    }
+
+#if !defined(_WIN32)
+    if (Options.Serve)
+        return RunServer(&Options.ServeOptions) == OK ? NORMAL : UNKNOWN;
+#endif
+
+    if (!Options.BinaryFile)
     {
         printf("No input binary given, exiting.\n");
+        printf(UsageString);
         return NO_INPUT;
     }
 
 
-    std::ifstream BinaryFile (argv[1],
+    std::ifstream BinaryFile (Options.BinaryFile,
                               std::ifstream::out | std::ifstream::binary);
     if (!BinaryFile)
     {
-        printf("Failed to open binary \"%s\", exiting.\n", argv[1]);
+        printf("Failed to open binary \"%s\", exiting.\n",
+               Options.BinaryFile);
         return NO_SUCH_FILE;
     }
 
-    // Discover binary size.
-    BinaryFile.seekg(0, BinaryFile.end);
-    long ProgramLength = BinaryFile.tellg();
-    BinaryFile.seekg(0, BinaryFile.beg);
+    BinaryFile.close();
 
-    if (ProgramLength %3 != 0)
-    {
-        printf("Input file size (%ldb) is not a multiple of three.\n"
-               "Input file is not a valid SUBLEQ binary, exiting.\n",
-               ProgramLength);
+    image Image;
 
+    if (LoadImage(Options.BinaryFile, &Image) != OK)
+    {
+        printf("Input file is not a valid SUBLEQ binary, exiting.\n");
         return INVALID_BINARY;
     }
 
-    int *Program = new int[ProgramLength];
+    int *Program = Image.Memory;
+    long ProgramLength = Image.MemorySize;
 
-    // TODO[joe] Abort if we haven't read the bytes we are looking for?
-    BinaryFile.read((char *)Program, ProgramLength);
 
+    unsigned long long *Counts = NULL;
 
-    int ProgramCounter, A, B, C = 0;
+    if (Options.ProfileFile)
+        Counts = new unsigned long long[ProgramLength]();
 
-    do
+
+    if (Options.ReadyAddress || Options.ReadySteps != NO_BUDGET)
     {
-        A = Program[ProgramCounter++];
-        B = Program[ProgramCounter++];
-        C = Program[ProgramCounter++];
+        exit_status Status = NORMAL;
+
+        status<unsigned int> Ready = { OK, (unsigned int)NO_READY_ADDRESS };
+        status<unsigned int> Input = { OK, 0 };
+
+        if (Options.ReadyAddress)
+            Ready = ParseAddress(Options.BinaryFile, Options.ReadyAddress);
 
-        if (!InBounds(A, ProgramLength) ||
-            !InBounds(B, ProgramLength) ||
-            !InBounds(C, ProgramLength))
+        if (Options.InputAddress)
+            Input = ParseAddress(Options.BinaryFile, Options.InputAddress);
+
+        vm_template Template;
+
+        if (Ready.Status != OK || Input.Status != OK)
+        {
+            Status = NO_INPUT;
+        }
+        else if (CreateTemplate(&Image, (int)Ready.unpack(),
+                                Options.ReadySteps, Counts,
+                                &Template) != OK)
+        {
+            printf("The program never got ready, exiting.\n");
+            Status = NOT_READY;
+        }
+        else
         {
-            break;
+            // NOTE What the program printed getting ready is its own
+            // response, before any request's.
+            printf("\n");
+            fflush(stdout);
+
+            if (ServeRequests(&Template, Input.unpack(), Options.Checked,
+                              Counts))
+            {
+                Status = OFFSET_OUT_OF_BOUNDS;
+            }
+
+            ReleaseTemplate(&Template);
         }
 
-        // The SUBLEQ operation.
-        if ((Program[B] = Program[A] - Program[B]) <= 0)
-            ProgramCounter = C;
+        if (Counts)
+            WriteProfile(Options.ProfileFile, Counts, ProgramLength);
+
+        Unload(&Image);
+
+        delete[] Counts;
+
+        return Status;
+    }
+
+
+    stats_segment *Stats = NULL;
+
+#if !defined(_WIN32)
+    if (Options.StatsName)
+        Stats = CreateStats(Options.StatsName,
+                            Options.SelfModifying ? STATS_SELF_MODIFYING : 0);
+#endif
 
-        printf("%d\n", Program[B]);
+    engine_status Stopped = Image.Static && !Options.Checked ?
+                            RunUnchecked(Program, Image.Entry, Counts, NULL,
+                                         NO_BUDGET, Stats) :
+                            RunChecked(Program, ProgramLength, Image.Entry,
+                                       Counts, NULL, NO_BUDGET, Stats);
+
+#if !defined(_WIN32)
+    if (Stats)
+    {
+        Stats->State.store(STATS_STOPPED, std::memory_order_release);
+        ReleaseStats(Stats, Options.StatsName);
     }
-    while (InBounds(ProgramCounter, ProgramLength) &&
-           !IsStdout(ProgramCounter));
+#endif
 
+    exit_status Status = NORMAL;
 
-    if (!InBounds(ProgramCounter, ProgramLength))
+    if (Stopped == COUNTER_OUT_OF_BOUNDS)
     {
         printf("Program counter is out-of-bounds, exiting.\n");
-        return OFFSET_OUT_OF_BOUNDS;
+        Status = OFFSET_OUT_OF_BOUNDS;
     }
-    else if (!InBounds(A, ProgramLength) ||
-             !InBounds(B, ProgramLength) ||
-             !InBounds(C, ProgramLength))
+    else if (Stopped == OPERAND_OUT_OF_BOUNDS)
     {
         printf("Attempted to access an out-of-bounds offset, exiting.\n");
-        return OFFSET_OUT_OF_BOUNDS;
-    }
-    else
-    {
-        return NORMAL;
+        Status = OFFSET_OUT_OF_BOUNDS;
     }
+
+    if (Counts)
+        WriteProfile(Options.ProfileFile, Counts, ProgramLength);
+
+
+    Unload(&Image);
+
+    delete[] Counts;
+
+    return Status;
 }
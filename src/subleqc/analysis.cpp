@@ -0,0 +1,197 @@
+/**
+ * @file analysis.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file works out what a linked program can touch: which instructions can
+ * run, and which cells they read and write. The passes that move or rewrite
+ * instructions after linking (see optimizer.cpp and layout.cpp) need it to
+ * know which words are addresses.
+ *
+ * In SUBLEQ every word of an instruction is an address, and any word can be
+ * read or written as data. If a running instruction's words can ever change,
+ * its addresses aren't what they look like, and the program can't be
+ * reasoned about ahead of time.
+ *
+ * What the analysis finds can also be written into an image (see image.cpp),
+ * as the instructions that can run. Whoever loads the image doesn't have to
+ * trust that: VerifyPartition() checks it in one pass over those instructions.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <algorithm>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+
+
+#define CELL_CODE    (1 << 0) // Part of an instruction that can run.
+#define CELL_DATA    (1 << 1) // Read or written by one that can.
+#define CELL_WRITTEN (1 << 2) // Written with something other than zero.
+#define CELL_CLEARED (1 << 3) // Written with zero.
+#define CELL_ZERO    (1 << 4) // Zero from start to finish.
+
+
+// IsAddress() returns whether [Value] is the address of a cell of a program
+// [Length] words long.
+static inline
+bool IsAddress(int Value, unsigned int Length)
+{
+    return 0 <= Value && (unsigned int)Value < Length;
+}
+
+// Analyze() fills [Cells] with the flags of every word of [Program], and
+// [Reachable] with whether each instruction can run. Returns false if the
+// program touches cells outside of itself, jumps into the middle of an
+// instruction, or changes the instructions it runs; the flags are incomplete
+// then.
+static
+bool Analyze(const buffer<int> *Program,
+             buffer<unsigned char> *Cells,
+             buffer<unsigned char> *Reachable)
+{
+    unsigned int Length = Program->Length;
+    unsigned int Count  = Length / 3;
+
+    const int *Words = Program->Data;
+
+    Reserve<unsigned char>(Cells, Length);
+    Cells->Length = Length;
+    std::fill(Cells->Data, Cells->Data + Length, 0);
+
+    Reserve<unsigned char>(Reachable, Count);
+    Reachable->Length = Count;
+    std::fill(Reachable->Data, Reachable->Data + Count, 0);
+
+    if (Count == 0)
+        return true;
+
+    buffer<unsigned int> Work = { };
+    Append<unsigned int>(&Work, 0);
+    (*Reachable)[0] = true;
+
+    bool Static = true;
+
+    while (Work.Length && Static)
+    {
+        unsigned int i = Pop<unsigned int>(&Work);
+
+        int A = Words[3 * i + 0];
+        int B = Words[3 * i + 1];
+        int C = Words[3 * i + 2];
+
+        // NOTE Touching cells outside the program, or jumping into the
+        // middle of an instruction, isn't something we can reason about.
+        if (!IsAddress(A, Length) || !IsAddress(B, Length) ||
+            (IsAddress(C, Length) && C % 3 != 0))
+        {
+            Static = false;
+            break;
+        }
+
+        for (unsigned int j = 0; j < 3; j++)
+            (*Cells)[3 * i + j] |= CELL_CODE;
+
+        (*Cells)[A] |= CELL_DATA;
+        (*Cells)[B] |= CELL_DATA;
+        (*Cells)[B] |= A == B ? CELL_CLEARED : CELL_WRITTEN;
+
+        // A subtraction from itself is zero, so it always jumps.
+        unsigned int Successors[2] = {
+            A == B ? Count : i + 1,
+            IsAddress(C, Length) ? C / 3 : Count
+        };
+
+        for (unsigned int j = 0; j < 2; j++)
+        {
+            if (Successors[j] < Count && !(*Reachable)[Successors[j]])
+            {
+                (*Reachable)[Successors[j]] = true;
+                Append<unsigned int>(&Work, Successors[j]);
+            }
+        }
+    }
+
+    Empty<unsigned int>(&Work);
+
+    for (unsigned int i = 0; i < Length && Static; i++)
+    {
+        unsigned char Flags = (*Cells)[i];
+
+        bool Changes = (Flags & CELL_WRITTEN) ||
+                       ((Flags & CELL_CLEARED) && Words[i] != 0);
+
+        if (Changes && (Flags & CELL_CODE))
+            Static = false;
+
+        if (!Changes && Words[i] == 0)
+            (*Cells)[i] |= CELL_ZERO;
+    }
+
+    return Static;
+}
+
+// VerifyPartition() returns whether the instructions marked in [Partition],
+// one bit for every instruction from [CodeStart] to [CodeEnd], are all a
+// program in [MemorySize] cells of [Memory] that starts at [Entry] can ever
+// run, and can never change. That holds when the entry is marked, and every
+// marked instruction reads and writes cells of memory, writes no marked
+// instruction, and can only go on to marked instructions or halt.
+static
+bool VerifyPartition(const int *Memory,
+                     unsigned int MemorySize,
+                     unsigned int Entry,
+                     unsigned int CodeStart,
+                     unsigned int CodeEnd,
+                     const unsigned char *Partition)
+{
+    if (CodeStart % 3 != 0 || CodeStart > CodeEnd ||
+        (CodeEnd - CodeStart) % 3 != 0 || CodeEnd > MemorySize)
+    {
+        return false;
+    }
+
+    // IsCode() returns whether [Address] is part of a marked instruction.
+    auto IsCode = [&](int Address)
+    {
+        if (Address < 0 || (unsigned int)Address < CodeStart ||
+            (unsigned int)Address >= CodeEnd)
+        {
+            return false;
+        }
+
+        unsigned int Index = ((unsigned int)Address - CodeStart) / 3;
+        return (Partition[Index / 8] >> (Index % 8) & 1) != 0;
+    };
+
+    if (Entry % 3 != 0 || !IsCode(Entry))
+        return false;
+
+    for (unsigned int i = CodeStart; i < CodeEnd; i += 3)
+    {
+        if (!IsCode(i))
+            continue;
+
+        int A = Memory[i + 0];
+        int B = Memory[i + 1];
+        int C = Memory[i + 2];
+
+        if (!IsAddress(A, MemorySize) || !IsAddress(B, MemorySize) ||
+            IsCode(B))
+        {
+            return false;
+        }
+
+        if (C != -1 && (C % 3 != 0 || !IsCode(C)))
+            return false;
+
+        // A subtraction from itself always jumps.
+        if (A != B && !IsCode(i + 3))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file arena.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains our bump allocator. An assembly pushes everything that
+ * lives as long as the assembly itself (the source text, error messages,
+ * etc...) onto one arena and frees it all at once at the end.
+ */
+
+#pragma once
+
+// C standard libraries
+#include <cstdlib>
+#include <cstddef>
+
+// Own Libraries
+#include "util.cpp"
+
+
+// MAGIC Blocks start small, since most arenas only ever hold a few error
+// messages and a 1MiB block costs more to get than an assembly of a small
+// program takes. Each block is twice as big as the last, up to 1MiB, so big
+// programs still only add a block per megabyte of things we couldn't size up
+// front.
+#define ARENA_FIRST_BLOCK_SIZE (4 * 1024)
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+
+struct alignas(max_align_t) arena_block {
+    arena_block *Previous;
+    size_t Size;
+    size_t Used;
+};
+
+struct arena {
+    arena_block *Current;
+};
+
+
+// PushSize() returns [Size] bytes from [Arena], aligned to [Alignment] (which
+// must be a power of two). The memory is not cleared.
+static
+void *PushSize(arena *Arena, size_t Size, size_t Alignment = alignof(max_align_t))
+{
+    arena_block *Block = Arena->Current;
+
+    size_t Offset = 0;
+
+    if (Block)
+        Offset = (Block->Used + Alignment - 1) & ~(Alignment - 1);
+
+    if (!Block || Offset + Size > Block->Size)
+    {
+        size_t BlockSize = !Block ? ARENA_FIRST_BLOCK_SIZE :
+                           Block->Size >= ARENA_BLOCK_SIZE / 2 ?
+                           ARENA_BLOCK_SIZE :
+                           Block->Size * 2;
+
+        // Allocations bigger than a block get a block all to themselves.
+        if (Size + Alignment > BlockSize)
+            BlockSize = Size + Alignment;
+
+        arena_block *NewBlock = (arena_block *)
+            std::malloc(sizeof(arena_block) + BlockSize);
+        Assert(NewBlock != NULL);
+
+        NewBlock->Previous = Block;
+        NewBlock->Size = BlockSize;
+        NewBlock->Used = 0;
+
+        Arena->Current = Block = NewBlock;
+
+        // NOTE Data starts right after the header, which is itself
+        // aligned to max_align_t by malloc(), so we align relative to it.
+        Offset = 0;
+    }
+
+    void *Result = (char *)(Block + 1) + Offset;
+    Block->Used = Offset + Size;
+
+    return Result;
+}
+
+#define PushStruct(ARENA, TYPE) ((TYPE *)PushSize(ARENA, sizeof(TYPE), alignof(TYPE)))
+#define PushArray(ARENA, COUNT, TYPE) \
+    ((TYPE *)PushSize(ARENA, sizeof(TYPE) * (COUNT), alignof(TYPE)))
+
+// Free() releases every block held by [Arena].
+static
+void Free(arena *Arena)
+{
+    arena_block *Block = Arena->Current;
+
+    while (Block)
+    {
+        arena_block *Previous = Block->Previous;
+        std::free(Block);
+        Block = Previous;
+    }
+
+    *Arena = { };
+}
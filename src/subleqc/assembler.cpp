@@ -0,0 +1,1231 @@
+/**
+ * @file assembler.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the SUBLEQ assembler proper: parsing tokens into
+ * instructions, resolving labels, and generating program code.
+ *
+ * The source is split into chunks at line boundaries, and every chunk is
+ * parsed on its own (in parallel when there is more than one) as if it began
+ * at address zero. Words whose value depends on where the chunk ends up are
+ * marked as relative, and references to labels the chunk doesn't declare are
+ * left as fixups. Link() then gives every chunk its base address, merges the
+ * chunks' labels, patches the remaining fixups and generates the code. With
+ * a single chunk this is exactly the serial assembler.
+ *
+ * Assembling an object instead of a program (see object.cpp) keeps track of
+ * every word that holds an address relative to the start of the program, and
+ * leaves references to labels that are never declared for the linker instead
+ * of reporting them.
+ *
+ * Besides instructions, a line can hold data, written out as it is by the
+ * .word, .fill and .zero directives. Every parameter is an expression: numbers,
+ * labels and question marks added together or subtracted. Since every label
+ * is an address relative to the start of the chunk, a parameter is relative
+ * when it adds one more address than it subtracts, and absolute when the
+ * addresses cancel out; anything else can't be given an address at all. That
+ * can be told as soon as the parameter is parsed, before any of its labels
+ * are declared, so references to labels only ever add or subtract an address
+ * from a word.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "arena.cpp"
+#include "scan.cpp"
+#include "token.cpp"
+#include "lexer.cpp"
+#include "hashmap.cpp"
+#include "symbol.cpp"
+#include "parallel.cpp"
+
+
+// MAGIC Below this many bytes per chunk, starting a thread costs more
+// than the parsing it would do.
+#define MIN_CHUNK_SIZE (256 * 1024)
+
+// MAGIC A .fill or a .zero is written out cell by cell, so it's kept to
+// a size that's quick to write. More memory than that is what --memory is for.
+#define MAX_FILL_COUNT (1024 * 1024)
+
+
+// An instruction, or a run of data words from a directive.
+struct instruction {
+    int Parameters[3];
+    unsigned int ParameterCount;
+    unsigned int Location;
+    // Bit N is set when parameter N is an address relative to the start of
+    // the chunk the instruction was parsed in.
+    unsigned int Relative;
+    // How many words it takes up: three for an instruction. Data is written
+    // out parameter by parameter, and the last parameter fills the rest.
+    unsigned int Length;
+    bool Data;
+};
+
+struct error {
+    char *Message;
+    unsigned int LineNumber;
+    unsigned int FirstColumn;
+    unsigned int LastColumn;
+};
+
+// A chunk is a run of whole lines of the source, and everything parsed from
+// it.
+struct chunk {
+    unsigned int Begin;
+    unsigned int End;
+    // The address of the chunk's first word, once linked.
+    unsigned int Base;
+    // How many words its instructions take up.
+    unsigned int Length;
+
+    buffer<instruction> Instructions;
+    symbol_table Symbols;
+    buffer<error> Errors;
+    arena Arena;
+
+    // For objects, the words that hold addresses relative to the start of
+    // the program, and the ones that refer to labels the program doesn't
+    // declare.
+    buffer<unsigned int> Relocations;
+    buffer<reference> Imports;
+};
+
+struct assembler {
+    const char *Source;
+    unsigned int SourceLength;
+    unsigned int ThreadCount;
+
+    buffer<unsigned int> LineStarts;
+    buffer<chunk> Chunks;
+
+    // Every label declared anywhere in the source, at its final address.
+    // With a single chunk, this is just that chunk's symbol table.
+    symbol_table *Labels;
+    symbol_table MergedLabels;
+
+    buffer<int> Program;
+
+    // Whether we're assembling an object, and if so, every chunk's
+    // relocations and imports, in order.
+    bool Relocatable;
+    buffer<unsigned int> Relocations;
+    buffer<reference> Imports;
+};
+
+
+// GenerateError() formats an error about [Token] onto [Arena], using the
+// printf()-style [Format] and its arguments.
+static
+error GenerateError(arena *Arena, const token *Token, const char *Format, ...)
+{
+    error Error = { };
+
+    va_list Arguments;
+
+    // NOTE Almost every message fits in here, so it only has to be
+    // formatted once. The arena still hands out exactly what we need.
+    char Message[256];
+
+    va_start(Arguments, Format);
+    int MessageLength = vsnprintf(Message, sizeof(Message), Format, Arguments);
+    va_end(Arguments);
+
+    Error.Message = PushArray(Arena, MessageLength + 1, char);
+
+    if (MessageLength < (int)sizeof(Message))
+    {
+        std::memcpy(Error.Message, Message, MessageLength + 1);
+    }
+    else
+    {
+        va_start(Arguments, Format);
+        vsnprintf(Error.Message, MessageLength + 1, Format, Arguments);
+        va_end(Arguments);
+    }
+
+    Error.LineNumber  = Token->LineNumber;
+    Error.FirstColumn = Token->Column;
+    Error.LastColumn  = Token->Column + Token->Length;
+
+    return Error;
+}
+
+// ReportError() prints [Error] to stderr, followed by the [LineLength]
+// characters of the source [Line] it happened on, if we have them.
+static
+void ReportError(const error *Error, const char *Line, unsigned int LineLength)
+{
+    if (!Line)
+    {
+        Error("Line %d, column %d: %s\n",
+               Error->LineNumber + 1,
+               Error->FirstColumn + 1,
+               Error->Message);
+
+        return;
+    }
+
+    // NOTE Lines keep their newline, except maybe the last one.
+    bool HasNewline = LineLength && Line[LineLength - 1] == '\n';
+
+    Error("Line %d, column %d: %s\n\n\t%.*s%s",
+           Error->LineNumber + 1,
+           Error->FirstColumn + 1,
+           Error->Message,
+           LineLength,
+           Line,
+           HasNewline ? "" : "\n");
+
+    // TODO Replace this with something that is more C++ idiomatic. This
+    // is an esoteric part of the printf() formatting language that I stumbled
+    // across looking for a way to do string padding. The details can be found
+    // here: https://stackoverflow.com/a/9741091/6785489
+    fprintf(stderr, "\t%*.*s^\n\n",
+                    Error->FirstColumn,
+                    Error->FirstColumn,
+                    " ");
+}
+
+// ReportErrors() reports every error in [Errors], taking the offending lines
+// from [Source], which [LineStarts] indexes. [Source] starts on line
+// [LineBase] of the file it came from.
+static inline
+void ReportErrors(buffer<error> *Errors,
+                  const char *Source,
+                  unsigned int SourceLength,
+                  buffer<unsigned int> *LineStarts,
+                  unsigned int LineBase = 0)
+{
+    for (unsigned int i = 0; i < Errors->Length; i++)
+    {
+        unsigned int LineNumber = (*Errors)[i].LineNumber;
+        unsigned int LineStart  = (*LineStarts)[LineNumber];
+        unsigned int LineEnd    = LineNumber + 1 < LineStarts->Length ?
+                                  (*LineStarts)[LineNumber + 1] :
+                                  SourceLength;
+
+        error Error = (*Errors)[i];
+        Error.LineNumber += LineBase;
+
+        ReportError(&Error, Source + LineStart, LineEnd - LineStart);
+    }
+}
+
+// FindInstruction() returns the one of the [Count] [Instructions] that output
+// word [Offset] is part of, or NULL if it's past the last of them.
+static inline
+instruction *FindInstruction(instruction *Instructions,
+                             unsigned int Count,
+                             unsigned int Offset)
+{
+    // NOTE Without data, every instruction is three words long, so
+    // there's usually no need to search.
+    if (Offset / 3 < Count)
+    {
+        instruction *Guess = &Instructions[Offset / 3];
+
+        if (Guess->Location <= Offset && Offset < Guess->Location + Guess->Length)
+            return Guess;
+    }
+
+    instruction *Found =
+        std::upper_bound(Instructions, Instructions + Count, Offset,
+                         [](unsigned int Offset, const instruction &Instruction)
+                         {
+                             return Offset < Instruction.Location;
+                         });
+
+    if (Found == Instructions)
+        return NULL;
+
+    Found--;
+
+    return Offset < Found->Location + Found->Length ? Found : NULL;
+}
+
+// AddAddress() adds [Address] to the parameter of [Instruction] at output
+// word [Offset], or subtracts it if [Negative].
+static inline
+void AddAddress(instruction *Instruction,
+                unsigned int Offset,
+                bool Negative,
+                unsigned int Address)
+{
+    // NOTE Only a reference from a line that was thrown away can point
+    // past the parameters.
+    if (!Instruction || Offset - Instruction->Location >= 3)
+        return;
+
+    int *Parameter = &Instruction->Parameters[Offset - Instruction->Location];
+
+    *Parameter = (int)((unsigned int)*Parameter +
+                       (Negative ? 0u - Address : Address));
+}
+
+// ReferenceLength() returns how many words, starting at output word
+// [Offset], are written from the parameter of [Instruction] that's there.
+// One-address instructions are written out with their address twice, and a
+// .fill writes its value over and over.
+static inline
+unsigned int ReferenceLength(const instruction *Instruction,
+                             unsigned int Offset)
+{
+    if (Instruction->Data)
+        return Offset == Instruction->Location + Instruction->ParameterCount - 1 ?
+               Instruction->Length - Instruction->ParameterCount + 1 :
+               1;
+
+    return Instruction->ParameterCount == 1 ? 2 : 1;
+}
+
+// Parse() parses the source of [Chunk] into instructions, declaring its
+// labels in the chunk's symbol table.
+static
+void Parse(assembler *Assembler, chunk *Chunk)
+{
+    /** Configure lexer. */
+
+    lexer Lexer        = { };
+    Lexer.Source       = Assembler->Source;
+    Lexer.SourceLength = Chunk->End;
+    Lexer.Cursor       = Chunk->Begin;
+    Lexer.LineStarts   = Assembler->LineStarts.Data;
+    Lexer.LineCount    = Assembler->LineStarts.Length;
+
+    // Start the lexer on the line the chunk begins on.
+    Lexer.LineNumber = (std::upper_bound(Lexer.LineStarts,
+                                         Lexer.LineStarts + Lexer.LineCount,
+                                         Chunk->Begin) - Lexer.LineStarts) - 1;
+
+
+    /** Parse tokens into instructions. */
+
+    unsigned int CurrentAddress = 0;
+
+    buffer<instruction> &Instructions = Chunk->Instructions;
+
+    // MAGIC The shortest instruction ("0\n") takes two characters, but
+    // anything realistic takes at least four.
+    Reserve<instruction>(&Instructions, (Chunk->End - Chunk->Begin) / 4 + 1);
+    instruction         CurrentInstruction = { };
+
+    symbol_table &Symbols = Chunk->Symbols;
+
+    // Which directive the line starts with, if any, and the count of a .fill
+    // or .zero once it's been parsed.
+    enum directive {
+        DIRECTIVE_NONE,
+        DIRECTIVE_WORD,
+        DIRECTIVE_FILL,
+        DIRECTIVE_ZERO
+    } Directive = DIRECTIVE_NONE;
+
+    int Count = -1;
+
+    // The output word of the parameter being parsed, and its first token.
+    // Whether its next term is subtracted, and how many more addresses it
+    // adds than it subtracts.
+    unsigned int Word = 0;
+    token ParameterToken = { };
+    bool Negative = false;
+    int Addresses = 0;
+
+// NOTE After an error the parser is INVALID until the end of the line,
+// and the instruction on that line is thrown away.
+#define PARSER_STATES \
+    _(INVALID) \
+    _(START) \
+    _(LABEL) \
+    _(DIRECTIVE) \
+    _(PARAM) \
+    _(OPERATOR) \
+    _(COMMA) \
+
+    enum parser_state {
+#define _(S) PARSER_STATE_##S,
+        PARSER_STATES
+#undef _
+    } ParserState = PARSER_STATE_START;
+
+
+    for (token Token = NextToken(&Lexer);
+         Token.Type != NONE;
+         Token = NextToken(&Lexer))
+    {
+        const char *TokenText = Lexer.Source + Token.Offset;
+
+#define TokenIs(T) (Token.Type == T)
+#define StateIs(S) (ParserState == PARSER_STATE_##S)
+
+#define ReportErrorAt(T, ...) \
+    Append<error>(&Chunk->Errors, \
+                  GenerateError(&Chunk->Arena, T, __VA_ARGS__)); \
+    TransitionTo(INVALID)
+#define ReportError(...) ReportErrorAt(&Token, __VA_ARGS__)
+#define ReportUnexpected() \
+    ReportError("Unexpected %s", TokenTypeToString(Token.Type))
+
+#define AddParameter(V) CurrentInstruction.Parameters[CurrentInstruction.ParameterCount++] = V
+#define MarkRelative() CurrentInstruction.Relative |= 1 << (CurrentInstruction.ParameterCount - 1)
+
+// The count of a .fill or .zero doesn't take up a word.
+#define Counting() \
+    ((Directive == DIRECTIVE_FILL || Directive == DIRECTIVE_ZERO) && Count < 0)
+
+// A term either starts a parameter, or is added to the one before it. A
+// signed number needs no operator in front of it, so "label-4" is two terms.
+#define BeginsParameter() \
+    (StateIs(START) || StateIs(LABEL) || StateIs(DIRECTIVE) || StateIs(COMMA))
+#define ContinuesParameter() \
+    (StateIs(OPERATOR) || \
+     (StateIs(PARAM) && TokenIs(NUMBER) && IsSign(TokenText[0])))
+
+#define AppendInstruction() \
+    Append<instruction>(&Instructions, CurrentInstruction); \
+    CurrentAddress = CurrentInstruction.Location + CurrentInstruction.Length; \
+    CurrentInstruction = { }; \
+    CurrentInstruction.Location = CurrentAddress
+
+// NOTE A .word with more than three values is split into several runs
+// of data, since a run only has room for three parameters.
+#define BeginParameter() \
+    if (Directive == DIRECTIVE_WORD && CurrentInstruction.ParameterCount == 3) \
+    { \
+        CurrentInstruction.Data   = true; \
+        CurrentInstruction.Length = 3; \
+        AppendInstruction(); \
+    } \
+    Word           = CurrentAddress; \
+    CurrentAddress = Counting() ? CurrentAddress : CurrentAddress + 1; \
+    ParameterToken = Token; \
+    Negative       = false; \
+    Addresses      = 0; \
+    AddParameter(0)
+#define AddTerm(V, ADDRESS) \
+    CurrentInstruction.Parameters[CurrentInstruction.ParameterCount - 1] = \
+        (int)((unsigned int)CurrentInstruction.Parameters[CurrentInstruction.ParameterCount - 1] + \
+              (Negative ? 0u - (unsigned int)(V) : (unsigned int)(V))); \
+    Addresses += (ADDRESS) ? (Negative ? -1 : 1) : 0; \
+    Negative = false
+
+// NOTE Whether a parameter is an address is only known once all of it
+// has been parsed.
+#define FinishParameter() \
+    if (Addresses > 1) \
+    { \
+        ReportErrorAt(&ParameterToken, "Can't add addresses together"); \
+    } \
+    else if (Addresses < 0) \
+    { \
+        ReportErrorAt(&ParameterToken, \
+                      "Can't subtract an address from a number"); \
+    } \
+    else if (Counting() && Addresses) \
+    { \
+        ReportErrorAt(&ParameterToken, "A count can't be an address"); \
+    } \
+    else if (Counting() && CurrentInstruction.Parameters[0] < 0) \
+    { \
+        ReportErrorAt(&ParameterToken, "A count can't be negative"); \
+    } \
+    else if (Counting() && CurrentInstruction.Parameters[0] > MAX_FILL_COUNT) \
+    { \
+        ReportErrorAt(&ParameterToken, \
+                      "A count can't be more than %d", MAX_FILL_COUNT); \
+    } \
+    else if (Counting()) \
+    { \
+        Count = CurrentInstruction.Parameters[0]; \
+        CurrentInstruction.Parameters[0] = 0; \
+        CurrentInstruction.ParameterCount = 0; \
+    } \
+    else if (Addresses == 1) \
+    { \
+        MarkRelative(); \
+    }
+
+#define Patch(OFFSET, NEGATIVE, V) \
+    AddAddress((OFFSET) >= CurrentInstruction.Location ? \
+               &CurrentInstruction : \
+               FindInstruction(Instructions.Data, Instructions.Length, OFFSET), \
+               OFFSET, \
+               NEGATIVE, \
+               V)
+#define TransitionTo(S) ParserState = PARSER_STATE_##S
+
+        // If we're skipping the rest of a line with an error on it, there's
+        // nothing to do until the end of the line.
+        if (StateIs(INVALID) && !TokenIs(EOL))
+        {
+        }
+        // If the token we're reading is a NUMBER and the state we're at is...
+        else if (TokenIs(NUMBER))
+        {
+            if (BeginsParameter() || ContinuesParameter())
+            {
+                if (BeginsParameter())
+                {
+                    BeginParameter();
+                }
+
+                AddTerm(ParseNumber(TokenText, Token.Length), false);
+
+                TransitionTo(PARAM);
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+        }
+        // If the token we're reading is a QMARK and the state we're at is...
+        else if (TokenIs(QMARK))
+        {
+            if (BeginsParameter() || StateIs(OPERATOR))
+            {
+                if (BeginsParameter())
+                {
+                    BeginParameter();
+                }
+
+                AddTerm(Word + 1, true);
+
+                TransitionTo(PARAM);
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+        }
+        // If the token we're reading is an IDENT and the state we're at is...
+        else if (TokenIs(IDENT))
+        {
+            if (BeginsParameter() || StateIs(OPERATOR))
+            {
+                if (BeginsParameter())
+                {
+                    BeginParameter();
+                }
+
+                unsigned int Index = Intern(&Symbols, TokenText, Token.Length);
+                symbol *Symbol = &Symbols.Symbols[Index];
+
+                // If the label hasn't been declared yet, leave a hole and
+                // patch it once the label turns up. A count has to be known
+                // straight away, since it says where everything after it
+                // goes.
+                if (Symbol->Defined)
+                {
+                    AddTerm(Symbol->Address, true);
+
+                    TransitionTo(PARAM);
+                }
+                else if (Counting())
+                {
+                    ReportError("Undeclared identifier \"%.*s\" in a count",
+                                Token.Length,
+                                TokenText);
+                }
+                else
+                {
+                    // NOTE A .fill of nothing has no word to patch.
+                    if (Directive != DIRECTIVE_FILL || Count > 0)
+                        AddFixup(&Symbols, Index, Word, Token, Negative);
+
+                    AddTerm(0, true);
+
+                    TransitionTo(PARAM);
+                }
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+        }
+        // If the token we're reading is an OPERATOR and the state we're at
+        // is...
+        else if (TokenIs(OPERATOR))
+        {
+            if (BeginsParameter() || StateIs(PARAM))
+            {
+                if (BeginsParameter())
+                {
+                    BeginParameter();
+                }
+
+                Negative = TokenText[0] == '-';
+
+                TransitionTo(OPERATOR);
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+        }
+        // If the token we're reading is a DIRECTIVE and the state we're at
+        // is...
+        else if (TokenIs(DIRECTIVE))
+        {
+            // NOTE A directive can't follow a label in the middle of
+            // an instruction.
+            if ((StateIs(START) || StateIs(LABEL)) &&
+                CurrentInstruction.ParameterCount == 0)
+            {
+#define DirectiveIs(NAME) \
+    (Token.Length == sizeof(NAME) - 1 && \
+     std::memcmp(TokenText, NAME, sizeof(NAME) - 1) == 0)
+
+                if (DirectiveIs(".word"))
+                {
+                    Directive = DIRECTIVE_WORD;
+                    TransitionTo(DIRECTIVE);
+                }
+                else if (DirectiveIs(".fill"))
+                {
+                    Directive = DIRECTIVE_FILL;
+                    TransitionTo(DIRECTIVE);
+                }
+                else if (DirectiveIs(".zero"))
+                {
+                    Directive = DIRECTIVE_ZERO;
+                    TransitionTo(DIRECTIVE);
+                }
+                else
+                {
+                    ReportError("Unknown directive \"%.*s\"",
+                                Token.Length,
+                                TokenText);
+                }
+
+#undef DirectiveIs
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+        }
+        // If the token we're reading is a LABEL and the state we're at is...
+        else if (TokenIs(LABEL))
+        {
+            // NOTE A label can go between the words of an instruction
+            // or a .word, but there are no words between the count and the
+            // value of a .fill.
+            if (StateIs(START) ||
+                (StateIs(COMMA) && (Directive == DIRECTIVE_NONE ||
+                                    Directive == DIRECTIVE_WORD)))
+            {
+                // NOTE The label's text includes the trailing colon,
+                // which isn't part of the label's name.
+                unsigned int Index = Intern(&Symbols,
+                                            TokenText,
+                                            Token.Length - 1);
+                symbol *Symbol = &Symbols.Symbols[Index];
+
+                if (Symbol->Defined)
+                {
+                    Append<error>(&Chunk->Errors,
+                                  GenerateError(&Chunk->Arena,
+                                                &Token,
+                                                "Redeclared label \"%.*s\"",
+                                                Token.Length - 1,
+                                                TokenText));
+                }
+                else
+                {
+                    Symbol->Address     = CurrentAddress;
+                    Symbol->Defined     = true;
+                    Symbol->Declaration = Token;
+
+                    for (unsigned int i = Symbol->FirstFixup;
+                         i != NO_FIXUP;
+                         i = Symbols.Fixups[i].Next)
+                    {
+                        Patch(Symbols.Fixups[i].Offset,
+                              Symbols.Fixups[i].Negative,
+                              CurrentAddress);
+                    }
+
+                    Symbol->FirstFixup = NO_FIXUP;
+                }
+
+                TransitionTo(LABEL);
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+        }
+        // If the token we're reading is a COMMA and the state we're at is...
+        else if (TokenIs(COMMA))
+        {
+            if (StateIs(PARAM))
+            {
+                FinishParameter();
+            }
+            else
+            {
+                ReportUnexpected();
+            }
+
+            if (StateIs(INVALID))
+            {
+            }
+            // NOTE An instruction only has room for three parameters.
+            else if (Directive == DIRECTIVE_NONE &&
+                     CurrentInstruction.ParameterCount == 3)
+            {
+                ReportError("Too many parameters, an instruction takes at "
+                            "most three");
+            }
+            else if (Directive == DIRECTIVE_FILL &&
+                     CurrentInstruction.ParameterCount == 1)
+            {
+                ReportError("Too many parameters, .fill takes a count and a "
+                            "value");
+            }
+            else if (Directive == DIRECTIVE_ZERO)
+            {
+                ReportError("Too many parameters, .zero takes a count");
+            }
+            else
+            {
+                // NOTE[joe] Can we remove COMMA and instead use START?
+                TransitionTo(COMMA);
+            }
+        }
+        // If the token we're reading is an EOL and the state we're at is...
+        else if (TokenIs(EOL))
+        {
+            if (StateIs(PARAM))
+            {
+                FinishParameter();
+            }
+
+            if (StateIs(PARAM) && Directive == DIRECTIVE_FILL &&
+                CurrentInstruction.ParameterCount == 0)
+            {
+                ReportError("Missing value, .fill takes a count and a value");
+            }
+
+            if (StateIs(PARAM))
+            {
+                // However many parameters were written, an instruction takes
+                // up three words. Data takes up as many as it says.
+                if (Directive == DIRECTIVE_NONE)
+                {
+                    CurrentInstruction.Length = 3;
+                }
+                else if (Directive == DIRECTIVE_WORD)
+                {
+                    CurrentInstruction.Data   = true;
+                    CurrentInstruction.Length =
+                        CurrentInstruction.ParameterCount;
+                }
+                // NOTE However big, a .fill or a .zero is a single run
+                // of data until the code is generated, and the zeros at the
+                // end of a program are never written to its image.
+                else
+                {
+                    if (Directive == DIRECTIVE_ZERO)
+                    {
+                        CurrentInstruction.Parameters[0]  = 0;
+                        CurrentInstruction.ParameterCount = 1;
+                    }
+
+                    CurrentInstruction.Data   = true;
+                    CurrentInstruction.Length = (unsigned int)Count;
+                }
+
+                if (CurrentInstruction.Length)
+                {
+                    AppendInstruction();
+                }
+                else
+                {
+                    CurrentAddress = CurrentInstruction.Location;
+
+                    CurrentInstruction = { };
+                    CurrentInstruction.Location = CurrentAddress;
+                }
+
+                TransitionTo(START);
+            }
+            // NOTE Empty lines, and labels on a line of their own, are let
+            // through, with the label going to the next instruction.
+            else if (StateIs(START) ||
+                     (StateIs(LABEL) && CurrentInstruction.ParameterCount == 0))
+            {
+            }
+            // Throw away the instruction with an error in it, and start over
+            // on the next line.
+            else
+            {
+                // NOTE An instruction never goes on past the end of its line,
+                // so that the source can be split at any line.
+                if (StateIs(LABEL))
+                {
+                    ReportError("Missing parameter after a label, an "
+                                "instruction ends at the end of its line");
+                }
+                else if (!StateIs(INVALID))
+                {
+                    ReportUnexpected();
+                }
+
+                CurrentAddress = CurrentInstruction.Location;
+
+                CurrentInstruction = { };
+                CurrentInstruction.Location = CurrentAddress;
+
+                TransitionTo(START);
+            }
+
+            Directive = DIRECTIVE_NONE;
+            Count     = -1;
+        }
+        // If the token we're reading is an INVALID token, report that we found
+        // an error.
+        else if (TokenIs(INVALID))
+        {
+            ReportUnexpected();
+        }
+        // If we reach here, there is definitely a problem...
+        else
+        {
+            Unreachable();
+        }
+
+#undef TokenIs
+#undef StateIs
+#undef ReportErrorAt
+#undef ReportError
+#undef ReportUnexpected
+#undef AddParameter
+#undef MarkRelative
+#undef Counting
+#undef BeginsParameter
+#undef ContinuesParameter
+#undef AppendInstruction
+#undef BeginParameter
+#undef AddTerm
+#undef FinishParameter
+#undef Patch
+#undef TransitionTo
+    }
+
+    // Anything after the last end of line is never finished.
+    Chunk->Length = CurrentInstruction.Location;
+
+#undef PARSER_STATES
+}
+
+// GenerateCode() writes the program code for [Count] [Instructions] to
+// [Output], relocating every relative address by [Base]. If [Relocations] is
+// given, the address of every relative word is appended to it. [Output] has
+// to have room for as many words as the instructions take up.
+static
+void GenerateCode(const instruction *Instructions,
+                  unsigned int Count,
+                  unsigned int Base,
+                  int *Output,
+                  buffer<unsigned int> *Relocations = NULL)
+{
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        const instruction *Instruction = &Instructions[i];
+
+        int Parameters[3];
+
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            Parameters[j] = Instruction->Parameters[j];
+
+            if (Instruction->Relative & (1 << j))
+                Parameters[j] += Base;
+        }
+
+        // Data is written out as it is, the last parameter over and over.
+        if (Instruction->Data)
+        {
+            unsigned int Last = Instruction->ParameterCount - 1;
+
+            std::copy(Parameters, Parameters + Last, Output);
+            std::fill(Output + Last,
+                      Output + Instruction->Length,
+                      Parameters[Last]);
+
+            for (unsigned int j = 0; Relocations && j < Instruction->Length; j++)
+            {
+                if (Instruction->Relative & (1 << std::min(j, Last)))
+                {
+                    Append<unsigned int>(Relocations,
+                                         Base + Instruction->Location + j);
+                }
+            }
+
+            Output += Instruction->Length;
+            continue;
+        }
+
+        int Next = Base + Instruction->Location + 3;
+
+        // Which of the three words are relative.
+        unsigned int Relative = 0;
+
+        switch (Instruction->ParameterCount)
+        {
+            case 1:
+            {
+                *Output++ = Parameters[0];
+                *Output++ = Parameters[0];
+                *Output++ = Next;
+
+                Relative = (Instruction->Relative & 1) * 3 | 4;
+            } break;
+
+            case 2:
+            {
+                *Output++ = Parameters[0];
+                *Output++ = Parameters[1];
+                *Output++ = Next;
+
+                Relative = (Instruction->Relative & 3) | 4;
+            } break;
+
+            case 3:
+            {
+                *Output++ = Parameters[0];
+                *Output++ = Parameters[1];
+                *Output++ = Parameters[2];
+
+                Relative = Instruction->Relative & 7;
+            } break;
+
+            // TODO[joe] Raise error? This is a case we should never reach.
+            default:
+            {
+                Unreachable();
+                Output += 3;
+            } break;
+        }
+
+        for (unsigned int j = 0; Relocations && j < 3; j++)
+        {
+            if (Relative & (1 << j))
+            {
+                Append<unsigned int>(Relocations,
+                                     Base + Instruction->Location + j);
+            }
+        }
+    }
+}
+
+// Link() gives every chunk of [Assembler] its base address, declares every
+// chunk's labels in the assembler's symbol table, patches the references each
+// chunk couldn't resolve on its own, and generates the program code.
+static
+void Link(assembler *Assembler)
+{
+    buffer<chunk> &Chunks = Assembler->Chunks;
+
+    unsigned int Base = 0;
+
+    for (unsigned int i = 0; i < Chunks.Length; i++)
+    {
+        Chunks[i].Base = Base;
+        Base += Chunks[i].Length;
+    }
+
+    // NOTE Merging labels is the only part of assembly that has to be
+    // done one chunk at a time, since chunks may try to declare the same
+    // label. A single chunk has nothing to merge.
+    symbol_table *Symbols = Chunks.Length == 1 ?
+                            &Chunks[0].Symbols :
+                            &Assembler->MergedLabels;
+
+    Assembler->Labels = Symbols;
+
+    for (unsigned int i = 0; i < Chunks.Length && Chunks.Length > 1; i++)
+    {
+        chunk *Chunk = &Chunks[i];
+
+        for (unsigned int j = 0; j < Chunk->Symbols.Symbols.Length; j++)
+        {
+            symbol *Local = &Chunk->Symbols.Symbols[j];
+
+            if (!Local->Defined)
+                continue;
+
+            const char *Name = SymbolName(&Chunk->Symbols, j);
+            unsigned int NameLength = Local->NameLength;
+
+            symbol *Global = &Symbols->Symbols[Intern(Symbols,
+                                                      Name,
+                                                      NameLength)];
+
+            if (Global->Defined)
+            {
+                Append<error>(&Chunk->Errors,
+                              GenerateError(&Chunk->Arena,
+                                            &Local->Declaration,
+                                            "Redeclared label \"%.*s\"",
+                                            NameLength,
+                                            Name));
+            }
+            else
+            {
+                Global->Address     = Chunk->Base + Local->Address;
+                Global->Defined     = true;
+                Global->Declaration = Local->Declaration;
+            }
+        }
+    }
+
+    Reserve<int>(&Assembler->Program, Base);
+    Assembler->Program.Length = Base;
+
+    ParallelFor(Chunks.Length, Assembler->ThreadCount, [&](unsigned int i)
+    {
+        chunk *Chunk = &Chunks[i];
+
+        for (unsigned int j = 0; j < Chunk->Symbols.Symbols.Length; j++)
+        {
+            symbol *Local = &Chunk->Symbols.Symbols[j];
+
+            if (Local->FirstFixup == NO_FIXUP)
+                continue;
+
+            const char *Name = SymbolName(&Chunk->Symbols, j);
+
+            status<unsigned int> Result = Get(&Symbols->Names,
+                                              Name,
+                                              Local->NameLength);
+
+            bool Declared = Result.Status == OK &&
+                            Symbols->Symbols[Result.unpack()].Defined;
+
+            for (unsigned int k = Local->FirstFixup;
+                 k != NO_FIXUP;
+                 k = Chunk->Symbols.Fixups[k].Next)
+            {
+                fixup *Fixup = &Chunk->Symbols.Fixups[k];
+
+                // NOTE A reference in an instruction that was never
+                // finished (no EOL before the end of the source) has nothing
+                // to patch.
+                instruction *Instruction =
+                    FindInstruction(Chunk->Instructions.Data,
+                                    Chunk->Instructions.Length,
+                                    Fixup->Offset);
+
+                unsigned int Bit = Instruction ?
+                                   1 << (Fixup->Offset - Instruction->Location) :
+                                   0;
+
+                if (Declared)
+                {
+                    // The label's address is relative to the start of the
+                    // program, so make it relative to the chunk's like the
+                    // chunk's own labels.
+                    AddAddress(Instruction,
+                               Fixup->Offset,
+                               Fixup->Negative,
+                               Symbols->Symbols[Result.unpack()].Address -
+                               Chunk->Base);
+                }
+                // NOTE The linker can only add a label's address to a
+                // word, so the rest of the word can't be an address.
+                else if (Assembler->Relocatable && Instruction &&
+                         (Fixup->Negative || !(Instruction->Relative & Bit)))
+                {
+                    Append<error>(&Chunk->Errors,
+                                  GenerateError(&Chunk->Arena,
+                                                &Fixup->Token,
+                                                "Can't leave \"%.*s\" to the "
+                                                "linker in this expression",
+                                                Local->NameLength,
+                                                Name));
+                }
+                else if (Assembler->Relocatable)
+                {
+                    // Leave the reference for the linker. A single parameter
+                    // can be more than one word.
+                    unsigned int Words = Instruction ?
+                                         ReferenceLength(Instruction,
+                                                         Fixup->Offset) :
+                                         0;
+
+                    if (Instruction)
+                        Instruction->Relative &= ~Bit;
+
+                    for (unsigned int l = 0; l < Words; l++)
+                    {
+                        Append<reference>(&Chunk->Imports, (reference) {
+                            .Offset     = Chunk->Base + Fixup->Offset + l,
+                            .Name       = Name,
+                            .NameLength = Local->NameLength
+                        });
+                    }
+                }
+                else
+                {
+                    // Any reference still waiting on a label refers to a
+                    // label that was never declared.
+                    Append<error>(&Chunk->Errors,
+                                  GenerateError(&Chunk->Arena,
+                                                &Fixup->Token,
+                                                "Undeclared identifier \"%.*s\"",
+                                                Local->NameLength,
+                                                Name));
+                }
+            }
+        }
+
+        GenerateCode(Chunk->Instructions.Data,
+                     Chunk->Instructions.Length,
+                     Chunk->Base,
+                     Assembler->Program.Data + Chunk->Base,
+                     Assembler->Relocatable ? &Chunk->Relocations : NULL);
+    });
+
+    for (unsigned int i = 0; i < Chunks.Length && Assembler->Relocatable; i++)
+    {
+        Append<unsigned int>(&Assembler->Relocations,
+                             Chunks[i].Relocations.Data,
+                             Chunks[i].Relocations.Length);
+        Append<reference>(&Assembler->Imports,
+                          Chunks[i].Imports.Data,
+                          Chunks[i].Imports.Length);
+    }
+
+    // NOTE Imports come out in the order of the labels they refer to,
+    // which depends on how the source was chunked. Keep objects the same no
+    // matter how many threads made them.
+    std::sort(Assembler->Imports.Data,
+              Assembler->Imports.Data + Assembler->Imports.Length,
+              [](const reference &X, const reference &Y)
+              {
+                  return X.Offset < Y.Offset;
+              });
+}
+
+// Assemble() assembles the [SourceLength] characters of [Source], using up to
+// [ThreadCount] threads. The program code is left in the assembler's
+// [Program]; if anything went wrong, the chunks' [Errors] say what.
+static inline
+void Assemble(assembler *Assembler,
+              const char *Source,
+              unsigned int SourceLength,
+              unsigned int ThreadCount)
+{
+    Assembler->Source       = Source;
+    Assembler->SourceLength = SourceLength;
+    Assembler->ThreadCount  = ThreadCount ? ThreadCount : 1;
+
+
+    /** Index line starts for the lexer and error reporting. */
+
+    // MAGIC Assume generously short lines so the index is sized once.
+    Reserve<unsigned int>(&Assembler->LineStarts, SourceLength / 8 + 1);
+
+    IndexLines(Source, SourceLength, &Assembler->LineStarts);
+
+
+    /** Split the source into chunks at line boundaries. */
+
+    unsigned int ChunkCount = SourceLength / MIN_CHUNK_SIZE;
+
+    ChunkCount = std::max(1u, std::min(ChunkCount, Assembler->ThreadCount));
+
+    Reserve<chunk>(&Assembler->Chunks, ChunkCount);
+
+    unsigned int Begin = 0;
+
+    for (unsigned int i = 0; i < ChunkCount; i++)
+    {
+        unsigned int End = SourceLength;
+
+        if (i + 1 < ChunkCount)
+        {
+            // End the chunk just after the first newline past its even share
+            // of the source. An instruction never goes on past the end of its
+            // line, so any newline will do.
+            unsigned int *LineStart =
+                std::upper_bound(Assembler->LineStarts.Data,
+                                 Assembler->LineStarts.Data +
+                                 Assembler->LineStarts.Length,
+                                 (unsigned int)(((unsigned long long)SourceLength *
+                                                 (i + 1)) / ChunkCount));
+
+            if (LineStart != Assembler->LineStarts.Data +
+                             Assembler->LineStarts.Length)
+            {
+                End = std::max(Begin, *LineStart);
+            }
+        }
+
+        chunk Chunk = { };
+        Chunk.Begin = Begin;
+        Chunk.End   = End;
+
+        Append<chunk>(&Assembler->Chunks, Chunk);
+
+        Begin = End;
+    }
+
+    ParallelFor(ChunkCount, Assembler->ThreadCount, [&](unsigned int i)
+    {
+        Parse(Assembler, &Assembler->Chunks[i]);
+    });
+
+    Link(Assembler);
+}
+
+// ErrorCount() returns how many errors assembling with [Assembler] produced.
+static inline
+unsigned int ErrorCount(assembler *Assembler)
+{
+    unsigned int Count = 0;
+
+    for (unsigned int i = 0; i < Assembler->Chunks.Length; i++)
+        Count += Assembler->Chunks[i].Errors.Length;
+
+    return Count;
+}
+
+// Empty() frees all the memory held by [Assembler].
+static inline
+void Empty(assembler *Assembler)
+{
+    for (unsigned int i = 0; i < Assembler->Chunks.Length; i++)
+    {
+        chunk *Chunk = &Assembler->Chunks[i];
+
+        Empty<instruction>(&Chunk->Instructions);
+        Empty(&Chunk->Symbols);
+        Empty<error>(&Chunk->Errors);
+        Free(&Chunk->Arena);
+        Empty<unsigned int>(&Chunk->Relocations);
+        Empty<reference>(&Chunk->Imports);
+    }
+
+    Empty<chunk>(&Assembler->Chunks);
+    Empty<unsigned int>(&Assembler->LineStarts);
+    Empty(&Assembler->MergedLabels);
+    Empty<int>(&Assembler->Program);
+    Empty<unsigned int>(&Assembler->Relocations);
+    Empty<reference>(&Assembler->Imports);
+}
+
+#undef MIN_CHUNK_SIZE
@@ -5,10 +5,25 @@
  *
  * This file is contains all the declarations and functionality for our dynamic
  * buffer struct.
+ *
+ * Buffers grow geometrically, and can be given their final size up front with
+ * Reserve() so that filling them never reallocates. Buffers of plain data grow
+ * with realloc(), which can often extend the allocation in place; anything
+ * else is moved, not copied, into its new storage.
  */
 
 #pragma once
 
+// C/C++ standard libraries
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+// Own Libraries
+#include "util.cpp"
+
+
 template <typename T>
 struct buffer {
     T *Data;
@@ -22,40 +37,118 @@ struct buffer {
 };
 
 
+// Reserve() makes sure [Buffer] has room for at least [Size] elements without
+// having to grow again.
 template <typename T>
 static
-void Append(buffer<T> *Buffer, const T Value)
+void Reserve(buffer<T> *Buffer, unsigned int Size)
 {
-    if (Buffer->_Size == 0)
+    if (Size <= Buffer->_Size)
+        return;
+
+    if (std::is_trivially_copyable<T>::value)
     {
-        Buffer->_Size  = 1;
-        Buffer->Length = 0;
-        Buffer->Data = new T[Buffer->_Size];
+        T *Data = (T *)std::realloc(Buffer->Data, sizeof(T) * Size);
+        Assert(Data != NULL);
+
+        Buffer->Data = Data;
     }
-    else if (Buffer->Length == Buffer->_Size)
+    else
     {
-        Buffer->_Size *= 2;
-
-        T *Temp = new T[Buffer->_Size];
+        T *Data = (T *)std::malloc(sizeof(T) * Size);
+        Assert(Data != NULL);
 
         for (unsigned int i = 0; i < Buffer->Length; i++)
         {
-            Temp[i] = Buffer->Data[i];
+            new (&Data[i]) T(std::move(Buffer->Data[i]));
+            Buffer->Data[i].~T();
         }
 
-        delete[] Buffer->Data;
-        Buffer->Data = Temp;
+        std::free(Buffer->Data);
+        Buffer->Data = Data;
     }
 
-    Buffer->Data[Buffer->Length++] = Value;
+    Buffer->_Size = Size;
 }
 
+// Grow() makes room for [Count] more elements in [Buffer], at least doubling
+// its size when it has to grow.
 template <typename T>
 static inline
-void Empty(buffer<T> *Buffer)
+void Grow(buffer<T> *Buffer, unsigned int Count)
+{
+    if (Buffer->Length + Count > Buffer->_Size)
+    {
+        unsigned int Size = Buffer->_Size ? 2 * Buffer->_Size : 16;
+
+        while (Size < Buffer->Length + Count)
+            Size *= 2;
+
+        Reserve<T>(Buffer, Size);
+    }
+}
+
+template <typename T>
+static inline
+void Append(buffer<T> *Buffer, const T& Value)
+{
+    Grow<T>(Buffer, 1);
+
+    new (&Buffer->Data[Buffer->Length++]) T(Value);
+}
+
+template <typename T>
+static inline
+void Append(buffer<T> *Buffer, T&& Value)
+{
+    Grow<T>(Buffer, 1);
+
+    new (&Buffer->Data[Buffer->Length++]) T(std::move(Value));
+}
+
+// Append() copies [Count] elements from [Values] onto the end of [Buffer],
+// growing it at most once.
+template <typename T>
+static
+void Append(buffer<T> *Buffer, const T *Values, unsigned int Count)
 {
-    Buffer->_Size = 0;
+    Grow<T>(Buffer, Count);
+
+    for (unsigned int i = 0; i < Count; i++)
+        new (&Buffer->Data[Buffer->Length++]) T(Values[i]);
+}
+
+template <typename T>
+static inline
+T Pop(buffer<T> *Buffer)
+{
+    // NOTE We can't pop from an empty buffer, so we'll assert here.
+    Assert(Buffer->Length != 0);
+
+    T Value = std::move(Buffer->Data[--Buffer->Length]);
+    Buffer->Data[Buffer->Length].~T();
+
+    return Value;
+}
+
+// Clear() drops every element of [Buffer] but keeps its memory for reuse.
+template <typename T>
+static inline
+void Clear(buffer<T> *Buffer)
+{
+    for (unsigned int i = 0; i < Buffer->Length; i++)
+        Buffer->Data[i].~T();
+
     Buffer->Length = 0;
+}
+
+template <typename T>
+static inline
+void Empty(buffer<T> *Buffer)
+{
+    Clear<T>(Buffer);
+
+    std::free(Buffer->Data);
 
-    delete[] Buffer->Data;
+    *Buffer = { };
 }
@@ -0,0 +1,363 @@
+/**
+ * @file engine.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the engines that run a loaded program, shared by the
+ * emulator and the benchmarks (see src/bench).
+ *
+ * There are two engines. The checked one makes sure every instruction, and
+ * every cell it touches, is in memory before running it. When the image
+ * carries a partition that checks out on load (see image.cpp), the program
+ * is known to stay inside the instructions it marks, which never change, so
+ * the unchecked engine runs it without any of that.
+ *
+ * Every result a program computes is printed on a line of its own. Printing
+ * goes through a buffer, since formatting each result with printf() takes
+ * longer than running the instruction that made it. Every thread has a buffer
+ * and an output of its own, so that programs can run side by side.
+ *
+ * Either engine can also publish how the program is doing to a stats segment
+ * (see stats.cpp) as it goes. That's a separate build of each engine, so that
+ * runs that don't publish anything don't pay for it at all. Counting the
+ * instructions that write to code that has run means marking every cell that
+ * runs and looking up every cell that's written to, which costs as much as
+ * the rest of the checked engine, so that's a separate build again, for when
+ * the segment asks for it.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+
+// Own Libraries
+#include "stats.cpp"
+
+
+#define IsStdout(OFFSET) (OFFSET == -1)
+
+// MAGIC Big enough that writing it out is rare.
+#define OUTPUT_SIZE (64 * 1024)
+
+// As many instructions as anything can run.
+#define NO_BUDGET (~0ull)
+
+// What the checked engine marks a cell with once an instruction in it has run
+// (see CheckedEngine()).
+#define EXECUTED_CELL  1 // The cell is part of an instruction that ran.
+#define EXECUTED_START 2 // An instruction starting at the cell ran.
+
+
+enum engine_status {
+    HALTED,
+    // The program counter left memory.
+    COUNTER_OUT_OF_BOUNDS,
+    // An instruction refers to a cell outside of memory.
+    OPERAND_OUT_OF_BOUNDS,
+    // The program ran as many instructions as it was allowed to.
+    OUT_OF_STEPS
+};
+
+
+// Where the program's output goes.
+static thread_local FILE *OutputFile = stdout;
+
+// The results the program has printed that haven't been written out yet.
+static thread_local char Output[OUTPUT_SIZE];
+static thread_local unsigned int OutputLength = 0;
+
+
+// Flush() writes out everything Print() has held on to.
+static
+void Flush()
+{
+    fwrite(Output, 1, OutputLength, OutputFile);
+    OutputLength = 0;
+}
+
+// Print() prints [Value] on a line of its own, the same as printf("%d\n")
+// would, without formatting through printf() for every one.
+static inline
+void Print(int Value)
+{
+    // NOTE The longest line is "-2147483648\n".
+    if (OutputLength > OUTPUT_SIZE - 12)
+        Flush();
+
+    char Digits[10];
+    unsigned int DigitCount = 0;
+    unsigned int Magnitude = Value < 0 ? 0u - (unsigned int)Value :
+                                         (unsigned int)Value;
+
+    do
+    {
+        Digits[DigitCount++] = (char)('0' + Magnitude % 10);
+        Magnitude /= 10;
+    } while (Magnitude);
+
+    if (Value < 0)
+        Output[OutputLength++] = '-';
+
+    while (DigitCount)
+        Output[OutputLength++] = Digits[--DigitCount];
+
+    Output[OutputLength++] = '\n';
+}
+
+static
+bool InBounds(int Offset, long Extent)
+{
+    if (IsStdout(Offset))
+        return true;
+
+    else if (0 <= Offset && Offset < Extent)
+        return true;
+
+    else
+        return false;
+}
+
+// InMemory() returns whether [Offset] is one of the [Extent] cells of memory.
+// Unlike the jump, an operand can't be -1, since there's no cell there.
+static inline
+bool InMemory(int Offset, long Extent)
+{
+    return 0 <= Offset && Offset < Extent;
+}
+
+// Subtract() returns [A] - [B], wrapping around like the machine does rather
+// than overflowing.
+static inline
+int Subtract(int A, int B)
+{
+    return (int)((unsigned int)A - (unsigned int)B);
+}
+
+
+// CheckedEngine() is RunChecked(), publishing to [Stats] as it goes if
+// [Publish], and counting the instructions that wrote to code that had run if
+// [Track].
+template <bool Publish, bool Track>
+static
+engine_status CheckedEngine(int *Program,
+                            long Length,
+                            int Entry,
+                            unsigned long long *Counts,
+                            unsigned long long *Steps,
+                            unsigned long long Budget,
+                            stats_segment *Stats)
+{
+    int ProgramCounter = Entry, A = 0, B = 0, C = 0;
+    unsigned long long Ran = 0;
+
+    // The cells of every instruction that has run, and what's counted of
+    // what the program did.
+    unsigned char *Executed = Track ? new unsigned char[Length]() : NULL;
+    unsigned long long Taken = 0, SelfModifying = 0;
+
+    // NOTE Publishing runs the program a block at a time, counting down how
+    // many instructions are left of it, so that the loop has no more to keep
+    // track of than it does without publishing.
+    for (;;)
+    {
+        unsigned long long Block =
+            Publish && Budget - Ran > STATS_BLOCK ? STATS_BLOCK : Budget - Ran;
+        unsigned long long Left = Block;
+
+        // NOTE The whole instruction has to be in memory, not just its first
+        // cell.
+        while (InBounds(ProgramCounter, Length - 2) &&
+               !IsStdout(ProgramCounter) &&
+               Left)
+        {
+            if (Counts)
+                Counts[ProgramCounter]++;
+
+            // NOTE Most instructions have run before, and checking for that
+            // is cheaper than marking them again. The instruction's first
+            // cell is marked apart from the rest, since a jump can land in
+            // the middle of another instruction.
+            if (Track && !(Executed[ProgramCounter] & EXECUTED_START))
+            {
+                Executed[ProgramCounter]     |= EXECUTED_START | EXECUTED_CELL;
+                Executed[ProgramCounter + 1] |= EXECUTED_CELL;
+                Executed[ProgramCounter + 2] |= EXECUTED_CELL;
+            }
+
+            A = Program[ProgramCounter++];
+            B = Program[ProgramCounter++];
+            C = Program[ProgramCounter++];
+
+            if (!InMemory(A, Length) ||
+                !InMemory(B, Length) ||
+                !InBounds(C, Length))
+            {
+                break;
+            }
+
+            if (Track)
+                SelfModifying += Executed[B] & EXECUTED_CELL;
+
+            // The SUBLEQ operation.
+            if ((Program[B] = Subtract(Program[A], Program[B])) <= 0)
+            {
+                ProgramCounter = C;
+
+                if (Publish)
+                    Taken++;
+            }
+
+            Print(Program[B]);
+            Left--;
+        }
+
+        Ran += Block - Left;
+
+        // Anything but the end of a block stops the program.
+        if (!Publish || Left || Ran == Budget)
+            break;
+
+        PublishStats(Stats, Ran, Taken, SelfModifying, ProgramCounter);
+    }
+
+    Flush();
+
+    if (Steps)
+        *Steps = Ran;
+
+    if (Publish)
+        PublishStats(Stats, Ran, Taken, SelfModifying, ProgramCounter);
+
+    if (Track)
+        delete[] Executed;
+
+    if (!InBounds(ProgramCounter, Length - 2))
+        return COUNTER_OUT_OF_BOUNDS;
+
+    else if (!InMemory(A, Length) ||
+             !InMemory(B, Length) ||
+             !InBounds(C, Length))
+        return OPERAND_OUT_OF_BOUNDS;
+
+    else if (!IsStdout(ProgramCounter))
+        return OUT_OF_STEPS;
+
+    else
+        return HALTED;
+}
+
+// UncheckedEngine() is RunUnchecked(), publishing to [Stats] as it goes if
+// [Publish]. A program with a partition can't change its code, so nothing it
+// does is counted as self-modifying.
+template <bool Publish>
+static
+engine_status UncheckedEngine(int *Program,
+                              int Entry,
+                              unsigned long long *Counts,
+                              unsigned long long *Steps,
+                              unsigned long long Budget,
+                              stats_segment *Stats)
+{
+    int ProgramCounter = Entry;
+    unsigned long long Ran = 0;
+
+    unsigned long long Taken = 0;
+
+    for (;;)
+    {
+        unsigned long long Block =
+            Publish && Budget - Ran > STATS_BLOCK ? STATS_BLOCK : Budget - Ran;
+        unsigned long long Left = Block;
+
+        while (!IsStdout(ProgramCounter) && Left)
+        {
+            if (Counts)
+                Counts[ProgramCounter]++;
+
+            const int *Instruction = Program + ProgramCounter;
+            int *B = Program + Instruction[1];
+
+            if ((*B = Subtract(Program[Instruction[0]], *B)) <= 0)
+            {
+                ProgramCounter = Instruction[2];
+
+                if (Publish)
+                    Taken++;
+            }
+            else
+            {
+                ProgramCounter += 3;
+            }
+
+            Print(*B);
+            Left--;
+        }
+
+        Ran += Block - Left;
+
+        if (!Publish || Left || Ran == Budget)
+            break;
+
+        PublishStats(Stats, Ran, Taken, 0, ProgramCounter);
+    }
+
+    Flush();
+
+    if (Steps)
+        *Steps = Ran;
+
+    if (Publish)
+        PublishStats(Stats, Ran, Taken, 0, ProgramCounter);
+
+    return IsStdout(ProgramCounter) ? HALTED : OUT_OF_STEPS;
+}
+
+// RunChecked() runs [Program], [Length] cells long, from [Entry] until it
+// halts, goes out of bounds or has run [Budget] instructions, counting every
+// instruction it runs in [Counts] if it's given. [Steps] is set to how many
+// instructions ran, if it's given, and the counters in [Stats] are kept up to
+// date, if it's given. Instructions that write to code are only counted if
+// [Stats] asks for them with STATS_SELF_MODIFYING. Returns how it stopped.
+static
+engine_status RunChecked(int *Program,
+                         long Length,
+                         int Entry,
+                         unsigned long long *Counts,
+                         unsigned long long *Steps = NULL,
+                         unsigned long long Budget = NO_BUDGET,
+                         stats_segment *Stats = NULL)
+{
+    if (!Stats)
+        return CheckedEngine<false, false>(Program, Length, Entry, Counts,
+                                           Steps, Budget, NULL);
+
+    else if (!(Stats->Flags & STATS_SELF_MODIFYING))
+        return CheckedEngine<true, false>(Program, Length, Entry, Counts,
+                                          Steps, Budget, Stats);
+
+    else
+        return CheckedEngine<true, true>(Program, Length, Entry, Counts,
+                                         Steps, Budget, Stats);
+}
+
+// RunUnchecked() runs [Program] from [Entry] until it halts or has run
+// [Budget] instructions, like RunChecked(), trusting that it never leaves its
+// partition.
+static inline
+engine_status RunUnchecked(int *Program,
+                           int Entry,
+                           unsigned long long *Counts,
+                           unsigned long long *Steps = NULL,
+                           unsigned long long Budget = NO_BUDGET,
+                           stats_segment *Stats = NULL)
+{
+    return Stats ? UncheckedEngine<true>(Program, Entry, Counts, Steps, Budget,
+                                         Stats) :
+                   UncheckedEngine<false>(Program, Entry, Counts, Steps,
+                                          Budget, NULL);
+}
+
+#undef EXECUTED_START
+#undef EXECUTED_CELL
+#undef OUTPUT_SIZE
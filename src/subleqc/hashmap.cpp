@@ -4,141 +4,205 @@
 //
 // This file contains our definitions for our hashmap, used by the SUBLEQ
 // assembler to store address values for labels.
+//
+// The map is a single open-addressed table with linear probing. Every node
+// keeps the full hash of its key so that probes only compare key text when
+// the hashes already match, and the table doubles once it is three quarters
+// full. Keys are interned into one contiguous pool owned by the map, so
+// storing a label costs no allocation of its own.
 
 #pragma once
 
 // C Standard Libraries
 #include <cstring>
-#include <algorithm>
 
 // Own Libraries
 #include "util.cpp"
+#include "buffer.cpp"
 
-#define MAX_PAGE_SIZE 64
+#define HASHMAP_INITIAL_CAPACITY 64
 
 struct hashnode
 {
-    const char *Key;
+    unsigned int Hash;
+    // Offset of this node's key in the map's key pool. An empty node has a
+    // [KeyLength] of zero; empty keys can't be stored.
+    unsigned int KeyOffset;
+    unsigned int KeyLength;
     unsigned int Value;
 };
 
 struct hashmap
 {
-    hashnode Nodes[MAX_PAGE_SIZE];
-    hashmap *NextPage;
-    unsigned int ActiveNodeCount;
+    hashnode *Nodes;
+    unsigned int Capacity;
+    unsigned int Count;
+    buffer<char> Keys;
 };
 
 
 // Hash() uses the djib2 string hashing function to create a hash value for
-// the input string. It then divides the computed hash by the maximum page size
-// to compute the table index the hashed value belongs at.
-unsigned int Hash(const char *String)
+// the input string of [Length] characters.
+static inline
+unsigned int Hash(const char *String, unsigned int Length)
 {
     unsigned int Hash = 5381;
-    char c;
 
-    while ((c = *String++))
-        Hash = ((Hash << 5) + Hash) + (unsigned int)c;
+    for (unsigned int i = 0; i < Length; i++)
+        Hash = ((Hash << 5) + Hash) + (unsigned int)String[i];
 
-    return Hash % MAX_PAGE_SIZE;
+    return Hash;
 }
 
-// Put() computes the hash of the [Key] and tries to insert the value into the
-// first page of the given [Map]. If the value cannot be inserted, it repeats
-// for the next page, or creates a new page if there is no next page.
-void Put(hashmap *Map, const char *Key, const unsigned int Value)
+// HashIndex() maps a full [Hash] to a node index in a table of [Capacity]
+// nodes (always a power of two). We multiply by 2^32/phi and keep the top
+// bits, so that the index depends on every bit of the djb2 hash.
+static inline
+unsigned int HashIndex(unsigned int Hash, unsigned int Capacity)
 {
-    if (Map->ActiveNodeCount < (MAX_PAGE_SIZE - 1))
-    {
-        int KeyLength = std::strlen(Key);
+    if (Capacity == 1)
+        return 0;
 
-        char* KeyCopy = new char[KeyLength + 1];
-        std::fill(KeyCopy, KeyCopy + KeyLength + 1, '\0');
-        std::copy(Key, Key + KeyLength, KeyCopy);
+    return (Hash * 2654435769u) >> (32 - CountTrailingZeros(Capacity));
+}
 
-        unsigned int Index = Hash(Key);
+// FindNode() returns the node that holds [Key] in [Map], or the empty node
+// where [Key] would be inserted if [Map] doesn't contain it.
+static
+hashnode *FindNode(hashmap *Map,
+                   const char *Key,
+                   const unsigned int KeyLength,
+                   const unsigned int KeyHash)
+{
+    unsigned int Mask = Map->Capacity - 1;
 
-        if (Map->Nodes[Index].Key == NULL)
-        {
-            Map->Nodes[Index] = (hashnode) {
-                .Key = KeyCopy,
-                .Value = Value
-            };
-        }
+    for (unsigned int i = HashIndex(KeyHash, Map->Capacity);
+         ;
+         i = (i + 1) & Mask)
+    {
+        hashnode *Node = &Map->Nodes[i];
+
+        if (Node->KeyLength == 0)
+            return Node;
 
-        else
+        else if (Node->Hash == KeyHash &&
+                 Node->KeyLength == KeyLength &&
+                 std::memcmp(Map->Keys.Data + Node->KeyOffset,
+                             Key,
+                             KeyLength) == 0)
         {
-            unsigned int i = Index + 1;
-            while (i != Index)
-            {
-                if (Map->Nodes[i].Key == NULL)
-                {
-                    Map->Nodes[i] = (hashnode) {
-                        .Key = KeyCopy,
-                        .Value = Value
-                    };
-
-                    break;
-                }
-
-                if (++i == MAX_PAGE_SIZE)
-                    i = 0;
-            }
+            return Node;
         }
-
-        Map->ActiveNodeCount++;
     }
-    else if (Map->NextPage == NULL)
-    {
-        Map->NextPage = new hashmap();
-        *(Map->NextPage) = { };
+}
 
-        Put(Map->NextPage, Key, Value);
-    }
-    else
+// Resize() moves every node of [Map] into a new table of [Capacity] nodes.
+// Keys stay where they are in the key pool, and the stored hashes mean we
+// never need to look at them.
+static
+void Resize(hashmap *Map, unsigned int Capacity)
+{
+    hashnode *OldNodes = Map->Nodes;
+    unsigned int OldCapacity = Map->Capacity;
+
+    Map->Nodes = new hashnode[Capacity]();
+    Map->Capacity = Capacity;
+
+    for (unsigned int i = 0; i < OldCapacity; i++)
     {
-        Put(Map->NextPage, Key, Value);
+        if (OldNodes[i].KeyLength == 0)
+            continue;
+
+        unsigned int j = HashIndex(OldNodes[i].Hash, Capacity);
+
+        while (Map->Nodes[j].KeyLength != 0)
+            j = (j + 1) & (Capacity - 1);
+
+        Map->Nodes[j] = OldNodes[i];
     }
+
+    delete[] OldNodes;
 }
 
-// Get() takes a hashmap pointer [Map] and a string [Key] and returns the value
-// stored in [Map] that is associated with that [Key].
-status<unsigned int> Get(hashmap *Map, const char *Key)
+// Put() associates [Value] with [Key] in the given [Map], replacing any value
+// already stored for [Key]. [Key] does not need to be null terminated; the map
+// interns its own copy. Returns where the interned key lives in the map's key
+// pool (see KeyAt()).
+unsigned int Put(hashmap *Map,
+                 const char *Key,
+                 const unsigned int KeyLength,
+                 const unsigned int Value)
 {
-    // todo(jrm): Replace with a hash-and-grab-or-search method instead of just
-    // linearly searching the hash table like a hooligan.
+    Assert(KeyLength != 0);
 
-    unsigned int StartIndex = Hash(Key);
+    if (Map->Capacity == 0)
+        Resize(Map, HASHMAP_INITIAL_CAPACITY);
 
-    unsigned int i = StartIndex;
-    do {
-        if (i == MAX_PAGE_SIZE)
-            i = 0;
+    // Keep the load factor at or below 3/4 so probe sequences stay short.
+    else if (4 * (Map->Count + 1) > 3 * Map->Capacity)
+        Resize(Map, 2 * Map->Capacity);
 
-        const char *StoredKey = Map->Nodes[i].Key;
+    unsigned int KeyHash = Hash(Key, KeyLength);
+    hashnode *Node = FindNode(Map, Key, KeyLength, KeyHash);
 
-        if (StoredKey == NULL)
-            continue;
+    if (Node->KeyLength == 0)
+    {
+        Node->Hash      = KeyHash;
+        Node->KeyOffset = Map->Keys.Length;
+        Node->KeyLength = KeyLength;
+
+        Append<char>(&Map->Keys, Key, KeyLength);
+
+        Map->Count++;
+    }
+
+    Node->Value = Value;
+
+    return Node->KeyOffset;
+}
+
+// KeyAt() returns the interned key at [KeyOffset] in [Map]'s key pool. The
+// pointer is only good until the next Put().
+static inline
+const char *KeyAt(hashmap *Map, unsigned int KeyOffset)
+{
+    return Map->Keys.Data + KeyOffset;
+}
 
-        else if (std::strcmp(StoredKey, Key) == 0)
+// Get() takes a hashmap pointer [Map] and a string [Key] and returns the value
+// stored in [Map] that is associated with that [Key].
+status<unsigned int> Get(hashmap *Map,
+                         const char *Key,
+                         const unsigned int KeyLength)
+{
+    if (Map->Count != 0)
+    {
+        hashnode *Node = FindNode(Map, Key, KeyLength, Hash(Key, KeyLength));
+
+        if (Node->KeyLength != 0)
         {
             return (status<unsigned int>) {
                 .Status = OK,
-                .Value  = Map->Nodes[i].Value
+                .Value  = Node->Value
             };
         }
-    } while (++i != StartIndex);
+    }
 
-    if (Map->NextPage != NULL)
-        return Get(Map, Key);
+    return (status<unsigned int>) {
+        .Status = ERROR,
+        .Value  = 0
+    };
+}
 
-    else {
-        return (status<unsigned int>) {
-            .Status = ERROR,
-            .Value  = 0
-        };
-    }
+// Empty() frees all the memory held by [Map], leaving it ready for reuse.
+static inline
+void Empty(hashmap *Map)
+{
+    delete[] Map->Nodes;
+
+    Empty<char>(&Map->Keys);
+
+    *Map = { };
 }
 
-#undef MAX_PAGE_SIZE
+#undef HASHMAP_INITIAL_CAPACITY
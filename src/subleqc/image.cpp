@@ -0,0 +1,701 @@
+/**
+ * @file image.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the binary image format that subleqc writes and subleq
+ * loads. An image starts with a header saying what it is: the format
+ * version, the byte order and width of its cells, where the program starts,
+ * and how much memory it asks for. The code comes straight after the header,
+ * and the zeros at the end of the program are left out and only counted, the
+ * way a BSS section is. An image may also have a symbol table after its code,
+ * with the address of every label.
+ *
+ *     offset  size  field
+ *          0     4  Magic, "SQX" and a zero byte
+ *          4     2  Version
+ *          6     1  Byte order of every field after it, 1 little or 2 big
+ *          7     1  Cell width in bytes
+ *          8     4  Entry, the address of the first instruction to run
+ *         12     4  Memory size in cells, at least code and zeros
+ *         16     4  Code length in cells, stored right after the header
+ *         20     4  Zero length in cells, the zeros after the code
+ *         24     4  Symbol count
+ *         28     4  Symbol offset, the symbol table's byte offset in the file
+ *         32     4  Encoding, how the code is stored: 0 cells, 1 packed
+ *         36     4  Encoded size, how many bytes of code are stored
+ *         40     4  Facts, what analysis found out about the program
+ *         44     4  Code start, the first cell of the code that can run
+ *         48     4  Code end, one past the last cell of it
+ *         52     4  Partition offset, the partition's byte offset in the file
+ *
+ * Packed code is described in pack.cpp.
+ *
+ * If the program was analyzed (see analysis.cpp) and can't change its own
+ * code, the image has a partition after its code: a bit for every instruction
+ * between the code start and end, set if it can run. The loader checks the
+ * partition before believing it, so a wrong one only costs speed.
+ *
+ * Every symbol is its address and the length of its name, 4 bytes each, then
+ * the name itself.
+ *
+ * Images used to be just the cells, with no header. Those still load; they
+ * start at address 0 and get exactly as much memory as they have cells.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "symbol.cpp"
+#include "analysis.cpp"
+#include "pack.cpp"
+
+
+#define IMAGE_VERSION     1
+#define IMAGE_HEADER_SIZE 56
+
+#define IMAGE_CELLS  0
+#define IMAGE_PACKED 1
+
+#define IMAGE_LITTLE_ENDIAN 1
+#define IMAGE_BIG_ENDIAN    2
+
+#define IMAGE_ANALYZED (1 << 0) // The program was analyzed.
+#define IMAGE_STATIC   (1 << 1) // It can't change its code; has a partition.
+
+struct image_header {
+    char Magic[4];
+    uint16_t Version;
+    uint8_t ByteOrder;
+    uint8_t CellWidth;
+    uint32_t Entry;
+    uint32_t MemorySize;
+    uint32_t CodeLength;
+    uint32_t ZeroLength;
+    uint32_t SymbolCount;
+    uint32_t SymbolOffset;
+    uint32_t Encoding;
+    uint32_t EncodedSize;
+    uint32_t Facts;
+    uint32_t CodeStart;
+    uint32_t CodeEnd;
+    uint32_t PartitionOffset;
+};
+
+static_assert(sizeof(image_header) == IMAGE_HEADER_SIZE,
+              "The header is written to disk as it is.");
+
+static const char ImageMagic[4] = { 'S', 'Q', 'X', '\0' };
+
+// What analysis found out about a program, to be written into its image.
+struct image_facts {
+    uint32_t Facts;
+    unsigned int CodeStart;
+    unsigned int CodeEnd;
+    buffer<unsigned char> Partition;
+};
+
+struct image {
+    // The program's memory, [MemorySize] cells of it.
+    int *Memory;
+    unsigned int MemorySize;
+    unsigned int Entry;
+    // Whether the image's partition checked out, so the program is known to
+    // never run an instruction outside of it, touch a cell outside of
+    // memory, or change its own code.
+    bool Static;
+    // The cells the partition covers, if it checked out. Writing anything
+    // there from outside the program can make it wrong.
+    unsigned int CodeStart;
+    unsigned int CodeEnd;
+    // Where the memory came from, so that Unload() can give it back.
+    void *Mapping;
+    size_t MappingSize;
+};
+
+
+// HostByteOrder() returns the byte order of the machine we're running on.
+static inline
+uint8_t HostByteOrder()
+{
+    const uint16_t Probe = 1;
+    return *(const uint8_t *)&Probe ? IMAGE_LITTLE_ENDIAN : IMAGE_BIG_ENDIAN;
+}
+
+// Swap() reverses the bytes of [Value].
+static inline
+uint32_t Swap(uint32_t Value)
+{
+    return (Value >> 24) | ((Value >> 8) & 0xFF00) |
+           ((Value << 8) & 0xFF0000) | (Value << 24);
+}
+
+
+// PartitionSize() returns how many bytes the partition of the code from
+// [CodeStart] to [CodeEnd] takes.
+static inline
+unsigned int PartitionSize(unsigned int CodeStart, unsigned int CodeEnd)
+{
+    return ((CodeEnd - CodeStart) / 3 + 7) / 8;
+}
+
+
+/** Writing images. */
+
+// AnalyzeImage() works out the [Facts] to write into the image of [Program]
+// when it asks for [MemorySize] cells of memory. Only a program that can't
+// change its own code, and passes the same checks the loader makes, gets a
+// partition.
+static inline
+void AnalyzeImage(const buffer<int> *Program,
+                  unsigned int MemorySize,
+                  image_facts *Facts)
+{
+    *Facts = { };
+    Facts->Facts = IMAGE_ANALYZED;
+
+    buffer<unsigned char> Cells = { };
+    buffer<unsigned char> Reachable = { };
+
+    if (Analyze(Program, &Cells, &Reachable) && Reachable.Length)
+    {
+        unsigned int First = 0;
+        unsigned int Last = Reachable.Length;
+
+        while (!Reachable[First])
+            First++;
+
+        while (!Reachable[Last - 1])
+            Last--;
+
+        Facts->CodeStart = 3 * First;
+        Facts->CodeEnd   = 3 * Last;
+
+        unsigned int Size = PartitionSize(Facts->CodeStart, Facts->CodeEnd);
+
+        Reserve<unsigned char>(&Facts->Partition, Size);
+        Facts->Partition.Length = Size;
+        std::memset(Facts->Partition.Data, 0, Size);
+
+        for (unsigned int i = First; i < Last; i++)
+            Facts->Partition[(i - First) / 8] |= Reachable[i] << (i - First) % 8;
+
+        if (VerifyPartition(Program->Data,
+                            std::max(Program->Length, MemorySize),
+                            0,
+                            Facts->CodeStart,
+                            Facts->CodeEnd,
+                            Facts->Partition.Data))
+        {
+            Facts->Facts |= IMAGE_STATIC;
+        }
+        else
+        {
+            Empty<unsigned char>(&Facts->Partition);
+            Facts->CodeStart = Facts->CodeEnd = 0;
+        }
+    }
+
+    Empty<unsigned char>(&Cells);
+    Empty<unsigned char>(&Reachable);
+}
+
+// WriteHeader() writes a header for [CodeLength] cells of code followed by
+// [ZeroLength] zeros to [File], asking for [MemorySize] cells of memory, or
+// just enough for the program if that's fewer. The code takes [EncodedSize]
+// bytes stored with [Encoding]. If there are [SymbolCount] symbols, they start
+// at [SymbolOffset]. If there are [Facts], their partition is at
+// [PartitionOffset].
+static
+void WriteHeader(std::ostream *File,
+                 unsigned int CodeLength,
+                 unsigned int ZeroLength,
+                 unsigned int MemorySize,
+                 unsigned int Encoding,
+                 unsigned int EncodedSize,
+                 unsigned int SymbolCount,
+                 unsigned int SymbolOffset,
+                 const image_facts *Facts = NULL,
+                 unsigned int PartitionOffset = 0)
+{
+    image_header Header = { };
+
+    std::memcpy(Header.Magic, ImageMagic, sizeof(Header.Magic));
+    Header.Version      = IMAGE_VERSION;
+    Header.ByteOrder    = HostByteOrder();
+    Header.CellWidth    = sizeof(int);
+    Header.Entry        = 0;
+    Header.MemorySize   = CodeLength + ZeroLength > MemorySize ?
+                          CodeLength + ZeroLength :
+                          MemorySize;
+    Header.CodeLength   = CodeLength;
+    Header.ZeroLength   = ZeroLength;
+    Header.SymbolCount  = SymbolCount;
+    Header.SymbolOffset = SymbolCount ? SymbolOffset : 0;
+    Header.Encoding     = Encoding;
+    Header.EncodedSize  = EncodedSize;
+
+    if (Facts)
+    {
+        Header.Facts     = Facts->Facts;
+        Header.CodeStart = Facts->CodeStart;
+        Header.CodeEnd   = Facts->CodeEnd;
+
+        if (Facts->Facts & IMAGE_STATIC)
+            Header.PartitionOffset = PartitionOffset;
+    }
+
+    File->write((char *)&Header, sizeof(Header));
+}
+
+// WriteImage() writes the [Length] cells of [Program] to [File] as an image
+// asking for [MemorySize] cells of memory, packing the code if [Packed]. If
+// [TrimZeros], the zeros at the end of the program are left to the loader. If
+// [Facts] or [Labels] are given, they're written along with it.
+static inline
+void WriteImage(std::ostream *File,
+                const int *Program,
+                unsigned int Length,
+                unsigned int MemorySize,
+                bool TrimZeros,
+                bool Packed,
+                const image_facts *Facts,
+                symbol_table *Labels)
+{
+    unsigned int CodeLength = Length;
+
+    while (TrimZeros && CodeLength && Program[CodeLength - 1] == 0)
+        CodeLength--;
+
+    unsigned int SymbolCount = 0;
+
+    for (unsigned int i = 0; Labels && i < Labels->Symbols.Length; i++)
+        SymbolCount += Labels->Symbols[i].Defined;
+
+    buffer<unsigned char> Code = { };
+
+    if (Packed)
+        Pack(Program, CodeLength, &Code);
+
+    unsigned int EncodedSize = Packed ? Code.Length : sizeof(int) * CodeLength;
+    unsigned int PartitionLength = Facts ? Facts->Partition.Length : 0;
+
+    WriteHeader(File,
+                CodeLength,
+                Length - CodeLength,
+                MemorySize,
+                Packed ? IMAGE_PACKED : IMAGE_CELLS,
+                EncodedSize,
+                SymbolCount,
+                sizeof(image_header) + EncodedSize + PartitionLength,
+                Facts,
+                sizeof(image_header) + EncodedSize);
+
+    if (Packed)
+        File->write((char *)Code.Data, Code.Length);
+    else
+        File->write((char *)Program, sizeof(int) * CodeLength);
+
+    if (PartitionLength)
+        File->write((char *)Facts->Partition.Data, PartitionLength);
+
+    Empty<unsigned char>(&Code);
+
+    for (unsigned int i = 0; SymbolCount && i < Labels->Symbols.Length; i++)
+    {
+        const symbol *Symbol = &Labels->Symbols[i];
+
+        if (!Symbol->Defined)
+            continue;
+
+        uint32_t Fields[2] = { Symbol->Address, Symbol->NameLength };
+
+        File->write((char *)Fields, sizeof(Fields));
+        File->write(SymbolName(Labels, i), Symbol->NameLength);
+    }
+}
+
+
+/** Loading images. */
+
+// CheckHeader() returns whether [Header], byte swapped into our order
+// already, describes a valid image of [FileSize] bytes, reporting what's
+// wrong with it if not.
+static
+bool CheckHeader(const image_header *Header, uint64_t FileSize)
+{
+    uint64_t CodeEnd = IMAGE_HEADER_SIZE + (uint64_t)Header->EncodedSize;
+    uint64_t PartitionEnd = (uint64_t)Header->PartitionOffset +
+                            PartitionSize(Header->CodeStart, Header->CodeEnd);
+
+    if (Header->Version != IMAGE_VERSION)
+    {
+        Error("Unsupported image version %u.\n", Header->Version);
+    }
+    else if (Header->Encoding != IMAGE_CELLS &&
+             Header->Encoding != IMAGE_PACKED)
+    {
+        Error("Unknown code encoding %u.\n", Header->Encoding);
+    }
+    else if (Header->Encoding == IMAGE_CELLS &&
+             Header->EncodedSize !=
+             (uint64_t)Header->CellWidth * Header->CodeLength)
+    {
+        Error("The code's size doesn't match its length.\n");
+    }
+    else if (Header->ByteOrder != IMAGE_LITTLE_ENDIAN &&
+             Header->ByteOrder != IMAGE_BIG_ENDIAN)
+    {
+        Error("Unknown byte order %u.\n", Header->ByteOrder);
+    }
+    else if (Header->CellWidth != sizeof(int))
+    {
+        Error("Unsupported cell width of %u bytes.\n", Header->CellWidth);
+    }
+    else if ((uint64_t)Header->CodeLength + Header->ZeroLength >
+             Header->MemorySize)
+    {
+        Error("The image is bigger than the memory it asks for.\n");
+    }
+    else if (CodeEnd > FileSize)
+    {
+        Error("The image is truncated, its code ends past the end of the "
+              "file.\n");
+    }
+    else if (Header->MemorySize && Header->Entry >= Header->MemorySize)
+    {
+        Error("The entry point is outside of memory.\n");
+    }
+    else if ((Header->Facts & IMAGE_STATIC) &&
+             (Header->CodeStart > Header->CodeEnd ||
+              Header->PartitionOffset < CodeEnd || PartitionEnd > FileSize))
+    {
+        Error("The partition is outside of the file.\n");
+    }
+    else if (Header->SymbolCount &&
+             (Header->SymbolOffset < CodeEnd ||
+              Header->SymbolOffset > FileSize ||
+              (uint64_t)8 * Header->SymbolCount >
+              FileSize - Header->SymbolOffset))
+    {
+        Error("The symbol table is outside of the file.\n");
+    }
+    else
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Unload() gives back the memory of [Image].
+static
+void Unload(image *Image)
+{
+#if !defined(_WIN32)
+    if (Image->Mapping)
+        munmap(Image->Mapping, Image->MappingSize);
+#else
+    delete[] Image->Memory;
+#endif
+
+    *Image = { };
+}
+
+// LoadImage() loads the image at [Path] into [Image], checking that it's
+// valid first. Code stored cell by cell is mapped straight from the file where
+// we can, and read otherwise; packed code is unpacked as it's read. Returns
+// ERROR, after saying why, if it can't be loaded.
+static inline
+status_code LoadImage(const char *Path, image *Image)
+{
+    *Image = { };
+
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    if (!File)
+    {
+        Error("Failed to open image \"%s\".\n", Path);
+        return ERROR;
+    }
+
+    File.seekg(0, File.end);
+    uint64_t FileSize = File.tellg();
+    File.seekg(0, File.beg);
+
+    image_header Header = { };
+
+    File.read((char *)&Header,
+              std::min<uint64_t>(FileSize, IMAGE_HEADER_SIZE));
+
+    bool Raw = FileSize < sizeof(ImageMagic) ||
+               std::memcmp(Header.Magic, ImageMagic, sizeof(ImageMagic)) != 0;
+    bool Swapped = !Raw && Header.ByteOrder != HostByteOrder();
+
+    if (Swapped)
+    {
+        Header.Version = (uint16_t)((Header.Version >> 8) |
+                                    (Header.Version << 8));
+    }
+
+    uint64_t Offset = Raw ? 0 : IMAGE_HEADER_SIZE;
+    uint64_t CodeOffset = Offset;
+
+    if (Raw)
+    {
+        if (FileSize % (3 * sizeof(int)) != 0)
+        {
+            Error("Input file size (%llub) is not a multiple of three "
+                  "cells.\n",
+                  (unsigned long long)FileSize);
+            return ERROR;
+        }
+
+        Header = { };
+        Header.ByteOrder   = HostByteOrder();
+        Header.CellWidth   = sizeof(int);
+        Header.CodeLength  = FileSize / sizeof(int);
+        Header.MemorySize  = Header.CodeLength;
+        Header.Encoding    = IMAGE_CELLS;
+        Header.EncodedSize = FileSize;
+    }
+
+    if (Swapped)
+    {
+        uint32_t *Fields[] = {
+            &Header.Entry, &Header.MemorySize, &Header.CodeLength,
+            &Header.ZeroLength, &Header.SymbolCount, &Header.SymbolOffset,
+            &Header.Encoding, &Header.EncodedSize, &Header.Facts,
+            &Header.CodeStart, &Header.CodeEnd, &Header.PartitionOffset
+        };
+
+        for (uint32_t *Field : Fields)
+            *Field = Swap(*Field);
+    }
+
+    if (!Raw && (FileSize < Offset || !CheckHeader(&Header, FileSize)))
+    {
+        if (FileSize < Offset)
+            Error("The image is truncated, its header is incomplete.\n");
+
+        return ERROR;
+    }
+
+    bool Packed = Header.Encoding == IMAGE_PACKED;
+
+    // NOTE Packed code is unpacked into fresh memory, not mapped, so
+    // there's no header in front of it.
+    if (Packed)
+        Offset = 0;
+
+    uint64_t CodeSize = Packed ? 0 : sizeof(int) * (uint64_t)Header.CodeLength;
+    uint64_t Size = Offset + sizeof(int) * (uint64_t)Header.MemorySize;
+
+#if !defined(_WIN32)
+    // Map anonymous memory for all of it, then the file over the start of
+    // it. Both are private, so the program can write to its own cells.
+    int Descriptor = open(Path, O_RDONLY);
+
+    if (Descriptor < 0)
+    {
+        Error("Failed to open image \"%s\".\n", Path);
+        return ERROR;
+    }
+
+    uint64_t PageSize = sysconf(_SC_PAGESIZE);
+    uint64_t CodeEnd = Offset + CodeSize;
+
+    int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_POPULATE)
+    // NOTE We're about to write every cell of packed code, and faulting
+    // the pages in all at once is a lot cheaper than one at a time.
+    if (Packed)
+        Flags |= MAP_POPULATE;
+#endif
+
+    Image->MappingSize = Size ? Size : 1;
+    Image->Mapping = mmap(NULL,
+                          Image->MappingSize,
+                          PROT_READ | PROT_WRITE,
+                          Flags,
+                          -1,
+                          0);
+
+    if (Image->Mapping != MAP_FAILED && CodeSize &&
+        mmap(Image->Mapping,
+             CodeEnd,
+             PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED,
+             Descriptor,
+             0) == MAP_FAILED)
+    {
+        munmap(Image->Mapping, Image->MappingSize);
+        Image->Mapping = MAP_FAILED;
+    }
+
+    close(Descriptor);
+
+    if (Image->Mapping == MAP_FAILED)
+    {
+        Error("Failed to map image \"%s\".\n", Path);
+        *Image = { };
+        return ERROR;
+    }
+
+    // NOTE The file is mapped a page at a time, so whatever follows the
+    // code in its last page, like the symbol table, has to be zeroed.
+    uint64_t PageEnd = (CodeEnd + PageSize - 1) / PageSize * PageSize;
+    uint64_t FileEnd = FileSize < PageEnd ? FileSize : PageEnd;
+
+    if (CodeSize && FileEnd > CodeEnd)
+        std::memset((char *)Image->Mapping + CodeEnd, 0, FileEnd - CodeEnd);
+
+    Image->Memory = (int *)((char *)Image->Mapping + Offset);
+#else
+    Image->Memory = new int[Header.MemorySize ? Header.MemorySize : 1]();
+
+    File.seekg(Offset, File.beg);
+    File.read((char *)Image->Memory, CodeSize);
+#endif
+
+    Image->MemorySize = Header.MemorySize;
+    Image->Entry = Header.Entry;
+
+    if (Packed)
+    {
+        File.clear();
+        File.seekg(CodeOffset, File.beg);
+
+        if (Unpack(&File,
+                   Header.EncodedSize,
+                   Image->Memory,
+                   Header.CodeLength) != OK)
+        {
+            Error("The image's packed code is corrupt.\n");
+            Unload(Image);
+            return ERROR;
+        }
+    }
+    else if (Swapped)
+    {
+        for (unsigned int i = 0; i < Header.CodeLength; i++)
+            Image->Memory[i] = (int)Swap((uint32_t)Image->Memory[i]);
+    }
+
+    // NOTE The partition is only a claim, so it has to hold up against
+    // the code we actually loaded. If it doesn't, the program still runs,
+    // just without anyone relying on it.
+    if (Header.Facts & IMAGE_STATIC)
+    {
+        buffer<unsigned char> Partition = { };
+        unsigned int Size = PartitionSize(Header.CodeStart, Header.CodeEnd);
+
+        Reserve<unsigned char>(&Partition, Size);
+        Partition.Length = Size;
+
+        File.clear();
+        File.seekg(Header.PartitionOffset, File.beg);
+
+        Image->Static = File.read((char *)Partition.Data, Size) &&
+                        VerifyPartition(Image->Memory,
+                                        Image->MemorySize,
+                                        Image->Entry,
+                                        Header.CodeStart,
+                                        Header.CodeEnd,
+                                        Partition.Data);
+
+        if (Image->Static)
+        {
+            Image->CodeStart = Header.CodeStart;
+            Image->CodeEnd   = Header.CodeEnd;
+        }
+
+        Empty<unsigned char>(&Partition);
+    }
+
+    return OK;
+}
+
+// FindSymbol() looks up the address of the label called [Name] in the symbol
+// table of the image at [Path]. Returns ERROR if the image has no such
+// symbol, or no symbol table at all.
+static inline
+status<unsigned int> FindSymbol(const char *Path, const char *Name)
+{
+    status<unsigned int> Result = { ERROR, 0 };
+
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    image_header Header = { };
+
+    if (!File.read((char *)&Header, IMAGE_HEADER_SIZE) ||
+        std::memcmp(Header.Magic, ImageMagic, sizeof(ImageMagic)) != 0)
+    {
+        return Result;
+    }
+
+    bool Swapped = Header.ByteOrder != HostByteOrder();
+
+    if (Swapped)
+    {
+        Header.SymbolCount  = Swap(Header.SymbolCount);
+        Header.SymbolOffset = Swap(Header.SymbolOffset);
+    }
+
+    size_t NameLength = std::strlen(Name);
+    buffer<char> Candidate = { };
+
+    File.seekg(Header.SymbolOffset, File.beg);
+
+    for (unsigned int i = 0; i < Header.SymbolCount; i++)
+    {
+        uint32_t Fields[2];
+
+        if (!File.read((char *)Fields, sizeof(Fields)))
+            break;
+
+        if (Swapped)
+        {
+            Fields[0] = Swap(Fields[0]);
+            Fields[1] = Swap(Fields[1]);
+        }
+
+        if (Fields[1] != NameLength)
+        {
+            File.seekg(Fields[1], File.cur);
+            continue;
+        }
+
+        Reserve<char>(&Candidate, NameLength + 1);
+
+        if (!File.read(Candidate.Data, NameLength))
+            break;
+
+        if (std::memcmp(Candidate.Data, Name, NameLength) == 0)
+        {
+            Result = { OK, Fields[0] };
+            break;
+        }
+    }
+
+    Empty<char>(&Candidate);
+
+    return Result;
+}
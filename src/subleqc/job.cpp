@@ -0,0 +1,180 @@
+/**
+ * @file job.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the protocol the emulator speaks when it's serving jobs
+ * (see serve.cpp), shared with its client (see src/subleq-client).
+ *
+ * A client connects to the server's Unix domain socket and sends one request,
+ * a line for each thing it asks for, ending with an empty line:
+ *
+ *     run <image>                 the image to run, by its full path
+ *     input <address> <cell>...   cells to write before it runs
+ *     budget <count>              the most instructions it may run
+ *     checked                     run it on the checked engine
+ *
+ * Only "run" is needed. The input's address can also be the name of a label
+ * in the image's symbol table. A request of just "stats" asks for the
+ * server's statistics instead, which it sends as they are.
+ *
+ * The server answers a job with what the program prints, as it prints it,
+ * and then a line with how it went: "=", how the program stopped, how many
+ * instructions it ran, and how many microseconds the job took in all. A job
+ * that can't run gets a line of "!" and why instead. The program only ever
+ * prints numbers, so neither line can be mistaken for its output.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sstream>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+
+
+// Where the server listens if it isn't told otherwise.
+#define DEFAULT_SOCKET_PATH "/tmp/subleq.sock"
+
+// As many instructions as a job can ask for.
+#define NO_JOB_BUDGET (~0ull)
+
+
+struct job {
+    // Whether this is a request for statistics rather than a job.
+    bool Stats;
+    std::string ImagePath;
+    // Where to write the input, an address or a label, if there is any.
+    std::string InputAddress;
+    buffer<int> Input;
+    unsigned long long Budget;
+    bool Checked;
+};
+
+
+// Empty() frees all the memory held by [Job].
+static
+void Empty(job *Job)
+{
+    Empty<int>(&Job->Input);
+    *Job = { };
+}
+
+// ReadJob() reads a request from [File] into [Job]. Returns ERROR, with
+// [Reason] set to why, if it isn't a request.
+static inline
+status_code ReadJob(FILE *File, job *Job, const char **Reason)
+{
+    *Job = { };
+    Job->Budget = NO_JOB_BUDGET;
+
+    char Line[4096];
+    std::string Request;
+
+    // NOTE Input lines can be longer than any one read, so lines are
+    // put back together before they're looked at.
+    while (fgets(Line, sizeof(Line), File))
+    {
+        Request += Line;
+
+        if (Request.back() != '\n')
+            continue;
+
+        Request.pop_back();
+
+        if (Request.empty())
+            break;
+
+        std::istringstream Fields (Request);
+        std::string Keyword;
+        long long Value;
+        bool Valid = false;
+
+        Fields >> Keyword;
+
+        if (Keyword == "run")
+        {
+            Valid = (bool)(Fields >> Job->ImagePath);
+        }
+        else if (Keyword == "input" && Job->InputAddress.empty())
+        {
+            Valid = (bool)(Fields >> Job->InputAddress);
+
+            while (Valid && Fields >> Value)
+                Append<int>(&Job->Input, (int)Value);
+        }
+        else if (Keyword == "budget")
+        {
+            Valid = (bool)(Fields >> Job->Budget);
+        }
+        else if (Keyword == "checked")
+        {
+            Job->Checked = Valid = true;
+        }
+        else if (Keyword == "stats")
+        {
+            Job->Stats = Valid = true;
+        }
+
+        // NOTE Whatever's left of the line has to be blank, which also
+        // catches input that isn't all numbers.
+        if (!Valid || !(Fields >> std::ws).eof())
+        {
+            *Reason = "Not a request.";
+            return ERROR;
+        }
+
+        Request.clear();
+    }
+
+    if (!Request.empty())
+    {
+        *Reason = "The request never ended.";
+        return ERROR;
+    }
+
+    if (!Job->Stats && Job->ImagePath.empty())
+    {
+        *Reason = "There's no image to run.";
+        return ERROR;
+    }
+
+    return OK;
+}
+
+// WriteJob() writes [Job] to [File] as a request.
+static inline
+void WriteJob(FILE *File, const job *Job)
+{
+    if (Job->Stats)
+    {
+        fprintf(File, "stats\n\n");
+        return;
+    }
+
+    fprintf(File, "run %s\n", Job->ImagePath.c_str());
+
+    if (!Job->InputAddress.empty())
+    {
+        fprintf(File, "input %s", Job->InputAddress.c_str());
+
+        for (unsigned int i = 0; i < Job->Input.Length; i++)
+            fprintf(File, " %d", Job->Input.Data[i]);
+
+        fprintf(File, "\n");
+    }
+
+    if (Job->Budget != NO_JOB_BUDGET)
+        fprintf(File, "budget %llu\n", Job->Budget);
+
+    if (Job->Checked)
+        fprintf(File, "checked\n");
+
+    fprintf(File, "\n");
+}
@@ -0,0 +1,356 @@
+/**
+ * @file layout.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file lays a linked program out by an execution profile, so that the
+ * instructions that run the most, and the cells they touch, sit next to each
+ * other instead of being spread out between cold code.
+ *
+ * The program is cut into units that can be moved without changing what it
+ * does. Instructions that can run are grouped into chains: an instruction
+ * that can go on to the next one is in the same chain as it, so nothing ever
+ * falls out of a chain into whatever ends up after it. Every instruction that
+ * can't run is a unit of its own, which holds data. Chains are then placed
+ * hottest first, each followed by the data it touches, and everything else
+ * keeps its order after them. The operands of running instructions are
+ * relocated to match, the same way the optimizer relocates them.
+ *
+ * A profile has a line for every address the emulator ran an instruction at,
+ * with how many times it did, as written by `subleq --profile`. Blank lines
+ * and lines starting with '#' are ignored.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "symbol.cpp"
+#include "analysis.cpp"
+
+
+#define NO_UNIT 0xFFFFFFFF
+
+
+struct layout_unit {
+    // The first word of the unit, and how many words it has.
+    unsigned int Start;
+    unsigned int Length;
+    // How many times its instructions ran, or for data, how many times
+    // instructions read or wrote it.
+    unsigned long long Heat;
+    bool Code;
+};
+
+
+// LoadProfile() reads the counts in the profile at [Path] into [Counts], one
+// for every word of a program [Length] words long, reporting the lines it
+// can't make sense of. Returns ERROR if the profile can't be read.
+static
+status_code LoadProfile(const char *Path,
+                        unsigned int Length,
+                        buffer<unsigned long long> *Counts)
+{
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    if (!File)
+        return ERROR;
+
+    Reserve<unsigned long long>(Counts, Length);
+    Counts->Length = Length;
+    std::fill(Counts->Data, Counts->Data + Length, 0);
+
+    std::string Line;
+    unsigned int LineNumber = 0;
+
+    while (std::getline(File, Line))
+    {
+        LineNumber++;
+
+        std::istringstream Fields (Line);
+
+        long long Address;
+        unsigned long long Count;
+        std::string Rest;
+
+        if (!(Fields >> Rest) || Rest[0] == '#')
+            continue;
+
+        Fields.clear();
+        Fields.seekg(0);
+
+        if (!(Fields >> Address >> Count) || (Fields >> Rest))
+        {
+            Warning("%s:%u: Not an address and a count, skipping it.\n",
+                    Path,
+                    LineNumber);
+        }
+        else if (Address < 0 || Address >= Length)
+        {
+            Warning("%s:%u: Address %lld is outside of the program, skipping "
+                    "it.\n",
+                    Path,
+                    LineNumber,
+                    Address);
+        }
+        else
+        {
+            (*Counts)[Address] += Count;
+        }
+    }
+
+    return OK;
+}
+
+// Layout() reorders [Program] in place so that the instructions [Counts] says
+// ran the most come first, next to the cells they touch, moving the addresses
+// of [Labels] along with them if they're given. Returns how many words moved.
+static
+unsigned int Layout(buffer<int> *Program,
+                    const buffer<unsigned long long> *Counts,
+                    symbol_table *Labels)
+{
+    unsigned int Length = Program->Length;
+    unsigned int Count  = Length / 3;
+
+    int *Words = Program->Data;
+    const unsigned long long *Runs = Counts->Data;
+
+    if (Count == 0)
+        return 0;
+
+    buffer<unsigned char> Cells = { };
+    buffer<unsigned char> Reachable = { };
+
+    // NOTE The assembler only ever emits whole instructions, so a
+    // program that isn't one came from somewhere we don't know about.
+    if (!Analyze(Program, &Cells, &Reachable) || Length % 3 != 0)
+    {
+        Info("Not laying out the program, it modifies its own code.\n");
+
+        Empty<unsigned char>(&Cells);
+        Empty<unsigned char>(&Reachable);
+
+        return 0;
+    }
+
+
+    /** Cut the program into units. */
+
+    buffer<layout_unit> Units = { };
+
+    // The unit every word is in.
+    buffer<unsigned int> UnitOf = { };
+    Reserve<unsigned int>(&UnitOf, Length);
+    UnitOf.Length = Length;
+
+    bool Mismatched = false;
+
+    for (unsigned int i = 0; i < Count; )
+    {
+        layout_unit Unit = { 3 * i, 0, 0, Reachable[i] != 0 };
+
+        for (bool More = true; More; i++)
+        {
+            Unit.Length += 3;
+
+            if (Reachable[i])
+                Unit.Heat += Runs[3 * i];
+            else
+                Mismatched |= Runs[3 * i] != 0;
+
+            Mismatched |= Runs[3 * i + 1] || Runs[3 * i + 2];
+
+            // Only an instruction that always jumps ends a chain.
+            More = Reachable[i] &&
+                   Words[3 * i + 0] != Words[3 * i + 1] &&
+                   i + 1 < Count;
+        }
+
+        for (unsigned int j = Unit.Start; j < Unit.Start + Unit.Length; j++)
+            UnitOf[j] = Units.Length;
+
+        Append<layout_unit>(&Units, Unit);
+    }
+
+    if (Mismatched)
+    {
+        Warning("The profile has counts for instructions that can't run, it "
+                "may be for a different program.\n");
+    }
+
+    // Data is as hot as the instructions that touch it.
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        if (!Reachable[i])
+            continue;
+
+        for (unsigned int j = 0; j < 2; j++)
+        {
+            layout_unit &Unit = Units[UnitOf[Words[3 * i + j]]];
+
+            if (!Unit.Code)
+                Unit.Heat += Runs[3 * i];
+        }
+    }
+
+    // Operands that are also read as data can't change, so neither can
+    // anything they point at, nor anything before that. The first chain is
+    // where the program starts, so it stays where it is.
+    unsigned int Pinned = Units[0].Length;
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        if ((Cells[i] & CELL_CODE) && (Cells[i] & CELL_DATA) &&
+            IsAddress(Words[i], Length))
+        {
+            layout_unit &Unit = Units[UnitOf[Words[i]]];
+            Pinned = std::max(Pinned, Unit.Start + Unit.Length);
+        }
+    }
+
+    // A chain that falls off the end of the program has to stay at the end.
+    unsigned int Last = NO_UNIT;
+
+    if (Reachable[Count - 1] && Words[Length - 3] != Words[Length - 2] &&
+        Units[Units.Length - 1].Start >= Pinned)
+    {
+        Last = Units.Length - 1;
+    }
+
+
+    /** Place the units. */
+
+    buffer<unsigned int> Order = { };
+    Reserve<unsigned int>(&Order, Units.Length);
+
+    buffer<unsigned char> Placed = { };
+    Reserve<unsigned char>(&Placed, Units.Length);
+    Placed.Length = Units.Length;
+    std::fill(Placed.Data, Placed.Data + Units.Length, 0);
+
+    auto Place = [&](unsigned int Unit)
+    {
+        if (!Placed[Unit] && Unit != Last)
+        {
+            Append<unsigned int>(&Order, Unit);
+            Placed[Unit] = true;
+        }
+    };
+
+    for (unsigned int i = 0; i < Units.Length && Units[i].Start < Pinned; i++)
+        Place(i);
+
+    buffer<unsigned int> Hot = { };
+
+    for (unsigned int i = 0; i < Units.Length; i++)
+    {
+        if (Units[i].Code && Units[i].Heat)
+            Append<unsigned int>(&Hot, i);
+    }
+
+    std::stable_sort(Hot.Data, Hot.Data + Hot.Length,
+                     [&](unsigned int X, unsigned int Y)
+                     {
+                         return Units[X].Heat > Units[Y].Heat;
+                     });
+
+    for (unsigned int i = 0; i < Hot.Length; i++)
+    {
+        const layout_unit &Chain = Units[Hot[i]];
+
+        Place(Hot[i]);
+
+        // The data the chain touches goes right after it, in the order the
+        // chain touches it.
+        for (unsigned int j = Chain.Start; j < Chain.Start + Chain.Length; j++)
+        {
+            if (j % 3 == 2)
+                continue;
+
+            unsigned int Unit = UnitOf[Words[j]];
+
+            if (!Units[Unit].Code && Units[Unit].Heat)
+                Place(Unit);
+        }
+    }
+
+    for (unsigned int i = 0; i < Units.Length; i++)
+        Place(i);
+
+    if (Last != NO_UNIT)
+        Append<unsigned int>(&Order, Last);
+
+    Empty<unsigned int>(&Hot);
+    Empty<unsigned char>(&Placed);
+
+
+    /** Move the units, and relocate the operands. */
+
+    // The new address of every word, and of the end of the program.
+    buffer<unsigned int> NewAddress = { };
+    Reserve<unsigned int>(&NewAddress, Length + 1);
+    NewAddress.Length = Length + 1;
+    NewAddress[Length] = Length;
+
+    unsigned int Address = 0;
+    unsigned int MovedCount = 0;
+
+    for (unsigned int i = 0; i < Order.Length; i++)
+    {
+        const layout_unit &Unit = Units[Order[i]];
+
+        for (unsigned int j = 0; j < Unit.Length; j++)
+        {
+            NewAddress[Unit.Start + j] = Address;
+            MovedCount += Unit.Start + j != Address;
+            Address++;
+        }
+    }
+
+    buffer<int> Output = { };
+    Reserve<int>(&Output, Length);
+    Output.Length = Length;
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        int Value = Words[i];
+
+        if ((Cells[i] & CELL_CODE) && 0 <= Value &&
+            (unsigned int)Value <= Length)
+        {
+            Value = NewAddress[Value];
+        }
+
+        Output[NewAddress[i]] = Value;
+    }
+
+    std::copy(Output.Data, Output.Data + Length, Words);
+
+    for (unsigned int i = 0; Labels && i < Labels->Symbols.Length; i++)
+    {
+        unsigned int &Address = Labels->Symbols[i].Address;
+
+        if (Address <= Length)
+            Address = NewAddress[Address];
+    }
+
+    Empty<int>(&Output);
+    Empty<unsigned int>(&NewAddress);
+    Empty<unsigned int>(&Order);
+    Empty<unsigned int>(&UnitOf);
+    Empty<layout_unit>(&Units);
+    Empty<unsigned char>(&Reachable);
+    Empty<unsigned char>(&Cells);
+
+    return MovedCount;
+}
+
+#undef NO_UNIT
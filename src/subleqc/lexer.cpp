@@ -5,274 +5,230 @@
  *
  * This file contains all the definitions for the funcionality of the SUBLEQC
  * lexer.
+ *
+ * The lexer is a single-pass state machine: every byte of the source is looked
+ * at exactly once, and tokens are handed back as (offset, length) views into
+ * the source rather than as copies.
  */
 
 #pragma once
 
 
-/* C Standard Libraries. */
-#include <algorithm>
-
 /* Own Libraries. */
 #include "token.cpp"
-#include "stack.cpp"
+#include "scan.cpp"
 
 
 /* Structs */
 
 struct lexer {
-    char *Source;
+    const char *Source;
+    unsigned int SourceLength;
     unsigned int Cursor;
+    // The line-start index built by IndexLines(), used to give tokens their
+    // line and column.
+    const unsigned int *LineStarts;
+    unsigned int LineCount;
     unsigned int LineNumber;
-    unsigned int ColumnNumber;
 };
 
 
 /* Functions */
 
 /**
- * Peeks at the character currently under the [Lexer]'s cursor.
+ * Checks if the given [Character] is classified as a digit.
  */
 static inline
-char PeekCursor(lexer *Lexer)
+bool IsDigit(const char Character)
 {
-    return Lexer->Source[Lexer->Cursor];
+    return Character >= '0' && Character <= '9';
 }
 
 /**
- * Peeks at the character immediately following the [Lexer]'s cursor.
+ * Checks if the given [Character] is classified as a sign.
  */
 static inline
-char PeekNextCursor(lexer *Lexer)
+bool IsSign(const char Character)
 {
-    // If we are at the end of the source, don't read past it.
-    if (PeekCursor(Lexer) == '\0')
-        return '\0';
-
-    else
-        return Lexer->Source[Lexer->Cursor + 1];
+    return Character == '-' || Character == '+';
 }
 
 /**
- * Advances the [Lexer]'s cursor a single character and increments the
- * [Lexer]'s column number, returning the character under the moved cursor. It
- * additionaly checks the character it's advancing the cursor from. If the
- * character is a newline, it increments the [Lexer]'s line number and resets
- * the column number to zero. If the character is a null terminator, it doesn't
- * advance the cursor.
+ * Converts the [Text] of a NUMBER token into its integer value. The text is
+ * expected to have already been recognized as a number by the lexer.
  */
-static inline // NOTE[joe] Maybe not inline?
-char AdvanceCursor(lexer *Lexer)
+static
+int ParseNumber(const char *Text, unsigned int TextLength)
 {
-    char CurrentCharacter = PeekCursor(Lexer);
-
-    if (CurrentCharacter == '\n')
-    {
-        ++Lexer->LineNumber;
-        Lexer->ColumnNumber = 0;
-    }
+    unsigned int i = 0;
+    bool Negative = false;
 
-    if (CurrentCharacter != '\0')
+    if (IsSign(Text[0]))
     {
-        ++Lexer->Cursor;
-        ++Lexer->ColumnNumber;
+        Negative = Text[0] == '-';
+        i++;
     }
 
-    return PeekCursor(Lexer);
-}
+    // NOTE We accumulate unsigned so that overflow wraps instead of
+    // being undefined, which matches what atoi() did for us in practice.
+    unsigned int Value = 0;
 
-/**
- * Checks if the given [Character] is classified as ignorable whitespace.
- */
-static
-bool IsWhitespace(const char Character)
-{
-    char WhitespaceSet[] = { ' ', '\t', '\r' };
+    for (; i < TextLength; i++)
+        Value = Value * 10 + (unsigned int)(Text[i] - '0');
 
-    for (unsigned int i = 0; i < sizeof(WhitespaceSet); i++)
-    {
-        if (WhitespaceSet[i] == Character)
-            return true;
-    }
-
-    return false;
+    return (int)(Negative ? 0u - Value : Value);
 }
 
 /**
- * Checks if the given [Character] is classified as a digit.
+ * Uses the given [Lexer] to produce a token. Once the source is exhausted,
+ * the returned token has the type NONE.
  */
 static
-bool IsDigit(const char Character)
+token NextToken(lexer *Lexer)
 {
-    int DecimalValue = (int) Character;
-    return DecimalValue >= 48 && DecimalValue <= 57;
-}
+    token Token = { };
 
-/**
- * Checks if the given [Character] is classified as a sign.
- */
-static
-bool IsSign(const char Character)
-{
-    return Character == '-' || Character == '+';
-}
+    const char *Source = Lexer->Source;
+    unsigned int End = Lexer->SourceLength;
+    unsigned int Cursor = Lexer->Cursor;
 
-/**
- * Checks if the given [Text] classifies as a number.
- */
-static
-bool IsNumber(const char* Text, unsigned int TextLength)
-{
-    if (!IsSign(Text[0]) && !IsDigit(Text[0]))
-        return false;
+    while (Cursor < End && IsWhitespace(Source[Cursor]))
+        Cursor++;
 
-    for (int i = 1; i < TextLength; i++)
+    if (Cursor == End)
     {
-        if (!IsDigit(Text[i]))
-            return false;
+        Lexer->Cursor = Cursor;
+        return Token;
     }
 
-    return true;
-}
-
-/**
- * Checks if the given [Text] classifies as a question mark.
- */
-static
-bool IsQuestionMark(const char* Text, unsigned int TextLength)
-{
-    return TextLength == 1 && Text[0] == '?';
-}
+#define LEXER_STATES \
+    _(START) \
+    _(SIGN) \
+    _(NUMBER) \
+    _(QMARK) \
+    _(IDENT) \
+    _(DIRECTIVE) \
 
-/**
- * Checks if the given [Text] classifies as a comma.
- */
-static
-bool IsComma(const char* Text, unsigned int TextLength)
-{
-    return TextLength == 1 && Text[0] == ',';
-}
+    enum lexer_state {
+#define _(S) LEXER_STATE_##S,
+        LEXER_STATES
+#undef _
+    } LexerState = LEXER_STATE_START;
 
-/**
- * Checks if the given [Text] classifies as an end-of-line (EOL).
- */
-static
-bool IsEOL(const char* Text, unsigned int TextLength)
-{
-    return TextLength == 1 &&
-           (Text[0] == '\n' || Text[0] == ';');
-}
+#define TransitionTo(S) LexerState = LEXER_STATE_##S
 
-static
-bool IsIdentifier(const char* Text, unsigned int TextLength)
-{
-    for (unsigned int i = 0; i < TextLength; i++)
+    while (Lexer->LineNumber + 1 < Lexer->LineCount &&
+           Lexer->LineStarts[Lexer->LineNumber + 1] <= Cursor)
     {
-        if (Text[i] == ',' ||
-            Text[i] == ':' ||
-            IsEOL(&Text[i], 1) ||
-            IsWhitespace(Text[i]))
-        {
-            return false;
-        }
+        Lexer->LineNumber++;
     }
 
-    return true;
-}
+    Token.Offset     = Cursor;
+    Token.LineNumber = Lexer->LineNumber;
+    Token.Column     = Cursor - Lexer->LineStarts[Lexer->LineNumber];
 
-static
-bool IsLabel(const char* Text, unsigned int TextLength)
-{
-    return IsIdentifier(Text, TextLength - 1) &&
-           Text[TextLength - 1] == ':';
-}
+    // Single character tokens never enter the state machine.
+    char Character = Source[Cursor];
 
-/**
- * Checks if the given [Text] matches any of the known token types. If it does
- * not, the type is reported to be INVALID.
- */
-static inline
-token_type CheckTokenType(const char *Text, unsigned int TextLength)
-{
-#define Match(F,T)  if (Is##F(Text, TextLength)) return T;
-
-    Match(Number, NUMBER)
-    else Match(QuestionMark, QMARK)
-    else Match(Comma, COMMA)
-    else Match(EOL, EOL)
-    else Match(Identifier, IDENT)
-    else Match(Label, LABEL)
-    else
+    if (Character == ',' || IsEOL(Character) || Character == ':')
     {
-        return INVALID;
-    }
-}
-
-/**
- * Uses the given [Lexer] to produce a token.
- */
-static
-token NextToken(lexer *Lexer)
-{
-    token       Token = { };
-    stack<char> Stack = { };
-
-    token_type CurrentType = NONE;
-    token_type    NextType = NONE;
+        Token.Type   = Character == ',' ? COMMA :
+                       Character == ':' ? INVALID : EOL;
+        Token.Length = 1;
 
+        Lexer->Cursor = Cursor + 1;
+        return Token;
+    }
 
-    for (char Character = PeekCursor(Lexer);
-         Character != '\0';
-         Character = AdvanceCursor(Lexer))
+    for (; Cursor < End; Cursor++)
     {
-        if (IsWhitespace(Character))
-            continue;
+        Character = Source[Cursor];
 
+        if (IsDelimiter(Character))
+            break;
 
-        Push<char>(&Stack, Character);
-        CurrentType = CheckTokenType(Stack.Data, Stack.Length);
+        // NOTE A sign starts a token, but ends any other token, so that
+        // "label+4" is three tokens.
+        if (IsSign(Character) && LexerState != LEXER_STATE_START)
+            break;
 
-        char NextCharacter = PeekNextCursor(Lexer);
+        switch (LexerState)
+        {
+            case LEXER_STATE_START:
+            {
+                if (IsSign(Character))       TransitionTo(SIGN);
+                else if (IsDigit(Character)) TransitionTo(NUMBER);
+                else if (Character == '?')   TransitionTo(QMARK);
+                else if (Character == '.')   TransitionTo(DIRECTIVE);
+                else                         TransitionTo(IDENT);
+            } break;
+
+            case LEXER_STATE_SIGN:
+            {
+                if (IsDigit(Character)) TransitionTo(NUMBER);
+            } break;
+
+            case LEXER_STATE_NUMBER:
+            {
+                if (IsDigit(Character)) TransitionTo(NUMBER);
+                else                    TransitionTo(IDENT);
+            } break;
+
+            case LEXER_STATE_QMARK:
+            {
+                TransitionTo(IDENT);
+            } break;
+
+            case LEXER_STATE_IDENT:
+            case LEXER_STATE_DIRECTIVE:
+            {
+                Unreachable();
+            } break;
+        }
 
-        Push<char>(&Stack, NextCharacter);
-        NextType = CheckTokenType(Stack.Data, Stack.Length);
+        // A sign that isn't followed by a digit is an operator on its own.
+        if (LexerState == LEXER_STATE_SIGN && Cursor > Token.Offset)
+            break;
 
-        Pop<char>(&Stack);
+        // NOTE Nothing can take us out of IDENT except a delimiter or a
+        // sign, so skip straight to it a block at a time.
+        if (LexerState == LEXER_STATE_IDENT ||
+            LexerState == LEXER_STATE_DIRECTIVE)
+        {
+            Cursor = FindDelimiter(Source, Cursor + 1, End);
+            break;
+        }
+    }
 
+#undef TransitionTo
+#undef LEXER_STATES
 
-        if (NextType == INVALID &&
-            (CurrentType != INVALID || CheckTokenType(&NextCharacter, 1) != INVALID))
+    // Anything directly followed by a colon is a label, and the colon is part
+    // of the label's text.
+    if (Cursor < End && Source[Cursor] == ':')
+    {
+        Token.Type = LABEL;
+        Cursor++;
+    }
+    else
+    {
+        switch (LexerState)
         {
-            std::copy(Stack.Data,
-                      Stack.Data + Stack.Length,
-                      Token.Text);
-
-            // note(jrm): This will cause segfault if the stack is too long!
-            // If the stack length is 32, then we will write to the 32'nd index,
-            // which will be out of bounds for the token text field.
-            // We don't have to worry about anything longer, since that segfault
-            // will happen during the copy executed above.
-            Token.Text[Stack.Length] = '\0';
-
-            Token.Type = CurrentType;
-            Token.LineNumber = Lexer->LineNumber;
-            Token.LastColumn = Lexer->ColumnNumber;
-
-            // NOTE[joe] Empty frees any memory we allocated to [Stack].
-            // To prevent the memory being leaked, we'll use Empty to clean up.
-            Empty<char>(&Stack);
-
-            // NOTE[joe] Since we are exiting immediately after this, we need
-            // to advance the cursor forward, otherwise we'll get stuck in an
-            // infinite loop.
-            //
-            // Speaking from experience on this one...
-            AdvanceCursor(Lexer);
-
-            return Token;
+            case LEXER_STATE_NUMBER:    Token.Type = NUMBER;    break;
+            case LEXER_STATE_QMARK:     Token.Type = QMARK;     break;
+            case LEXER_STATE_SIGN:      Token.Type = OPERATOR;  break;
+            case LEXER_STATE_IDENT:     Token.Type = IDENT;     break;
+            case LEXER_STATE_DIRECTIVE: Token.Type = DIRECTIVE; break;
+
+            default:
+            {
+                Unreachable();
+            } break;
         }
     }
 
+    Token.Length  = Cursor - Token.Offset;
+    Lexer->Cursor = Cursor;
 
     return Token;
 }
@@ -0,0 +1,306 @@
+/**
+ * @file object.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the relocatable object format that `subleqc -c` writes
+ * and subleq-ld links. An object is a program assembled as if it started at
+ * address zero, along with what the linker needs to move it somewhere else:
+ * which words hold addresses within the object (relocations), the labels it
+ * declares (symbols), and the words that refer to labels it doesn't declare
+ * (imports).
+ *
+ *     offset  size  field
+ *          0     4  Magic, "SQO" and a zero byte
+ *          4     2  Version
+ *          6     1  Byte order of every field after it, 1 little or 2 big
+ *          7     1  Cell width in bytes
+ *          8     4  Code length in cells, stored right after the header
+ *         12     4  Relocation count
+ *         16     4  Symbol count
+ *         20     4  Import count
+ *
+ * The code is followed by the relocations, each the 4 byte address of a word
+ * that the object's base address is added to. Then come the symbols, each an
+ * address and the length of a name, 4 bytes each, then the name itself, like
+ * in images. Imports are laid out the same way as symbols, except that the
+ * address is of the word the label's address is added to.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "symbol.cpp"
+#include "image.cpp"
+
+
+#define OBJECT_VERSION 1
+
+struct object_header {
+    char Magic[4];
+    uint16_t Version;
+    uint8_t ByteOrder;
+    uint8_t CellWidth;
+    uint32_t CodeLength;
+    uint32_t RelocationCount;
+    uint32_t SymbolCount;
+    uint32_t ImportCount;
+};
+
+static_assert(sizeof(object_header) == 24,
+              "The header is written to disk as it is.");
+
+static const char ObjectMagic[4] = { 'S', 'Q', 'O', '\0' };
+
+struct object {
+    buffer<int> Code;
+    buffer<unsigned int> Relocations;
+    // Every label the object declares.
+    symbol_table Symbols;
+    // The names of imports point into [File].
+    buffer<reference> Imports;
+    buffer<char> File;
+};
+
+
+// WriteObject() writes the [Length] cells of [Program] to [File] as an
+// object, along with its [Relocations], the labels [Labels] declares and its
+// [Imports].
+static inline
+void WriteObject(std::ostream *File,
+                 const int *Program,
+                 unsigned int Length,
+                 const buffer<unsigned int> *Relocations,
+                 symbol_table *Labels,
+                 const buffer<reference> *Imports)
+{
+    object_header Header = { };
+
+    std::memcpy(Header.Magic, ObjectMagic, sizeof(Header.Magic));
+    Header.Version         = OBJECT_VERSION;
+    Header.ByteOrder       = HostByteOrder();
+    Header.CellWidth       = sizeof(int);
+    Header.CodeLength      = Length;
+    Header.RelocationCount = Relocations->Length;
+    Header.ImportCount     = Imports->Length;
+
+    for (unsigned int i = 0; i < Labels->Symbols.Length; i++)
+        Header.SymbolCount += Labels->Symbols[i].Defined;
+
+    File->write((char *)&Header, sizeof(Header));
+    File->write((char *)Program, sizeof(int) * Length);
+    File->write((char *)Relocations->Data,
+                sizeof(unsigned int) * Relocations->Length);
+
+    for (unsigned int i = 0; i < Labels->Symbols.Length; i++)
+    {
+        const symbol *Symbol = &Labels->Symbols[i];
+
+        if (!Symbol->Defined)
+            continue;
+
+        uint32_t Fields[2] = { Symbol->Address, Symbol->NameLength };
+
+        File->write((char *)Fields, sizeof(Fields));
+        File->write(SymbolName(Labels, i), Symbol->NameLength);
+    }
+
+    for (unsigned int i = 0; i < Imports->Length; i++)
+    {
+        const reference *Import = &Imports->Data[i];
+
+        uint32_t Fields[2] = { Import->Offset, Import->NameLength };
+
+        File->write((char *)Fields, sizeof(Fields));
+        File->write(Import->Name, Import->NameLength);
+    }
+}
+
+// Empty() frees all the memory held by [Object].
+static
+void Empty(object *Object)
+{
+    Empty<int>(&Object->Code);
+    Empty<unsigned int>(&Object->Relocations);
+    Empty(&Object->Symbols);
+    Empty<reference>(&Object->Imports);
+    Empty<char>(&Object->File);
+}
+
+// LoadObject() reads the object at [Path] into [Object], checking that
+// everything in it is where it says it is. Returns ERROR, after saying why,
+// if it can't be loaded.
+static inline
+status_code LoadObject(const char *Path, object *Object)
+{
+    *Object = { };
+
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    if (!File)
+    {
+        Error("Failed to open object \"%s\".\n", Path);
+        return ERROR;
+    }
+
+    File.seekg(0, File.end);
+    uint64_t FileSize = File.tellg();
+    File.seekg(0, File.beg);
+
+    Reserve<char>(&Object->File, FileSize);
+    Object->File.Length = FileSize;
+    File.read(Object->File.Data, FileSize);
+
+    const char *Data = Object->File.Data;
+    uint64_t Cursor = sizeof(object_header);
+
+    object_header Header = { };
+
+    if (FileSize >= sizeof(Header))
+        std::memcpy(&Header, Data, sizeof(Header));
+
+    bool Swapped = Header.ByteOrder != HostByteOrder();
+
+    // Next() reads the field at the cursor, in our byte order.
+    auto Next = [&]() -> uint32_t
+    {
+        uint32_t Field;
+        std::memcpy(&Field, Data + Cursor, sizeof(Field));
+        Cursor += sizeof(Field);
+
+        return Swapped ? Swap(Field) : Field;
+    };
+
+    if (Swapped)
+    {
+        Header.Version = (uint16_t)((Header.Version >> 8) |
+                                    (Header.Version << 8));
+
+        uint32_t *Fields[] = {
+            &Header.CodeLength, &Header.RelocationCount,
+            &Header.SymbolCount, &Header.ImportCount
+        };
+
+        for (uint32_t *Field : Fields)
+            *Field = Swap(*Field);
+    }
+
+    const char *Problem = NULL;
+
+    if (FileSize < sizeof(Header) ||
+        std::memcmp(Header.Magic, ObjectMagic, sizeof(ObjectMagic)) != 0)
+    {
+        Problem = "It isn't an object";
+    }
+    else if (Header.Version != OBJECT_VERSION)
+    {
+        Problem = "Its version is unsupported";
+    }
+    else if (Header.ByteOrder != IMAGE_LITTLE_ENDIAN &&
+             Header.ByteOrder != IMAGE_BIG_ENDIAN)
+    {
+        Problem = "Its byte order is unknown";
+    }
+    else if (Header.CellWidth != sizeof(int))
+    {
+        Problem = "Its cell width is unsupported";
+    }
+    else if (4 * ((uint64_t)Header.CodeLength + Header.RelocationCount) >
+             FileSize - Cursor)
+    {
+        Problem = "It's truncated";
+    }
+
+    if (!Problem)
+    {
+        Reserve<int>(&Object->Code, Header.CodeLength);
+        Object->Code.Length = Header.CodeLength;
+
+        for (unsigned int i = 0; i < Header.CodeLength; i++)
+            Object->Code[i] = (int)Next();
+
+        Reserve<unsigned int>(&Object->Relocations, Header.RelocationCount);
+
+        for (unsigned int i = 0; i < Header.RelocationCount && !Problem; i++)
+        {
+            unsigned int Offset = Next();
+
+            if (Offset >= Header.CodeLength)
+                Problem = "A relocation is outside of its code";
+
+            Append<unsigned int>(&Object->Relocations, Offset);
+        }
+    }
+
+    // Symbols and imports are read the same way, one after the other.
+    unsigned int Counts[2] = { Header.SymbolCount, Header.ImportCount };
+
+    for (unsigned int i = 0; i < 2 && !Problem; i++)
+    {
+        for (unsigned int j = 0; j < Counts[i] && !Problem; j++)
+        {
+            if (8 > FileSize - Cursor)
+            {
+                Problem = "It's truncated";
+                break;
+            }
+
+            unsigned int Address = Next();
+            unsigned int NameLength = Next();
+            const char *Name = Data + Cursor;
+
+            if (NameLength == 0 || NameLength > FileSize - Cursor)
+            {
+                Problem = "A name is outside of the file";
+                break;
+            }
+
+            Cursor += NameLength;
+
+            if (i == 1)
+            {
+                if (Address >= Header.CodeLength)
+                    Problem = "An import is outside of its code";
+
+                Append<reference>(&Object->Imports, (reference) {
+                    .Offset     = Address,
+                    .Name       = Name,
+                    .NameLength = NameLength
+                });
+
+                continue;
+            }
+
+            symbol *Symbol = &Object->Symbols.Symbols[Intern(&Object->Symbols,
+                                                             Name,
+                                                             NameLength)];
+
+            if (Address > Header.CodeLength)
+                Problem = "A symbol is outside of its code";
+            else if (Symbol->Defined)
+                Problem = "It declares a label twice";
+
+            Symbol->Address = Address;
+            Symbol->Defined = true;
+        }
+    }
+
+    if (Problem)
+    {
+        Error("Can't load object \"%s\": %s.\n", Path, Problem);
+        Empty(Object);
+
+        return ERROR;
+    }
+
+    return OK;
+}
+
+#undef OBJECT_VERSION
@@ -0,0 +1,492 @@
+/**
+ * @file optimizer.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the peephole optimizer, which removes instructions that
+ * can never run. Every instruction that runs prints the cell it wrote (see
+ * engine.cpp), so taking out one that runs changes what the program prints.
+ * If asked to, the optimizer does that anyway: it also removes instructions
+ * that provably do nothing but print, replaces known sequences with shorter
+ * ones, and threads jumps through unconditional jumps.
+ *
+ * It works on the linked program, since that's the only place every address
+ * is known. In SUBLEQ every word of an instruction is an address, and any
+ * word can be read or written as data, so the optimizer first works out what
+ * the program can touch (see analysis.cpp): which instructions can run, and
+ * which cells they read and write. If a running instruction's words can
+ * ever change, its addresses aren't what they look like, and the program is
+ * left alone.
+ *
+ * An instruction that can't run is removed when nothing reads its words as
+ * data. One that can run is only removed when it leaves memory as it found it
+ * and always continues with the next instruction, and when nothing reads its
+ * words as data. The cells known to be zero are tracked through each run of
+ * straight line code to find those: clears of a cell that is already zero,
+ * including clears of a cell that is only ever cleared, and so jumps to the
+ * next address through such a cell. The same knowledge decides where the
+ * rewrites from a rewrite database (see rewrite.cpp) can be applied.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <algorithm>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "symbol.cpp"
+#include "analysis.cpp"
+#include "rewrite.cpp"
+
+
+#define OPTIMIZER_SCRATCH (1 << 5) // Zero whenever a run of code starts.
+
+#define NO_CELL 0xFFFFFFFF
+
+
+// Optimize() rewrites [Program] in place, applying [Rewrites] if they're
+// given, and returns how many instructions it removed. The program does the
+// same thing it did before, and prints the same, apart from where its cells
+// are and whatever [Rewrites] print differently (see LoadRewrites()). If
+// [DropPrints], it also removes the subtractions that did nothing and threads
+// jumps, which leaves memory the same but prints less. The addresses of
+// [Labels], if given, move along with their cells.
+static
+unsigned int Optimize(buffer<int> *Program,
+                      const buffer<rewrite> *Rewrites,
+                      symbol_table *Labels,
+                      bool DropPrints)
+{
+    unsigned int Length = Program->Length;
+    unsigned int Count  = Length / 3;
+
+    int *Words = Program->Data;
+
+    if (Count == 0)
+        return 0;
+
+
+    /** Find the instructions that can run, and the cells they touch. */
+
+    buffer<unsigned char> Cells = { };
+    buffer<unsigned char> Reachable = { };
+
+    if (!Analyze(Program, &Cells, &Reachable))
+    {
+        Info("Not optimizing, the program modifies its own code.\n");
+
+        Empty<unsigned char>(&Cells);
+        Empty<unsigned char>(&Reachable);
+
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        if (Words[i] == 0)
+            Cells[i] |= OPTIMIZER_SCRATCH;
+    }
+
+    // Removing an instruction moves every cell after it. Operands that are
+    // also read as data can't move, so nothing before them can be removed.
+    unsigned int Limit = 0;
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        if ((Cells[i] & CELL_CODE) && (Cells[i] & CELL_DATA) &&
+            0 <= Words[i] && (unsigned int)Words[i] <= Length)
+        {
+            Limit = std::max(Limit, (unsigned int)Words[i] / 3);
+        }
+    }
+
+
+    /** Follow the cells known to be zero through straight line code. */
+
+    // Straight line code starts wherever something other than the previous
+    // instruction can jump to.
+    buffer<unsigned char> Target = { };
+    Reserve<unsigned char>(&Target, Count);
+    Target.Length = Count;
+    std::fill(Target.Data, Target.Data + Count, 0);
+
+    Target[0] = true;
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        int C = Words[3 * i + 2];
+
+        if (Reachable[i] && IsAddress(C, Length) &&
+            (unsigned int)C != 3 * i + 3)
+        {
+            Target[C / 3] = true;
+        }
+    }
+
+    // A cell written in the current run holds the run's number here, along
+    // with whether it was written with zero. Otherwise, it's whatever it was
+    // when the run started.
+    buffer<unsigned int> Written = { };
+    Reserve<unsigned int>(&Written, Length);
+    Written.Length = Length;
+    std::fill(Written.Data, Written.Data + Length, 0);
+
+    buffer<unsigned char> WrittenZero = { };
+    Reserve<unsigned char>(&WrittenZero, Length);
+    WrittenZero.Length = Length;
+
+    unsigned int Run = 0;
+
+#define IsZero(CELL) \
+    (Written[CELL] == Run ? \
+     WrittenZero[CELL] != 0 : \
+     (Cells[CELL] & (CELL_ZERO | OPTIMIZER_SCRATCH)) != 0)
+
+#define Subtract(A, B) \
+    { \
+        bool Zero = (A) == (B) || (IsZero(A) && IsZero(B)); \
+        Written[B] = Run; \
+        WrittenZero[B] = Zero; \
+    }
+
+    // Scratch cells start out as zero, and have to be zero again every time
+    // control can leave a run. Assuming that of every scratch cell, drop the
+    // ones that aren't until what's left holds up.
+    buffer<unsigned int> Dirty = { };
+
+    auto Leave = [&]() -> bool
+    {
+        bool Dropped = false;
+
+        for (unsigned int i = 0; i < Dirty.Length; i++)
+        {
+            unsigned int Cell = Dirty[i];
+
+            if ((Cells[Cell] & OPTIMIZER_SCRATCH) && !IsZero(Cell))
+            {
+                Cells[Cell] &= ~OPTIMIZER_SCRATCH;
+                Dropped = true;
+            }
+        }
+
+        Clear<unsigned int>(&Dirty);
+
+        return Dropped;
+    };
+
+    for (bool Dropped = true; Dropped; )
+    {
+        Dropped = false;
+
+        bool FallsThrough = false;
+
+        for (unsigned int i = 0; i < Count; i++)
+        {
+            if (!Reachable[i])
+            {
+                FallsThrough = false;
+                continue;
+            }
+
+            if (Target[i] || !FallsThrough)
+            {
+                if (FallsThrough)
+                    Dropped |= Leave();
+
+                Clear<unsigned int>(&Dirty);
+                Run++;
+            }
+
+            int A = Words[3 * i + 0];
+            int B = Words[3 * i + 1];
+            int C = Words[3 * i + 2];
+
+            Subtract(A, B);
+
+            if (!WrittenZero[B])
+                Append<unsigned int>(&Dirty, B);
+
+            if (IsAddress(C, Length) && (unsigned int)C != 3 * i + 3)
+                Dropped |= Leave();
+
+            FallsThrough = !WrittenZero[B] || (unsigned int)C == 3 * i + 3;
+        }
+    }
+
+    Empty<unsigned int>(&Dirty);
+
+
+    /** Remove the instructions that do nothing, and apply rewrites. */
+
+    buffer<unsigned char> Removed = { };
+    Reserve<unsigned char>(&Removed, Count);
+    Removed.Length = Count;
+    std::fill(Removed.Data, Removed.Data + Count, 0);
+
+    unsigned int RemovedCount = 0;
+    bool FallsThrough = false;
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        if (!Reachable[i])
+        {
+            // NOTE An instruction that never runs never prints.
+            if (i >= Limit &&
+                !((Cells[3 * i + 0] | Cells[3 * i + 1] | Cells[3 * i + 2]) &
+                  CELL_DATA))
+            {
+                Removed[i] = true;
+                RemovedCount++;
+            }
+
+            FallsThrough = false;
+            continue;
+        }
+
+        if (Target[i] || !FallsThrough)
+            Run++;
+
+        // Every instruction we touch has to go straight on to the next, and
+        // nothing can jump into the middle of them or read them.
+        unsigned int Straight = 0;
+
+        while (Straight < REWRITE_MAX_LENGTH && i + Straight < Count)
+        {
+            unsigned int j = i + Straight;
+
+            if (!Reachable[j] || (Straight && Target[j]) ||
+                (unsigned int)Words[3 * j + 2] != 3 * j + 3 ||
+                ((Cells[3 * j + 0] | Cells[3 * j + 1] | Cells[3 * j + 2]) &
+                 CELL_DATA))
+            {
+                break;
+            }
+
+            Straight++;
+        }
+
+        const rewrite *Match = NULL;
+        unsigned int Bound[REWRITE_MAX_VARIABLES];
+
+        for (unsigned int j = 0;
+             Rewrites && j < Rewrites->Length && !Match;
+             j++)
+        {
+            const rewrite *Rewrite = &Rewrites->Data[j];
+
+            if (Rewrite->PatternLength > Straight ||
+                i + Rewrite->ReplacementLength < Limit)
+            {
+                continue;
+            }
+
+            std::fill(Bound, Bound + REWRITE_MAX_VARIABLES, NO_CELL);
+
+            bool Matches = true;
+
+            // Bind every variable to a cell, distinct variables to distinct
+            // cells.
+            for (unsigned int k = 0;
+                 k < 2 * Rewrite->PatternLength && Matches;
+                 k++)
+            {
+                unsigned int Variable = k % 2 ?
+                                        Rewrite->Pattern[k / 2].B :
+                                        Rewrite->Pattern[k / 2].A;
+                unsigned int Cell = Words[3 * (i + k / 2) + k % 2];
+
+                if (Bound[Variable] == NO_CELL)
+                {
+                    Matches = std::find(Bound,
+                                        Bound + Rewrite->VariableCount,
+                                        Cell) ==
+                              Bound + Rewrite->VariableCount;
+
+                    Bound[Variable] = Cell;
+                }
+                else
+                {
+                    Matches = Bound[Variable] == Cell;
+                }
+            }
+
+            for (unsigned int k = 0; k < Rewrite->VariableCount && Matches; k++)
+            {
+                if (Rewrite->Zero & (1 << k))
+                    Matches = IsZero(Bound[k]);
+            }
+
+            if (Matches)
+                Match = Rewrite;
+        }
+
+        if (Match)
+        {
+            for (unsigned int j = 0; j < Match->ReplacementLength; j++)
+            {
+                unsigned int A = Bound[Match->Replacement[j].A];
+                unsigned int B = Bound[Match->Replacement[j].B];
+
+                Words[3 * (i + j) + 0] = A;
+                Words[3 * (i + j) + 1] = B;
+
+                Subtract(A, B);
+            }
+
+            for (unsigned int j = Match->ReplacementLength;
+                 j < Match->PatternLength;
+                 j++)
+            {
+                Removed[i + j] = true;
+                RemovedCount++;
+            }
+
+            i += Match->PatternLength - 1;
+            FallsThrough = true;
+            continue;
+        }
+
+        int A = Words[3 * i + 0];
+        int B = Words[3 * i + 1];
+        int C = Words[3 * i + 2];
+
+        bool ResultIsZero = A == B || (IsZero(A) && IsZero(B));
+        bool Next = (unsigned int)C == 3 * i + 3;
+
+        // Writing zero over zero, and going on to the next instruction either
+        // way, does nothing but print.
+        if (DropPrints && ResultIsZero && IsZero(B) && Straight && i >= Limit)
+        {
+            Removed[i] = true;
+            RemovedCount++;
+            FallsThrough = true;
+            continue;
+        }
+
+        Subtract(A, B);
+
+        FallsThrough = !ResultIsZero || Next;
+    }
+
+#undef IsZero
+#undef Subtract
+
+    Empty<unsigned char>(&Target);
+    Empty<unsigned int>(&Written);
+    Empty<unsigned char>(&WrittenZero);
+
+
+    /** Thread jumps through instructions that only jump. */
+
+    for (unsigned int i = 0; i < Count && DropPrints; i++)
+    {
+        if (!Reachable[i] || Removed[i] ||
+            (Cells[3 * i + 2] & CELL_DATA))
+        {
+            continue;
+        }
+
+        int C = Words[3 * i + 2];
+
+        // NOTE Bounded, in case the jumps go round in a circle.
+        for (unsigned int Step = 0;
+             Step < Count && IsAddress(C, Length);
+             Step++)
+        {
+            unsigned int j = C / 3;
+
+            int A = Words[3 * j + 0];
+            int B = Words[3 * j + 1];
+            int Jump = Words[3 * j + 2];
+
+            if (Removed[j])
+            {
+                C += 3;
+            }
+            // Only jump straight to where the jump goes if it's somewhere we
+            // could have gone anyway. Jumping out of bounds is an error the
+            // emulator catches before the subtraction.
+            else if (A == B && (Cells[A] & CELL_ZERO) &&
+                     (Jump == -1 || (unsigned int)Jump <= Length))
+            {
+                C = Jump;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        Words[3 * i + 2] = C;
+    }
+
+
+    /** Take the removed instructions out. */
+
+    // The new index of every instruction; for removed ones, the index of the
+    // next one that's kept, which is where jumps to them now go.
+    buffer<unsigned int> NewIndex = { };
+    Reserve<unsigned int>(&NewIndex, Count + 1);
+
+    unsigned int Kept = 0;
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        Append<unsigned int>(&NewIndex, Kept);
+        Kept += !Removed[i];
+    }
+
+    Append<unsigned int>(&NewIndex, Kept);
+
+    // The operands of running instructions are addresses and move with the
+    // cells they point at. Everything else is data and keeps its value.
+    unsigned int Output = 0;
+
+    for (unsigned int i = 0; i < Count && RemovedCount; i++)
+    {
+        if (Removed[i])
+            continue;
+
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            int Value = Words[3 * i + j];
+
+            if ((Cells[3 * i + j] & CELL_CODE) &&
+                0 <= Value && (unsigned int)Value <= Length)
+            {
+                Value = 3 * NewIndex[Value / 3] + Value % 3;
+            }
+
+            Words[Output++] = Value;
+        }
+    }
+
+    // Words after the last whole instruction can't run, so they're data.
+    for (unsigned int i = 3 * Count; i < Length && RemovedCount; i++)
+        Words[Output++] = Words[i];
+
+    if (RemovedCount)
+        Program->Length = Output;
+
+    for (unsigned int i = 0;
+         Labels && RemovedCount && i < Labels->Symbols.Length;
+         i++)
+    {
+        unsigned int &Address = Labels->Symbols[i].Address;
+
+        if (Address <= Length)
+            Address = 3 * NewIndex[Address / 3] + Address % 3;
+    }
+
+    Empty<unsigned int>(&NewIndex);
+    Empty<unsigned char>(&Removed);
+    Empty<unsigned char>(&Reachable);
+    Empty<unsigned char>(&Cells);
+
+    return RemovedCount;
+}
+
+#undef OPTIMIZER_SCRATCH
+#undef NO_CELL
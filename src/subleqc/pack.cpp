@@ -0,0 +1,223 @@
+/**
+ * @file pack.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the codec for packed images. Most cells of a program are
+ * easy to guess from the cells before them: the third cell of an instruction
+ * is usually the address of the next one, the second is often the same as the
+ * first, and the first is often near the first of the instruction before. So
+ * every cell is stored as how far it is from that guess, zigzagged so that
+ * small differences either way are small numbers, in as few bytes as the
+ * number needs (seven bits a byte, the top bit saying another byte follows).
+ * Runs of zero cells are stored as just their length.
+ *
+ * Every token is one such number. If its lowest bit is set, the rest is one
+ * less than the length of a run of zeros; otherwise the rest is the zigzagged
+ * difference of one cell from its guess. A guess only ever looks at cells that
+ * come before, so the code can be unpacked as it's read.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdint>
+#include <cstring>
+#include <istream>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+
+
+// NOTE A token is at most 33 bits, so 5 bytes.
+#define PACK_MAX_TOKEN 5
+
+// MAGIC Big enough that reads are cheap, small enough to stay in cache.
+#define PACK_WINDOW_SIZE (64 * 1024)
+
+
+// Guess() returns what cell [Address] of [Cells] probably is, going by the
+// cells before it.
+static inline
+uint32_t Guess(const int *Cells, unsigned int Address)
+{
+    switch (Address % 3)
+    {
+        case 0:  return Address >= 3 ? (uint32_t)Cells[Address - 3] : 0;
+        case 1:  return (uint32_t)Cells[Address - 1];
+        default: return Address + 1;
+    }
+}
+
+// PutToken() appends [Token] to [Output], seven bits at a time.
+static inline
+void PutToken(buffer<unsigned char> *Output, uint64_t Token)
+{
+    while (Token >= 0x80)
+    {
+        Append<unsigned char>(Output, (unsigned char)(Token | 0x80));
+        Token >>= 7;
+    }
+
+    Append<unsigned char>(Output, (unsigned char)Token);
+}
+
+// Pack() appends the [Length] cells of [Cells], packed, to [Output].
+static
+void Pack(const int *Cells, unsigned int Length, buffer<unsigned char> *Output)
+{
+    for (unsigned int i = 0; i < Length; )
+    {
+        if (Cells[i] == 0)
+        {
+            unsigned int Run = 1;
+
+            while (i + Run < Length && Cells[i + Run] == 0)
+                Run++;
+
+            PutToken(Output, ((uint64_t)(Run - 1) << 1) | 1);
+            i += Run;
+        }
+        else
+        {
+            int32_t Difference = (int32_t)((uint32_t)Cells[i] - Guess(Cells, i));
+            uint32_t Zigzag = ((uint32_t)Difference << 1) ^
+                              (uint32_t)(Difference >> 31);
+
+            PutToken(Output, (uint64_t)Zigzag << 1);
+            i++;
+        }
+    }
+}
+
+// Unpack() reads [Size] bytes of packed code from [File] into the [Length]
+// cells of [Cells], a window at a time. [Cells] has to be zeroed already,
+// since runs of zeros are skipped over. Returns ERROR if the packed code
+// doesn't unpack to exactly [Length] cells.
+static
+status_code Unpack(std::istream *File,
+                   uint64_t Size,
+                   int *Cells,
+                   unsigned int Length)
+{
+    unsigned char Window[PACK_WINDOW_SIZE];
+    unsigned int WindowLength = 0;
+    unsigned int At = 0;
+
+    unsigned int Address = 0;
+    // NOTE Address % 3, kept up as we go since it's needed for every
+    // cell.
+    unsigned int Slot = 0;
+
+    for (;;)
+    {
+        std::memmove(Window, Window + At, WindowLength - At);
+        WindowLength -= At;
+        At = 0;
+
+        unsigned int ReadLength = sizeof(Window) - WindowLength;
+
+        if (ReadLength > Size)
+            ReadLength = (unsigned int)Size;
+
+        if (ReadLength && !File->read((char *)Window + WindowLength,
+                                      ReadLength))
+        {
+            return ERROR;
+        }
+
+        WindowLength += ReadLength;
+        Size -= ReadLength;
+
+        if (At == WindowLength)
+            break;
+
+        // Tokens can only be cut off at the end of the code, so until then,
+        // stop short of the end of the window and read more.
+        unsigned int End = Size ? WindowLength - PACK_MAX_TOKEN + 1 : WindowLength;
+
+        while (At < End)
+        {
+            // Most instructions are three one-byte cells, so handle those in
+            // one go.
+            if (Slot == 0 && At + 3 <= End && Address + 3 <= Length &&
+                !((Window[At] | Window[At + 1] | Window[At + 2]) & 0x81))
+            {
+                uint32_t Differences[3];
+
+                for (unsigned int i = 0; i < 3; i++)
+                {
+                    uint32_t Zigzag = Window[At + i] >> 1;
+                    Differences[i] = (Zigzag >> 1) ^ (0 - (Zigzag & 1));
+                }
+
+                int First = (int)((Address >= 3 ? (uint32_t)Cells[Address - 3] :
+                                                  0) + Differences[0]);
+
+                Cells[Address + 0] = First;
+                Cells[Address + 1] = (int)((uint32_t)First + Differences[1]);
+                Cells[Address + 2] = (int)(Address + 3 + Differences[2]);
+
+                Address += 3;
+                At += 3;
+                continue;
+            }
+
+            uint64_t Token = Window[At++];
+
+            if (Token & 0x80)
+            {
+                Token &= 0x7F;
+
+                for (unsigned int Shift = 7; ; Shift += 7)
+                {
+                    if (At == WindowLength || Shift >= 7 * PACK_MAX_TOKEN)
+                        return ERROR;
+
+                    uint64_t Byte = Window[At++];
+                    Token |= (Byte & 0x7F) << Shift;
+
+                    if (!(Byte & 0x80))
+                        break;
+                }
+            }
+
+            if (Token & 1)
+            {
+                uint64_t Run = (Token >> 1) + 1;
+
+                if (Run > Length - Address)
+                    return ERROR;
+
+                Address += (unsigned int)Run;
+                Slot = (unsigned int)((Slot + Run) % 3);
+            }
+            else
+            {
+                if (Address == Length)
+                    return ERROR;
+
+                uint32_t Zigzag = (uint32_t)(Token >> 1);
+                uint32_t Difference = (Zigzag >> 1) ^ (0 - (Zigzag & 1));
+                uint32_t Guessed;
+
+                if (Slot == 0)
+                    Guessed = Address >= 3 ? (uint32_t)Cells[Address - 3] : 0;
+                else if (Slot == 1)
+                    Guessed = (uint32_t)Cells[Address - 1];
+                else
+                    Guessed = Address + 1;
+
+                Cells[Address] = (int)(Guessed + Difference);
+                Address++;
+                Slot = Slot == 2 ? 0 : Slot + 1;
+            }
+        }
+    }
+
+    return Address == Length ? OK : ERROR;
+}
+
+#undef PACK_MAX_TOKEN
+#undef PACK_WINDOW_SIZE
@@ -0,0 +1,62 @@
+/**
+ * @file parallel.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the little bit of threading the assembler needs.
+ */
+
+#pragma once
+
+// C++ standard libraries
+#include <thread>
+#include <atomic>
+
+
+// HardwareThreadCount() returns how many threads the machine can run at once.
+static inline
+unsigned int HardwareThreadCount()
+{
+    unsigned int Count = std::thread::hardware_concurrency();
+
+    return Count ? Count : 1;
+}
+
+// ParallelFor() calls [Function] with every index in [0, Count), spread over
+// at most [ThreadCount] threads. Threads pull indices as they finish, so work
+// items of uneven size still balance out. The calling thread does work too.
+template <typename F>
+static
+void ParallelFor(unsigned int Count, unsigned int ThreadCount, F Function)
+{
+    if (ThreadCount > Count)
+        ThreadCount = Count;
+
+    if (ThreadCount <= 1)
+    {
+        for (unsigned int i = 0; i < Count; i++)
+            Function(i);
+
+        return;
+    }
+
+    std::atomic<unsigned int> Next (0);
+
+    auto Worker = [&]()
+    {
+        for (unsigned int i = Next++; i < Count; i = Next++)
+            Function(i);
+    };
+
+    std::thread *Threads = new std::thread[ThreadCount - 1];
+
+    for (unsigned int i = 0; i < ThreadCount - 1; i++)
+        Threads[i] = std::thread(Worker);
+
+    Worker();
+
+    for (unsigned int i = 0; i < ThreadCount - 1; i++)
+        Threads[i].join();
+
+    delete[] Threads;
+}
@@ -0,0 +1,487 @@
+/**
+ * @file rewrite.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains rewrites, pairs of straight line instruction sequences
+ * that leave memory the same, and the database of them that the optimizer
+ * applies.
+ * The database is a text file with one rewrite per line:
+ *
+ *     b, b; a, Z; Z, b; Z => b; a, b | zero Z
+ *
+ * The pattern before the arrow and the replacement after it are SUBLEQ source,
+ * where every identifier is a variable that stands for some cell, distinct
+ * variables standing for distinct cells. Every instruction has to continue
+ * with the next one, so the third address can only be `?` or left out.
+ * Variables listed after "zero" are zero before the pattern, and have to be
+ * zero again after it. Lines that are blank or start with '#' are ignored.
+ *
+ * Without branches, every instruction just replaces a cell with the
+ * difference of two cells, so the cells a sequence ends up with are sums of
+ * the cells it started with. Two sequences leave memory the same exactly when
+ * those sums come out the same, which is how Verify() checks rewrites.
+ *
+ * The emulator also prints the cell every instruction writes, so a shorter
+ * sequence always prints fewer lines than the one it replaces. Verify() can
+ * hold a rewrite to printing the same as well, the same number of lines with
+ * the same sums in order, which no rewrite that saves an instruction passes.
+ * Rewrites that only leave memory the same are applied with --drop-prints.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "symbol.cpp"
+#include "assembler.cpp"
+
+
+// MAGIC Enough for every idiom worth looking up, and small enough to keep
+// rewrites flat.
+#define REWRITE_MAX_LENGTH    8
+#define REWRITE_MAX_VARIABLES 8
+
+#define NO_VARIABLE 0xFFFFFFFF
+
+// A straight line instruction, by the variables it subtracts.
+struct rewrite_instruction {
+    unsigned char A;
+    unsigned char B;
+};
+
+struct rewrite {
+    rewrite_instruction Pattern[REWRITE_MAX_LENGTH];
+    rewrite_instruction Replacement[REWRITE_MAX_LENGTH];
+    unsigned int PatternLength;
+    unsigned int ReplacementLength;
+    unsigned int VariableCount;
+    // Bit N is set when variable N is zero before and after.
+    unsigned int Zero;
+};
+
+// What a sequence leaves in each variable, and what each of its instructions
+// prints, as sums of what every variable held before it.
+struct rewrite_state {
+    unsigned int Terms[REWRITE_MAX_VARIABLES][REWRITE_MAX_VARIABLES];
+    unsigned int Printed[REWRITE_MAX_LENGTH][REWRITE_MAX_VARIABLES];
+};
+
+
+// Evaluate() works out what the [Count] [Instructions] leave in each of
+// [VariableCount] variables, and what they print, the variables set in [Zero]
+// starting out as zero.
+static
+rewrite_state Evaluate(const rewrite_instruction *Instructions,
+                       unsigned int Count,
+                       unsigned int VariableCount,
+                       unsigned int Zero)
+{
+    rewrite_state State = { };
+
+    for (unsigned int i = 0; i < VariableCount; i++)
+    {
+        if (!(Zero & (1 << i)))
+            State.Terms[i][i] = 1;
+    }
+
+    // NOTE Unsigned, so it wraps around like the emulator does.
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        unsigned int *A = State.Terms[Instructions[i].A];
+        unsigned int *B = State.Terms[Instructions[i].B];
+
+        for (unsigned int j = 0; j < VariableCount; j++)
+            B[j] = A[j] - B[j];
+
+        std::copy(B, B + VariableCount, State.Printed[i]);
+    }
+
+    return State;
+}
+
+// Verify() returns whether both sides of [Rewrite] leave every variable with
+// the same value, and leave its zero variables zero. If [Prints], they also
+// have to print the same: run as many instructions, each printing the same
+// value as its counterpart.
+static
+bool Verify(const rewrite *Rewrite, bool Prints)
+{
+    rewrite_state Pattern = Evaluate(Rewrite->Pattern,
+                                     Rewrite->PatternLength,
+                                     Rewrite->VariableCount,
+                                     Rewrite->Zero);
+    rewrite_state Replacement = Evaluate(Rewrite->Replacement,
+                                         Rewrite->ReplacementLength,
+                                         Rewrite->VariableCount,
+                                         Rewrite->Zero);
+
+    for (unsigned int i = 0; i < Rewrite->VariableCount; i++)
+    {
+        for (unsigned int j = 0; j < Rewrite->VariableCount; j++)
+        {
+            if (Pattern.Terms[i][j] != Replacement.Terms[i][j])
+                return false;
+
+            if ((Rewrite->Zero & (1 << i)) && Pattern.Terms[i][j] != 0)
+                return false;
+        }
+    }
+
+    if (!Prints)
+        return true;
+
+    if (Rewrite->PatternLength != Rewrite->ReplacementLength)
+        return false;
+
+    for (unsigned int i = 0; i < Rewrite->PatternLength; i++)
+    {
+        if (!std::equal(Pattern.Printed[i],
+                        Pattern.Printed[i] + Rewrite->VariableCount,
+                        Replacement.Printed[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ParseSequence() parses the [Length] characters of [Text] as a straight line
+// sequence of instructions into [Output], interning its variables in
+// [Variables]. Returns how many instructions there were, or an ERROR if
+// [Text] isn't such a sequence.
+static
+status<unsigned int> ParseSequence(const char *Text,
+                                   unsigned int Length,
+                                   symbol_table *Variables,
+                                   rewrite_instruction *Output)
+{
+    // NOTE The parser only finishes an instruction at an EOL, and
+    // doesn't like empty lines.
+    while (Length && (IsWhitespace(*Text) || IsEOL(*Text)))
+    {
+        Text++;
+        Length--;
+    }
+
+    while (Length && (IsWhitespace(Text[Length - 1]) ||
+                      IsEOL(Text[Length - 1])))
+    {
+        Length--;
+    }
+
+    if (Length == 0)
+        return (status<unsigned int>) { .Status = OK, .Value = 0 };
+
+    buffer<char> Source = { };
+    Append<char>(&Source, Text, Length);
+    Append<char>(&Source, '\n');
+
+    assembler Assembler    = { };
+    Assembler.Source       = Source.Data;
+    Assembler.SourceLength = Source.Length;
+    Assembler.ThreadCount  = 1;
+
+    IndexLines(Source.Data, Source.Length, &Assembler.LineStarts);
+
+    chunk Chunk = { };
+    Chunk.Begin = 0;
+    Chunk.End   = Source.Length;
+
+    Parse(&Assembler, &Chunk);
+
+    buffer<instruction> &Instructions = Chunk.Instructions;
+
+    // NOTE Data would leave words that aren't instructions, and throw
+    // every instruction after it off of its word.
+    bool Valid = Chunk.Errors.Length == 0 &&
+                 Instructions.Length <= REWRITE_MAX_LENGTH &&
+                 Chunk.Length == 3 * Instructions.Length;
+
+    for (unsigned int i = 0; i < Instructions.Length && Valid; i++)
+        Valid = !Instructions[i].Data;
+
+    // The variable each word refers to.
+    unsigned int Words[3 * REWRITE_MAX_LENGTH];
+    std::fill(Words, Words + 3 * REWRITE_MAX_LENGTH, NO_VARIABLE);
+
+    for (unsigned int i = 0; i < Chunk.Symbols.Symbols.Length && Valid; i++)
+    {
+        symbol *Symbol = &Chunk.Symbols.Symbols[i];
+
+        // Labels have no business in a rewrite.
+        if (Symbol->Defined)
+        {
+            Valid = false;
+            break;
+        }
+
+        unsigned int Variable = Intern(Variables,
+                                       SymbolName(&Chunk.Symbols, i),
+                                       Symbol->NameLength);
+
+        for (unsigned int j = Symbol->FirstFixup;
+             j != NO_FIXUP && Valid;
+             j = Chunk.Symbols.Fixups[j].Next)
+        {
+            fixup *Fixup = &Chunk.Symbols.Fixups[j];
+
+            // A word has to be just the one variable.
+            Valid = !Fixup->Negative && Words[Fixup->Offset] == NO_VARIABLE;
+
+            Words[Fixup->Offset] = Variable;
+        }
+    }
+
+    Valid = Valid && Variables->Symbols.Length <= REWRITE_MAX_VARIABLES;
+
+    for (unsigned int i = 0; i < Instructions.Length && Valid; i++)
+    {
+        instruction *Instruction = &Instructions[i];
+        unsigned int *Word = Words + 3 * i;
+
+        if (Instruction->ParameterCount == 1)
+            Word[1] = Word[0];
+
+        // Only variables, and a third address of `?`.
+        Valid = Word[0] != NO_VARIABLE && Word[1] != NO_VARIABLE &&
+                Instruction->Parameters[0] == 0 &&
+                (Instruction->ParameterCount == 1 ||
+                 Instruction->Parameters[1] == 0) &&
+                (Instruction->ParameterCount < 3 ||
+                 ((Instruction->Relative & (1 << 2)) &&
+                  Instruction->Parameters[2] == (int)Instruction->Location + 3));
+
+        Output[i].A = (unsigned char)Word[0];
+        Output[i].B = (unsigned char)Word[1];
+    }
+
+    status<unsigned int> Result = { };
+    Result.Status = Valid ? OK : ERROR;
+    Result.Value  = Instructions.Length;
+
+    Empty<instruction>(&Chunk.Instructions);
+    Empty(&Chunk.Symbols);
+    Empty<error>(&Chunk.Errors);
+    Free(&Chunk.Arena);
+    Empty<unsigned int>(&Assembler.LineStarts);
+    Empty<char>(&Source);
+
+    return Result;
+}
+
+// ParseRewrite() parses the [Length] characters of [Line] into [Rewrite],
+// naming its variables in [Variables]. Returns ERROR if [Line] isn't a
+// rewrite.
+static
+status_code ParseRewrite(const char *Line,
+                         unsigned int Length,
+                         rewrite *Rewrite,
+                         symbol_table *Variables)
+{
+    *Rewrite = { };
+
+    const char *End   = Line + Length;
+    const char *Arrow = std::search(Line, End, "=>", "=>" + 2);
+    const char *Bar   = std::find(Line, End, '|');
+
+    if (Arrow == End || Bar < Arrow)
+        return ERROR;
+
+    status<unsigned int> Pattern = ParseSequence(Line,
+                                                 Arrow - Line,
+                                                 Variables,
+                                                 Rewrite->Pattern);
+
+    unsigned int PatternVariables = Variables->Symbols.Length;
+
+    status<unsigned int> Replacement = ParseSequence(Arrow + 2,
+                                                     Bar - (Arrow + 2),
+                                                     Variables,
+                                                     Rewrite->Replacement);
+
+    // NOTE A variable only the replacement uses would have to be a cell
+    // nobody cares about, which we can't know.
+    if (Pattern.Status != OK || Replacement.Status != OK ||
+        Variables->Symbols.Length != PatternVariables)
+    {
+        return ERROR;
+    }
+
+    Rewrite->PatternLength     = Pattern.unpack();
+    Rewrite->ReplacementLength = Replacement.unpack();
+    Rewrite->VariableCount     = PatternVariables;
+
+    if (Bar == End)
+        return OK;
+
+    /** Read the list of zero variables. */
+
+    const char *Cursor = Bar + 1;
+
+    auto SkipWhitespace = [&]()
+    {
+        while (Cursor < End && IsWhitespace(*Cursor))
+            Cursor++;
+    };
+
+    SkipWhitespace();
+
+    if (End - Cursor < 4 || std::strncmp(Cursor, "zero", 4) != 0)
+        return ERROR;
+
+    Cursor += 4;
+
+    for (SkipWhitespace(); Cursor < End; SkipWhitespace())
+    {
+        const char *Name = Cursor;
+
+        while (Cursor < End && !IsWhitespace(*Cursor))
+            Cursor++;
+
+        status<unsigned int> Variable = Get(&Variables->Names,
+                                            Name,
+                                            Cursor - Name);
+
+        if (Variable.Status != OK)
+            return ERROR;
+
+        Rewrite->Zero |= 1 << Variable.unpack();
+    }
+
+    return OK;
+}
+
+// WriteSequence() writes the [Count] [Instructions] to [File] as SUBLEQ
+// source, with the variable names in [Variables].
+static
+void WriteSequence(FILE *File,
+                   const rewrite_instruction *Instructions,
+                   unsigned int Count,
+                   symbol_table *Variables)
+{
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        const char *A = SymbolName(Variables, Instructions[i].A);
+        const char *B = SymbolName(Variables, Instructions[i].B);
+        unsigned int ALength = Variables->Symbols[Instructions[i].A].NameLength;
+        unsigned int BLength = Variables->Symbols[Instructions[i].B].NameLength;
+
+        if (i)
+            fprintf(File, "; ");
+
+        // One-address notation for clears.
+        if (Instructions[i].A == Instructions[i].B)
+            fprintf(File, "%.*s", ALength, A);
+        else
+            fprintf(File, "%.*s, %.*s", ALength, A, BLength, B);
+    }
+}
+
+// WriteRewrite() writes [Rewrite] to [File] as a line of a rewrite database,
+// with the variable names in [Variables].
+static inline
+void WriteRewrite(FILE *File, const rewrite *Rewrite, symbol_table *Variables)
+{
+    WriteSequence(File, Rewrite->Pattern, Rewrite->PatternLength, Variables);
+
+    fprintf(File, " =>");
+
+    if (Rewrite->ReplacementLength)
+        fprintf(File, " ");
+
+    WriteSequence(File,
+                  Rewrite->Replacement,
+                  Rewrite->ReplacementLength,
+                  Variables);
+
+    if (Rewrite->Zero)
+    {
+        fprintf(File, " | zero");
+
+        for (unsigned int i = 0; i < Rewrite->VariableCount; i++)
+        {
+            if (Rewrite->Zero & (1 << i))
+            {
+                fprintf(File,
+                        " %.*s",
+                        Variables->Symbols[i].NameLength,
+                        SymbolName(Variables, i));
+            }
+        }
+    }
+
+    fprintf(File, "\n");
+}
+
+// LoadRewrites() appends every rewrite in the database at [Path] to
+// [Rewrites], reporting the lines that aren't valid rewrites. Unless
+// [DropPrints], a rewrite also has to print the same as what it replaces.
+// Returns ERROR if the database can't be read.
+static
+status_code LoadRewrites(const char *Path,
+                         buffer<rewrite> *Rewrites,
+                         bool DropPrints)
+{
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    if (!File)
+        return ERROR;
+
+    std::string Line;
+    unsigned int LineNumber = 0;
+
+    while (std::getline(File, Line))
+    {
+        LineNumber++;
+
+        unsigned int Begin = 0;
+
+        while (Begin < Line.size() && IsWhitespace(Line[Begin]))
+            Begin++;
+
+        if (Begin == Line.size() || Line[Begin] == '#')
+            continue;
+
+        rewrite Rewrite;
+        symbol_table Variables = { };
+
+        if (ParseRewrite(Line.data(), Line.size(), &Rewrite, &Variables) != OK)
+        {
+            Warning("%s:%u: Not a rewrite, skipping it.\n", Path, LineNumber);
+        }
+        else if (!Verify(&Rewrite, false))
+        {
+            Warning("%s:%u: The two sides of this rewrite differ, skipping "
+                    "it.\n",
+                    Path,
+                    LineNumber);
+        }
+        else if (!DropPrints && !Verify(&Rewrite, true))
+        {
+            Warning("%s:%u: This rewrite changes what a program prints, "
+                    "skipping it without --drop-prints.\n",
+                    Path,
+                    LineNumber);
+        }
+        else if (Rewrite.ReplacementLength < Rewrite.PatternLength)
+        {
+            Append<rewrite>(Rewrites, Rewrite);
+        }
+
+        Empty(&Variables);
+    }
+
+    return OK;
+}
+
+#undef NO_VARIABLE
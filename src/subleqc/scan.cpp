@@ -0,0 +1,206 @@
+/**
+ * @file scan.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the vectorized pre-pass over SUBLEQ source text. It
+ * builds the line-start index used by the lexer and error reporting, and
+ * finds the delimiters and signs that end identifiers a block at a time.
+ *
+ * We use AVX2 when the compiler targets it, SSE2 otherwise (always available
+ * on x64), and fall back to plain loops everywhere else.
+ */
+
+#pragma once
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCAN_SSE2 1
+#endif
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+
+
+/* Character classification */
+
+enum character_class {
+    CLASS_WHITESPACE = 1 << 0,
+    CLASS_EOL        = 1 << 1,
+    CLASS_COMMA      = 1 << 2,
+    CLASS_COLON      = 1 << 3,
+    CLASS_SIGN       = 1 << 4,
+
+    CLASS_DELIMITER  = CLASS_WHITESPACE | CLASS_EOL | CLASS_COMMA | CLASS_COLON,
+};
+
+// NOTE A lookup table turns every classification below into a single
+// load, instead of a chain of comparisons per character. Only the first 64
+// characters have a class; everything past ';' is zero-initialized.
+#define W CLASS_WHITESPACE
+#define E CLASS_EOL
+#define C CLASS_COMMA
+#define L CLASS_COLON
+#define S CLASS_SIGN
+static const unsigned char CharacterClasses[256] = {
+//  NUL                           \t \n       \r
+    0, 0, 0, 0, 0, 0, 0, 0, 0, W, E, 0, 0, W, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+//  ' '                              '+' ',' '-'
+    W, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, S, C, S, 0, 0,
+//                                    ':' ';'
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, L, E, 0, 0, 0, 0,
+};
+#undef W
+#undef E
+#undef C
+#undef L
+#undef S
+
+#define IsClass(CHARACTER, CLASS) \
+    (CharacterClasses[(unsigned char)(CHARACTER)] & (CLASS))
+
+/**
+ * Checks if the given [Character] is classified as ignorable whitespace.
+ */
+static inline
+bool IsWhitespace(const char Character)
+{
+    return IsClass(Character, CLASS_WHITESPACE);
+}
+
+/**
+ * Checks if the given [Character] is classified as an end-of-line (EOL).
+ */
+static inline
+bool IsEOL(const char Character)
+{
+    return IsClass(Character, CLASS_EOL);
+}
+
+/**
+ * Checks if the given [Character] ends an identifier, number or question mark.
+ */
+static inline
+bool IsDelimiter(const char Character)
+{
+    return IsClass(Character, CLASS_DELIMITER);
+}
+
+
+// IndexLines() appends the offset of the first character of every line in
+// [Source] to [LineStarts]. The first line always starts at offset 0, and
+// every newline starts another line directly after it.
+static
+void IndexLines(const char *Source,
+                unsigned int SourceLength,
+                buffer<unsigned int> *LineStarts)
+{
+    Append<unsigned int>(LineStarts, 0);
+
+    unsigned int i = 0;
+
+#if SCAN_AVX2
+    const __m256i Newlines = _mm256_set1_epi8('\n');
+
+    for (; i + 32 <= SourceLength; i += 32)
+    {
+        __m256i Block = _mm256_loadu_si256((const __m256i *)(Source + i));
+        unsigned int Mask = (unsigned int)
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(Block, Newlines));
+
+        while (Mask)
+        {
+            Append<unsigned int>(LineStarts, i + CountTrailingZeros(Mask) + 1);
+            Mask &= Mask - 1;
+        }
+    }
+#elif SCAN_SSE2
+    const __m128i Newlines = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= SourceLength; i += 16)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)(Source + i));
+        unsigned int Mask = (unsigned int)
+            _mm_movemask_epi8(_mm_cmpeq_epi8(Block, Newlines));
+
+        while (Mask)
+        {
+            Append<unsigned int>(LineStarts, i + CountTrailingZeros(Mask) + 1);
+            Mask &= Mask - 1;
+        }
+    }
+#endif
+
+    for (; i < SourceLength; i++)
+    {
+        if (Source[i] == '\n')
+            Append<unsigned int>(LineStarts, i + 1);
+    }
+}
+
+// FindDelimiter() returns the offset of the first character at or after
+// [Cursor] that ends an identifier (whitespace, EOL, comma, colon or sign),
+// or [SourceLength] if there is none.
+static inline
+unsigned int FindDelimiter(const char *Source,
+                           unsigned int Cursor,
+                           unsigned int SourceLength)
+{
+#if SCAN_AVX2
+    for (; Cursor + 32 <= SourceLength; Cursor += 32)
+    {
+        __m256i Block = _mm256_loadu_si256((const __m256i *)(Source + Cursor));
+
+#define Is(C) _mm256_cmpeq_epi8(Block, _mm256_set1_epi8(C))
+        __m256i Delimiters =
+            _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(Is(' '), Is('\t')),
+                                            _mm256_or_si256(Is('\r'), Is('\n'))),
+                            _mm256_or_si256(_mm256_or_si256(Is(';'), Is(',')),
+                                            Is(':')));
+        __m256i Signs = _mm256_or_si256(Is('+'), Is('-'));
+#undef Is
+
+        Delimiters = _mm256_or_si256(Delimiters, Signs);
+
+        unsigned int Mask = (unsigned int)_mm256_movemask_epi8(Delimiters);
+
+        if (Mask)
+            return Cursor + CountTrailingZeros(Mask);
+    }
+#elif SCAN_SSE2
+    for (; Cursor + 16 <= SourceLength; Cursor += 16)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)(Source + Cursor));
+
+#define Is(C) _mm_cmpeq_epi8(Block, _mm_set1_epi8(C))
+        __m128i Delimiters =
+            _mm_or_si128(_mm_or_si128(_mm_or_si128(Is(' '), Is('\t')),
+                                      _mm_or_si128(Is('\r'), Is('\n'))),
+                         _mm_or_si128(_mm_or_si128(Is(';'), Is(',')),
+                                      Is(':')));
+        __m128i Signs = _mm_or_si128(Is('+'), Is('-'));
+#undef Is
+
+        Delimiters = _mm_or_si128(Delimiters, Signs);
+
+        unsigned int Mask = (unsigned int)_mm_movemask_epi8(Delimiters);
+
+        if (Mask)
+            return Cursor + CountTrailingZeros(Mask);
+    }
+#endif
+
+    for (; Cursor < SourceLength; Cursor++)
+    {
+        if (IsClass(Source[Cursor], CLASS_DELIMITER | CLASS_SIGN))
+            break;
+    }
+
+    return Cursor;
+}
@@ -0,0 +1,821 @@
+/**
+ * @file serve.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the emulator's server, which stays up and runs jobs sent
+ * to it over a Unix domain socket (see job.cpp for what's sent), so that a
+ * job doesn't pay for starting a process and loading its image.
+ *
+ * Images are loaded once, into a template (see template.cpp) ready to run
+ * from their entry, and kept in a cache by path, along with when the file was
+ * last changed. A job whose image hasn't changed since runs on a clone of the
+ * cached template, which costs a mapping. The cache holds a limited number of
+ * images, and the one used least recently makes way for a new one, taking its
+ * path out of the cache with it.
+ *
+ * Connections are queued for a pool of workers, a thread each, pinned to a
+ * processor each where we can. A worker reads a job, runs it, and writes its
+ * output straight to the connection as the engine flushes it, so a client
+ * that doesn't keep up holds up the job rather than the server holding on to
+ * its output. When every worker is busy and the queue is full, the server
+ * stops accepting connections until there's room, and clients wait in the
+ * socket's backlog.
+ *
+ * The server waits for connections with poll(), on the socket and on a pipe
+ * of its own. Anything that needs it to look again, a signal to stop or a
+ * worker making room in a full queue, writes a byte to the pipe, so nothing
+ * that happens just before it starts waiting is missed.
+ *
+ * How long every job waited, ran, and took in all is kept in histograms,
+ * which a client can ask for, and which are printed when the server stops.
+ *
+ * This needs Unix domain sockets and threads, so it only builds on POSIX
+ * systems.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+// POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "hashmap.cpp"
+#include "image.cpp"
+#include "engine.cpp"
+#include "template.cpp"
+#include "job.cpp"
+#include "parallel.cpp"
+
+
+// MAGIC Enough images for every program a machine is serving at once.
+#define DEFAULT_CACHE_SIZE 64
+
+// MAGIC A few connections per worker keeps them busy without letting
+// clients wait long in the queue rather than the backlog.
+#define QUEUE_SIZE_PER_WORKER 4
+
+// MAGIC How long a client has to send its request, and to read a chunk
+// of output, before its job is given up on.
+#define CONNECTION_TIMEOUT 30
+
+// Histograms have a bucket for every power of two microseconds.
+#define HISTOGRAM_BUCKETS 40
+
+
+struct serve_options {
+    const char *SocketPath;
+    unsigned int WorkerCount;
+    // How many images to keep loaded at once.
+    unsigned int CacheSize;
+    // The most instructions any job can run.
+    unsigned long long Budget;
+};
+
+struct cached_image {
+    bool Loaded;
+    vm_template Template;
+    // When the file was last changed, in nanoseconds, as of loading it.
+    long long ModifiedTime;
+    // When the image was last used, on the cache's clock.
+    unsigned long long LastUsed;
+    // Where its path is in the cache's key pool (see KeyAt()), and how long.
+    unsigned int PathOffset;
+    unsigned int PathLength;
+};
+
+struct image_cache {
+    std::mutex Lock;
+    // The path of every loaded image, to its index in [Images].
+    hashmap Paths;
+    buffer<cached_image> Images;
+    unsigned int LoadedCount;
+    unsigned int Size;
+    unsigned long long Clock;
+    unsigned long long Hits;
+    unsigned long long Misses;
+};
+
+// A connection waiting for a worker, and when it was accepted.
+struct queued_connection {
+    int Descriptor;
+    std::chrono::steady_clock::time_point Accepted;
+};
+
+struct connection_queue {
+    std::mutex Lock;
+    std::condition_variable NotEmpty;
+    buffer<queued_connection> Connections;
+    unsigned int Head;
+    unsigned int Count;
+    bool Stopping;
+};
+
+// How many jobs took under each power of two microseconds.
+struct histogram {
+    std::atomic<unsigned long long> Counts[HISTOGRAM_BUCKETS];
+};
+
+struct server {
+    const serve_options *Options;
+    image_cache Cache;
+    connection_queue Queue;
+    std::atomic<unsigned long long> JobCount;
+    std::atomic<unsigned long long> FailedCount;
+    histogram Queued;
+    histogram Running;
+    histogram Total;
+};
+
+
+// How a job stopped, in the order of engine_status (see engine.cpp).
+static const char *JobStatusNames[] = {
+    "halted",
+    "counter-out-of-bounds",
+    "operand-out-of-bounds",
+    "out-of-steps"
+};
+
+// Set when the server is told to stop.
+static volatile sig_atomic_t StopRequested = 0;
+
+// The end of the server's pipe to write to, to wake it up (see Wake()).
+static int WakeDescriptor = -1;
+
+
+/** Statistics. */
+
+// Record() counts a job that took [Microseconds] in [Histogram].
+static inline
+void Record(histogram *Histogram, unsigned long long Microseconds)
+{
+    unsigned int Bucket = 0;
+
+    while (Bucket < HISTOGRAM_BUCKETS - 1 && Microseconds >> Bucket)
+        Bucket++;
+
+    Histogram->Counts[Bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+// MicrosecondsSince() returns how many microseconds have passed since
+// [Start].
+static inline
+unsigned long long MicrosecondsSince(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - Start).count();
+}
+
+// WriteStats() writes what [Server] has done so far to [File], as tab
+// separated values.
+static
+void WriteStats(server *Server, FILE *File)
+{
+    {
+        std::lock_guard<std::mutex> Guard (Server->Cache.Lock);
+
+        fprintf(File, "jobs\t%llu\n", Server->JobCount.load());
+        fprintf(File, "failed\t%llu\n", Server->FailedCount.load());
+        fprintf(File, "cache_hits\t%llu\n", Server->Cache.Hits);
+        fprintf(File, "cache_misses\t%llu\n", Server->Cache.Misses);
+        fprintf(File, "cached_images\t%u\n", Server->Cache.LoadedCount);
+    }
+
+    const char *Names[] = { "queued", "running", "total" };
+    histogram *Histograms[] = {
+        &Server->Queued, &Server->Running, &Server->Total
+    };
+
+    fprintf(File, "\nhistogram\tunder_microseconds\tjobs\n");
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        for (unsigned int j = 0; j < HISTOGRAM_BUCKETS; j++)
+        {
+            unsigned long long Count =
+                Histograms[i]->Counts[j].load(std::memory_order_relaxed);
+
+            if (Count)
+                fprintf(File, "%s\t%llu\t%llu\n", Names[i], 1ull << j, Count);
+        }
+    }
+}
+
+
+/** The image cache. */
+
+// Forget() drops every image [Cache] doesn't have loaded, path and all, so
+// that it never holds more paths than it has room for images.
+// NOTE The hashmap can't remove a key, so the paths left are put in a new one.
+static
+void Forget(image_cache *Cache)
+{
+    if (Cache->Images.Length == Cache->LoadedCount)
+        return;
+
+    hashmap Paths = { };
+    buffer<cached_image> Images = { };
+
+    for (unsigned int i = 0; i < Cache->Images.Length; i++)
+    {
+        cached_image Kept = Cache->Images[i];
+
+        if (!Kept.Loaded)
+            continue;
+
+        Kept.PathOffset = Put(&Paths, KeyAt(&Cache->Paths, Kept.PathOffset),
+                              Kept.PathLength, Images.Length);
+        Append<cached_image>(&Images, Kept);
+    }
+
+    Empty(&Cache->Paths);
+    Empty<cached_image>(&Cache->Images);
+
+    Cache->Paths  = Paths;
+    Cache->Images = Images;
+}
+
+// CloneImage() makes [Clone] a clone of the image at [Path], from [Cache] if
+// it's there and hasn't changed since, loading it into the cache if not.
+// Returns ERROR, with [Reason] set to why, if it can't be loaded.
+static
+status_code CloneImage(image_cache *Cache,
+                       const char *Path,
+                       image *Clone,
+                       const char **Reason)
+{
+    struct stat Status;
+
+    if (stat(Path, &Status) != 0)
+    {
+        *Reason = "There's no such image.";
+        return ERROR;
+    }
+
+    long long ModifiedTime = Status.st_mtim.tv_sec * 1000000000ll +
+                             Status.st_mtim.tv_nsec;
+    unsigned int PathLength = (unsigned int)std::strlen(Path);
+
+    {
+        std::lock_guard<std::mutex> Guard (Cache->Lock);
+
+        status<unsigned int> Index = Get(&Cache->Paths, Path, PathLength);
+
+        if (Index.Status == OK)
+        {
+            cached_image *Cached = &Cache->Images[Index.unpack()];
+
+            if (Cached->Loaded && Cached->ModifiedTime == ModifiedTime)
+            {
+                Cache->Hits++;
+                Cached->LastUsed = ++Cache->Clock;
+
+                if (CloneTemplate(&Cached->Template, Clone) != OK)
+                {
+                    *Reason = "The image can't be cloned.";
+                    return ERROR;
+                }
+
+                return OK;
+            }
+        }
+
+        Cache->Misses++;
+    }
+
+    // NOTE Loading can take a while, so it happens outside of the lock.
+    // Two workers may load the same image at once; the last one to finish
+    // is the one that's kept.
+    image Image;
+    vm_template Template;
+
+    if (LoadImage(Path, &Image) != OK)
+    {
+        *Reason = "The image doesn't load.";
+        return ERROR;
+    }
+
+    // A template ready at the entry is just the loaded program.
+    status_code Made = CreateTemplate(&Image, (int)Image.Entry, NO_BUDGET,
+                                      NULL, &Template);
+
+    Unload(&Image);
+
+    if (Made != OK)
+    {
+        *Reason = "The image can't be cached.";
+        return ERROR;
+    }
+
+    std::lock_guard<std::mutex> Guard (Cache->Lock);
+
+    status<unsigned int> Index = Get(&Cache->Paths, Path, PathLength);
+
+    if (Index.Status == OK && Cache->Images[Index.unpack()].Loaded)
+    {
+        ReleaseTemplate(&Cache->Images[Index.unpack()].Template);
+        Cache->Images[Index.unpack()].Loaded = false;
+        Cache->LoadedCount--;
+    }
+
+    // Make room by dropping the image used least recently.
+    if (Cache->LoadedCount >= Cache->Size)
+    {
+        cached_image *Oldest = NULL;
+
+        for (unsigned int i = 0; i < Cache->Images.Length; i++)
+        {
+            cached_image *Other = &Cache->Images[i];
+
+            if (Other->Loaded &&
+                (!Oldest || Other->LastUsed < Oldest->LastUsed))
+            {
+                Oldest = Other;
+            }
+        }
+
+        if (Oldest)
+        {
+            ReleaseTemplate(&Oldest->Template);
+            Oldest->Loaded = false;
+            Cache->LoadedCount--;
+        }
+    }
+
+    Forget(Cache);
+
+    Index = Get(&Cache->Paths, Path, PathLength);
+
+    if (Index.Status != OK)
+    {
+        cached_image Unloaded = { };
+        Index = { OK, Cache->Images.Length };
+
+        Unloaded.PathOffset = Put(&Cache->Paths, Path, PathLength,
+                                  Index.unpack());
+        Unloaded.PathLength = PathLength;
+        Append<cached_image>(&Cache->Images, Unloaded);
+    }
+
+    cached_image *Cached = &Cache->Images[Index.unpack()];
+
+    Cached->Loaded       = true;
+    Cached->Template     = Template;
+    Cached->ModifiedTime = ModifiedTime;
+    Cached->LastUsed     = ++Cache->Clock;
+    Cache->LoadedCount++;
+
+    if (CloneTemplate(&Cached->Template, Clone) != OK)
+    {
+        *Reason = "The image can't be cloned.";
+        return ERROR;
+    }
+
+    return OK;
+}
+
+
+/** Workers. */
+
+// Wake() gets the server to look at its queue and whether it's been told to
+// stop, whether or not it's waiting yet. It's safe to call from a signal
+// handler.
+static
+void Wake()
+{
+    int SavedError = errno;
+    char Byte = 0;
+
+    // NOTE The pipe doesn't block, and if it's full, the server has plenty
+    // to wake it already.
+    ssize_t Written = write(WakeDescriptor, &Byte, 1);
+    (void)Written;
+
+    errno = SavedError;
+}
+
+// RunJob() runs [Job] on a clone of its image from [Server]'s cache, writing
+// what it prints, and how it went, to [Output]. Returns whether it ran.
+static
+bool RunJob(server *Server,
+            const job *Job,
+            FILE *Output,
+            std::chrono::steady_clock::time_point Accepted)
+{
+    const char *Reason = NULL;
+    image Clone;
+
+    if (CloneImage(&Server->Cache, Job->ImagePath.c_str(), &Clone,
+                   &Reason) != OK)
+    {
+        fprintf(Output, "! %s\n", Reason);
+        return false;
+    }
+
+    if (!Job->InputAddress.empty())
+    {
+        const char *Text = Job->InputAddress.c_str();
+        char *End = NULL;
+        long long Address = strtoll(Text, &End, 0);
+
+        status<unsigned int> Input = { OK, (unsigned int)Address };
+
+        if (End == Text || *End != '\0')
+            Input = FindSymbol(Job->ImagePath.c_str(), Text);
+        else if (Address < 0 || Address > 0xFFFFFFFFll)
+            Input.Status = ERROR;
+
+        if (Input.Status != OK)
+            Reason = "There's no such input address or label.";
+
+        else if (WriteInput(&Clone, Input.unpack(), Job->Input.Data,
+                            Job->Input.Length) != OK)
+            Reason = "The input doesn't fit in memory.";
+
+        if (Reason)
+        {
+            fprintf(Output, "! %s\n", Reason);
+            Unload(&Clone);
+            return false;
+        }
+    }
+
+    unsigned long long Budget = std::min(Job->Budget, Server->Options->Budget);
+    unsigned long long Steps = 0;
+
+    auto Start = std::chrono::steady_clock::now();
+
+    OutputFile = Output;
+
+    engine_status Stopped = Clone.Static && !Job->Checked ?
+                            RunUnchecked(Clone.Memory, Clone.Entry, NULL,
+                                         &Steps, Budget) :
+                            RunChecked(Clone.Memory, Clone.MemorySize,
+                                       Clone.Entry, NULL, &Steps, Budget);
+
+    OutputFile = stdout;
+
+    Record(&Server->Running, MicrosecondsSince(Start));
+
+    Unload(&Clone);
+
+    fprintf(Output, "= %s %llu %llu\n",
+            JobStatusNames[Stopped], Steps, MicrosecondsSince(Accepted));
+
+    return true;
+}
+
+// Serve() answers the request on the connection [Descriptor], accepted at
+// [Accepted].
+static
+void Serve(server *Server,
+           int Descriptor,
+           std::chrono::steady_clock::time_point Accepted)
+{
+    Record(&Server->Queued, MicrosecondsSince(Accepted));
+
+    struct timeval Timeout = { CONNECTION_TIMEOUT, 0 };
+
+    setsockopt(Descriptor, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+    setsockopt(Descriptor, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+
+    int WriteDescriptor = dup(Descriptor);
+
+    FILE *Input = fdopen(Descriptor, "r");
+    FILE *Output = WriteDescriptor >= 0 ? fdopen(WriteDescriptor, "w") : NULL;
+
+    if (!Input || !Output)
+    {
+        if (Input)
+            fclose(Input);
+        else
+            close(Descriptor);
+
+        if (Output)
+            fclose(Output);
+        else if (WriteDescriptor >= 0)
+            close(WriteDescriptor);
+
+        return;
+    }
+
+    job Job;
+    const char *Reason = NULL;
+
+    if (ReadJob(Input, &Job, &Reason) != OK)
+    {
+        fprintf(Output, "! %s\n", Reason);
+    }
+    else if (Job.Stats)
+    {
+        WriteStats(Server, Output);
+    }
+    else
+    {
+        Server->JobCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (!RunJob(Server, &Job, Output, Accepted))
+            Server->FailedCount.fetch_add(1, std::memory_order_relaxed);
+
+        Record(&Server->Total, MicrosecondsSince(Accepted));
+    }
+
+    Empty(&Job);
+
+    fclose(Output);
+    fclose(Input);
+}
+
+// Work() serves the connections in [Server]'s queue until it's stopped,
+// pinned to the [Index]th processor where it can be.
+static
+void Work(server *Server, unsigned int Index)
+{
+#if defined(__linux__)
+    cpu_set_t Processors;
+    CPU_ZERO(&Processors);
+    CPU_SET(Index % HardwareThreadCount(), &Processors);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(Processors), &Processors);
+#else
+    (void)Index;
+#endif
+
+    connection_queue *Queue = &Server->Queue;
+
+    for (;;)
+    {
+        queued_connection Connection;
+        bool WasFull;
+
+        {
+            std::unique_lock<std::mutex> Guard (Queue->Lock);
+
+            Queue->NotEmpty.wait(Guard, [&]()
+            {
+                return Queue->Count || Queue->Stopping;
+            });
+
+            if (!Queue->Count)
+                return;
+
+            WasFull = Queue->Count == Queue->Connections.Length;
+
+            Connection = Queue->Connections[Queue->Head];
+            Queue->Head = (Queue->Head + 1) % Queue->Connections.Length;
+            Queue->Count--;
+        }
+
+        // NOTE The server stops watching the socket while the queue is full.
+        if (WasFull)
+            Wake();
+
+        Serve(Server, Connection.Descriptor, Connection.Accepted);
+    }
+}
+
+
+/** The server. */
+
+// StopServing() tells the server to stop, once the jobs it has are done.
+static
+void StopServing(int Signal)
+{
+    (void)Signal;
+    StopRequested = 1;
+    Wake();
+}
+
+// RemoveSocket() removes the socket at [Path], if that's what's there, so
+// that whatever else might be there is never removed by mistake.
+static
+void RemoveSocket(const char *Path)
+{
+    struct stat Status;
+
+    if (lstat(Path, &Status) == 0 && S_ISSOCK(Status.st_mode))
+        unlink(Path);
+}
+
+// SetBlocking() makes reading and writing [Descriptor] wait if [Blocking],
+// and fail rather than wait if not.
+static
+void SetBlocking(int Descriptor, bool Blocking)
+{
+    int Flags = fcntl(Descriptor, F_GETFL);
+
+    if (Flags >= 0)
+        fcntl(Descriptor, F_SETFL, Blocking ? Flags & ~O_NONBLOCK :
+                                              Flags | O_NONBLOCK);
+}
+
+// RunServer() serves jobs on the socket at the path in [Options] until it's
+// interrupted, then prints its statistics. Returns ERROR, after saying why, if
+// it can't listen.
+static
+status_code RunServer(const serve_options *Options)
+{
+    sockaddr_un Address = { };
+    Address.sun_family = AF_UNIX;
+
+    if (std::strlen(Options->SocketPath) >= sizeof(Address.sun_path))
+    {
+        Error("The socket path \"%s\" is too long.\n", Options->SocketPath);
+        return ERROR;
+    }
+
+    std::strcpy(Address.sun_path, Options->SocketPath);
+
+    int Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    // NOTE A socket left behind by a server that didn't stop cleanly
+    // would keep us from binding. Anything else at the path is left alone,
+    // and binding fails.
+    RemoveSocket(Options->SocketPath);
+
+    int WakePipe[2] = { -1, -1 };
+
+    if (pipe(WakePipe) != 0 ||
+        Listener < 0 ||
+        bind(Listener, (sockaddr *)&Address, sizeof(Address)) != 0 ||
+        listen(Listener, SOMAXCONN) != 0)
+    {
+        Error("Failed to listen on \"%s\": %s.\n",
+              Options->SocketPath, strerror(errno));
+
+        if (Listener >= 0)
+            close(Listener);
+
+        if (WakePipe[0] >= 0)
+        {
+            close(WakePipe[0]);
+            close(WakePipe[1]);
+        }
+
+        return ERROR;
+    }
+
+    // NOTE A connection can go away between poll() saying it's there and
+    // accepting it, which mustn't leave us waiting in accept().
+    SetBlocking(Listener, false);
+    SetBlocking(WakePipe[0], false);
+    SetBlocking(WakePipe[1], false);
+
+    StopRequested = 0;
+    WakeDescriptor = WakePipe[1];
+
+    struct sigaction Action = { };
+    Action.sa_handler = StopServing;
+    sigemptyset(&Action.sa_mask);
+
+    sigaction(SIGINT, &Action, NULL);
+    sigaction(SIGTERM, &Action, NULL);
+
+    // A client that goes away only fails its own job.
+    signal(SIGPIPE, SIG_IGN);
+
+    server *Server = new server();
+    Server->Options    = Options;
+    Server->Cache.Size = std::max(1u, Options->CacheSize);
+
+    unsigned int WorkerCount = std::max(1u, Options->WorkerCount);
+
+    Reserve<queued_connection>(&Server->Queue.Connections,
+                               WorkerCount * QUEUE_SIZE_PER_WORKER);
+    Server->Queue.Connections.Length = WorkerCount * QUEUE_SIZE_PER_WORKER;
+
+    // NOTE The workers don't take the signals, so that they always
+    // interrupt poll().
+    sigset_t Signals, Previous;
+    sigemptyset(&Signals);
+    sigaddset(&Signals, SIGINT);
+    sigaddset(&Signals, SIGTERM);
+
+    pthread_sigmask(SIG_BLOCK, &Signals, &Previous);
+
+    std::thread *Workers = new std::thread[WorkerCount];
+
+    for (unsigned int i = 0; i < WorkerCount; i++)
+        Workers[i] = std::thread(Work, Server, i);
+
+    pthread_sigmask(SIG_SETMASK, &Previous, NULL);
+
+    Info("Serving on \"%s\" with %u workers.\n",
+         Options->SocketPath, WorkerCount);
+    fflush(stdout);
+
+    connection_queue *Queue = &Server->Queue;
+
+    while (!StopRequested)
+    {
+        bool Full;
+
+        {
+            std::lock_guard<std::mutex> Guard (Queue->Lock);
+            Full = Queue->Count == Queue->Connections.Length;
+        }
+
+        // NOTE Only the pipe is watched while the queue is full, until a
+        // worker makes room.
+        pollfd Watched[2] = {
+            { WakePipe[0], POLLIN, 0 },
+            { Listener, (short)(Full ? 0 : POLLIN), 0 }
+        };
+
+        if (poll(Watched, 2, -1) < 0)
+            continue;
+
+        if (Watched[0].revents & POLLIN)
+        {
+            char Bytes[64];
+
+            while (read(WakePipe[0], Bytes, sizeof(Bytes)) > 0) { }
+        }
+
+        if (!(Watched[1].revents & POLLIN))
+            continue;
+
+        int Descriptor = accept(Listener, NULL, NULL);
+
+        if (Descriptor < 0)
+            continue;
+
+        // NOTE Whether a connection takes after the socket that accepted it
+        // differs from system to system.
+        SetBlocking(Descriptor, true);
+
+        {
+            std::lock_guard<std::mutex> Guard (Queue->Lock);
+
+            unsigned int Tail = (Queue->Head + Queue->Count) %
+                                Queue->Connections.Length;
+
+            Queue->Connections[Tail] = {
+                Descriptor, std::chrono::steady_clock::now()
+            };
+            Queue->Count++;
+        }
+
+        Queue->NotEmpty.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> Guard (Queue->Lock);
+        Queue->Stopping = true;
+    }
+
+    Queue->NotEmpty.notify_all();
+
+    for (unsigned int i = 0; i < WorkerCount; i++)
+        Workers[i].join();
+
+    close(Listener);
+    RemoveSocket(Options->SocketPath);
+
+    WakeDescriptor = -1;
+    close(WakePipe[0]);
+    close(WakePipe[1]);
+
+    WriteStats(Server, stdout);
+
+    for (unsigned int i = 0; i < Server->Cache.Images.Length; i++)
+    {
+        if (Server->Cache.Images[i].Loaded)
+            ReleaseTemplate(&Server->Cache.Images[i].Template);
+    }
+
+    Empty(&Server->Cache.Paths);
+    Empty<cached_image>(&Server->Cache.Images);
+    Empty<queued_connection>(&Server->Queue.Connections);
+
+    delete[] Workers;
+    delete Server;
+
+    return OK;
+}
+
+#undef QUEUE_SIZE_PER_WORKER
+#undef CONNECTION_TIMEOUT
+#undef HISTOGRAM_BUCKETS
@@ -0,0 +1,220 @@
+/**
+ * @file stats.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the stats segment, where a running program's counters
+ * are published for subleq-top (see src/subleq-top) to watch, shared by the
+ * emulator and the engines (see engine.cpp).
+ *
+ * The segment is a small piece of shared memory with a name, which the
+ * emulator makes and the watcher maps read only. The engine only ever stores
+ * into it, with relaxed atomics, once every STATS_BLOCK instructions and when
+ * it stops, so publishing costs it no system calls and next to no time. In
+ * between, the engine counts in variables of its own.
+ *
+ * The segment holds how many instructions have run, how many of them jumped,
+ * and where the program counter was. How many wrote to a cell of an
+ * instruction that had already run is only counted if the segment is made
+ * with STATS_SELF_MODIFYING, since that slows the engine down a lot. How fast
+ * instructions are running is up to the watcher, from how fast the count goes
+ * up; the engine doesn't read a clock.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <new>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Own Libraries
+#include "util.cpp"
+
+
+// MAGIC Often enough that a watcher polling a few times a second sees
+// every change, rarely enough that publishing doesn't show up in a profile.
+#define STATS_BLOCK (64 * 1024)
+
+#define STATS_VERSION 2
+
+#define STATS_RUNNING 1 // The program is still running.
+#define STATS_STOPPED 2 // It's stopped, and the counters are final.
+
+// What the segment asks the engine to count, on top of what it always does.
+#define STATS_SELF_MODIFYING 1 // Writes to code that has run.
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The counters are shared with another process.");
+
+struct stats_segment {
+    char Magic[4];
+    uint32_t Version;
+    // The process running the program.
+    uint32_t ProcessId;
+    std::atomic<uint32_t> State;
+    // What's counted, on top of what always is.
+    uint32_t Flags;
+    // How many instructions have run.
+    std::atomic<uint64_t> Steps;
+    // How many of them jumped.
+    std::atomic<uint64_t> Taken;
+    // How many of them wrote to a cell of an instruction that had run.
+    std::atomic<uint64_t> SelfModifying;
+    // The address of the next instruction to run.
+    std::atomic<int64_t> Counter;
+};
+
+static const char StatsMagic[4] = { 'S', 'Q', 'S', '\0' };
+
+
+// PublishStats() stores the counters into [Segment], without ordering them
+// with anything else.
+static inline
+void PublishStats(stats_segment *Segment,
+                  uint64_t Steps,
+                  uint64_t Taken,
+                  uint64_t SelfModifying,
+                  int Counter)
+{
+    Segment->Steps.store(Steps, std::memory_order_relaxed);
+    Segment->Taken.store(Taken, std::memory_order_relaxed);
+    Segment->SelfModifying.store(SelfModifying, std::memory_order_relaxed);
+    Segment->Counter.store(Counter, std::memory_order_relaxed);
+}
+
+#if !defined(_WIN32)
+
+// StatsPath() writes the name of the shared memory object called [Name] to
+// [Path], [Size] bytes long, with the slash in front of it that it needs.
+// Returns whether it fit.
+static inline
+bool StatsPath(const char *Name, char *Path, size_t Size)
+{
+    int Length = snprintf(Path, Size, "%s%s", Name[0] == '/' ? "" : "/",
+                          Name);
+
+    return Length >= 0 && (size_t)Length < Size;
+}
+
+// CreateStats() makes a stats segment called [Name], replacing any there was,
+// asking for what's in [Flags] to be counted, and returns it, or NULL after
+// saying why if it can't.
+static inline
+stats_segment *CreateStats(const char *Name, uint32_t Flags = 0)
+{
+    char Path[256];
+
+    if (!StatsPath(Name, Path, sizeof(Path)))
+    {
+        Error("The stats segment's name \"%s\" is too long.\n", Name);
+        return NULL;
+    }
+
+    shm_unlink(Path);
+
+    int Descriptor = shm_open(Path, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if (Descriptor < 0 ||
+        ftruncate(Descriptor, sizeof(stats_segment)) != 0)
+    {
+        Error("Failed to make the stats segment \"%s\".\n", Path);
+
+        if (Descriptor >= 0)
+        {
+            close(Descriptor);
+            shm_unlink(Path);
+        }
+
+        return NULL;
+    }
+
+    void *Mapping = mmap(NULL, sizeof(stats_segment), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, Descriptor, 0);
+
+    close(Descriptor);
+
+    if (Mapping == MAP_FAILED)
+    {
+        Error("Failed to map the stats segment \"%s\".\n", Path);
+        shm_unlink(Path);
+        return NULL;
+    }
+
+    stats_segment *Segment = new (Mapping) stats_segment();
+
+    std::memcpy(Segment->Magic, StatsMagic, sizeof(StatsMagic));
+    Segment->Version   = STATS_VERSION;
+    Segment->ProcessId = (uint32_t)getpid();
+    Segment->Flags     = Flags;
+    Segment->State.store(STATS_RUNNING, std::memory_order_release);
+
+    return Segment;
+}
+
+// OpenStats() maps the stats segment called [Name] to read it, and returns
+// it, or NULL if there's no such segment.
+static inline
+const stats_segment *OpenStats(const char *Name)
+{
+    char Path[256];
+
+    if (!StatsPath(Name, Path, sizeof(Path)))
+        return NULL;
+
+    int Descriptor = shm_open(Path, O_RDONLY, 0);
+
+    if (Descriptor < 0)
+        return NULL;
+
+    struct stat Status;
+    void *Mapping = MAP_FAILED;
+
+    if (fstat(Descriptor, &Status) == 0 &&
+        Status.st_size >= (off_t)sizeof(stats_segment))
+    {
+        Mapping = mmap(NULL, sizeof(stats_segment), PROT_READ, MAP_SHARED,
+                       Descriptor, 0);
+    }
+
+    close(Descriptor);
+
+    if (Mapping == MAP_FAILED)
+        return NULL;
+
+    const stats_segment *Segment = (const stats_segment *)Mapping;
+
+    if (std::memcmp(Segment->Magic, StatsMagic, sizeof(StatsMagic)) != 0 ||
+        Segment->Version != STATS_VERSION)
+    {
+        munmap(Mapping, sizeof(stats_segment));
+        return NULL;
+    }
+
+    return Segment;
+}
+
+// ReleaseStats() unmaps [Segment], and if [Name] is given, removes it so that
+// nothing else can open it. Whoever has it mapped can still read it.
+static inline
+void ReleaseStats(const stats_segment *Segment, const char *Name = NULL)
+{
+    munmap((void *)Segment, sizeof(stats_segment));
+
+    char Path[256];
+
+    // NOTE A name too long to make a segment of has none to remove.
+    if (Name && StatsPath(Name, Path, sizeof(Path)))
+        shm_unlink(Path);
+}
+
+#endif
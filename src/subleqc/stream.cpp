@@ -0,0 +1,415 @@
+/**
+ * @file stream.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the streaming mode of the assembler, for sources too big
+ * to hold in memory. The source is read a window of whole lines at a time;
+ * each window is parsed like a chunk and its code written out straight away.
+ * The only things kept between windows are the labels and the references to
+ * labels that haven't been declared yet. Those references are patched in the
+ * output file once the whole source has been read, which needs the words as
+ * they were written, so those are kept too.
+ *
+ * NOTE The program is never all in memory, so it isn't analyzed, and the
+ * image says so: its facts and partition are left at zero, and the emulator
+ * runs it checked.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <fstream>
+#include <algorithm>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "arena.cpp"
+#include "assembler.cpp"
+#include "image.cpp"
+
+
+// MAGIC Big enough that per-window overhead disappears, small enough
+// that it doesn't matter.
+#define STREAM_WINDOW_SIZE (1024 * 1024)
+
+struct patch {
+    unsigned int Offset;
+    int Value;
+};
+
+
+// AssembleStream() assembles [SourceFile] into [BinaryFile] one window at a
+// time, reporting any errors as it goes, as an image asking for [MemorySize]
+// cells of memory, with its labels if [Symbols]. Returns how many errors
+// there were; if there were any, the contents of [BinaryFile] are
+// meaningless.
+static
+unsigned int AssembleStream(std::ifstream *SourceFile,
+                            std::ofstream *BinaryFile,
+                            unsigned int MemorySize,
+                            bool Symbols)
+{
+    unsigned int ErrorCount = 0;
+
+    // Every label seen so far, at its final address. Fixups in here are
+    // references (by output word) that were written out before their label
+    // was declared.
+    symbol_table Labels = { };
+
+    // Holds the messages for errors we can only report once we're done.
+    arena Arena = { };
+
+    buffer<char> Window = { };
+    buffer<int>  Code   = { };
+
+    // The words that still need patching, as they were written out.
+    buffer<patch> Unpatched = { };
+
+    unsigned int Base     = 0;
+    unsigned int LineBase = 0;
+
+    bool EndOfFile = false;
+
+    // NOTE We don't know how long the program is until we're done, so
+    // the header is written again then. Zeros at the end aren't worth
+    // holding back, they stay in the code.
+    WriteHeader(BinaryFile, 0, 0, 0, IMAGE_CELLS, 0, 0, 0);
+
+    while (!EndOfFile || Window.Length)
+    {
+        if (!EndOfFile)
+        {
+            Reserve<char>(&Window, Window.Length + STREAM_WINDOW_SIZE);
+
+            SourceFile->read(Window.Data + Window.Length, STREAM_WINDOW_SIZE);
+
+            unsigned int ReadLength = (unsigned int)SourceFile->gcount();
+            Window.Length += ReadLength;
+
+            EndOfFile = ReadLength < STREAM_WINDOW_SIZE;
+        }
+
+        // Only hand whole lines to the parser; the rest of the window waits
+        // for the next read. An instruction never goes on past the end of its
+        // line, so any line will do.
+        unsigned int Length = Window.Length;
+
+        if (!EndOfFile)
+        {
+            while (Length > 0 && Window[Length - 1] != '\n')
+                Length--;
+
+            // NOTE A line longer than the window; keep reading until we
+            // find its end.
+            if (Length == 0)
+                continue;
+        }
+
+
+        /** Parse the window. */
+
+        assembler Assembler    = { };
+        Assembler.Source       = Window.Data;
+        Assembler.SourceLength = Length;
+        Assembler.ThreadCount  = 1;
+
+        IndexLines(Window.Data, Length, &Assembler.LineStarts);
+
+        chunk Chunk = { };
+        Chunk.Begin = 0;
+        Chunk.End   = Length;
+        Chunk.Base  = Base;
+
+        Parse(&Assembler, &Chunk);
+
+
+        /** Declare the window's labels. */
+
+        for (unsigned int i = 0; i < Chunk.Symbols.Symbols.Length; i++)
+        {
+            symbol *Local = &Chunk.Symbols.Symbols[i];
+
+            if (!Local->Defined)
+                continue;
+
+            const char *Name = SymbolName(&Chunk.Symbols, i);
+
+            symbol *Global = &Labels.Symbols[Intern(&Labels,
+                                                    Name,
+                                                    Local->NameLength)];
+
+            if (Global->Defined)
+            {
+                Append<error>(&Chunk.Errors,
+                              GenerateError(&Chunk.Arena,
+                                            &Local->Declaration,
+                                            "Redeclared label \"%.*s\"",
+                                            Local->NameLength,
+                                            Name));
+            }
+            else
+            {
+                Global->Address     = Base + Local->Address;
+                Global->Defined     = true;
+                Global->Declaration = Local->Declaration;
+            }
+        }
+
+
+        /** Resolve what we can, and hold back the rest. */
+
+        unsigned int FirstUnpatched = Unpatched.Length;
+
+        for (unsigned int i = 0; i < Chunk.Symbols.Symbols.Length; i++)
+        {
+            symbol *Local = &Chunk.Symbols.Symbols[i];
+
+            if (Local->FirstFixup == NO_FIXUP)
+                continue;
+
+            unsigned int Index = Intern(&Labels,
+                                        SymbolName(&Chunk.Symbols, i),
+                                        Local->NameLength);
+
+            for (unsigned int j = Local->FirstFixup;
+                 j != NO_FIXUP;
+                 j = Chunk.Symbols.Fixups[j].Next)
+            {
+                fixup *Fixup = &Chunk.Symbols.Fixups[j];
+
+                // NOTE A reference in an instruction that was never
+                // finished (no EOL before the end of the source) has nothing
+                // to patch, but still has to be declared.
+                instruction *Instruction =
+                    FindInstruction(Chunk.Instructions.Data,
+                                    Chunk.Instructions.Length,
+                                    Fixup->Offset);
+
+                // Like every label of the window, the address is relative to
+                // the start of the window.
+                if (Labels.Symbols[Index].Defined)
+                {
+                    AddAddress(Instruction,
+                               Fixup->Offset,
+                               Fixup->Negative,
+                               Labels.Symbols[Index].Address - Base);
+                }
+                else
+                {
+                    token Reference = Fixup->Token;
+                    Reference.LineNumber += LineBase;
+
+                    // NOTE Until it's patched, the label is taken to be
+                    // at address 0, so the patch is just its address.
+                    AddAddress(Instruction,
+                               Fixup->Offset,
+                               Fixup->Negative,
+                               0u - Base);
+
+                    // One-address instructions are written out with their
+                    // address twice, and a .fill over and over, so every
+                    // word needs patching.
+                    unsigned int Words = Instruction ?
+                                         ReferenceLength(Instruction,
+                                                         Fixup->Offset) :
+                                         1;
+
+                    for (unsigned int l = 0; l < Words; l++)
+                    {
+                        AddFixup(&Labels,
+                                 Index,
+                                 Base + Fixup->Offset + l,
+                                 Reference,
+                                 Fixup->Negative);
+
+                        if (Instruction)
+                        {
+                            Append<patch>(&Unpatched, (patch) {
+                                .Offset = Base + Fixup->Offset + l,
+                                .Value  = 0
+                            });
+                        }
+                    }
+                }
+            }
+        }
+
+        ErrorCount += Chunk.Errors.Length;
+        ReportErrors(&Chunk.Errors,
+                     Window.Data,
+                     Length,
+                     &Assembler.LineStarts,
+                     LineBase);
+
+
+        /** Generate and write the window's code. */
+
+        Clear<int>(&Code);
+        Reserve<int>(&Code, Chunk.Length);
+        Code.Length = Chunk.Length;
+
+        GenerateCode(Chunk.Instructions.Data,
+                     Chunk.Instructions.Length,
+                     Base,
+                     Code.Data);
+
+        for (unsigned int i = FirstUnpatched; i < Unpatched.Length; i++)
+            Unpatched[i].Value = Code[Unpatched[i].Offset - Base];
+
+        BinaryFile->write((char *)Code.Data, sizeof(int) * Code.Length);
+
+        Base     += Code.Length;
+        LineBase += Assembler.LineStarts.Length - 1;
+
+
+        /** Keep the unparsed tail of the window for the next one. */
+
+        std::copy(Window.Data + Length,
+                  Window.Data + Window.Length,
+                  Window.Data);
+        Window.Length -= Length;
+
+        Empty<instruction>(&Chunk.Instructions);
+        Empty(&Chunk.Symbols);
+        Empty<error>(&Chunk.Errors);
+        Free(&Chunk.Arena);
+        Empty<unsigned int>(&Assembler.LineStarts);
+    }
+
+
+    /** Patch the references that were written before their labels. */
+
+    buffer<patch> Patches = { };
+    Reserve<patch>(&Patches, Labels.Fixups.Length);
+
+    buffer<error> Errors = { };
+
+    for (unsigned int i = 0; i < Labels.Symbols.Length; i++)
+    {
+        symbol *Symbol = &Labels.Symbols[i];
+
+        for (unsigned int j = Symbol->FirstFixup;
+             j != NO_FIXUP;
+             j = Labels.Fixups[j].Next)
+        {
+            fixup *Fixup = &Labels.Fixups[j];
+
+            // NOTE A reference to more than one word has a fixup for
+            // each of them, one after the other, so it's only reported once.
+            bool Repeated =
+                Fixup->Next != NO_FIXUP &&
+                Labels.Fixups[Fixup->Next].Token.LineNumber ==
+                    Fixup->Token.LineNumber &&
+                Labels.Fixups[Fixup->Next].Token.Column ==
+                    Fixup->Token.Column;
+
+            if (Symbol->Defined)
+            {
+                Append<patch>(&Patches, (patch) {
+                    .Offset = Fixup->Offset,
+                    .Value  = Fixup->Negative ? -(int)Symbol->Address :
+                                                (int)Symbol->Address
+                });
+            }
+            else if (!Repeated)
+            {
+                Append<error>(&Errors,
+                              GenerateError(&Arena,
+                                            &Fixup->Token,
+                                            "Undeclared identifier \"%.*s\"",
+                                            Symbol->NameLength,
+                                            SymbolName(&Labels, i)));
+            }
+        }
+    }
+
+    // The source is long gone, so these errors come without their lines.
+    for (unsigned int i = 0; i < Errors.Length; i++)
+        ReportError(&Errors[i], NULL, 0);
+
+    ErrorCount += Errors.Length;
+
+    if (ErrorCount == 0)
+    {
+        // NOTE Patch in output order so the writes sweep through the
+        // file once. A word can refer to more than one label, and all of
+        // their addresses go into it at once.
+        auto ByOffset = [](const patch &A, const patch &B)
+        {
+            return A.Offset < B.Offset;
+        };
+
+        std::sort(Patches.Data, Patches.Data + Patches.Length, ByOffset);
+        std::sort(Unpatched.Data, Unpatched.Data + Unpatched.Length, ByOffset);
+
+        for (unsigned int i = 0; i < Patches.Length; )
+        {
+            unsigned int Offset = Patches[i].Offset;
+
+            patch *Written = std::lower_bound(Unpatched.Data,
+                                              Unpatched.Data +
+                                              Unpatched.Length,
+                                              Patches[i],
+                                              ByOffset);
+
+            // NOTE A reference in an instruction that was never
+            // finished was never written.
+            bool Found = Written != Unpatched.Data + Unpatched.Length &&
+                         Written->Offset == Offset;
+
+            unsigned int Value = Found ? (unsigned int)Written->Value : 0;
+
+            for (; i < Patches.Length && Patches[i].Offset == Offset; i++)
+                Value += (unsigned int)Patches[i].Value;
+
+            if (!Found)
+                continue;
+
+            BinaryFile->seekp(sizeof(image_header) + sizeof(int) * Offset);
+            BinaryFile->write((char *)&Value, sizeof(int));
+        }
+
+        unsigned int SymbolCount = 0;
+        unsigned int SymbolOffset = sizeof(image_header) + sizeof(int) * Base;
+
+        BinaryFile->seekp(SymbolOffset);
+
+        for (unsigned int i = 0; Symbols && i < Labels.Symbols.Length; i++)
+        {
+            symbol *Symbol = &Labels.Symbols[i];
+
+            if (!Symbol->Defined)
+                continue;
+
+            uint32_t Fields[2] = { Symbol->Address, Symbol->NameLength };
+
+            BinaryFile->write((char *)Fields, sizeof(Fields));
+            BinaryFile->write(SymbolName(&Labels, i), Symbol->NameLength);
+
+            SymbolCount++;
+        }
+
+        BinaryFile->seekp(0);
+
+        WriteHeader(BinaryFile,
+                    Base,
+                    0,
+                    MemorySize,
+                    IMAGE_CELLS,
+                    sizeof(int) * Base,
+                    SymbolCount,
+                    SymbolOffset);
+    }
+
+    Empty<patch>(&Patches);
+    Empty<patch>(&Unpatched);
+    Empty<error>(&Errors);
+    Empty<char>(&Window);
+    Empty<int>(&Code);
+    Empty(&Labels);
+    Free(&Arena);
+
+    return ErrorCount;
+}
@@ -6,8 +6,6 @@
  * This is the assembler for turning SUBLEQ assembly into a plain binary that
  * is to be interpreted by subleq.exe.
  *
- * TODO[joe]:
- * - Add commandline argument parsing.
  */
 
 // C/C++ stdlib
@@ -17,17 +15,27 @@
 #include <cassert>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
 
 // Internal libs
 #include "util.cpp"
 #include "buffer.cpp"
-#include "stack.cpp"
-#include "token.cpp"
-#include "lexer.cpp"
-#include "hashmap.cpp"
+#include "arena.cpp"
+#include "assembler.cpp"
+#include "stream.cpp"
+#include "watch.cpp"
+#include "optimizer.cpp"
+#include "layout.cpp"
+#include "image.cpp"
+#include "object.cpp"
 
 
-#define UsageString "Usage: subleqc <input file> <output file>\n"
+#define UsageString \
+    "Usage: subleqc [-j <threads>] [-c] " \
+    "[-O [--drop-prints] [--rewrites <database>]] " \
+    "[--profile <profile>] [--memory <cells>] [--symbols] [--compress] " \
+    "[--stream | --watch] " \
+    "<input file> <output file>\n"
 
 
 enum exit_status {
@@ -37,49 +45,104 @@ enum exit_status {
     UNKNOWN
 };
 
-struct instruction {
-    int Parameters[3];
-    unsigned int ParameterCount;
-    unsigned int Location;
-};
-
-struct error {
-    char *Message;
-    char *SourceLine;
-    unsigned int LineNumber;
-    unsigned int FirstColumn;
-    unsigned int LastColumn;
+struct options {
+    const char *InputFile;
+    const char *OutputFile;
+    // How many threads to assemble with. Defaults to one per hardware
+    // thread.
+    unsigned int ThreadCount;
+    // Whether to assemble a window at a time instead of reading the whole
+    // source into memory.
+    bool Stream;
+    // Whether to keep re-assembling the source whenever it changes.
+    bool Watch;
+    // Whether to run the peephole optimizer over the program, whether it may
+    // change what the program prints, and the rewrite database it should
+    // apply, if any.
+    bool Optimize;
+    bool DropPrints;
+    const char *RewriteFile;
+    // The execution profile to lay the program out by, if any.
+    const char *ProfileFile;
+    // How many cells of memory the program asks for. It always gets at least
+    // as many as it has.
+    unsigned int MemorySize;
+    // Whether to write the address of every label into the image.
+    bool Symbols;
+    // Whether to pack the image's code (see pack.cpp).
+    bool Compress;
+    // Whether to write a relocatable object (see object.cpp) instead of an
+    // image.
+    bool Object;
 };
 
 
-static
-error GenerateError(const char *Message, token *Token)
+int main(int argc, char** argv)
 {
-    error Error = { };
-
-    char *TypeString = TokenTypeToString(Token->Type);
-
-    // MAGIC[joe] 256 is an arbitray value selected based on an estimation of
-    // how long an error message is expected to be. This has no other basis
-    // than some sloppy mental math.
-    Error.Message = new char[256];
-
-    sprintf(Error.Message,
-            Message,
-            TokenTypeToString(Token->Type));
-
-    Error.LineNumber  = Token->LineNumber;
-    Error.FirstColumn = Token->LastColumn - strlen(Token->Text);
-    Error.LastColumn  = Token->LastColumn;
-
-    return Error;
-}
-
+    options Options = { };
+    Options.ThreadCount = HardwareThreadCount();
 
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            Options.ThreadCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "-c") == 0)
+        {
+            Options.Object = true;
+        }
+        else if (std::strcmp(argv[i], "-O") == 0)
+        {
+            Options.Optimize = true;
+        }
+        else if (std::strcmp(argv[i], "--drop-prints") == 0)
+        {
+            Options.DropPrints = true;
+        }
+        else if (std::strcmp(argv[i], "--rewrites") == 0 && i + 1 < argc)
+        {
+            Options.RewriteFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            Options.ProfileFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+        {
+            Options.MemorySize = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--symbols") == 0)
+        {
+            Options.Symbols = true;
+        }
+        else if (std::strcmp(argv[i], "--compress") == 0)
+        {
+            Options.Compress = true;
+        }
+        else if (std::strcmp(argv[i], "--stream") == 0)
+        {
+            Options.Stream = true;
+        }
+        else if (std::strcmp(argv[i], "--watch") == 0)
+        {
+            Options.Watch = true;
+        }
+        else if (!Options.InputFile)
+        {
+            Options.InputFile = argv[i];
+        }
+        else if (!Options.OutputFile)
+        {
+            Options.OutputFile = argv[i];
+        }
+        else
+        {
+            Warning("Ignoring extra argument \"%s\".\n", argv[i]);
+        }
+    }
 
-int main(int argc, char** argv)
-{
-    if (argc == 1)
+    if (!Options.InputFile)
     {
         Severe("No input file specified, exiting.\n");
 
@@ -87,7 +150,7 @@ int main(int argc, char** argv)
 
         return MISSING_ARGS;
     }
-    else if (argc == 2)
+    else if (!Options.OutputFile)
     {
         Severe("Missing either input or output file name, exiting.\n");
 
@@ -96,297 +159,228 @@ int main(int argc, char** argv)
         return MISSING_ARGS;
     }
 
-    std::ifstream SourceFile (argv[1],
-                              std::ifstream::in | std::ifstream::binary);
+    // NOTE An object is only part of a program, so everything that
+    // needs the whole program, or shapes the image, is up to the linker.
+    if (Options.Object &&
+        (Options.Optimize || Options.ProfileFile || Options.MemorySize ||
+         Options.Symbols || Options.Compress || Options.Stream ||
+         Options.Watch))
+    {
+        Warning("Ignoring -O, --profile, --memory, --symbols, --compress, "
+                "--stream and --watch, which can't be combined with -c.\n");
+
+        Options.Optimize    = false;
+        Options.DropPrints  = false;
+        Options.RewriteFile = NULL;
+        Options.ProfileFile = NULL;
+        Options.MemorySize  = 0;
+        Options.Symbols     = false;
+        Options.Compress    = false;
+        Options.Stream      = false;
+        Options.Watch       = false;
+    }
 
-    if (!SourceFile)
+    if (Options.DropPrints && !Options.Optimize)
+        Warning("Ignoring --drop-prints without -O.\n");
+
+    if (Options.RewriteFile && !Options.Optimize)
+        Warning("Ignoring --rewrites without -O.\n");
+
+    // NOTE Neither mode ever has the whole program to optimize.
+    if (Options.Optimize && (Options.Stream || Options.Watch))
     {
-        Error("Failed to open input file \"%s\", exiting.\n", argv[1]);
+        Warning("Ignoring -O, which can't be combined with --stream or "
+                "--watch.\n");
+    }
 
-        return UNKNOWN;
+    if (Options.ProfileFile && (Options.Stream || Options.Watch))
+    {
+        Warning("Ignoring --profile, which can't be combined with --stream or "
+                "--watch.\n");
     }
 
-    SourceFile.seekg(0, std::ios::end);
-    long SourceFileSize = SourceFile.tellg();
-    SourceFile.seekg(0, std::ios::beg);
+    // NOTE Both modes write cells in place after the fact.
+    if (Options.Compress && (Options.Stream || Options.Watch))
+    {
+        Warning("Ignoring --compress, which can't be combined with --stream "
+                "or --watch.\n");
+    }
 
-    char *RawProgram = new char[SourceFileSize + 1];
+    if (Options.Symbols && Options.Watch)
+        Warning("Ignoring --symbols, which can't be combined with --watch.\n");
 
-    SourceFile.read(RawProgram, SourceFileSize);
-
-    SourceFile.close();
+    if (Options.Watch)
+    {
+        Watch(Options.InputFile, Options.OutputFile, Options.MemorySize);
+    }
 
-    // Ensure that our raw program input is a well-formed c-string.
-    RawProgram[SourceFileSize] = '\0';
+    std::ifstream SourceFile (Options.InputFile,
+                              std::ifstream::in | std::ifstream::binary);
 
+    if (!SourceFile)
+    {
+        Error("Failed to open input file \"%s\", exiting.\n",
+              Options.InputFile);
 
-    /** Split source into lines for error reporting. */
-    buffer<char *> Lines = { };
-    buffer<char>   Line  = { };
+        return UNKNOWN;
+    }
 
-    for (char *Character = RawProgram;
-         *Character != '\0';
-         Character++)
+    if (Options.Stream)
     {
-        Append<char>(&Line, *Character);
+        std::ofstream BinaryFile (Options.OutputFile,
+                                  std::ofstream::out | std::ofstream::binary);
 
-        if (*Character == '\n')
+        if (!BinaryFile)
         {
-            Append<char>(&Line, '\0');
-            Append<char *>(&Lines, Line.Data);
-
-            // NOTE[joe] We don't use Empty() here since it would free memory
-            // we'd want to use later.
-            Line = { };
+            printf("Error: Failed to open output file \"%s\", exiting.\n",
+                   Options.OutputFile);
+            return UNKNOWN;
         }
-    }
 
+        unsigned int ErrorCount = AssembleStream(&SourceFile,
+                                                 &BinaryFile,
+                                                 Options.MemorySize,
+                                                 Options.Symbols);
 
-    /** Configure lexer. */
+        BinaryFile.close();
 
-    lexer Lexer  = { };
-    Lexer.Source = RawProgram;
+        // NOTE Unlike the in-memory path, we've already written code by
+        // the time we find out about errors. Don't leave a broken binary.
+        if (ErrorCount)
+        {
+            std::remove(Options.OutputFile);
+            return SYNTAX_ERROR;
+        }
 
+        return NORMAL;
+    }
 
-    /** Parse tokens into instructions. */
+    SourceFile.seekg(0, std::ios::end);
+    long SourceFileSize = SourceFile.tellg();
+    SourceFile.seekg(0, std::ios::beg);
 
-    unsigned int CurrentAddress = 0;
+    // Everything that lives as long as the assembly goes on this arena.
+    arena Arena = { };
 
-    buffer<instruction> Instructions = { };
-    instruction         CurrentInstruction = { };
+    char *RawProgram = PushArray(&Arena, SourceFileSize + 1, char);
 
-    buffer<error> Errors = { };
+    SourceFile.read(RawProgram, SourceFileSize);
 
-    hashmap Labels = { };
+    SourceFile.close();
 
-#define PARSER_STATES \
-    _(INVALID) \
-    _(START) \
-    _(LABEL) \
-    _(PARAM) \
-    _(COMMA) \
+    // Ensure that our raw program input is a well-formed c-string.
+    RawProgram[SourceFileSize] = '\0';
 
-    enum parser_state {
-#define _(S) PARSER_STATE_##S,
-        PARSER_STATES
-#undef _
-    } ParserState = PARSER_STATE_START;
 
+    /** Assemble the program. */
 
-    for (token Token = NextToken(&Lexer);
-         Token.Type != NONE;
-         Token = NextToken(&Lexer))
-    {
-#define TokenIs(T) (Token.Type == T)
-#define StateIs(S) (ParserState == PARSER_STATE_##S)
+    assembler Assembler = { };
+    Assembler.Relocatable = Options.Object;
 
-#define AddParameter(V) CurrentInstruction.Parameters[CurrentInstruction.ParameterCount++] = V
-#define TransitionTo(S) ParserState = PARSER_STATE_##S
+    Assemble(&Assembler, RawProgram, SourceFileSize, Options.ThreadCount);
 
-        // If the token we're reading is a NUMBER and the state we're at is...
-        if (TokenIs(NUMBER))
-        {
-            if (StateIs(START) || StateIs(LABEL) || StateIs(COMMA))
-            {
-                CurrentAddress++;
-                AddParameter(atoi(Token.Text));
-
-                TransitionTo(PARAM);
-            }
-            else
-            {
-                // TODO[joe] Error reporting...
-                Unreachable();
-            }
-        }
-        // If the token we're reading is a QMARK and the state we're at is...
-        else if (TokenIs(QMARK))
-        {
-            if (StateIs(START) || StateIs(LABEL) || StateIs(COMMA))
-            {
-                AddParameter(++CurrentAddress);
-
-                TransitionTo(PARAM);
-            }
-            else
-            {
-                // TODO[joe] Error reporting...
-                Unreachable();
-            }
-        }
-        // If the token we're reading is an IDENT and the state we're at is...
-        else if (TokenIs(IDENT))
-        {
-            if (StateIs(START) || StateIs(LABEL) || StateIs(COMMA))
-            {
-                status<unsigned int> Result = Get(&Labels, Token.Text);
-
-                if (Result.Status == ERROR)
-                {
-                    Error("Undeclared identifier: %s\n", Token.Text);
-                    // todo(jrm): Determine if all we need to do is report an
-                    // error, or add it to the error queue.
-                }
-                else
-                {
-                    unsigned int Address = Result.unpack();
-
-                    CurrentAddress++;
-                    AddParameter(Address);
-                }
-
-                TransitionTo(PARAM);
-            }
-            else
-            {
-                // TODO[joe] Error reporting...
-                Unreachable();
-            }
-        }
-        // If the token we're reading is a LABEL and the state we're at is...
-        else if (TokenIs(LABEL))
-        {
-            if (StateIs(START) || StateIs(COMMA))
-            {
-                unsigned int LabelLength = std::strlen(Token.Text) - 1;
-
-                char *Label = new char[LabelLength];
-                std::fill(Label, Label+LabelLength, '\0');
-                std::copy(Token.Text, Token.Text+LabelLength, Label);
-
-                Put(&Labels, Label, CurrentAddress);
-
-                TransitionTo(LABEL);
-            }
-            else
-            {
-                // TODO[joe] Error reporting...
-                Unreachable();
-            }
-        }
-        // If the token we're reading is a COMMA and the state we're at is...
-        else if (TokenIs(COMMA))
-        {
-            if (StateIs(PARAM))
-            {
-                // NOTE[joe] Can we remove COMMA and instead use START?
-                TransitionTo(COMMA);
-            }
-            else
-            {
-                // TODO[joe] Error reporting...
-                Unreachable();
-            }
-        }
-        // If the token we're reading is an EOL and the state we're at is...
-        else if (TokenIs(EOL))
-        {
-            if (StateIs(PARAM))
-            {
-                // TODO[joe] Close out instruction and reset.
-                Append<instruction>(&Instructions, CurrentInstruction);
-                CurrentInstruction = { };
-
-                TransitionTo(START);
-            }
-            else
-            {
-                // TODO[joe] Error reporting...
-                Unreachable();
-            }
-        }
-        // If the token we're reading is an INVALID token, report that we found
-        // an error.
-        else if (TokenIs(INVALID))
-        {
-            // TODO[joe] Error reporting...
-            Unreachable();
-        }
-        // If we reach here, there is definitely a problem...
-        else
+    if (ErrorCount(&Assembler))
+    {
+        for (unsigned int i = 0; i < Assembler.Chunks.Length; i++)
         {
-            Unreachable();
+            ReportErrors(&Assembler.Chunks[i].Errors,
+                         RawProgram,
+                         SourceFileSize,
+                         &Assembler.LineStarts);
         }
+
+        return SYNTAX_ERROR;
     }
 
-    if (Errors.Length)
+    buffer<int> &Program = Assembler.Program;
+
+    if (Options.Optimize)
     {
-        for (unsigned int i = 0; i < Errors.Length; i++)
+        buffer<rewrite> Rewrites = { };
+
+        if (Options.RewriteFile &&
+            LoadRewrites(Options.RewriteFile,
+                         &Rewrites,
+                         Options.DropPrints) != OK)
         {
-            Error("Line %d, column %d: %s\n\n\t%s",
-                   Errors[i].LineNumber + 1,
-                   Errors[i].FirstColumn + 1,
-                   Errors[i].Message,
-                   Lines[Errors[i].LineNumber]);
-
-            // TODO[joe] Replace this with something that is more C++ idiomatic.
-            // This is an esoteric part of the printf() formatting language
-            // that I stumbled across looking for a way to do string padding.
-            // The details can be found here:
-            // https://stackoverflow.com/a/9741091/6785489
-            fprintf(stderr, "\t%*.*s^\n\n",
-                            Errors[i].FirstColumn,
-                            Errors[i].FirstColumn,
-                            " ");
-        }
+            Error("Failed to open rewrite database \"%s\", exiting.\n",
+                  Options.RewriteFile);
 
-        return SYNTAX_ERROR;
-    }
+            return UNKNOWN;
+        }
 
+        unsigned int InstructionCount = Program.Length / 3;
+        unsigned int RemovedCount = Optimize(&Program,
+                                             &Rewrites,
+                                             Assembler.Labels,
+                                             Options.DropPrints);
 
-    /** Generate program code. */
+        Empty<rewrite>(&Rewrites);
 
-    buffer<int> Program = { };
+        Info("Removed %u of %u instructions.\n",
+             RemovedCount,
+             InstructionCount);
+    }
 
-    for (unsigned int i = 0; i < Instructions.Length; i++)
+    if (Options.ProfileFile)
     {
-        instruction Instruction = Instructions[i];
+        buffer<unsigned long long> Counts = { };
 
-        switch (Instruction.ParameterCount)
+        if (LoadProfile(Options.ProfileFile, Program.Length, &Counts) != OK)
         {
-            case 1:
-            {
-                Append<int>(&Program, Instruction.Parameters[0]);
-                Append<int>(&Program, Instruction.Parameters[0]);
-                Append<int>(&Program, Instruction.Location + 3);
-            } break;
-
-            case 2:
-            {
-                Append<int>(&Program, Instruction.Parameters[0]);
-                Append<int>(&Program, Instruction.Parameters[1]);
-                Append<int>(&Program, Instruction.Location + 3);
-            } break;
-
-            case 3:
-            {
-                Append<int>(&Program, Instruction.Parameters[0]);
-                Append<int>(&Program, Instruction.Parameters[1]);
-                Append<int>(&Program, Instruction.Parameters[2]);
-            } break;
-
-            // TODO[joe] Raise error? This is a case we should never reach.
-            default:
-            {
-                Unreachable();
-            } break;
+            Error("Failed to open profile \"%s\", exiting.\n",
+                  Options.ProfileFile);
+
+            return UNKNOWN;
         }
+
+        unsigned int MovedCount = Layout(&Program,
+                                         &Counts,
+                                         Assembler.Labels);
+
+        Empty<unsigned long long>(&Counts);
+
+        Info("Moved %u of %u words.\n", MovedCount, Program.Length);
     }
 
 
     /** Output program code to provided binary file. */
 
-    std::ofstream BinaryFile (argv[2],
+    std::ofstream BinaryFile (Options.OutputFile,
                               std::ofstream::out | std::ofstream::binary);
 
     if (!BinaryFile)
     {
-        printf("Error: Failed to open output file \"%s\", exiting.\n", argv[2]);
+        printf("Error: Failed to open output file \"%s\", exiting.\n",
+               Options.OutputFile);
         return UNKNOWN;
     }
 
-    BinaryFile.write((char *) Program.Data,
-                     sizeof(int) * Program.Length);
+    if (Options.Object)
+    {
+        WriteObject(&BinaryFile,
+                    Program.Data,
+                    Program.Length,
+                    &Assembler.Relocations,
+                    Assembler.Labels,
+                    &Assembler.Imports);
+    }
+    else
+    {
+        image_facts Facts = { };
+        AnalyzeImage(&Program, Options.MemorySize, &Facts);
+
+        WriteImage(&BinaryFile,
+                   Program.Data,
+                   Program.Length,
+                   Options.MemorySize,
+                   true,
+                   Options.Compress,
+                   &Facts,
+                   Options.Symbols ? Assembler.Labels : NULL);
+
+        Empty<unsigned char>(&Facts.Partition);
+    }
 
     BinaryFile.close();
 
@@ -0,0 +1,130 @@
+/**
+ * @file symbol.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the assembler's symbol table. Labels may be referenced
+ * before they are declared: such references are recorded as fixups (the
+ * output word that the label's address is added to or subtracted from)
+ * chained off the label's symbol, and are patched as soon as the label is
+ * declared.
+ */
+
+#pragma once
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "token.cpp"
+#include "hashmap.cpp"
+
+
+#define NO_FIXUP 0xFFFFFFFF
+
+struct fixup {
+    // The output word that needs the symbol's address, and whether the
+    // address is subtracted from it rather than added.
+    unsigned int Offset;
+    bool Negative;
+    // The next fixup waiting on the same symbol, or NO_FIXUP.
+    unsigned int Next;
+    // The reference itself, so that we can report it if it's never resolved.
+    token Token;
+};
+
+struct symbol {
+    unsigned int Address;
+    unsigned int FirstFixup;
+    bool Defined;
+    // The label that declared this symbol, once [Defined].
+    token Declaration;
+    // Where the symbol's name lives in the table's name pool.
+    unsigned int NameOffset;
+    unsigned int NameLength;
+};
+
+// A word that refers to a label by name, for labels that are declared in
+// another object and only get an address once linked.
+struct reference {
+    unsigned int Offset;
+    const char *Name;
+    unsigned int NameLength;
+};
+
+struct symbol_table {
+    // Maps a symbol's name to its index in [Symbols].
+    hashmap Names;
+    buffer<symbol> Symbols;
+    buffer<fixup> Fixups;
+};
+
+
+// Intern() returns the index of the symbol called [Name] in [Table], adding a
+// new, undefined symbol if there isn't one yet.
+static inline
+unsigned int Intern(symbol_table *Table,
+                    const char *Name,
+                    const unsigned int NameLength)
+{
+    status<unsigned int> Result = Get(&Table->Names, Name, NameLength);
+
+    if (Result.Status == OK)
+        return Result.unpack();
+
+    unsigned int Index = Table->Symbols.Length;
+
+    Append<symbol>(&Table->Symbols, (symbol) {
+        .Address     = 0,
+        .FirstFixup  = NO_FIXUP,
+        .Defined     = false,
+        .Declaration = { },
+        .NameOffset  = 0,
+        .NameLength  = NameLength
+    });
+
+    Table->Symbols[Index].NameOffset = Put(&Table->Names,
+                                           Name,
+                                           NameLength,
+                                           Index);
+
+    return Index;
+}
+
+// SymbolName() returns the name of the symbol at [Index] in [Table]. The name
+// is not null terminated, and is only good until the next Intern().
+static inline
+const char *SymbolName(symbol_table *Table, const unsigned int Index)
+{
+    return KeyAt(&Table->Names, Table->Symbols[Index].NameOffset);
+}
+
+// AddFixup() records that output word [Offset] refers to the (not yet
+// defined) symbol at [Index], through the reference [Token], subtracting its
+// address if [Negative].
+static inline
+void AddFixup(symbol_table *Table,
+              const unsigned int Index,
+              const unsigned int Offset,
+              const token Token,
+              const bool Negative = false)
+{
+    symbol *Symbol = &Table->Symbols[Index];
+
+    Append<fixup>(&Table->Fixups, (fixup) {
+        .Offset   = Offset,
+        .Negative = Negative,
+        .Next     = Symbol->FirstFixup,
+        .Token    = Token
+    });
+
+    Symbol->FirstFixup = Table->Fixups.Length - 1;
+}
+
+// Empty() frees all the memory held by [Table].
+static inline
+void Empty(symbol_table *Table)
+{
+    Empty(&Table->Names);
+    Empty<symbol>(&Table->Symbols);
+    Empty<fixup>(&Table->Fixups);
+}
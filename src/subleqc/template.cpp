@@ -0,0 +1,292 @@
+/**
+ * @file template.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains warm templates, for serving many requests with the same
+ * program when the program spends a long time setting itself up before it
+ * gets to the part that depends on the request.
+ *
+ * A template is made by running the program until it's ready: until it's
+ * about to run the instruction at a given address, or has run a given number
+ * of instructions. Its memory is then frozen into an anonymous file (a memfd
+ * where there is one), along with where it got to. Each request gets a clone
+ * of it, which maps that file privately, so that cloning doesn't copy
+ * anything and only the pages the request writes to get copied, and picks up
+ * where the template left off.
+ *
+ * SUBLEQ has no input instruction, so a request's input is written into the
+ * clone's cells (see WriteInput()) before it runs. A clone of a program with
+ * a partition keeps it, as long as its input stays out of the code.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Own Libraries
+#include "util.cpp"
+#include "image.cpp"
+#include "engine.cpp"
+
+
+// No address to get ready at, only a number of instructions.
+#define NO_READY_ADDRESS -1
+
+
+struct vm_template {
+    // The file the memory was frozen into.
+    int Descriptor;
+#if defined(_WIN32)
+    // NOTE There's nothing to map privately here, so clones are copies.
+    int *Memory;
+#endif
+    unsigned int MemorySize;
+    // Where the clones pick up from.
+    unsigned int Counter;
+    // How many instructions it took to get ready.
+    unsigned long long Steps;
+    // Whether the program's partition checked out, and what it covers (see
+    // image).
+    bool Static;
+    unsigned int CodeStart;
+    unsigned int CodeEnd;
+};
+
+
+// WarmUp() runs [Image] on the checked engine until it's about to run the
+// instruction at [ReadyAddress], or has run [ReadySteps] instructions,
+// counting every instruction it runs in [Counts] if it's given. [Counter] is
+// set to where it stopped and [Steps] to how many instructions ran. Returns
+// how it stopped; it's ready if it ran out of steps.
+static
+engine_status WarmUp(image *Image,
+                     int ReadyAddress,
+                     unsigned long long ReadySteps,
+                     unsigned long long *Counts,
+                     int *Counter,
+                     unsigned long long *Steps)
+{
+    int *Program = Image->Memory;
+    long Length = Image->MemorySize;
+
+    int ProgramCounter = Image->Entry, A = 0, B = 0, C = 0;
+    unsigned long long Ran = 0;
+    engine_status Status = OUT_OF_STEPS;
+
+    // NOTE This only happens once per template, so it isn't worth
+    // another engine that can stop at an address.
+    while (ProgramCounter != ReadyAddress && Ran < ReadySteps)
+    {
+        if (IsStdout(ProgramCounter))
+        {
+            Status = HALTED;
+            break;
+        }
+
+        if (!InBounds(ProgramCounter, Length - 2))
+        {
+            Status = COUNTER_OUT_OF_BOUNDS;
+            break;
+        }
+
+        if (Counts)
+            Counts[ProgramCounter]++;
+
+        A = Program[ProgramCounter];
+        B = Program[ProgramCounter + 1];
+        C = Program[ProgramCounter + 2];
+
+        if (!InMemory(A, Length) ||
+            !InMemory(B, Length) ||
+            !InBounds(C, Length))
+        {
+            Status = OPERAND_OUT_OF_BOUNDS;
+            break;
+        }
+
+        // The SUBLEQ operation.
+        if ((Program[B] = Subtract(Program[A], Program[B])) <= 0)
+            ProgramCounter = C;
+        else
+            ProgramCounter += 3;
+
+        Print(Program[B]);
+        Ran++;
+    }
+
+    Flush();
+
+    *Counter = ProgramCounter;
+    *Steps = Ran;
+
+    return Status;
+}
+
+// ReleaseTemplate() gives back everything [Template] holds on to. Its clones
+// stay valid.
+static
+void ReleaseTemplate(vm_template *Template)
+{
+#if !defined(_WIN32)
+    if (Template->Descriptor >= 0)
+        close(Template->Descriptor);
+#else
+    delete[] Template->Memory;
+#endif
+
+    *Template = { };
+    Template->Descriptor = -1;
+}
+
+// CreateTemplate() runs [Image] until it's ready (see WarmUp()) and freezes
+// it into [Template]. Whatever the program prints getting ready is printed
+// then, once. [Image] is left as the program was when it got ready. Returns
+// ERROR, after saying why, if the program stops before it's ready or the
+// template can't be made.
+static
+status_code CreateTemplate(image *Image,
+                           int ReadyAddress,
+                           unsigned long long ReadySteps,
+                           unsigned long long *Counts,
+                           vm_template *Template)
+{
+    *Template = { };
+    Template->Descriptor = -1;
+
+    int Counter = 0;
+    engine_status Stopped = WarmUp(Image, ReadyAddress, ReadySteps, Counts,
+                                   &Counter, &Template->Steps);
+
+    if (Stopped != OUT_OF_STEPS)
+    {
+        Error("The program %s after %llu instructions, before it was "
+              "ready.\n",
+              Stopped == HALTED ? "halted" : "went out of bounds",
+              Template->Steps);
+        return ERROR;
+    }
+
+    Template->MemorySize = Image->MemorySize;
+    Template->Counter    = (unsigned int)Counter;
+    Template->Static     = Image->Static;
+    Template->CodeStart  = Image->CodeStart;
+    Template->CodeEnd    = Image->CodeEnd;
+
+    size_t Size = sizeof(int) * (size_t)Image->MemorySize;
+
+#if !defined(_WIN32)
+#if defined(__linux__)
+    Template->Descriptor = memfd_create("subleq-template", MFD_CLOEXEC);
+#else
+    char Path[] = "/tmp/subleq-template-XXXXXX";
+
+    Template->Descriptor = mkstemp(Path);
+
+    if (Template->Descriptor >= 0)
+        unlink(Path);
+#endif
+
+    if (Template->Descriptor < 0 ||
+        ftruncate(Template->Descriptor, Size) != 0)
+    {
+        Error("Failed to make a file for the template.\n");
+        ReleaseTemplate(Template);
+        return ERROR;
+    }
+
+    const char *Memory = (const char *)Image->Memory;
+
+    for (size_t Written = 0; Written < Size; )
+    {
+        ssize_t Result = write(Template->Descriptor, Memory + Written,
+                               Size - Written);
+
+        if (Result <= 0)
+        {
+            Error("Failed to write the template.\n");
+            ReleaseTemplate(Template);
+            return ERROR;
+        }
+
+        Written += Result;
+    }
+#else
+    Template->Memory = new int[Image->MemorySize];
+    std::copy(Image->Memory, Image->Memory + Image->MemorySize,
+              Template->Memory);
+#endif
+
+    return OK;
+}
+
+// CloneTemplate() makes [Clone] a copy of the program frozen in [Template],
+// ready to run from where the template left off. Its memory is only copied
+// as it's written to. Unload() gives it back. Returns ERROR, after saying
+// why, if it can't be made.
+static
+status_code CloneTemplate(const vm_template *Template, image *Clone)
+{
+    *Clone = { };
+
+#if !defined(_WIN32)
+    Clone->MappingSize = sizeof(int) * (size_t)Template->MemorySize;
+    Clone->Mapping = mmap(NULL,
+                          Clone->MappingSize,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE,
+                          Template->Descriptor,
+                          0);
+
+    if (Clone->Mapping == MAP_FAILED)
+    {
+        Error("Failed to map the template.\n");
+        *Clone = { };
+        return ERROR;
+    }
+
+    Clone->Memory = (int *)Clone->Mapping;
+#else
+    Clone->Memory = new int[Template->MemorySize];
+    std::copy(Template->Memory, Template->Memory + Template->MemorySize,
+              Clone->Memory);
+#endif
+
+    Clone->MemorySize = Template->MemorySize;
+    Clone->Entry      = Template->Counter;
+    Clone->Static     = Template->Static;
+    Clone->CodeStart  = Template->CodeStart;
+    Clone->CodeEnd    = Template->CodeEnd;
+
+    return OK;
+}
+
+// WriteInput() writes the [Count] cells of [Input] into [Image] from
+// [Address] on. Input written into the code takes away the image's
+// partition, since it no longer says anything about the code. Returns ERROR
+// if the input doesn't fit in memory.
+static
+status_code WriteInput(image *Image,
+                       unsigned int Address,
+                       const int *Input,
+                       unsigned int Count)
+{
+    if (Address > Image->MemorySize || Count > Image->MemorySize - Address)
+        return ERROR;
+
+    if (Count && Address < Image->CodeEnd && Address + Count > Image->CodeStart)
+        Image->Static = false;
+
+    std::copy(Input, Input + Count, Image->Memory + Address);
+
+    return OK;
+}
@@ -9,9 +9,6 @@
 #pragma once
 
 
-/* C Standard Libraries */
-#include <algorithm>
-
 /* Own Libraries */
 #include "util.cpp"
 
@@ -26,31 +23,28 @@ enum token_type {
     EOL,
     IDENT,
     LABEL,
+    OPERATOR,
+    DIRECTIVE,
     INVALID,
 };
 
 
 /* Functions */
 
+// Tokens don't own their text. [Offset] and [Length] describe where the
+// token's text lives in the source the lexer was given.
 struct token {
     token_type Type;
-    // To quote a friend, 32B should be more than enough for anyone.
-    char Text[32];
+    unsigned int Offset;
+    unsigned int Length;
     unsigned int LineNumber;
-    unsigned int LastColumn;
+    unsigned int Column;
 };
 
 static inline
-char *TokenTypeToString(token_type Type)
+const char *TokenTypeToString(token_type Type)
 {
-    char* Return = new char[16];
-    std::fill(Return, Return + 16, '\0');
-
-#define CASE(T, S) case T: \
-                   { \
-                       std::string String(S); \
-                       std::copy(String.begin(), String.end(), Return); \
-                   } break;
+#define CASE(T, S) case T: return S;
 
     switch (Type)
     {
@@ -60,6 +54,8 @@ char *TokenTypeToString(token_type Type)
         CASE(EOL, "end of line")
         CASE(IDENT, "identifier")
         CASE(LABEL, "label")
+        CASE(OPERATOR, "operator")
+        CASE(DIRECTIVE, "directive")
         CASE(INVALID, "invalid token")
 
         default:
@@ -68,5 +64,7 @@ char *TokenTypeToString(token_type Type)
         }
     }
 
-    return Return;
+#undef CASE
+
+    return "";
 }
@@ -52,3 +52,24 @@ struct status {
         return this->Value;
     }
 };
+
+
+/** Bit twiddling */
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// CountTrailingZeros() returns the index of the lowest set bit in [Value].
+// [Value] must not be zero.
+static inline
+unsigned int CountTrailingZeros(unsigned int Value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long Index;
+    _BitScanForward(&Index, Value);
+    return (unsigned int)Index;
+#else
+    return (unsigned int)__builtin_ctz(Value);
+#endif
+}
@@ -0,0 +1,850 @@
+/**
+ * @file watch.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This file contains the watch mode of the assembler, which re-assembles a
+ * source every time it changes, redoing as little work as it can.
+ *
+ * Every distinct line of source is parsed once, on its own, as if it began at
+ * address zero, and the result is cached by the line's text. A re-assembly
+ * only parses lines it hasn't seen before. If the edited lines take up as many
+ * words as the lines they replaced, nothing else moves. Only the edited words
+ * and the words that refer to labels that moved get regenerated. Otherwise the
+ * cached lines are relinked at their new addresses. Either way, only the words
+ * that actually changed are rewritten in the output file.
+ *
+ * A word that's more than a label from another line, like "label+4" or
+ * "end-start", can't be patched on its own, so once the source has one, every
+ * edit relinks.
+ */
+
+#pragma once
+
+// C/C++ standard libraries
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+
+// Own Libraries
+#include "util.cpp"
+#include "buffer.cpp"
+#include "hashmap.cpp"
+#include "symbol.cpp"
+#include "assembler.cpp"
+#include "image.cpp"
+
+
+#define NO_SYMBOL 0xFFFFFFFF
+
+// MAGIC How many bytes to compare at a time when diffing sources.
+#define WATCH_BLOCK_SIZE 4096
+
+// MAGIC How often to check the source for changes, in milliseconds.
+#define WATCH_INTERVAL 50
+
+// A label declared on a line, at an address relative to the line.
+struct line_label {
+    unsigned int Symbol;
+    unsigned int Address;
+};
+
+// A reference to a label from a line, by output word relative to the line.
+struct line_reference {
+    unsigned int Symbol;
+    unsigned int Offset;
+    bool Negative;
+};
+
+// What parsing one line's text produced. The instructions, labels and
+// references live in the cache's pools.
+struct line_result {
+    unsigned int FirstInstruction;
+    unsigned int InstructionCount;
+    // How many words the line takes up.
+    unsigned int Length;
+    unsigned int FirstLabel;
+    unsigned int LabelCount;
+    unsigned int FirstReference;
+    unsigned int ReferenceCount;
+    bool HasErrors;
+};
+
+struct line_state {
+    unsigned int Result;
+    unsigned int Address;
+};
+
+struct cache {
+    // Maps a line's text to the index of its result in [Results].
+    hashmap LineResults;
+    buffer<line_result> Results;
+    buffer<instruction> Instructions;
+    buffer<line_label> Labels;
+    buffer<line_reference> References;
+
+    // The source as last assembled, where its lines start, and their state.
+    buffer<char> Source;
+    buffer<unsigned int> LineStarts;
+    buffer<line_state> Lines;
+
+    // Every label by name. Each symbol's fixups are the words that refer to
+    // it; entries go stale when their word is regenerated, which
+    // [WordSymbols] tells us.
+    symbol_table Symbols;
+    buffer<unsigned int> WordSymbols;
+
+    buffer<int> Program;
+
+    // Whether any line parsed so far has a word that's more than a label
+    // from another line.
+    bool Expressions;
+
+    // A chunk to parse lines with, kept so its memory is reused.
+    chunk Scratch;
+};
+
+
+// ClearChunk() empties [Chunk] for reuse without freeing its memory.
+static
+void ClearChunk(chunk *Chunk)
+{
+    Clear<instruction>(&Chunk->Instructions);
+    Clear<error>(&Chunk->Errors);
+    Empty(&Chunk->Symbols);
+}
+
+// LineResult() returns the index of the result of parsing the line from
+// [Begin] to [End] in [Assembler]'s source, parsing it if we haven't seen its
+// text before. An instruction never goes on past the end of its line, so a
+// line parses the same on its own as it does in the whole source.
+static
+unsigned int LineResult(cache *Cache,
+                        assembler *Assembler,
+                        unsigned int Begin,
+                        unsigned int End)
+{
+    // NOTE Result 0 is always the empty line, since the hashmap can't
+    // store empty keys.
+    if (Begin == End)
+        return 0;
+
+    const char *Text = Assembler->Source + Begin;
+
+    status<unsigned int> Cached = Get(&Cache->LineResults, Text, End - Begin);
+
+    if (Cached.Status == OK)
+        return Cached.unpack();
+
+    chunk *Chunk = &Cache->Scratch;
+
+    ClearChunk(Chunk);
+    Chunk->Begin = Begin;
+    Chunk->End   = End;
+
+    Parse(Assembler, Chunk);
+
+    line_result Result = { };
+    Result.FirstInstruction = Cache->Instructions.Length;
+    Result.InstructionCount = Chunk->Instructions.Length;
+    Result.Length           = Chunk->Length;
+    Result.FirstLabel       = Cache->Labels.Length;
+    Result.FirstReference   = Cache->References.Length;
+    Result.HasErrors        = Chunk->Errors.Length != 0;
+
+    Append<instruction>(&Cache->Instructions,
+                        Chunk->Instructions.Data,
+                        Chunk->Instructions.Length);
+
+    for (unsigned int i = 0; i < Chunk->Symbols.Symbols.Length; i++)
+    {
+        symbol *Local = &Chunk->Symbols.Symbols[i];
+
+        unsigned int Symbol = Intern(&Cache->Symbols,
+                                     SymbolName(&Chunk->Symbols, i),
+                                     Local->NameLength);
+
+        if (Local->Defined)
+        {
+            Append<line_label>(&Cache->Labels, (line_label) {
+                .Symbol  = Symbol,
+                .Address = Local->Address
+            });
+        }
+
+        for (unsigned int j = Local->FirstFixup;
+             j != NO_FIXUP;
+             j = Chunk->Symbols.Fixups[j].Next)
+        {
+            fixup *Fixup = &Chunk->Symbols.Fixups[j];
+
+            // References in an unfinished instruction don't produce a word.
+            instruction *Instruction =
+                FindInstruction(Chunk->Instructions.Data,
+                                Chunk->Instructions.Length,
+                                Fixup->Offset);
+
+            if (!Instruction)
+                continue;
+
+            // NOTE A word is just the label if its parameter is left
+            // relative to the line with nothing else added to it. Two
+            // references to the same word are caught once it's generated.
+            unsigned int Parameter = Fixup->Offset - Instruction->Location;
+
+            Cache->Expressions |=
+                Fixup->Negative ||
+                !(Instruction->Relative & (1 << Parameter)) ||
+                Instruction->Parameters[Parameter] != 0;
+
+            Append<line_reference>(&Cache->References, (line_reference) {
+                .Symbol   = Symbol,
+                .Offset   = Fixup->Offset,
+                .Negative = Fixup->Negative
+            });
+        }
+    }
+
+    Result.LabelCount     = Cache->Labels.Length - Result.FirstLabel;
+    Result.ReferenceCount = Cache->References.Length - Result.FirstReference;
+
+    unsigned int Index = Cache->Results.Length;
+
+    Append<line_result>(&Cache->Results, Result);
+    Put(&Cache->LineResults, Text, End - Begin, Index);
+
+    return Index;
+}
+
+// GenerateLine() generates the code for [Line] into the cache's program,
+// filling in its label references. Returns false if it refers to a label
+// that isn't declared.
+static
+bool GenerateLine(cache *Cache, line_state *Line)
+{
+    line_result *Result = &Cache->Results[Line->Result];
+
+    GenerateCode(Cache->Instructions.Data + Result->FirstInstruction,
+                 Result->InstructionCount,
+                 Line->Address,
+                 Cache->Program.Data + Line->Address);
+
+    for (unsigned int i = 0; i < Result->ReferenceCount; i++)
+    {
+        line_reference *Reference =
+            &Cache->References[Result->FirstReference + i];
+        symbol *Symbol = &Cache->Symbols.Symbols[Reference->Symbol];
+
+        if (!Symbol->Defined)
+            return false;
+
+        // One-address instructions are written out with their address
+        // twice, and a .fill over and over, so every word refers to the
+        // label.
+        instruction *Instruction =
+            FindInstruction(Cache->Instructions.Data +
+                            Result->FirstInstruction,
+                            Result->InstructionCount,
+                            Reference->Offset);
+        unsigned int WordCount = ReferenceLength(Instruction,
+                                                 Reference->Offset);
+
+        // NOTE Like the labels of other chunks when linking, the label
+        // is taken to be relative to the start of the line.
+        unsigned int Relative = Symbol->Address - Line->Address;
+
+        for (unsigned int j = 0; j < WordCount; j++)
+        {
+            unsigned int Word = Line->Address + Reference->Offset + j;
+
+            Cache->Program[Word] =
+                (int)((unsigned int)Cache->Program[Word] +
+                      (Reference->Negative ? 0u - Relative : Relative));
+
+            Cache->Expressions |= Cache->WordSymbols[Word] != NO_SYMBOL;
+            Cache->WordSymbols[Word] = Reference->Symbol;
+
+            AddFixup(&Cache->Symbols, Reference->Symbol, Word, (token) { });
+        }
+    }
+
+    return true;
+}
+
+// DeclareLabels() declares the labels of [Line] at their final addresses,
+// appending every symbol it declares to [Declared] if it's given. Returns
+// false if a label was already declared.
+static
+bool DeclareLabels(cache *Cache,
+                   line_state *Line,
+                   buffer<unsigned int> *Declared)
+{
+    line_result *Result = &Cache->Results[Line->Result];
+
+    for (unsigned int i = 0; i < Result->LabelCount; i++)
+    {
+        line_label *Label = &Cache->Labels[Result->FirstLabel + i];
+        symbol *Symbol = &Cache->Symbols.Symbols[Label->Symbol];
+
+        if (Symbol->Defined)
+            return false;
+
+        Symbol->Address = Line->Address + Label->Address;
+        Symbol->Defined = true;
+
+        if (Declared)
+            Append<unsigned int>(Declared, Label->Symbol);
+    }
+
+    return true;
+}
+
+// Relink() lays every line of [Cache] out from address zero and regenerates
+// the whole program from the cached line results. Returns false if the lines
+// don't link.
+static
+bool Relink(cache *Cache)
+{
+    unsigned int Address = 0;
+
+    for (unsigned int i = 0; i < Cache->Lines.Length; i++)
+    {
+        Cache->Lines[i].Address = Address;
+        Address += Cache->Results[Cache->Lines[i].Result].Length;
+    }
+
+    for (unsigned int i = 0; i < Cache->Symbols.Symbols.Length; i++)
+    {
+        Cache->Symbols.Symbols[i].Defined    = false;
+        Cache->Symbols.Symbols[i].FirstFixup = NO_FIXUP;
+    }
+
+    Clear<fixup>(&Cache->Symbols.Fixups);
+
+    Reserve<int>(&Cache->Program, Address);
+    Cache->Program.Length = Address;
+
+    Reserve<unsigned int>(&Cache->WordSymbols, Address);
+    Cache->WordSymbols.Length = Address;
+    std::fill(Cache->WordSymbols.Data,
+              Cache->WordSymbols.Data + Address,
+              NO_SYMBOL);
+
+    for (unsigned int i = 0; i < Cache->Lines.Length; i++)
+    {
+        if (!DeclareLabels(Cache, &Cache->Lines[i], NULL))
+            return false;
+    }
+
+    for (unsigned int i = 0; i < Cache->Lines.Length; i++)
+    {
+        if (!GenerateLine(Cache, &Cache->Lines[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// CommonPrefix() returns how many bytes [A] and [B] have in common at their
+// start, looking at no more than [Length] bytes.
+static
+unsigned int CommonPrefix(const char *A, const char *B, unsigned int Length)
+{
+    unsigned int Prefix = 0;
+
+    while (Length - Prefix >= WATCH_BLOCK_SIZE &&
+           memcmp(A + Prefix, B + Prefix, WATCH_BLOCK_SIZE) == 0)
+    {
+        Prefix += WATCH_BLOCK_SIZE;
+    }
+
+    while (Prefix < Length && A[Prefix] == B[Prefix])
+        Prefix++;
+
+    return Prefix;
+}
+
+// CommonSuffix() returns how many bytes the [Length] bytes before [A] and [B]
+// have in common at their end.
+static
+unsigned int CommonSuffix(const char *A, const char *B, unsigned int Length)
+{
+    unsigned int Suffix = 0;
+
+    while (Length - Suffix >= WATCH_BLOCK_SIZE &&
+           memcmp(A - Suffix - WATCH_BLOCK_SIZE,
+                  B - Suffix - WATCH_BLOCK_SIZE,
+                  WATCH_BLOCK_SIZE) == 0)
+    {
+        Suffix += WATCH_BLOCK_SIZE;
+    }
+
+    while (Suffix < Length && A[-(int)Suffix - 1] == B[-(int)Suffix - 1])
+        Suffix++;
+
+    return Suffix;
+}
+
+// Update() brings [Cache] up to date with [Source]. The offsets of every word of the program that changed are appended to
+// [Changed]. Returns false if the source doesn't assemble, in which case
+// [Cache] has to be rebuilt.
+static
+bool Update(cache *Cache,
+            const buffer<char> *Source,
+            buffer<unsigned int> *Changed)
+{
+    /** Find the lines that changed, by diffing the text. */
+
+    buffer<unsigned int> &OldStarts = Cache->LineStarts;
+
+    unsigned int OldLength = Cache->Source.Length;
+    unsigned int NewLength = Source->Length;
+    unsigned int OldCount  = OldStarts.Length;
+
+    unsigned int Common = std::min(OldLength, NewLength);
+
+    unsigned int SamePrefix = CommonPrefix(Cache->Source.Data,
+                                           Source->Data,
+                                           Common);
+    unsigned int SameSuffix = CommonSuffix(Cache->Source.Data + OldLength,
+                                           Source->Data + NewLength,
+                                           Common - SamePrefix);
+
+    // NOTE A line is only the same if its newline is too; the last line
+    // never has one, so it's never kept.
+    unsigned int Prefix = 0;
+
+    if (OldCount > 0)
+    {
+        Prefix = std::upper_bound(OldStarts.Data,
+                                  OldStarts.Data + OldCount,
+                                  SamePrefix) - OldStarts.Data - 1;
+        Prefix = std::min(Prefix, OldCount - 1);
+    }
+
+    // NOTE The same goes for the newline before a line kept at the end,
+    // which is why the comparison is strict.
+    unsigned int SuffixBegin = std::upper_bound(OldStarts.Data,
+                                                OldStarts.Data + OldCount,
+                                                OldLength - SameSuffix) -
+                               OldStarts.Data;
+    SuffixBegin = std::max(SuffixBegin, std::max(Prefix, 1u));
+
+    unsigned int Suffix = SuffixBegin < OldCount ? OldCount - SuffixBegin : 0;
+
+    unsigned int MiddleBegin = OldCount > 0 ? OldStarts[Prefix] : 0;
+    unsigned int MiddleEnd   = Suffix > 0 ?
+                               OldStarts[SuffixBegin] + NewLength - OldLength :
+                               NewLength;
+
+
+    /** Index the new source, reusing the old index outside the edit. */
+
+    buffer<unsigned int> NewStarts = { };
+    Reserve<unsigned int>(&NewStarts, OldCount + 1);
+
+    Append<unsigned int>(&NewStarts, OldStarts.Data, Prefix);
+
+    unsigned int MiddleFirst = NewStarts.Length;
+
+    IndexLines(Source->Data + MiddleBegin,
+               MiddleEnd - MiddleBegin,
+               &NewStarts);
+
+    for (unsigned int i = MiddleFirst; i < NewStarts.Length; i++)
+        NewStarts[i] += MiddleBegin;
+
+    // The middle ends with the newline before the suffix, which makes the
+    // suffix's first line look like a line of the middle.
+    if (Suffix > 0)
+        Pop<unsigned int>(&NewStarts);
+
+    unsigned int MiddleCount = NewStarts.Length - MiddleFirst;
+
+    for (unsigned int i = SuffixBegin; i < OldCount; i++)
+        Append<unsigned int>(&NewStarts, OldStarts[i] + NewLength - OldLength);
+
+
+    /** Find the result of every changed line, parsing only unseen ones. */
+
+    assembler Assembler    = { };
+    Assembler.Source       = Source->Data;
+    Assembler.SourceLength = NewLength;
+    Assembler.ThreadCount  = 1;
+    Assembler.LineStarts   = NewStarts;
+
+    buffer<line_state> Middle = { };
+    Reserve<line_state>(&Middle, MiddleCount);
+
+    bool Parsed = true;
+
+    for (unsigned int i = Prefix; i < Prefix + MiddleCount && Parsed; i++)
+    {
+        unsigned int End = i + 1 < NewStarts.Length ?
+                           NewStarts[i + 1] :
+                           NewLength;
+
+        unsigned int Result = LineResult(Cache, &Assembler, NewStarts[i], End);
+
+        Parsed = !Cache->Results[Result].HasErrors;
+
+        Append<line_state>(&Middle, (line_state) {
+            .Result  = Result,
+            .Address = 0
+        });
+    }
+
+    if (!Parsed)
+    {
+        Empty<line_state>(&Middle);
+        Empty<unsigned int>(&NewStarts);
+        return false;
+    }
+
+    Clear<char>(&Cache->Source);
+    Append<char>(&Cache->Source, Source->Data, NewLength);
+
+    Empty<unsigned int>(&Cache->LineStarts);
+    Cache->LineStarts = NewStarts;
+
+    unsigned int NewCount = Prefix + MiddleCount + Suffix;
+
+    unsigned int OldWords = 0;
+    unsigned int NewWords = 0;
+
+    for (unsigned int i = Prefix; i < OldCount - Suffix; i++)
+        OldWords += Cache->Results[Cache->Lines[i].Result].Length;
+
+    for (unsigned int i = 0; i < MiddleCount; i++)
+        NewWords += Cache->Results[Middle[i].Result].Length;
+
+    bool InPlace = OldWords == NewWords && OldCount > 0 && !Cache->Expressions;
+
+    unsigned int RegionBegin = Prefix < OldCount ?
+                               Cache->Lines[Prefix].Address :
+                               Cache->Program.Length;
+    unsigned int RegionEnd   = RegionBegin + NewWords;
+
+
+    /** Swap the changed lines in. */
+
+    buffer<unsigned int> Moved = { };
+
+    // If nothing else moves, forget the labels the old lines declared.
+    if (InPlace)
+    {
+        for (unsigned int i = Prefix; i < OldCount - Suffix; i++)
+        {
+            line_result *Result = &Cache->Results[Cache->Lines[i].Result];
+
+            for (unsigned int j = 0; j < Result->LabelCount; j++)
+            {
+                unsigned int Symbol =
+                    Cache->Labels[Result->FirstLabel + j].Symbol;
+
+                Cache->Symbols.Symbols[Symbol].Defined = false;
+                Append<unsigned int>(&Moved, Symbol);
+            }
+        }
+    }
+
+    unsigned int Address = RegionBegin;
+
+    buffer<line_state> Lines = { };
+    Reserve<line_state>(&Lines, NewCount);
+
+    Append<line_state>(&Lines, Cache->Lines.Data, Prefix);
+
+    for (unsigned int i = 0; i < MiddleCount; i++)
+    {
+        Middle[i].Address = Address;
+        Address += Cache->Results[Middle[i].Result].Length;
+
+        Append<line_state>(&Lines, Middle[i]);
+    }
+
+    Append<line_state>(&Lines,
+                       Cache->Lines.Data + OldCount - Suffix,
+                       Suffix);
+
+    Empty<line_state>(&Middle);
+    Empty<line_state>(&Cache->Lines);
+    Cache->Lines = Lines;
+
+
+    /** If the edit moved code around, relink everything. */
+
+    if (!InPlace)
+    {
+        buffer<int> OldProgram = Cache->Program;
+        Cache->Program = { };
+
+        bool Linked = Relink(Cache);
+
+        if (Linked)
+        {
+            for (unsigned int i = 0; i < Cache->Program.Length; i++)
+            {
+                if (i >= OldProgram.Length || OldProgram[i] != Cache->Program[i])
+                    Append<unsigned int>(Changed, i);
+            }
+        }
+
+        Empty<int>(&OldProgram);
+
+        return Linked;
+    }
+
+
+    /** Otherwise, only the edited lines and their labels' users change. */
+
+    bool Linked = true;
+
+    for (unsigned int i = Prefix; i < NewCount - Suffix && Linked; i++)
+        Linked = DeclareLabels(Cache, &Cache->Lines[i], &Moved);
+
+    // Every word outside the edit that refers to a label that moved (or
+    // vanished) needs patching.
+    for (unsigned int i = 0; i < Moved.Length && Linked; i++)
+    {
+        symbol *Symbol = &Cache->Symbols.Symbols[Moved[i]];
+
+        unsigned int *Link = &Symbol->FirstFixup;
+
+        while (*Link != NO_FIXUP)
+        {
+            fixup *Fixup = &Cache->Symbols.Fixups[*Link];
+            unsigned int Word = Fixup->Offset;
+
+            // Drop references that went stale, or that are about to be
+            // regenerated along with the edited lines.
+            if (Cache->WordSymbols[Word] != Moved[i] ||
+                (RegionBegin <= Word && Word < RegionEnd))
+            {
+                *Link = Fixup->Next;
+                continue;
+            }
+
+            if (!Symbol->Defined)
+            {
+                Linked = false;
+                break;
+            }
+
+            if (Cache->Program[Word] != (int)Symbol->Address)
+            {
+                Cache->Program[Word] = Symbol->Address;
+                Append<unsigned int>(Changed, Word);
+            }
+
+            Link = &Fixup->Next;
+        }
+    }
+
+    Empty<unsigned int>(&Moved);
+
+    if (!Linked)
+        return false;
+
+    // Finally, regenerate the edited lines themselves.
+    buffer<int> Previous = { };
+    Append<int>(&Previous, Cache->Program.Data + RegionBegin, NewWords);
+
+    std::fill(Cache->WordSymbols.Data + RegionBegin,
+              Cache->WordSymbols.Data + RegionEnd,
+              NO_SYMBOL);
+
+    for (unsigned int i = Prefix; i < NewCount - Suffix && Linked; i++)
+        Linked = GenerateLine(Cache, &Cache->Lines[i]);
+
+    for (unsigned int i = 0; i < NewWords && Linked; i++)
+    {
+        if (Previous[i] != Cache->Program[RegionBegin + i])
+            Append<unsigned int>(Changed, RegionBegin + i);
+    }
+
+    Empty<int>(&Previous);
+
+    return Linked;
+}
+
+// Empty() frees all the memory held by [Cache].
+static
+void Empty(cache *Cache)
+{
+    Empty(&Cache->LineResults);
+    Empty<line_result>(&Cache->Results);
+    Empty<instruction>(&Cache->Instructions);
+    Empty<line_label>(&Cache->Labels);
+    Empty<line_reference>(&Cache->References);
+    Empty<char>(&Cache->Source);
+    Empty<unsigned int>(&Cache->LineStarts);
+    Empty<line_state>(&Cache->Lines);
+    Empty(&Cache->Symbols);
+    Empty<unsigned int>(&Cache->WordSymbols);
+    Empty<int>(&Cache->Program);
+
+    Empty<instruction>(&Cache->Scratch.Instructions);
+    Empty(&Cache->Scratch.Symbols);
+    Empty<error>(&Cache->Scratch.Errors);
+    Free(&Cache->Scratch.Arena);
+}
+
+// ModificationTime() returns when the file at [Path] was last changed, or 0
+// if it can't be read.
+static
+long long ModificationTime(const char *Path)
+{
+    struct stat Status;
+
+    if (stat(Path, &Status) != 0)
+        return 0;
+
+    long long Time = (long long)Status.st_mtime * 1000000000;
+
+#if defined(__linux__)
+    Time += Status.st_mtim.tv_nsec;
+#endif
+
+    // NOTE Fold the size in too, since a quick save can land within the
+    // resolution of the timestamp.
+    return Time ^ ((long long)Status.st_size << 1);
+}
+
+// Watch() assembles [InputFile] into [OutputFile], as an image asking for
+// [MemorySize] cells of memory, and then does it again every time [InputFile]
+// changes. It never returns.
+static inline
+void Watch(const char *InputFile, const char *OutputFile,
+           unsigned int MemorySize)
+{
+    cache Cache = { };
+
+    // Result 0 is the empty line.
+    Append<line_result>(&Cache.Results, (line_result) { });
+
+    long long LastModified = -1;
+
+    for (;;)
+    {
+        long long Modified = ModificationTime(InputFile);
+
+        if (Modified == LastModified)
+        {
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(WATCH_INTERVAL));
+            continue;
+        }
+
+        LastModified = Modified;
+
+        std::ifstream SourceFile (InputFile,
+                                  std::ifstream::in | std::ifstream::binary);
+
+        if (!SourceFile)
+        {
+            Error("Failed to open input file \"%s\".\n", InputFile);
+            continue;
+        }
+
+        SourceFile.seekg(0, std::ios::end);
+        long SourceFileSize = SourceFile.tellg();
+        SourceFile.seekg(0, std::ios::beg);
+
+        buffer<char> Source = { };
+        Reserve<char>(&Source, SourceFileSize + 1);
+        SourceFile.read(Source.Data, SourceFileSize);
+        Source.Length = SourceFileSize;
+        Source[SourceFileSize] = '\0';
+
+        SourceFile.close();
+
+        auto Start = std::chrono::steady_clock::now();
+
+        unsigned int OldLength = Cache.Program.Length;
+        buffer<unsigned int> Changed = { };
+
+        if (Update(&Cache, &Source, &Changed))
+        {
+            // Rewrite the whole file if it changed size, otherwise just the
+            // words that changed.
+            if (Cache.Program.Length != OldLength || OldLength == 0)
+            {
+                std::ofstream BinaryFile (OutputFile,
+                                          std::ofstream::out |
+                                          std::ofstream::binary);
+
+                // NOTE The zeros at the end stay in the code, so that
+                // every word can be rewritten in place next time.
+                WriteImage(&BinaryFile,
+                           Cache.Program.Data,
+                           Cache.Program.Length,
+                           MemorySize,
+                           false,
+                           false,
+                           NULL,
+                           NULL);
+            }
+            else
+            {
+                std::ofstream BinaryFile (OutputFile,
+                                          std::ofstream::in |
+                                          std::ofstream::out |
+                                          std::ofstream::binary);
+
+                std::sort(Changed.Data, Changed.Data + Changed.Length);
+
+                for (unsigned int i = 0; i < Changed.Length; i++)
+                {
+                    BinaryFile.seekp(sizeof(image_header) +
+                                     sizeof(int) * Changed[i]);
+                    BinaryFile.write((char *)&Cache.Program[Changed[i]],
+                                     sizeof(int));
+                }
+            }
+
+            std::chrono::duration<double, std::milli> Elapsed =
+                std::chrono::steady_clock::now() - Start;
+
+            Info("Assembled \"%s\" in %.3fms, %u words changed.\n",
+                 InputFile,
+                 Elapsed.count(),
+                 Changed.Length);
+        }
+        else
+        {
+            // Let the regular assembler explain what's wrong, and start from
+            // scratch once it's fixed.
+            assembler Reporter = { };
+
+            Assemble(&Reporter, Source.Data, Source.Length, 1);
+
+            for (unsigned int i = 0; i < Reporter.Chunks.Length; i++)
+            {
+                ReportErrors(&Reporter.Chunks[i].Errors,
+                             Source.Data,
+                             Source.Length,
+                             &Reporter.LineStarts);
+            }
+
+            Empty(&Reporter);
+            Empty(&Cache);
+
+            Cache = { };
+            Append<line_result>(&Cache.Results, (line_result) { });
+        }
+
+        fflush(stdout);
+
+        Empty<unsigned int>(&Changed);
+        Empty<char>(&Source);
+    }
+}
+
+#undef NO_SYMBOL
+#undef WATCH_BLOCK_SIZE
+#undef WATCH_INTERVAL
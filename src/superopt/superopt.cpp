@@ -0,0 +1,482 @@
+/**
+ * @file superopt.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the SUBLEQ superoptimizer. Given a straight line snippet of SUBLEQ,
+ * it searches for the shortest sequence of instructions that leaves memory the
+ * same, and adds the pair to a rewrite database that subleqc can apply. Being
+ * shorter, it prints less (see rewrite.cpp).
+ *
+ * Short sequences are searched exhaustively, shortest first; past a point
+ * there are too many, and the search samples them stochastically instead,
+ * walking towards sequences that get more test vectors right. Candidates are
+ * run over random test vectors first, which rules almost all of them out, and
+ * the ones that survive are proven equivalent symbolically with Verify().
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/symbol.cpp"
+#include "../subleqc/rewrite.cpp"
+
+
+#define UsageString \
+    "Usage: superopt [-n <length>] [--samples <count>] " \
+    "[--zero <variable>]... <snippet> [<database>]\n"
+
+// MAGIC The most candidates of one length we're willing to try one by
+// one, which takes a few seconds.
+#define EXHAUSTIVE_LIMIT (1 << 24)
+
+// MAGIC Enough vectors that a wrong candidate almost never passes them
+// all, few enough that trying one stays cheap.
+#define TEST_VECTOR_COUNT 4
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    INVALID_SNIPPET,
+    UNKNOWN
+};
+
+struct options {
+    const char *SnippetFile;
+    const char *DatabaseFile;
+    // The longest replacement to look for; by default, one shorter than the
+    // snippet.
+    unsigned int MaxLength;
+    // How many candidates to sample at each length too long to search
+    // exhaustively.
+    unsigned int SampleCount;
+    // The variables that are zero before and after the snippet.
+    buffer<const char *> Zero;
+};
+
+// What the snippet does to each of the test vectors.
+struct search {
+    unsigned int VariableCount;
+    unsigned int Inputs[TEST_VECTOR_COUNT][REWRITE_MAX_VARIABLES];
+    unsigned int Outputs[TEST_VECTOR_COUNT][REWRITE_MAX_VARIABLES];
+};
+
+
+// Random() returns the next number from the xorshift generator in [State].
+static inline
+unsigned int Random(unsigned int *State)
+{
+    *State ^= *State << 13;
+    *State ^= *State >> 17;
+    *State ^= *State << 5;
+
+    return *State;
+}
+
+// Run() runs the [Count] [Instructions] on [Cells].
+static inline
+void Run(const rewrite_instruction *Instructions,
+         unsigned int Count,
+         unsigned int *Cells)
+{
+    for (unsigned int i = 0; i < Count; i++)
+        Cells[Instructions[i].B] = Cells[Instructions[i].A] -
+                                   Cells[Instructions[i].B];
+}
+
+// Mismatches() returns in how many places running the [Count] [Instructions]
+// on the test vectors of [Search] gets a different result than the snippet.
+static
+unsigned int Mismatches(const search *Search,
+                        const rewrite_instruction *Instructions,
+                        unsigned int Count)
+{
+    unsigned int Result = 0;
+
+    for (unsigned int i = 0; i < TEST_VECTOR_COUNT; i++)
+    {
+        unsigned int Cells[REWRITE_MAX_VARIABLES];
+        std::copy(Search->Inputs[i],
+                  Search->Inputs[i] + REWRITE_MAX_VARIABLES,
+                  Cells);
+
+        Run(Instructions, Count, Cells);
+
+        for (unsigned int j = 0; j < Search->VariableCount; j++)
+            Result += Cells[j] != Search->Outputs[i][j];
+    }
+
+    return Result;
+}
+
+// Check() returns whether the replacement of [Rewrite] passes the test
+// vectors of [Search] and is proven to do the same as its pattern.
+static inline
+bool Check(const search *Search, const rewrite *Rewrite)
+{
+    return Mismatches(Search,
+                      Rewrite->Replacement,
+                      Rewrite->ReplacementLength) == 0 &&
+           Verify(Rewrite, false);
+}
+
+// SearchExhaustively() tries every sequence of [Rewrite]'s replacement
+// length, in order. Returns whether one of them does the same as the pattern,
+// leaving it as the replacement.
+static
+bool SearchExhaustively(const search *Search, rewrite *Rewrite)
+{
+    unsigned int Choices = Search->VariableCount * Search->VariableCount;
+    unsigned int Length  = Rewrite->ReplacementLength;
+
+    unsigned int Indices[REWRITE_MAX_LENGTH] = { };
+
+    for (;;)
+    {
+        for (unsigned int i = 0; i < Length; i++)
+        {
+            Rewrite->Replacement[i].A = Indices[i] / Search->VariableCount;
+            Rewrite->Replacement[i].B = Indices[i] % Search->VariableCount;
+        }
+
+        if (Check(Search, Rewrite))
+            return true;
+
+        // Count up to the next sequence, like an odometer.
+        unsigned int i = 0;
+
+        while (i < Length && ++Indices[i] == Choices)
+            Indices[i++] = 0;
+
+        if (i == Length)
+            return false;
+    }
+}
+
+// SearchStochastically() walks through [SampleCount] sequences of [Rewrite]'s
+// replacement length, changing one operand at a time, and preferring changes
+// that get more test vectors right. Returns whether it came across one that
+// does the same as the pattern, leaving it as the replacement.
+static
+bool SearchStochastically(const search *Search,
+                          rewrite *Rewrite,
+                          unsigned int SampleCount,
+                          unsigned int *Seed)
+{
+    unsigned int Length = Rewrite->ReplacementLength;
+    unsigned int VariableCount = Search->VariableCount;
+
+    for (unsigned int i = 0; i < Length; i++)
+    {
+        Rewrite->Replacement[i].A = Random(Seed) % VariableCount;
+        Rewrite->Replacement[i].B = Random(Seed) % VariableCount;
+    }
+
+    unsigned int Cost = Mismatches(Search, Rewrite->Replacement, Length);
+
+    for (unsigned int Sample = 0; Sample < SampleCount; Sample++)
+    {
+        if (Cost == 0 && Verify(Rewrite, false))
+            return true;
+
+        unsigned int Index = Random(Seed) % Length;
+        rewrite_instruction Previous = Rewrite->Replacement[Index];
+
+        if (Random(Seed) % 2)
+            Rewrite->Replacement[Index].A = Random(Seed) % VariableCount;
+        else
+            Rewrite->Replacement[Index].B = Random(Seed) % VariableCount;
+
+        unsigned int NewCost = Mismatches(Search,
+                                          Rewrite->Replacement,
+                                          Length);
+
+        // NOTE Sometimes take a step for the worse, so we don't get
+        // stuck.
+        double Chance = std::exp((double)Cost - (double)NewCost);
+
+        if (NewCost <= Cost ||
+            Random(Seed) < Chance * (double)0xFFFFFFFF)
+        {
+            Cost = NewCost;
+        }
+        else
+        {
+            Rewrite->Replacement[Index] = Previous;
+        }
+    }
+
+    return false;
+}
+
+// SamePattern() returns whether [A] and [B] have the same pattern, with the
+// same zero variables.
+static
+bool SamePattern(const rewrite *A, const rewrite *B)
+{
+    if (A->PatternLength != B->PatternLength ||
+        A->VariableCount != B->VariableCount ||
+        A->Zero != B->Zero)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < A->PatternLength; i++)
+    {
+        if (A->Pattern[i].A != B->Pattern[i].A ||
+            A->Pattern[i].B != B->Pattern[i].B)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.MaxLength   = REWRITE_MAX_LENGTH;
+    Options.SampleCount = 1000000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            Options.MaxLength = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            Options.SampleCount = std::max(0, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--zero") == 0 && i + 1 < argc)
+        {
+            Append<const char *>(&Options.Zero, argv[++i]);
+        }
+        else if (!Options.SnippetFile)
+        {
+            Options.SnippetFile = argv[i];
+        }
+        else if (!Options.DatabaseFile)
+        {
+            Options.DatabaseFile = argv[i];
+        }
+        else
+        {
+            Warning("Ignoring extra argument \"%s\".\n", argv[i]);
+        }
+    }
+
+    if (!Options.SnippetFile)
+    {
+        Severe("No snippet specified, exiting.\n");
+
+        printf(UsageString);
+
+        return MISSING_ARGS;
+    }
+
+
+    /** Read the snippet. */
+
+    std::ifstream SnippetFile (Options.SnippetFile,
+                               std::ifstream::in | std::ifstream::binary);
+
+    if (!SnippetFile)
+    {
+        Error("Failed to open snippet \"%s\", exiting.\n",
+              Options.SnippetFile);
+
+        return UNKNOWN;
+    }
+
+    std::string Snippet ((std::istreambuf_iterator<char>(SnippetFile)),
+                         std::istreambuf_iterator<char>());
+
+    rewrite Rewrite = { };
+    symbol_table Variables = { };
+
+    status<unsigned int> Pattern = ParseSequence(Snippet.data(),
+                                                 Snippet.size(),
+                                                 &Variables,
+                                                 Rewrite.Pattern);
+
+    if (Pattern.Status != OK)
+    {
+        Error("\"%s\" isn't a straight line sequence of at most %d "
+              "instructions over at most %d variables, exiting.\n",
+              Options.SnippetFile,
+              REWRITE_MAX_LENGTH,
+              REWRITE_MAX_VARIABLES);
+
+        return INVALID_SNIPPET;
+    }
+
+    Rewrite.PatternLength = Pattern.unpack();
+    Rewrite.VariableCount = Variables.Symbols.Length;
+
+    for (unsigned int i = 0; i < Options.Zero.Length; i++)
+    {
+        status<unsigned int> Variable = Get(&Variables.Names,
+                                            Options.Zero[i],
+                                            std::strlen(Options.Zero[i]));
+
+        if (Variable.Status != OK)
+        {
+            Error("The snippet has no variable \"%s\", exiting.\n",
+                  Options.Zero[i]);
+
+            return INVALID_SNIPPET;
+        }
+
+        Rewrite.Zero |= 1 << Variable.unpack();
+    }
+
+    // The snippet is trivially the same as itself, so this only fails if it
+    // doesn't leave its zero variables zero.
+    Rewrite.ReplacementLength = Rewrite.PatternLength;
+    std::copy(Rewrite.Pattern,
+              Rewrite.Pattern + Rewrite.PatternLength,
+              Rewrite.Replacement);
+
+    if (!Verify(&Rewrite, false))
+    {
+        Error("The snippet doesn't leave its zero variables zero, "
+              "exiting.\n");
+
+        return INVALID_SNIPPET;
+    }
+
+
+    /** Run the snippet on the test vectors. */
+
+    search Search = { };
+    Search.VariableCount = Rewrite.VariableCount;
+
+    // NOTE Fixed, so that runs are repeatable.
+    unsigned int Seed = 0x2545F491;
+
+    for (unsigned int i = 0; i < TEST_VECTOR_COUNT; i++)
+    {
+        for (unsigned int j = 0; j < Rewrite.VariableCount; j++)
+        {
+            Search.Inputs[i][j] = (Rewrite.Zero & (1 << j)) ?
+                                  0 :
+                                  Random(&Seed);
+        }
+
+        std::copy(Search.Inputs[i],
+                  Search.Inputs[i] + REWRITE_MAX_VARIABLES,
+                  Search.Outputs[i]);
+
+        Run(Rewrite.Pattern, Rewrite.PatternLength, Search.Outputs[i]);
+    }
+
+
+    /** Look for a shorter sequence, shortest first. */
+
+    unsigned int MaxLength = std::min(Options.MaxLength,
+                                      Rewrite.PatternLength - 1);
+    bool Found = false;
+
+    for (unsigned int Length = 0;
+         Length <= MaxLength && Rewrite.PatternLength && !Found;
+         Length++)
+    {
+        Rewrite.ReplacementLength = Length;
+
+        double Space = std::pow((double)Rewrite.VariableCount *
+                                Rewrite.VariableCount,
+                                Length);
+
+        if (Space <= EXHAUSTIVE_LIMIT)
+        {
+            Found = SearchExhaustively(&Search, &Rewrite);
+        }
+        else
+        {
+            Info("Sampling %u of %.0f sequences of %u instructions.\n",
+                 Options.SampleCount,
+                 Space,
+                 Length);
+
+            Found = SearchStochastically(&Search,
+                                         &Rewrite,
+                                         Options.SampleCount,
+                                         &Seed);
+        }
+    }
+
+    if (!Found)
+    {
+        Info("No shorter sequence found.\n");
+
+        Empty(&Variables);
+        Empty<const char *>(&Options.Zero);
+
+        return NORMAL;
+    }
+
+    Info("Found a sequence of %u instructions for one of %u:\n",
+         Rewrite.ReplacementLength,
+         Rewrite.PatternLength);
+
+    WriteRewrite(stdout, &Rewrite, &Variables);
+
+
+    /** Add it to the database, unless it's there already. */
+
+    if (Options.DatabaseFile)
+    {
+        buffer<rewrite> Known = { };
+
+        // NOTE A database that doesn't exist yet is just empty.
+        LoadRewrites(Options.DatabaseFile, &Known, true);
+
+        bool Duplicate = false;
+
+        for (unsigned int i = 0; i < Known.Length && !Duplicate; i++)
+        {
+            Duplicate = SamePattern(&Known[i], &Rewrite) &&
+                        Known[i].ReplacementLength <=
+                        Rewrite.ReplacementLength;
+        }
+
+        if (Duplicate)
+        {
+            Info("\"%s\" already has this rewrite.\n", Options.DatabaseFile);
+        }
+        else
+        {
+            FILE *Database = fopen(Options.DatabaseFile, "a");
+
+            if (!Database)
+            {
+                Error("Failed to open database \"%s\", exiting.\n",
+                      Options.DatabaseFile);
+
+                return UNKNOWN;
+            }
+
+            WriteRewrite(Database, &Rewrite, &Variables);
+            fclose(Database);
+        }
+
+        Empty<rewrite>(&Known);
+    }
+
+    Empty(&Variables);
+    Empty<const char *>(&Options.Zero);
+
+    return NORMAL;
+}
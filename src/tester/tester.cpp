@@ -0,0 +1,2010 @@
+/**
+ * @file tester.cpp
+ * @author agent <agent@local>
+ * @date 2026-10-18
+ *
+ * This is the test driver. It builds every program in data/tests with the
+ * assembler (and linker, for the tests that link objects) built into it, and
+ * checks that what it builds is what it should be. Then it runs every program
+ * that builds on every engine (see engine.cpp): straight from the assembler on
+ * the checked engine, which the other runs are compared to, on the unchecked
+ * engine if the program gets a partition, loaded back from a plain and a
+ * packed image the way the emulator loads them, and from a clone of a
+ * template frozen halfway through (see template.cpp), and on both engines
+ * again publishing its counters to a stats segment (see stats.cpp), which are
+ * read back the way subleq-top reads them and checked. Every run has to leave
+ * memory, the output and how it stopped exactly the same. A program with one
+ * source is also built with the optimizer and without, and both have to print
+ * the same and stop the same way. A test can also ask for its program to be
+ * sent to the emulator's server (see serve.cpp) with subleq-client, which has
+ * to print the same, or to be specialized on one of its cells (see
+ * src/subleq-spec), which has to end with the same memory.
+ *
+ * A test can also ask for its source to be assembled again other ways, like
+ * on several threads, each of which has to give exactly the same program. The
+ * source of such a test is often made by the generator (see src/sqgen), since
+ * it has to be far bigger than anyone writes by hand for the assembler to
+ * split it up.
+ *
+ * Every test runs in a process of its own, so that one that crashes or never
+ * halts only fails itself. What a test prints is only shown if it fails. How
+ * long each step of each test took is reported either way, so that slow paths
+ * stand out.
+ *
+ * This needs fork(), so it only builds on POSIX systems.
+ */
+
+// C/C++ stdlib
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+// POSIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Internal libs
+#include "../subleqc/util.cpp"
+#include "../subleqc/buffer.cpp"
+#include "../subleqc/arena.cpp"
+#include "../subleqc/assembler.cpp"
+#include "../subleqc/optimizer.cpp"
+#include "../subleqc/layout.cpp"
+#include "../subleqc/image.cpp"
+#include "../subleqc/object.cpp"
+#include "../subleqc/engine.cpp"
+#include "../subleqc/template.cpp"
+#include "../subleqc/stream.cpp"
+#include "../subleqc/watch.cpp"
+#include "../subleqc/serve.cpp"
+#include "../subleq-ld/link.cpp"
+#include "../sqgen/generate.cpp"
+#include "../subleq-spec/specialize.cpp"
+
+
+#define UsageString \
+    "Usage: tester [--timeout <seconds>] [--client <path>] [<test>...]\n"
+
+#define DATA_DIRECTORY "data/tests"
+
+// MAGIC Far longer than any test takes, short enough not to hold up a
+// run that hangs for long.
+#define DEFAULT_TIMEOUT 10
+
+#define MAX_SOURCES 2
+
+#define Cells(ARRAY) ARRAY, sizeof(ARRAY) / sizeof(ARRAY[0])
+
+// MAGIC Far more than any test's program runs, or makes variants of when it's
+// specialized.
+#define SPECIALIZE_BUDGET 1000000
+#define SPECIALIZE_VARIANTS 4096
+
+
+enum exit_status {
+    NORMAL,
+    MISSING_ARGS,
+    TESTS_FAILED,
+    UNKNOWN
+};
+
+struct options {
+    // How long a test may take before it's stopped and failed.
+    unsigned int Timeout;
+    // The server's client, if it isn't next to the tester.
+    const char *ClientPath;
+    // The tests to run; all of them if none are given.
+    buffer<const char *> Tests;
+};
+
+// The ways a program is run, the first of which every other is compared to.
+enum run {
+    RUN_CHECKED,
+    RUN_UNCHECKED,
+    RUN_IMAGE,
+    RUN_PACKED,
+    RUN_TEMPLATE,
+    RUN_STATS,
+    RUN_UNCHECKED_STATS,
+    RUN_COUNT
+};
+
+// The server's client. scripts/build.sh puts it next to the tester.
+static char ClientPath[4096] = "subleq-client";
+
+static const char *RunNames[RUN_COUNT] = {
+    "checked", "unchecked", "image", "packed", "template", "stats",
+    "unchecked+stats"
+};
+
+struct test_case {
+    const char *Name = NULL;
+    // The sources in DATA_DIRECTORY the program is built from, without
+    // ".sq". If there's more than one, each is assembled into an object and
+    // they're linked in order.
+    const char *Sources[MAX_SOURCES] = { };
+    // Whether to optimize the program, whether the optimizer may change what
+    // it prints, and the rewrite database it applies then, if there is one.
+    bool Optimize = false;
+    bool DropPrints = false;
+    const char *RewriteFile = NULL;
+    // The profile to lay the program out by, if any.
+    const char *ProfileFile = NULL;
+    // Whether the program shouldn't build.
+    bool Fails = false;
+    // Whether the program never halts, so it's built but not run.
+    bool Endless = false;
+    // Whether the program writes to a cell of one of its instructions after
+    // that instruction has run.
+    bool SelfModifying = false;
+    // The cells the program should build to, if they're known.
+    const int *Cells = NULL;
+    unsigned int CellCount = 0;
+    // Whether to check the facts the program's image gets, and what they
+    // should be.
+    bool CheckFacts = false;
+    uint32_t Facts = 0;
+    unsigned int CodeStart = 0;
+    unsigned int CodeEnd = 0;
+    // How many bytes of source to make with the generator instead of reading
+    // the one source, if any.
+    unsigned long long GeneratedSize = 0;
+    // How many threads to assemble the one source on as well, if more than
+    // one. The source has to be big enough to be split that many ways.
+    unsigned int Threads = 0;
+    // Whether to assemble the one source as a stream as well. The source has
+    // to be bigger than a window.
+    bool Streamed = false;
+    // Whether to assemble the one source the way --watch does as well, from
+    // nothing and then through a few edits.
+    bool Watched = false;
+    // Whether to run the program from the emulator's server as well, sending
+    // it with subleq-client.
+    bool Served = false;
+    // The cell to take as the program's input when specializing it (see
+    // src/subleq-spec), if it's to be specialized.
+    int SpecializeInput = -1;
+};
+
+// What a test's process reports back.
+struct test_result {
+    bool Passed;
+    // How long building the program, and each run, took. Runs that didn't
+    // happen took no time.
+    double BuildMilliseconds;
+    double RunMilliseconds[RUN_COUNT];
+    bool Ran[RUN_COUNT];
+};
+
+// Everything a run leaves behind.
+struct run_result {
+    engine_status Status;
+    buffer<int> Memory;
+    buffer<char> Output;
+};
+
+
+/** Tests. */
+
+static const int BasicCells[]            = { 0, 0, -1 };
+static const int NextAddressCells[]      = { 1, 2, 3 };
+static const int TwoAddressCells[]       = { 0, 1, 3 };
+static const int OneAddressCells[]       = { 1, 1, 3 };
+static const int ComplexCells[]          = { 0, 1, 3, 0, 1, 6, 0, 0, -1 };
+static const int ForwardReferenceCells[] = { 3, 3, 6, 0, 0, 6, 0, 0, -1 };
+
+// The instruction nothing jumps to is removed, and t and Z move up.
+static const int DeadCodeCells[] = {
+    12, 12, 3, 9, 12, 6, 12, 12, -1, 7, 7, 15, 0, 0, 18
+};
+
+// The second clear and both jumps to the next instruction are removed, and
+// the first clear jumps straight to the exit.
+static const int OptimizeCells[] = {
+    6, 6, -1, 9, 9, -1, 7, 7, 18, 0, 0, 21
+};
+
+// The move through Z is rewritten to a clear and a single subtraction.
+static const int RewriteCells[] = {
+    12, 12, 3, 9, 12, 6, 15, 15, -1, 5, 5, 18, 3, 3, 21, 0, 0, 24
+};
+
+// The table's words and the fill are written out, and the zeros take up
+// space like any other cells.
+static const int DirectivesCells[] = {
+    10, 20, 3, 11, 20, 6, 23, 23, 26, 1, 2, 3, 4, 17, 17, 17, 0, 0, 0, 0, 0,
+    0, 23, 0, 0, 26, 23, 23, -1
+};
+
+// NOTE layout.profile was written by subleq --profile, running the
+// program as it assembles without a profile. The loop body comes straight
+// after the entry, each part followed by the cells it uses, and the cold code
+// that never runs is moved to the end.
+static const int LayoutCells[] = {
+    30, 30, 33, 12, 15, 6, 18, 15, 9, 12, 12, 21, 3, 3, 36, 0, 0, 39, 1, 1,
+    45, 15, 12, 24, 30, 12, 36, 30, 30, 33, 0, 0, 42, 15, 15, 3, 30, 30, -1,
+    6, 6, -1, 5, 5, 9
+};
+
+// Each object refers to labels in the other, and the result is what
+// assembling the two sources as one file gives.
+static const int LinkCells[] = {
+    15, 18, 6, 21, 21, -1, 15, 21, 9, 21, 18, 12, 21, 21, 0, 3, 3, 18, 4, 4,
+    21, 0, 0, 24
+};
+
+// Every program in DATA_DIRECTORY that isn't built by one of these is built
+// on its own, and only has to build.
+static const test_case TestCases[] = {
+    // Clearing a cell of the instruction doing it counts as writing to code
+    // that has run.
+    { .Name = "basic",             .Sources = { "basic" },
+      .SelfModifying = true,
+      .Cells = Cells(BasicCells) },
+    { .Name = "next_address",      .Sources = { "next_address" },
+      .Cells = Cells(NextAddressCells) },
+    { .Name = "two_address",       .Sources = { "two_address" },
+      .Cells = Cells(TwoAddressCells) },
+    { .Name = "one_address",       .Sources = { "one_address" },
+      .Cells = Cells(OneAddressCells) },
+    { .Name = "label",             .Sources = { "label" },
+      .SelfModifying = true,
+      .Cells = Cells(BasicCells) },
+    { .Name = "identifier",        .Sources = { "identifier" },
+      .SelfModifying = true,
+      .Cells = Cells(BasicCells) },
+
+    // complex.sq writes into its own code, so it gets no partition.
+    { .Name = "complex",           .Sources = { "complex" },
+      .SelfModifying = true,
+      .Cells = Cells(ComplexCells),
+      .CheckFacts = true, .Facts = IMAGE_ANALYZED },
+
+    { .Name = "forward_reference", .Sources = { "forward_reference" },
+      .SelfModifying = true,
+      .Cells = Cells(ForwardReferenceCells) },
+
+    { .Name = "directives",        .Sources = { "directives" },
+      .Cells = Cells(DirectivesCells),
+      .Watched = true },
+
+    { .Name = "undeclared_identifier", .Sources = { "undeclared_identifier" },
+      .Fails = true },
+    { .Name = "add_addresses",     .Sources = { "add_addresses" },
+      .Fails = true },
+    { .Name = "unknown_symbol",    .Sources = { "unknown_symbol" },
+      .Fails = true },
+
+    { .Name = "dead_code",         .Sources = { "dead_code" },
+      .Optimize = true,
+      .Cells = Cells(DeadCodeCells) },
+    { .Name = "optimize",          .Sources = { "optimize" },
+      .Optimize = true, .DropPrints = true,
+      .Cells = Cells(OptimizeCells) },
+    { .Name = "rewrite",           .Sources = { "rewrite" },
+      .Optimize = true, .DropPrints = true,
+      .RewriteFile = "data/rewrites.db",
+      .Cells = Cells(RewriteCells) },
+    { .Name = "layout",            .Sources = { "layout" },
+      .ProfileFile = DATA_DIRECTORY "/layout.profile",
+      .Cells = Cells(LayoutCells),
+      .Served = true },
+
+    // layout.sq never changes its code, so it gets a partition of the
+    // instructions that can run.
+    { .Name = "analysis",          .Sources = { "layout" },
+      .CheckFacts = true, .Facts = IMAGE_ANALYZED | IMAGE_STATIC,
+      .CodeStart = 0, .CodeEnd = 33 },
+
+    // countdown.sq runs for long enough that the engines publish their
+    // counters a good few times before it halts.
+    { .Name = "countdown",         .Sources = { "countdown" } },
+
+    // The linked program loops forever.
+    { .Name = "link_objects",      .Sources = { "link_main", "link_lib" },
+      .Endless = true,
+      .Cells = Cells(LinkCells) },
+
+    { .Name = "unexpected_characters", .Sources = { "unexpected_characters" },
+      .Fails = true },
+    { .Name = "label_ends_line",   .Sources = { "label_ends_line" },
+      .Fails = true },
+
+    // specialize.sq only loops over constants, so all that's left of it once
+    // it's specialized is what it does with x, cell 32.
+    { .Name = "specialize",        .Sources = { "specialize" },
+      .SpecializeInput = 32 },
+
+    // A generated program does whatever it happens to do, so it's built but
+    // not run. It's several times the size the assembler splits sources at,
+    // and the size of a stream's window.
+    { .Name = "generated",         .Sources = { "generated" },
+      .Endless = true,
+      .GeneratedSize = 3 * 1024 * 1024, .Threads = 4, .Streamed = true,
+      .Watched = true }
+};
+
+
+/** Building. */
+
+// ReadSource() reads the file at [Path] into [Source], with a zero after it.
+// Returns ERROR if it can't be read.
+static
+status_code ReadSource(const char *Path, buffer<char> *Source)
+{
+    std::ifstream File (Path, std::ifstream::in | std::ifstream::binary);
+
+    if (!File)
+    {
+        Error("Failed to open input file \"%s\".\n", Path);
+        return ERROR;
+    }
+
+    File.seekg(0, std::ios::end);
+    long Size = File.tellg();
+    File.seekg(0, std::ios::beg);
+
+    Reserve<char>(Source, Size + 1);
+    Source->Length = Size;
+
+    File.read(Source->Data, Size);
+    (*Source)[Size] = '\0';
+
+    return OK;
+}
+
+// LoadSource() reads source [Index] of [Case] into [Source], with a zero
+// after it, or makes it with the generator if the case asks for that.
+// Returns ERROR if it can't be read.
+static
+status_code LoadSource(const test_case *Case,
+                       unsigned int Index,
+                       buffer<char> *Source)
+{
+    if (Case->GeneratedSize)
+    {
+        source_shape Shape = DefaultShape();
+        Shape.Size = Case->GeneratedSize;
+
+        Generate(&Shape, Source);
+
+        Append<char>(Source, '\0');
+        Source->Length--;
+
+        return OK;
+    }
+
+    char Path[4096];
+    snprintf(Path, sizeof(Path), DATA_DIRECTORY "/%s.sq",
+             Case->Sources[Index]);
+
+    return ReadSource(Path, Source);
+}
+
+// AssembleSource() assembles source [Index] of [Case] into [Assembler], as
+// an object if [Relocatable], on up to [ThreadCount] threads. Returns ERROR,
+// after reporting why, if it doesn't assemble.
+static
+status_code AssembleSource(const test_case *Case,
+                           unsigned int Index,
+                           bool Relocatable,
+                           unsigned int ThreadCount,
+                           buffer<char> *Source,
+                           assembler *Assembler)
+{
+    if (LoadSource(Case, Index, Source) != OK)
+        return ERROR;
+
+    *Assembler = { };
+    Assembler->Relocatable = Relocatable;
+
+    Assemble(Assembler, Source->Data, Source->Length, ThreadCount);
+
+    if (ErrorCount(Assembler))
+    {
+        for (unsigned int i = 0; i < Assembler->Chunks.Length; i++)
+        {
+            ReportErrors(&Assembler->Chunks[i].Errors,
+                         Source->Data,
+                         Source->Length,
+                         &Assembler->LineStarts);
+        }
+
+        return ERROR;
+    }
+
+    return OK;
+}
+
+// Build() builds the program of [Case] into [Program], the way subleqc (and
+// subleq-ld) would, writing whatever files it needs into [Directory].
+// Returns ERROR, after saying why, if it doesn't build.
+static
+status_code Build(const test_case *Case,
+                  const char *Directory,
+                  buffer<int> *Program)
+{
+    status_code Status = OK;
+
+    unsigned int SourceCount = 0;
+
+    while (SourceCount < MAX_SOURCES && Case->Sources[SourceCount])
+        SourceCount++;
+
+    if (SourceCount == 1)
+    {
+        buffer<char> Source = { };
+        assembler Assembler = { };
+
+        Status = AssembleSource(Case, 0, false, 1, &Source, &Assembler);
+
+        if (Status == OK && Case->Optimize)
+        {
+            buffer<rewrite> Rewrites = { };
+
+            if (Case->RewriteFile &&
+                LoadRewrites(Case->RewriteFile, &Rewrites,
+                             Case->DropPrints) != OK)
+            {
+                Error("Failed to open rewrite database \"%s\".\n",
+                      Case->RewriteFile);
+
+                Status = ERROR;
+            }
+            else
+            {
+                Optimize(&Assembler.Program, &Rewrites, Assembler.Labels,
+                         Case->DropPrints);
+            }
+
+            Empty<rewrite>(&Rewrites);
+        }
+
+        if (Status == OK && Case->ProfileFile)
+        {
+            buffer<unsigned long long> Counts = { };
+
+            if (LoadProfile(Case->ProfileFile, Assembler.Program.Length,
+                            &Counts) != OK)
+            {
+                Error("Failed to open profile \"%s\".\n", Case->ProfileFile);
+
+                Status = ERROR;
+            }
+            else
+            {
+                Layout(&Assembler.Program, &Counts, Assembler.Labels);
+            }
+
+            Empty<unsigned long long>(&Counts);
+        }
+
+        if (Status == OK)
+        {
+            Append<int>(Program, Assembler.Program.Data,
+                        Assembler.Program.Length);
+        }
+
+        Empty(&Assembler);
+        Empty<char>(&Source);
+
+        return Status;
+    }
+
+    // Assemble every source into an object, then link them.
+    buffer<object> Objects = { };
+    Reserve<object>(&Objects, SourceCount);
+
+    for (unsigned int i = 0; i < SourceCount && Status == OK; i++)
+    {
+        buffer<char> Source = { };
+        assembler Assembler = { };
+
+        Status = AssembleSource(Case, i, true, 1, &Source, &Assembler);
+
+        char Path[4096];
+        snprintf(Path, sizeof(Path), "%s/%s.o", Directory, Case->Sources[i]);
+
+        if (Status == OK)
+        {
+            std::ofstream ObjectFile (Path, std::ofstream::out |
+                                            std::ofstream::binary);
+
+            WriteObject(&ObjectFile,
+                        Assembler.Program.Data,
+                        Assembler.Program.Length,
+                        &Assembler.Relocations,
+                        Assembler.Labels,
+                        &Assembler.Imports);
+
+            ObjectFile.close();
+
+            object Object = { };
+            Status = LoadObject(Path, &Object);
+
+            if (Status == OK)
+                Append<object>(&Objects, Object);
+
+            std::remove(Path);
+        }
+
+        Empty(&Assembler);
+        Empty<char>(&Source);
+    }
+
+    if (Status == OK)
+    {
+        symbol_table Labels = { };
+
+        if (LinkObjects(&Objects, Case->Sources, Program, &Labels))
+            Status = ERROR;
+
+        Empty(&Labels);
+    }
+
+    for (unsigned int i = 0; i < Objects.Length; i++)
+        Empty(&Objects[i]);
+
+    Empty<object>(&Objects);
+
+    return Status;
+}
+
+
+// SameProgram() returns whether [Program], built [How], is exactly
+// [Reference], saying where it isn't if not.
+static
+bool SameProgram(const buffer<int> *Reference,
+                 const buffer<int> *Program,
+                 const char *How)
+{
+    if (Program->Length != Reference->Length)
+    {
+        printf("Built %s, it has %u cells, not %u.\n",
+               How, Program->Length, Reference->Length);
+
+        return false;
+    }
+
+    for (unsigned int i = 0; i < Program->Length; i++)
+    {
+        if (Program->Data[i] != Reference->Data[i])
+        {
+            printf("Built %s, it has %d in cell %u, not %d.\n",
+                   How, Program->Data[i], i, Reference->Data[i]);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// BuildStream() writes [Source] to a file in [Directory] and assembles it
+// from there as a stream, the way subleqc --stream would, into [Program].
+// Returns ERROR, after saying why, if it doesn't build.
+static
+status_code BuildStream(const test_case *Case,
+                        const buffer<char> *Source,
+                        const char *Directory,
+                        buffer<int> *Program)
+{
+    char SourcePath[4096], ImagePath[4096];
+    snprintf(SourcePath, sizeof(SourcePath), "%s/%s.sq",
+             Directory, Case->Name);
+    snprintf(ImagePath, sizeof(ImagePath), "%s/%s.stream.x",
+             Directory, Case->Name);
+
+    std::ofstream SourceOut (SourcePath, std::ofstream::out |
+                                         std::ofstream::binary);
+    SourceOut.write(Source->Data, Source->Length);
+    SourceOut.close();
+
+    std::ifstream SourceFile (SourcePath, std::ifstream::in |
+                                          std::ifstream::binary);
+    std::ofstream BinaryFile (ImagePath, std::ofstream::out |
+                                         std::ofstream::binary);
+
+    unsigned int Errors = AssembleStream(&SourceFile, &BinaryFile, 0, false);
+
+    SourceFile.close();
+    BinaryFile.close();
+
+    image Image;
+    status_code Status = Errors ? ERROR : LoadImage(ImagePath, &Image);
+
+    if (Status == OK)
+    {
+        Append<int>(Program, Image.Memory, Image.MemorySize);
+        Unload(&Image);
+    }
+
+    std::remove(SourcePath);
+    std::remove(ImagePath);
+
+    return Status;
+}
+
+// WatchVersion() brings [Cache] up to date with [Source], the way --watch
+// does when the source is saved, and returns whether that gives exactly the
+// program assembling [Source] does, built [How].
+static
+bool WatchVersion(cache *Cache, const buffer<char> *Source, const char *How)
+{
+    assembler Assembler = { };
+    Assemble(&Assembler, Source->Data, Source->Length, 1);
+
+    buffer<unsigned int> Changed = { };
+
+    bool Same = true;
+
+    if (ErrorCount(&Assembler))
+    {
+        printf("It doesn't build %s.\n", How);
+        Same = false;
+    }
+    else if (!Update(Cache, Source, &Changed))
+    {
+        printf("It didn't build %s.\n", How);
+        Same = false;
+    }
+    else
+    {
+        Same = SameProgram(&Assembler.Program, &Cache->Program, How);
+    }
+
+    Empty<unsigned int>(&Changed);
+    Empty(&Assembler);
+
+    return Same;
+}
+
+// BuildWatched() assembles [Source] the way --watch does, first from nothing,
+// then with a line added in the middle, which moves everything after it, then
+// with labels moved on to the next line, each time going back to [Source]
+// after. Returns whether every version gave exactly the program
+// assembling it does.
+static
+bool BuildWatched(const buffer<char> *Source)
+{
+    cache Cache = { };
+    Append<line_result>(&Cache.Results, (line_result) { });
+
+    // LineAfter() returns where the line after [Offset] starts.
+    auto LineAfter = [&](unsigned int Offset) -> unsigned int
+    {
+        while (Offset < Source->Length && Source->Data[Offset] != '\n')
+            Offset++;
+
+        return std::min(Offset + 1, Source->Length);
+    };
+
+    bool Same = WatchVersion(&Cache, Source, "as watched");
+
+    // Every instruction takes up three words, so the words after it move.
+    buffer<char> Edited = { };
+    unsigned int Middle = LineAfter(Source->Length / 2);
+
+    Append<char>(&Edited, Source->Data, Middle);
+    Append<char>(&Edited, "0, 0, ?\n", 8);
+    Append<char>(&Edited, Source->Data + Middle, Source->Length - Middle);
+
+    Same = Same && WatchVersion(&Cache, &Edited, "as watched, after adding a "
+                                                 "line");
+    Same = Same && WatchVersion(&Cache, Source, "as watched, after taking "
+                                                "the line out again");
+
+    // Move the labels of a line a third of the way in on to the line after
+    // it, and make the line an instruction of its own. The words stay where
+    // they are, but the labels and everything that refers to them move.
+    auto LabelsEnd = [&](unsigned int Begin) -> unsigned int
+    {
+        unsigned int Labels = Begin;
+
+        for (unsigned int i = Begin; i < LineAfter(Begin); i++)
+        {
+            if (Source->Data[i] == ':')
+                Labels = i + 1;
+        }
+
+        return Labels;
+    };
+
+    unsigned int Begin = LineAfter(Source->Length / 3);
+
+    while (Begin < Source->Length &&
+           (LabelsEnd(Begin) == Begin ||
+            LabelsEnd(LineAfter(Begin)) != LineAfter(Begin)))
+    {
+        Begin = LineAfter(Begin);
+    }
+
+    unsigned int Labels = LabelsEnd(Begin);
+    unsigned int Next = LineAfter(Begin);
+
+    Clear<char>(&Edited);
+    Append<char>(&Edited, Source->Data, Begin);
+    Append<char>(&Edited, "1, 2, 3\n", 8);
+    Append<char>(&Edited, Source->Data + Begin, Labels - Begin);
+    Append<char>(&Edited, Source->Data + Next, Source->Length - Next);
+
+    Same = Same && WatchVersion(&Cache, &Edited, "as watched, after "
+                                                 "moving labels");
+    Same = Same && WatchVersion(&Cache, Source, "as watched, after moving "
+                                                "them back");
+
+    Empty<char>(&Edited);
+    Empty(&Cache);
+
+    return Same;
+}
+
+// CheckBuilds() builds the one source of [Case] again every other way it
+// asks for, writing whatever files it needs into [Directory], and returns
+// whether each of them gave exactly [Program].
+static
+bool CheckBuilds(const test_case *Case,
+                 const char *Directory,
+                 const buffer<int> *Program)
+{
+    bool Same = true;
+
+    if (Case->Streamed)
+    {
+        buffer<char> Source = { };
+        buffer<int> Streamed = { };
+
+        if (LoadSource(Case, 0, &Source) != OK ||
+            BuildStream(Case, &Source, Directory, &Streamed) != OK)
+        {
+            printf("It didn't build as a stream.\n");
+            Same = false;
+        }
+        // NOTE A source that fits in one window would pass without testing
+        // anything.
+        else if (Source.Length <= STREAM_WINDOW_SIZE)
+        {
+            printf("It's too small to stream in more than one window.\n");
+            Same = false;
+        }
+        else
+        {
+            Same &= SameProgram(Program, &Streamed, "as a stream");
+        }
+
+        Empty<int>(&Streamed);
+        Empty<char>(&Source);
+    }
+
+    if (Case->Watched)
+    {
+        buffer<char> Source = { };
+
+        if (LoadSource(Case, 0, &Source) != OK)
+            Same = false;
+        else
+            Same &= BuildWatched(&Source);
+
+        Empty<char>(&Source);
+    }
+
+    if (Case->Threads > 1)
+    {
+        buffer<char> Source = { };
+        assembler Assembler = { };
+
+        if (AssembleSource(Case, 0, false, Case->Threads, &Source,
+                           &Assembler) != OK)
+        {
+            printf("It didn't build on %u threads.\n", Case->Threads);
+            Same = false;
+        }
+        // NOTE A source too small to split would pass without testing
+        // anything.
+        else if (Assembler.Chunks.Length != Case->Threads)
+        {
+            printf("It was split into %u chunks, not %u.\n",
+                   Assembler.Chunks.Length, Case->Threads);
+            Same = false;
+        }
+        else
+        {
+            Same &= SameProgram(Program, &Assembler.Program,
+                                "on several threads");
+        }
+
+        Empty(&Assembler);
+        Empty<char>(&Source);
+    }
+
+    return Same;
+}
+
+
+/** Running. */
+
+// CaptureOutput() starts sending what programs print to a file of its own.
+static
+void CaptureOutput()
+{
+    OutputFile = tmpfile();
+    Assert(OutputFile != NULL);
+}
+
+// ReleaseOutput() appends everything printed since CaptureOutput() to
+// [Output], and goes back to printing to the standard output.
+static
+void ReleaseOutput(buffer<char> *Output)
+{
+    long OutputSize = ftell(OutputFile);
+    rewind(OutputFile);
+
+    Reserve<char>(Output, Output->Length + OutputSize + 1);
+    Output->Length += fread(Output->Data + Output->Length, 1, OutputSize,
+                            OutputFile);
+
+    fclose(OutputFile);
+    OutputFile = stdout;
+}
+
+// Run() runs [Memory], [MemorySize] cells of it, on the unchecked engine if
+// [Static] and the checked one if not, publishing to [Stats] if it's given,
+// and fills [Result] with everything the run leaves behind, after whatever
+// [Result] was already printed.
+static
+void Run(int *Memory, unsigned int MemorySize, unsigned int Entry,
+         bool Static, run_result *Result, stats_segment *Stats = NULL)
+{
+    CaptureOutput();
+
+    Result->Status = Static ? RunUnchecked(Memory, Entry, NULL, NULL,
+                                           NO_BUDGET, Stats) :
+                              RunChecked(Memory, MemorySize, Entry, NULL,
+                                         NULL, NO_BUDGET, Stats);
+
+    ReleaseOutput(&Result->Output);
+
+    Append<int>(&Result->Memory, Memory, MemorySize);
+}
+
+// RunImage() writes [Program] to an image at [Path], packed if [Packed], and
+// runs it the way the emulator would, filling [Result] with what the run
+// leaves behind. If there are [ReadySteps], it's run that far into a template
+// first, and the rest of the way from a clone of it. Returns ERROR if the
+// image can't be loaded back, or the template can't be made.
+static
+status_code RunImage(buffer<int> *Program,
+                     const image_facts *Facts,
+                     const char *Path,
+                     bool Packed,
+                     unsigned long long ReadySteps,
+                     run_result *Result)
+{
+    *Result = { };
+
+    std::ofstream BinaryFile (Path, std::ofstream::out |
+                                    std::ofstream::binary);
+
+    WriteImage(&BinaryFile, Program->Data, Program->Length, 0, true, Packed,
+               Facts, NULL);
+
+    BinaryFile.close();
+
+    image Image;
+    status_code Status = LoadImage(Path, &Image);
+
+    if (Status == OK && ReadySteps != NO_BUDGET)
+    {
+        vm_template Template;
+        image Clone;
+
+        CaptureOutput();
+        Status = CreateTemplate(&Image, NO_READY_ADDRESS, ReadySteps, NULL,
+                                &Template);
+        ReleaseOutput(&Result->Output);
+
+        if (Status == OK && (Status = CloneTemplate(&Template, &Clone)) == OK)
+        {
+            Run(Clone.Memory, Clone.MemorySize, Clone.Entry, Clone.Static,
+                Result);
+            Unload(&Clone);
+        }
+
+        if (Status != OK)
+            Error("The template can't be made.\n");
+
+        ReleaseTemplate(&Template);
+        Unload(&Image);
+    }
+    else if (Status == OK)
+    {
+        Run(Image.Memory, Image.MemorySize, Image.Entry, Image.Static,
+            Result);
+        Unload(&Image);
+    }
+    else
+    {
+        Error("The %s image doesn't load.\n", Packed ? "packed" : "plain");
+    }
+
+    std::remove(Path);
+
+    return Status;
+}
+
+// RunStats() runs [Program] the way "subleq --stats <name> --self-modifying"
+// does, on the unchecked engine if [Static] and the checked one if not,
+// filling [Result] like Run() does. Then it
+// reads the counters back the way subleq-top does, and checks them against
+// [Case] and the [Reference] run. Returns ERROR, after saying why, if the
+// segment can't be made or opened, or the counters are wrong.
+static
+status_code RunStats(const test_case *Case,
+                     const buffer<int> *Program,
+                     bool Static,
+                     const run_result *Reference,
+                     run_result *Result)
+{
+    char Name[256];
+    snprintf(Name, sizeof(Name), "subleq-tester-%d-%s", (int)getpid(),
+             Case->Name);
+
+    stats_segment *Stats = CreateStats(Name, STATS_SELF_MODIFYING);
+
+    if (!Stats)
+        return ERROR;
+
+    buffer<int> Memory = { };
+    Append<int>(&Memory, Program->Data, Program->Length);
+
+    Run(Memory.Data, Memory.Length, 0, Static, Result, Stats);
+
+    Empty<int>(&Memory);
+
+    Stats->State.store(STATS_STOPPED, std::memory_order_release);
+
+    const stats_segment *Segment = OpenStats(Name);
+
+    ReleaseStats(Stats, Name);
+
+    if (!Segment)
+    {
+        printf("The stats segment can't be opened.\n");
+        return ERROR;
+    }
+
+    // NOTE Every instruction prints a line, so the reference run's output
+    // says how many ran.
+    uint64_t Steps = std::count(Reference->Output.Data,
+                                Reference->Output.Data +
+                                Reference->Output.Length, '\n');
+    uint64_t Taken = Segment->Taken.load(std::memory_order_relaxed);
+    uint64_t SelfModifying =
+        Segment->SelfModifying.load(std::memory_order_relaxed);
+
+    status_code Status = OK;
+
+    if (Segment->State.load(std::memory_order_acquire) != STATS_STOPPED ||
+        Segment->Steps.load(std::memory_order_relaxed) != Steps ||
+        Taken > Steps ||
+        (SelfModifying > 0) != Case->SelfModifying)
+    {
+        printf("The %s run published %llu steps, %llu taken and %llu "
+               "self-modifying; %llu steps ran, and it should%s have "
+               "modified itself.\n",
+               RunNames[Static ? RUN_UNCHECKED_STATS : RUN_STATS],
+               (unsigned long long)Segment->Steps.load(
+                   std::memory_order_relaxed),
+               (unsigned long long)Taken,
+               (unsigned long long)SelfModifying,
+               (unsigned long long)Steps,
+               Case->SelfModifying ? "" : "n't");
+
+        Status = ERROR;
+    }
+
+    ReleaseStats(Segment);
+
+    return Status;
+}
+
+// Empty() frees all the memory held by [Result].
+static
+void Empty(run_result *Result)
+{
+    Empty<int>(&Result->Memory);
+    Empty<char>(&Result->Output);
+}
+
+// Compare() returns whether [Run] left behind exactly what [Reference] did,
+// saying how it didn't if not.
+static
+bool Compare(const run_result *Reference, run_result *Run, const char *Name)
+{
+    bool Same = true;
+
+    if (Run->Status != Reference->Status)
+    {
+        printf("The %s run stopped with %d, not %d.\n",
+               Name, Run->Status, Reference->Status);
+        Same = false;
+    }
+
+    if (Run->Output.Length != Reference->Output.Length ||
+        std::memcmp(Run->Output.Data, Reference->Output.Data,
+                    Run->Output.Length) != 0)
+    {
+        printf("The %s run printed something else.\n", Name);
+        Same = false;
+    }
+
+    if (Run->Memory.Length != Reference->Memory.Length)
+    {
+        printf("The %s run had %u cells of memory, not %u.\n",
+               Name, Run->Memory.Length, Reference->Memory.Length);
+        Same = false;
+    }
+    else
+    {
+        for (unsigned int i = 0; i < Run->Memory.Length; i++)
+        {
+            if (Run->Memory[i] != Reference->Memory.Data[i])
+            {
+                printf("The %s run left %d in cell %u, not %d.\n",
+                       Name, Run->Memory[i], i, Reference->Memory.Data[i]);
+                Same = false;
+                break;
+            }
+        }
+    }
+
+    return Same;
+}
+
+// CheckOptimized() builds the one source of [Case] with -O, and its rewrites
+// if it has any, and without, and runs both. Returns whether they stop the
+// same way and print exactly the same, saying how they didn't if not.
+// [Built] is the run of the program as [Case] builds it, which stands in for
+// the one without -O if it's that.
+static
+bool CheckOptimized(const test_case *Case,
+                    const char *Directory,
+                    const run_result *Built)
+{
+    test_case Plain = *Case;
+    Plain.Optimize    = false;
+    Plain.DropPrints  = false;
+    Plain.RewriteFile = NULL;
+    Plain.ProfileFile = NULL;
+
+    // NOTE Without --drop-prints, rewrites that print less are skipped.
+    test_case Optimized = Plain;
+    Optimized.Optimize    = true;
+    Optimized.RewriteFile = Case->RewriteFile;
+
+    const test_case *Cases[2] = { &Plain, &Optimized };
+    run_result Runs[2] = { };
+
+    bool BuiltPlain = !Case->Optimize && !Case->ProfileFile;
+    bool Same = true;
+
+    for (unsigned int i = BuiltPlain; i < 2 && Same; i++)
+    {
+        buffer<int> Program = { };
+
+        if (Build(Cases[i], Directory, &Program) != OK)
+        {
+            printf("It didn't build %s -O.\n", i ? "with" : "without");
+            Same = false;
+        }
+        else
+        {
+            Run(Program.Data, Program.Length, 0, false, &Runs[i]);
+        }
+
+        Empty<int>(&Program);
+    }
+
+    const run_result *Reference = BuiltPlain ? Built : &Runs[0];
+    const buffer<char> *Expected = &Reference->Output;
+    const buffer<char> *Got = &Runs[1].Output;
+
+    if (Same && Runs[1].Status != Reference->Status)
+    {
+        printf("Built with -O, it stopped with %d, not %d.\n",
+               Runs[1].Status, Reference->Status);
+        Same = false;
+    }
+
+    if (Same &&
+        (Got->Length != Expected->Length ||
+         std::memcmp(Got->Data, Expected->Data, Got->Length) != 0))
+    {
+        printf("Built with -O, it printed something else: %ld lines, where "
+               "it printed %ld without.\n",
+               (long)std::count(Got->Data, Got->Data + Got->Length, '\n'),
+               (long)std::count(Expected->Data,
+                                Expected->Data + Expected->Length, '\n'));
+        Same = false;
+    }
+
+    Empty(&Runs[0]);
+    Empty(&Runs[1]);
+
+    return Same;
+}
+
+// The inputs a specialized program is checked on, besides the one it has.
+static const int SpecializeSamples[] = { -64, -1, 0, 1, 64 };
+
+// CheckSpecialized() specializes [Program] with the cell [Case] says is its
+// input, and every other cell constant. Then it runs the original and the
+// residual program on the input the program has and on every one of
+// SpecializeSamples, and returns whether they always stop the same way with
+// the same values in every cell, and the residual program runs fewer
+// instructions, saying how they didn't if not. What they print isn't
+// compared, since it differs by design (see docs/subleq-spec.md).
+static
+bool CheckSpecialized(const test_case *Case, const buffer<int> *Program)
+{
+    unsigned int Length = Program->Length;
+    unsigned int Input = (unsigned int)Case->SpecializeInput;
+
+    buffer<unsigned char> Inputs = { };
+    Reserve<unsigned char>(&Inputs, Length);
+    Inputs.Length = Length;
+    std::fill(Inputs.Data, Inputs.Data + Length, 0);
+    Inputs[Input] = 1;
+
+    buffer<unsigned char> Watched = { };
+    Reserve<unsigned char>(&Watched, Length);
+    Watched.Length = Length;
+    std::fill(Watched.Data, Watched.Data + Length, 1);
+
+    specializer Specializer = { };
+    Specializer.Memory       = Program->Data;
+    Specializer.MemorySize   = Length;
+    Specializer.Watched      = Watched.Data;
+    Specializer.FoldLimit    = SPECIALIZE_BUDGET;
+    Specializer.VariantLimit = SPECIALIZE_VARIANTS;
+
+    residual Residual = { };
+    bool Same = Specialize(&Specializer, Inputs.Data, 0) == OK;
+
+    if (!Same)
+        printf("It didn't specialize.\n");
+    else
+        LayOut(&Specializer, &Residual);
+
+    unsigned int SampleCount = sizeof(SpecializeSamples) /
+                               sizeof(SpecializeSamples[0]);
+
+    buffer<int> Original = { };
+    buffer<int> Specialized = { };
+
+    // NOTE The residual program doesn't print what was worked out
+    // ahead of time, and prints the values it writes into its own cells to
+    // catch up with the original, and when it stops. No part of what the two
+    // print has to match, so it's formatted, but not kept.
+    OutputFile = fopen("/dev/null", "w");
+
+    for (unsigned int Sample = 0; Same && Sample <= SampleCount; Sample++)
+    {
+        int Value = Sample ? SpecializeSamples[Sample - 1] :
+                             Program->Data[Input];
+
+        Original.Length = 0;
+        Specialized.Length = 0;
+        Append<int>(&Original, Program->Data, Length);
+        Append<int>(&Specialized, Residual.Program.Data,
+                    Residual.Program.Length);
+
+        Original[Input] = Value;
+        Specialized[Residual.CellBase + Specializer.CellIndex[Input]] = Value;
+
+        unsigned long long Steps = 0, Fewer = 0;
+
+        engine_status Expected = RunChecked(Original.Data, Length, 0, NULL,
+                                            &Steps, SPECIALIZE_BUDGET);
+        engine_status Got = RunChecked(Specialized.Data, Specialized.Length,
+                                       0, NULL, &Fewer, SPECIALIZE_BUDGET);
+
+        if (Expected != HALTED || Got != HALTED || Fewer >= Steps)
+        {
+            printf("With %d as input, the original program stopped with %d "
+                   "after %llu steps, and the specialized one with %d after "
+                   "%llu.\n", Value, Expected, Steps, Got, Fewer);
+            Same = false;
+        }
+
+        for (unsigned int i = 0; Same && i < Length; i++)
+        {
+            // NOTE A cell that never got a residual cell never changes.
+            unsigned int Cell = Specializer.CellIndex[i];
+            int Ended = Cell == NO_CELL ? Program->Data[i] :
+                        Specialized[Residual.CellBase + Cell];
+
+            if (Ended != Original[i])
+            {
+                printf("With %d as input, the specialized program left %d "
+                       "in cell %u, not %d.\n", Value, Ended, i, Original[i]);
+                Same = false;
+            }
+        }
+    }
+
+    fclose(OutputFile);
+    OutputFile = stdout;
+
+    Empty<int>(&Original);
+    Empty<int>(&Specialized);
+    Empty(&Residual);
+    Empty(&Specializer);
+    Empty<unsigned char>(&Inputs);
+    Empty<unsigned char>(&Watched);
+
+    return Same;
+}
+
+// ReadAll() appends everything left in [File] to [Text], with a zero after it.
+static
+void ReadAll(FILE *File, buffer<char> *Text)
+{
+    char Chunk[4096];
+    size_t Read;
+
+    while ((Read = fread(Chunk, 1, sizeof(Chunk), File)) > 0)
+        Append<char>(Text, Chunk, (unsigned int)Read);
+
+    Append<char>(Text, '\0');
+    Text->Length--;
+}
+
+// Client() runs subleq-client with [Arguments], talking to the server at
+// [Socket], putting what it prints in [Output] and what it says about the
+// job in the file at [Messages]. Returns whether it said the job halted.
+static
+bool Client(const char *Socket,
+            const char *Arguments,
+            const char *Messages,
+            buffer<char> *Output)
+{
+    char Command[8192];
+    snprintf(Command, sizeof(Command), "%s --socket '%s' %s 2> '%s'",
+             ClientPath, Socket, Arguments, Messages);
+
+    fflush(stdout);
+
+    FILE *Pipe = popen(Command, "r");
+
+    if (!Pipe)
+        return false;
+
+    ReadAll(Pipe, Output);
+
+    int Status = pclose(Pipe);
+
+    return WIFEXITED(Status) && WEXITSTATUS(Status) == 0;
+}
+
+// StartServer() starts the emulator's server with [Options] in a process of
+// its own, which gives up after DEFAULT_TIMEOUT seconds, and returns it, or -1
+// if it can't be started. The process exits with 0 if the server stopped
+// cleanly, and 1 if it didn't start. If [Quiet], nothing it prints is shown.
+static
+pid_t StartServer(const serve_options *Options, bool Quiet)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t Server = fork();
+
+    if (Server == 0)
+    {
+        int Null = Quiet ? open("/dev/null", O_WRONLY) : -1;
+
+        if (Null >= 0)
+        {
+            dup2(Null, STDOUT_FILENO);
+            dup2(Null, STDERR_FILENO);
+            close(Null);
+        }
+
+        alarm(DEFAULT_TIMEOUT);
+        _exit(RunServer(Options) == OK ? 0 : 1);
+    }
+
+    return Server;
+}
+
+// CheckServed() writes [Program] to an image in [Directory], starts the
+// emulator's server in a process of its own, and sends it the image twice
+// with subleq-client, the second time from the server's cache. Each time, it
+// has to print what the [Reference] run did, and stop the same way. Then it
+// stops the server the way Ctrl-C would, which has to stop and remove its
+// socket, and checks that a server never removes a file at its socket's path
+// that isn't a socket. Returns whether all of that went as it should, saying
+// how it didn't if not.
+static
+bool CheckServed(const test_case *Case,
+                 const buffer<int> *Program,
+                 const image_facts *Facts,
+                 const char *Directory,
+                 const run_result *Reference)
+{
+    // NOTE One found on the PATH only turns up when it's run.
+    if (std::strchr(ClientPath, '/') && access(ClientPath, X_OK) != 0)
+    {
+        printf("There's no client to send the program with at \"%s\"; "
+               "build it with scripts/build.sh, or say where it is with "
+               "--client.\n", ClientPath);
+
+        return false;
+    }
+
+    char ImagePath[4096], OtherPath[4096], Socket[4096], Messages[4096];
+    snprintf(ImagePath, sizeof(ImagePath), "%s/%s.served.x",
+             Directory, Case->Name);
+    snprintf(OtherPath, sizeof(OtherPath), "%s/%s.served.other.x",
+             Directory, Case->Name);
+    snprintf(Socket, sizeof(Socket), "%s/%s.sock", Directory, Case->Name);
+    snprintf(Messages, sizeof(Messages), "%s/%s.client", Directory,
+             Case->Name);
+
+    std::ofstream BinaryFile (ImagePath, std::ofstream::out |
+                                         std::ofstream::binary);
+
+    WriteImage(&BinaryFile, Program->Data, Program->Length, 0, true, false,
+               Facts, NULL);
+
+    BinaryFile.close();
+
+    // The same program again, under another path, to make the cache evict.
+    std::ofstream OtherFile (OtherPath, std::ofstream::out |
+                                       std::ofstream::binary);
+
+    WriteImage(&OtherFile, Program->Data, Program->Length, 0, true, false,
+               Facts, NULL);
+
+    OtherFile.close();
+
+    serve_options Options = { };
+    Options.SocketPath  = Socket;
+    Options.WorkerCount = 2;
+    Options.CacheSize   = 1;
+    Options.Budget      = NO_BUDGET;
+
+    bool Passed = true;
+
+    // A file that isn't a socket is in the way, and has to stay that way.
+    // NOTE The server says it can't listen, which is what we're after.
+    std::ofstream (Socket).close();
+
+    struct stat Status;
+    pid_t Server = StartServer(&Options, true);
+    int Stopped = 0;
+
+    bool Exited = false;
+
+    for (unsigned int i = 0; i < 1000 && Server > 0 && !Exited; i++)
+    {
+        Exited = waitpid(Server, &Stopped, WNOHANG) == Server;
+
+        if (!Exited)
+            usleep(1000);
+    }
+
+    if (Server > 0 && !Exited)
+    {
+        kill(Server, SIGKILL);
+        waitpid(Server, &Stopped, 0);
+    }
+
+    if (!Exited || !WIFEXITED(Stopped) || WEXITSTATUS(Stopped) != 1 ||
+        lstat(Socket, &Status) != 0 || !S_ISREG(Status.st_mode))
+    {
+        printf("The server didn't leave the file at its socket's path be.\n");
+        Passed = false;
+    }
+
+    std::remove(Socket);
+
+    Server = StartServer(&Options, false);
+
+    if (Server < 0)
+    {
+        std::remove(ImagePath);
+        std::remove(OtherPath);
+        return false;
+    }
+
+    // NOTE The socket is there once the server's bound it, and can be
+    // connected to once it's listening, just after.
+    bool Listening = false;
+
+    for (unsigned int i = 0; i < 1000 && !Listening; i++)
+    {
+        sockaddr_un Address = { };
+        Address.sun_family = AF_UNIX;
+        std::strcpy(Address.sun_path, Socket);
+
+        int Descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        Listening = Descriptor >= 0 &&
+                    connect(Descriptor, (sockaddr *)&Address,
+                            sizeof(Address)) == 0;
+
+        if (Descriptor >= 0)
+            close(Descriptor);
+
+        if (!Listening)
+            usleep(1000);
+    }
+
+    if (!Listening)
+    {
+        printf("The server never started listening.\n");
+        Passed = false;
+    }
+    else
+    {
+        char Arguments[sizeof(ImagePath) + sizeof("--repeat 2 ''")];
+        snprintf(Arguments, sizeof(Arguments), "--repeat 2 '%s'", ImagePath);
+
+        buffer<char> Output = { };
+        bool Halted = Client(Socket, Arguments, Messages, &Output);
+
+        buffer<char> Expected = { };
+        Append<char>(&Expected, Reference->Output.Data,
+                     Reference->Output.Length);
+        Append<char>(&Expected, Reference->Output.Data,
+                     Reference->Output.Length);
+
+        if (Halted != (Reference->Status == HALTED) ||
+            Output.Length != Expected.Length ||
+            std::memcmp(Output.Data, Expected.Data, Output.Length) != 0)
+        {
+            printf("The served runs didn't print what the checked run did "
+                   "twice.\n");
+            Passed = false;
+        }
+
+        Empty<char>(&Output);
+        Empty<char>(&Expected);
+
+        // Both jobs are counted, and the second came from the cache.
+        Client(Socket, "--stats", Messages, &Output);
+
+        if (!std::strstr(Output.Data, "jobs\t2\n") ||
+            !std::strstr(Output.Data, "cache_hits\t1\n"))
+        {
+            printf("The server's statistics are wrong:\n%s", Output.Data);
+            Passed = false;
+        }
+
+        Empty<char>(&Output);
+
+        // With room for one image, each of these evicts the other, and
+        // neither may run the wrong one.
+        char OtherArguments[sizeof(OtherPath) + sizeof("''")];
+        snprintf(OtherArguments, sizeof(OtherArguments), "'%s'", OtherPath);
+        snprintf(Arguments, sizeof(Arguments), "'%s'", ImagePath);
+
+        const char *Jobs[] = { OtherArguments, Arguments };
+
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            Halted = Client(Socket, Jobs[i], Messages, &Output);
+
+            if (Halted != (Reference->Status == HALTED) ||
+                Output.Length != Reference->Output.Length ||
+                std::memcmp(Output.Data, Reference->Output.Data,
+                            Output.Length) != 0)
+            {
+                printf("A served run after an eviction didn't print what "
+                       "the checked run did.\n");
+                Passed = false;
+            }
+
+            Empty<char>(&Output);
+        }
+
+        Client(Socket, "--stats", Messages, &Output);
+
+        if (!std::strstr(Output.Data, "cache_misses\t3\n") ||
+            !std::strstr(Output.Data, "cached_images\t1\n"))
+        {
+            printf("The server didn't evict as it should have:\n%s",
+                   Output.Data);
+            Passed = false;
+        }
+
+        Empty<char>(&Output);
+    }
+
+    kill(Server, SIGINT);
+    waitpid(Server, &Stopped, 0);
+
+    if (!WIFEXITED(Stopped) || WEXITSTATUS(Stopped) != 0)
+    {
+        printf("The server didn't stop cleanly.\n");
+        Passed = false;
+    }
+    else if (lstat(Socket, &Status) == 0)
+    {
+        printf("The server left its socket behind.\n");
+        Passed = false;
+    }
+
+    std::remove(Socket);
+    std::remove(Messages);
+    std::remove(ImagePath);
+    std::remove(OtherPath);
+
+    return Passed;
+}
+
+// MillisecondsSince() returns how many milliseconds have passed since
+// [Start].
+static inline
+double MillisecondsSince(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - Start).count();
+}
+
+// RunTest() builds and runs [Case], writing whatever files it needs into
+// [Directory], printing what went wrong, if anything. Returns how it went.
+static
+test_result RunTest(const test_case *Case, const char *Directory)
+{
+    test_result Result = { };
+    Result.Passed = true;
+
+    buffer<int> Program = { };
+
+    auto Start = std::chrono::steady_clock::now();
+    status_code Built = Build(Case, Directory, &Program);
+    Result.BuildMilliseconds = MillisecondsSince(Start);
+
+    if (Case->Fails || Built != OK)
+    {
+        if (Case->Fails && Built == OK)
+            printf("It built, but shouldn't have.\n");
+        else if (!Case->Fails)
+            printf("It didn't build.\n");
+
+        Result.Passed = Case->Fails && Built != OK;
+
+        Empty<int>(&Program);
+
+        return Result;
+    }
+
+    if (Case->Cells &&
+        (Program.Length != Case->CellCount ||
+         !std::equal(Program.Data, Program.Data + Program.Length,
+                     Case->Cells)))
+    {
+        printf("Failed to assert that it builds to [");
+
+        for (unsigned int i = 0; i < Case->CellCount; i++)
+            printf(i ? ", %d" : "%d", Case->Cells[i]);
+
+        printf("]; it builds to [");
+
+        for (unsigned int i = 0; i < Program.Length; i++)
+            printf(i ? ", %d" : "%d", Program[i]);
+
+        printf("].\n");
+
+        Result.Passed = false;
+    }
+
+    Result.Passed &= CheckBuilds(Case, Directory, &Program);
+
+    image_facts Facts = { };
+    AnalyzeImage(&Program, 0, &Facts);
+
+    if (Case->CheckFacts &&
+        (Facts.Facts != Case->Facts ||
+         Facts.CodeStart != Case->CodeStart ||
+         Facts.CodeEnd != Case->CodeEnd))
+    {
+        printf("Failed to assert that its facts are (%u, %u, %u); "
+               "they're (%u, %u, %u).\n",
+               Case->Facts, Case->CodeStart, Case->CodeEnd,
+               Facts.Facts, Facts.CodeStart, Facts.CodeEnd);
+
+        Result.Passed = false;
+    }
+
+
+    /** Run it every way, and compare. */
+
+    if (Case->Endless)
+    {
+        Empty<unsigned char>(&Facts.Partition);
+        Empty<int>(&Program);
+
+        return Result;
+    }
+
+    run_result Runs[RUN_COUNT] = { };
+
+    for (unsigned int i = 0; i < RUN_COUNT; i++)
+    {
+        bool Static = Facts.Facts & IMAGE_STATIC;
+
+        if ((i == RUN_UNCHECKED || i == RUN_UNCHECKED_STATS) && !Static)
+            continue;
+
+        Start = std::chrono::steady_clock::now();
+
+        if (i == RUN_CHECKED || i == RUN_UNCHECKED)
+        {
+            buffer<int> Memory = { };
+            Append<int>(&Memory, Program.Data, Program.Length);
+
+            Run(Memory.Data, Memory.Length, 0, i == RUN_UNCHECKED, &Runs[i]);
+
+            Empty<int>(&Memory);
+        }
+        else if (i == RUN_STATS || i == RUN_UNCHECKED_STATS)
+        {
+            if (RunStats(Case, &Program, i == RUN_UNCHECKED_STATS,
+                         &Runs[RUN_CHECKED], &Runs[i]) != OK)
+            {
+                Result.Passed = false;
+                continue;
+            }
+        }
+        else
+        {
+            char Path[4096];
+            snprintf(Path, sizeof(Path), "%s/%s.%s.x",
+                     Directory, Case->Name, RunNames[i]);
+
+            // NOTE Every instruction prints a line, so the reference
+            // run's output says how far halfway is.
+            const buffer<char> *Reference = &Runs[RUN_CHECKED].Output;
+            unsigned long long ReadySteps =
+                i != RUN_TEMPLATE ? NO_BUDGET :
+                std::count(Reference->Data,
+                           Reference->Data + Reference->Length, '\n') / 2;
+
+            if (RunImage(&Program, &Facts, Path, i == RUN_PACKED, ReadySteps,
+                         &Runs[i]) != OK)
+            {
+                Result.Passed = false;
+                continue;
+            }
+        }
+
+        Result.RunMilliseconds[i] = MillisecondsSince(Start);
+        Result.Ran[i] = true;
+
+        if (i != RUN_CHECKED)
+            Result.Passed &= Compare(&Runs[RUN_CHECKED], &Runs[i], RunNames[i]);
+    }
+
+    if (!Case->Sources[1])
+        Result.Passed &= CheckOptimized(Case, Directory, &Runs[RUN_CHECKED]);
+
+    if (Case->SpecializeInput >= 0)
+        Result.Passed &= CheckSpecialized(Case, &Program);
+
+    if (Case->Served)
+        Result.Passed &= CheckServed(Case, &Program, &Facts, Directory,
+                                     &Runs[RUN_CHECKED]);
+
+    for (unsigned int i = 0; i < RUN_COUNT; i++)
+        Empty(&Runs[i]);
+
+    Empty<unsigned char>(&Facts.Partition);
+    Empty<int>(&Program);
+
+    return Result;
+}
+
+// ForkTest() runs [Case] in a process of its own, stopping it after [Timeout]
+// seconds, and puts everything it prints in [Messages]. Returns how it went.
+static
+test_result ForkTest(const test_case *Case,
+                     const char *Directory,
+                     unsigned int Timeout,
+                     buffer<char> *Messages)
+{
+    test_result Result = { };
+
+    int MessagePipe[2], ResultPipe[2];
+
+    if (pipe(MessagePipe) != 0)
+        return Result;
+
+    if (pipe(ResultPipe) != 0)
+    {
+        close(MessagePipe[0]);
+        close(MessagePipe[1]);
+
+        return Result;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t Child = fork();
+
+    if (Child == 0)
+    {
+        close(MessagePipe[0]);
+        close(ResultPipe[0]);
+
+        dup2(MessagePipe[1], STDOUT_FILENO);
+        dup2(MessagePipe[1], STDERR_FILENO);
+        close(MessagePipe[1]);
+
+        alarm(Timeout);
+
+        Result = RunTest(Case, Directory);
+
+        fflush(stdout);
+        fflush(stderr);
+
+        ssize_t Written = write(ResultPipe[1], &Result, sizeof(Result));
+
+        _exit(Written == sizeof(Result) ? 0 : 1);
+    }
+
+    close(MessagePipe[1]);
+    close(ResultPipe[1]);
+
+    if (Child > 0)
+    {
+        char Chunk[4096];
+        ssize_t Read;
+
+        while ((Read = read(MessagePipe[0], Chunk, sizeof(Chunk))) > 0)
+            Append<char>(Messages, Chunk, (unsigned int)Read);
+
+        bool Reported = read(ResultPipe[0], &Result, sizeof(Result)) ==
+                        sizeof(Result);
+
+        int Status = 0;
+        waitpid(Child, &Status, 0);
+
+        if (WIFSIGNALED(Status))
+        {
+            char Message[128];
+            int Length = snprintf(Message, sizeof(Message),
+                                  WTERMSIG(Status) == SIGALRM ?
+                                  "It took more than %u seconds.\n" :
+                                  "It died with signal %d.\n",
+                                  WTERMSIG(Status) == SIGALRM ?
+                                  Timeout : (unsigned int)WTERMSIG(Status));
+
+            Append<char>(Messages, Message, (unsigned int)Length);
+        }
+
+        if (!Reported)
+            Result.Passed = false;
+    }
+
+    close(MessagePipe[0]);
+    close(ResultPipe[0]);
+
+    return Result;
+}
+
+
+int main(int argc, char** argv)
+{
+    options Options = { };
+    Options.Timeout = DEFAULT_TIMEOUT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+        {
+            Options.Timeout = std::max(1, atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--client") == 0 && i + 1 < argc)
+        {
+            Options.ClientPath = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            Severe("Unknown option \"%s\", exiting.\n", argv[i]);
+
+            printf(UsageString);
+
+            return MISSING_ARGS;
+        }
+        else
+        {
+            Append<const char *>(&Options.Tests, argv[i]);
+        }
+    }
+
+
+    // NOTE Without a directory in front of it, the client would be
+    // looked up on the PATH rather than next to the tester.
+    const char *Slash = std::strrchr(argv[0], '/');
+    int ClientLength = 0;
+
+    if (Options.ClientPath)
+    {
+        ClientLength = snprintf(ClientPath, sizeof(ClientPath), "%s",
+                                Options.ClientPath);
+    }
+    else if (Slash)
+    {
+        ClientLength = snprintf(ClientPath, sizeof(ClientPath),
+                                "%.*s/subleq-client",
+                                (int)(Slash - argv[0]), argv[0]);
+    }
+
+    if (ClientLength < 0 || (size_t)ClientLength >= sizeof(ClientPath))
+    {
+        Severe("The client's path is too long, exiting.\n");
+        return MISSING_ARGS;
+    }
+
+
+    /** Find every test. */
+
+    buffer<test_case> Cases = { };
+
+    unsigned int KnownCount = sizeof(TestCases) / sizeof(TestCases[0]);
+
+    Append<test_case>(&Cases, TestCases, KnownCount);
+
+    // The names of the programs that only have to build.
+    arena Names = { };
+
+    DIR *Directory = opendir(DATA_DIRECTORY);
+
+    if (!Directory)
+    {
+        Error("Failed to open \"%s\"; run from the project root.\n",
+              DATA_DIRECTORY);
+
+        return UNKNOWN;
+    }
+
+    while (dirent *Entry = readdir(Directory))
+    {
+        unsigned int Length = strlen(Entry->d_name);
+
+        if (Length < 4 || std::strcmp(Entry->d_name + Length - 3, ".sq") != 0)
+            continue;
+
+        bool Covered = false;
+
+        for (unsigned int i = 0; i < KnownCount; i++)
+        {
+            for (unsigned int j = 0; j < MAX_SOURCES; j++)
+            {
+                const char *Source = TestCases[i].Sources[j];
+
+                Covered = Covered ||
+                          (Source && strlen(Source) == Length - 3 &&
+                           std::strncmp(Source, Entry->d_name,
+                                        Length - 3) == 0);
+            }
+        }
+
+        if (Covered)
+            continue;
+
+        char *Name = PushArray(&Names, Length - 2, char);
+        std::memcpy(Name, Entry->d_name, Length - 3);
+        Name[Length - 3] = '\0';
+
+        test_case Case = { };
+        Case.Name = Name;
+        Case.Sources[0] = Name;
+
+        Append<test_case>(&Cases, Case);
+    }
+
+    closedir(Directory);
+
+    // Directory order isn't the same everywhere, so the ones we found go in
+    // order of name.
+    std::sort(Cases.Data + KnownCount, Cases.Data + Cases.Length,
+              [](const test_case &X, const test_case &Y)
+              {
+                  return std::strcmp(X.Name, Y.Name) < 0;
+              });
+
+
+    /** Run them. */
+
+    char TemporaryDirectory[] = "/tmp/subleq-tester-XXXXXX";
+
+    if (!mkdtemp(TemporaryDirectory))
+    {
+        Error("Failed to make a temporary directory.\n");
+        return UNKNOWN;
+    }
+
+    unsigned int RunCount = 0;
+    unsigned int FailedCount = 0;
+
+    for (unsigned int i = 0; i < Cases.Length; i++)
+    {
+        const test_case *Case = &Cases[i];
+
+        if (Options.Tests.Length &&
+            std::none_of(Options.Tests.Data,
+                         Options.Tests.Data + Options.Tests.Length,
+                         [&](const char *Name)
+                         {
+                             return std::strcmp(Name, Case->Name) == 0;
+                         }))
+        {
+            continue;
+        }
+
+        buffer<char> Messages = { };
+
+        auto Start = std::chrono::steady_clock::now();
+
+        test_result Result = ForkTest(Case, TemporaryDirectory,
+                                      Options.Timeout, &Messages);
+
+        double Milliseconds = MillisecondsSince(Start);
+
+        RunCount++;
+        FailedCount += !Result.Passed;
+
+        printf("==> Test \"%s\" %s\t%.3f ms (build %.3f",
+               Case->Name,
+               Result.Passed ? "PASSED" : "FAILED",
+               Milliseconds,
+               Result.BuildMilliseconds);
+
+        for (unsigned int j = 0; j < RUN_COUNT; j++)
+        {
+            if (Result.Ran[j])
+                printf(", %s %.3f", RunNames[j], Result.RunMilliseconds[j]);
+        }
+
+        printf(")\n");
+
+        // Only say what a test printed if it failed, a line at a time.
+        for (unsigned int j = 0; j < Messages.Length && !Result.Passed; )
+        {
+            unsigned int End = j;
+
+            while (End < Messages.Length && Messages[End] != '\n')
+                End++;
+
+            printf("\t%.*s\n", End - j, Messages.Data + j);
+
+            j = End + 1;
+        }
+
+        Empty<char>(&Messages);
+    }
+
+    rmdir(TemporaryDirectory);
+
+    if (FailedCount)
+        printf("\n\t%u / %u tests passing.\n", RunCount - FailedCount, RunCount);
+    else
+        printf("\n\tAll tests passing.\n");
+
+    Free(&Names);
+    Empty<test_case>(&Cases);
+    Empty<const char *>(&Options.Tests);
+
+    return FailedCount ? TESTS_FAILED : NORMAL;
+}